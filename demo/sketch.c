@@ -98,9 +98,9 @@ free_stroke(struct stroke_change* c) {
 }
 
 GundoActionType action_type = {
-	(GundoActionCallback)undo_stroke,
-	(GundoActionCallback)redo_stroke,
-	(GundoActionCallback)free_stroke
+	.undo = (GundoActionCallback)undo_stroke,
+	.redo = (GundoActionCallback)redo_stroke,
+	.free = (GundoActionCallback)free_stroke
 };
 
 // CHECKED // CHECKED // CHECKED // CHECKED // CHECKED // CHECKED // CHECKED //
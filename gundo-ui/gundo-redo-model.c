@@ -36,7 +36,7 @@
 #include <string.h>
 
 struct _GUndoRedoModelPrivate {
-  gint emit_n_removes;
+  guint n_rows;
 };
 
 #define PRIV(i) (((GUndoRedoModel*)(i))->_private)
@@ -51,47 +51,37 @@ gundo_redo_model_init (GUndoRedoModel* self)
 {
   PRIV (self) = G_TYPE_INSTANCE_GET_PRIVATE (self, GUNDO_TYPE_REDO_MODEL, GUndoRedoModelPrivate);
 
-  PRIV (self)->emit_n_removes = 0;
+  PRIV (self)->n_rows = 0;
 }
 
+/* applies the changes of the redoable side of the history to the rows;
+ * the latest change is on top, so positions match the rows */
 static void
-history_changed_before (GundoHistory  * history,
-                        GUndoRedoModel* self)
+history_stacks_changed (GundoHistory            * history,
+                        GundoHistoryChange const* change,
+                        GUndoRedoModel          * self)
 {
-  GtkTreePath* path = gtk_tree_path_new_from_string ("0");
-  for (PRIV (self)->emit_n_removes = gundo_history_get_n_redos (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (self)));
-       PRIV (self)->emit_n_removes;
-       PRIV (self)->emit_n_removes--)
-    {
-      gtk_tree_model_row_deleted (GTK_TREE_MODEL (self), path);
-    }
-  gtk_tree_path_free (path);
-}
+  GundoStackChange const* stack = &change->redo;
+  GtkTreePath           * path;
+  GtkTreeIter             iter;
+  guint                   i;
 
-static void
-history_redo (GundoHistory  * history,
-              GUndoRedoModel* self)
-{
-  GtkTreePath* path = gtk_tree_path_new_from_string ("0");
-  gtk_tree_model_row_deleted (GTK_TREE_MODEL (self), path);
-  gtk_tree_path_free (path);
-}
+  g_return_if_fail (stack->position + stack->n_removed <= PRIV (self)->n_rows);
 
-static void
-history_undo (GundoHistory  * history,
-              GUndoRedoModel* self)
-{
-  GtkTreePath* path = gtk_tree_path_new_from_string ("0");
-  GtkTreeIter  iter;
+  path = gtk_tree_path_new_from_indices (stack->position, -1);
 
-  if (gtk_tree_model_get_iter (GTK_TREE_MODEL (self), &iter, path))
+  for (i = 0; i < stack->n_removed; i++)
     {
-      gtk_tree_model_row_inserted (GTK_TREE_MODEL (self),
-                                   path, &iter);
+      PRIV (self)->n_rows--;
+      gtk_tree_model_row_deleted (GTK_TREE_MODEL (self), path);
     }
-  else
+
+  for (i = 0; i < stack->n_added; i++)
     {
-      g_warning ("eeek!");
+      PRIV (self)->n_rows++;
+      gtk_tree_model_get_iter (GTK_TREE_MODEL (self), &iter, path);
+      gtk_tree_model_row_inserted (GTK_TREE_MODEL (self), path, &iter);
+      gtk_tree_path_next (path);
     }
 
   gtk_tree_path_free (path);
@@ -100,9 +90,7 @@ history_undo (GundoHistory  * history,
 static void
 model_finalize (GObject* object)
 {
-  g_signal_handlers_disconnect_by_func (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), history_changed_before, object);
-  g_signal_handlers_disconnect_by_func (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), history_redo, object);
-  g_signal_handlers_disconnect_by_func (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), history_undo, object);
+  g_signal_handlers_disconnect_by_func (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), history_stacks_changed, object);
 
   G_OBJECT_CLASS (gundo_redo_model_parent_class)->finalize (object);
 }
@@ -113,12 +101,10 @@ model_notify (GObject   * object,
 {
   if (!strcmp ("history", g_param_spec_get_name (pspec)))
     {
-      g_signal_connect (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), "changed",
-                        G_CALLBACK (history_changed_before), object);
-      g_signal_connect_after (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), "redo",
-                              G_CALLBACK (history_redo), object);
-      g_signal_connect_after (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), "undo",
-                              G_CALLBACK (history_undo), object);
+      PRIV (object)->n_rows = gundo_history_get_n_redos (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)));
+
+      g_signal_connect_after (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), "stacks-changed",
+                              G_CALLBACK (history_stacks_changed), object);
     }
 
   if (G_OBJECT_CLASS (gundo_redo_model_parent_class)->notify)
@@ -210,7 +196,7 @@ model_iter_from_index (GtkTreeModel* model,
   if (index < 0)
     return FALSE;
 
-  if (index >= gundo_history_get_n_redos (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (model))) - PRIV (model)->emit_n_removes)
+  if ((guint) index >= PRIV (model)->n_rows)
     return FALSE;
 
   iter->user_data = GINT_TO_POINTER (index);
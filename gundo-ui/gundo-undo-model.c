@@ -43,6 +43,12 @@
  *   the next change gets 0, the one before 1, the last one n_changes() - 1
  */
 
+struct _GUndoUndoModelPrivate {
+  guint n_rows;
+};
+
+#define PRIV(i) (((GUndoUndoModel*)(i))->_private)
+
 static void implement_gtk_tree_model (GtkTreeModelIface* iface);
 
 G_DEFINE_TYPE_WITH_CODE (GUndoUndoModel, gundo_undo_model, GUNDO_TYPE_POPUP_MODEL,
@@ -50,36 +56,49 @@ G_DEFINE_TYPE_WITH_CODE (GUndoUndoModel, gundo_undo_model, GUNDO_TYPE_POPUP_MODE
 
 static void
 gundo_undo_model_init (GUndoUndoModel* self)
-{}
+{
+  PRIV (self) = G_TYPE_INSTANCE_GET_PRIVATE (self, GUNDO_TYPE_UNDO_MODEL, GUndoUndoModelPrivate);
 
-static void
-redo_callback (GundoHistory   * history,
-               GUndoPopupModel* self)
-{
-  GtkTreePath* path = gtk_tree_path_new_from_string ("0");
-  GtkTreeIter  iter;
-  gtk_tree_model_get_iter     (GTK_TREE_MODEL (self),
-                               &iter, path);
-  gtk_tree_model_row_inserted (GTK_TREE_MODEL (self),
-                               path, &iter);
-  gtk_tree_path_free (path);
+  PRIV (self)->n_rows = 0;
 }
 
+/* applies the changes of the undoable side of the history to the rows;
+ * the latest change is on top, so positions match the rows */
 static void
-undo_callback (GundoHistory   * history,
-               GUndoPopupModel* self)
+history_stacks_changed (GundoHistory            * history,
+                        GundoHistoryChange const* change,
+                        GUndoUndoModel          * self)
 {
-  GtkTreePath* path = gtk_tree_path_new_from_string ("0");
-  gtk_tree_model_row_deleted (GTK_TREE_MODEL (self),
-                              path);
+  GundoStackChange const* stack = &change->undo;
+  GtkTreePath           * path;
+  GtkTreeIter             iter;
+  guint                   i;
+
+  g_return_if_fail (stack->position + stack->n_removed <= PRIV (self)->n_rows);
+
+  path = gtk_tree_path_new_from_indices (stack->position, -1);
+
+  for (i = 0; i < stack->n_removed; i++)
+    {
+      PRIV (self)->n_rows--;
+      gtk_tree_model_row_deleted (GTK_TREE_MODEL (self), path);
+    }
+
+  for (i = 0; i < stack->n_added; i++)
+    {
+      PRIV (self)->n_rows++;
+      gtk_tree_model_get_iter (GTK_TREE_MODEL (self), &iter, path);
+      gtk_tree_model_row_inserted (GTK_TREE_MODEL (self), path, &iter);
+      gtk_tree_path_next (path);
+    }
+
   gtk_tree_path_free (path);
 }
 
 static void
 model_finalize (GObject* object)
 {
-  g_signal_handlers_disconnect_by_func (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), redo_callback, object);
-  g_signal_handlers_disconnect_by_func (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), undo_callback, object);
+  g_signal_handlers_disconnect_by_func (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), history_stacks_changed, object);
 
   G_OBJECT_CLASS (gundo_undo_model_parent_class)->finalize (object);
 }
@@ -90,12 +109,10 @@ model_notify (GObject   * object,
 {
   if (!strcmp ("history", g_param_spec_get_name (pspec)))
     {
-      g_signal_connect_after (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), "changed",
-                              G_CALLBACK (redo_callback), object);
-      g_signal_connect_after (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), "redo",
-                              G_CALLBACK (redo_callback), object);
-      g_signal_connect_after (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), "undo",
-                              G_CALLBACK (undo_callback), object);
+      PRIV (object)->n_rows = gundo_history_get_position (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)));
+
+      g_signal_connect_after (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (object)), "stacks-changed",
+                              G_CALLBACK (history_stacks_changed), object);
     }
 
   if (G_OBJECT_CLASS (gundo_undo_model_parent_class)->notify)
@@ -111,6 +128,8 @@ gundo_undo_model_class_init (GUndoUndoModelClass* self_class)
 
   object_class->finalize = model_finalize;
   object_class->notify   = model_notify;
+
+  g_type_class_add_private (self_class, sizeof (GUndoUndoModelPrivate));
 }
 
 /**
@@ -164,7 +183,7 @@ model_iter_from_index (GtkTreeModel* model,
 {
   iter->user_data = GINT_TO_POINTER (index);
 
-  return GPOINTER_TO_INT (iter->user_data) < gundo_history_get_n_undos (gundo_popup_model_get_history (GUNDO_POPUP_MODEL (model)));
+  return index < PRIV (model)->n_rows;
 }
 
 static gboolean
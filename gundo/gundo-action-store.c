@@ -0,0 +1,191 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gundo-action-store.h"
+
+#include <string.h>
+
+#define BLOCK_SIZE GUNDO_ACTION_STORE_BLOCK_SIZE
+
+GundoActionStore*
+gundo_action_store_new (void)
+{
+  return g_slice_new0 (GundoActionStore);
+}
+
+static void
+store_free_block (GundoActionStore* self,
+                  UndoAction      * block)
+{
+  /* keep one block around so an add/undo cycle on a block boundary doesn't
+   * keep hitting the allocator */
+  if (!self->spare)
+    self->spare = block;
+  else
+    g_free (block);
+}
+
+void
+gundo_action_store_free (GundoActionStore* self)
+{
+  guint i;
+
+  for (i = 0; i < self->n_blocks; i++)
+    g_free (self->blocks[i]);
+
+  g_free (self->spare);
+  g_free (self->blocks);
+  g_slice_free (GundoActionStore, self);
+}
+
+static guint
+store_get_capacity (GundoActionStore* self)
+{
+  return self->n_blocks * BLOCK_SIZE - self->head;
+}
+
+static void
+store_add_block (GundoActionStore* self)
+{
+  if (self->n_blocks == self->blocks_size)
+    {
+      /* only the block table gets copied, never the records */
+      self->blocks_size = MAX (4, self->blocks_size * 2);
+      self->blocks = g_renew (UndoAction*, self->blocks, self->blocks_size);
+    }
+
+  if (self->spare)
+    {
+      self->blocks[self->n_blocks++] = self->spare;
+      self->spare = NULL;
+    }
+  else
+    {
+      self->blocks[self->n_blocks++] = g_new (UndoAction, BLOCK_SIZE);
+    }
+}
+
+/* makes sure @n_actions more records can be appended without allocating;
+ * truncating the store keeps the blocks until the reservation is used up */
+void
+gundo_action_store_reserve (GundoActionStore* self,
+                            guint             n_actions)
+{
+  self->reserved = MAX (self->reserved, self->len + n_actions);
+
+  while (store_get_capacity (self) < self->reserved)
+    store_add_block (self);
+}
+
+void
+gundo_action_store_append (GundoActionStore* self,
+                           UndoAction const* action)
+{
+  if (store_get_capacity (self) == self->len)
+    {
+      /* growing past the reserved blocks means they are all in use */
+      self->reserved = 0;
+      store_add_block (self);
+    }
+
+  *gundo_action_store_index (self, self->len) = *action;
+  self->len++;
+}
+
+/* drops the oldest @n_actions records; they need to be freed already */
+void
+gundo_action_store_drop_head (GundoActionStore* self,
+                              guint             n_actions)
+{
+  guint n_free;
+  guint i;
+
+  g_return_if_fail (n_actions <= self->len);
+
+  self->head += n_actions;
+  self->len  -= n_actions;
+  self->reserved -= MIN (self->reserved, n_actions);
+
+  n_free = self->head / BLOCK_SIZE;
+  if (!n_free)
+    return;
+
+  for (i = 0; i < n_free; i++)
+    store_free_block (self, self->blocks[i]);
+
+  memmove (self->blocks, self->blocks + n_free, (self->n_blocks - n_free) * sizeof (UndoAction*));
+  self->n_blocks -= n_free;
+  self->head     -= n_free * BLOCK_SIZE;
+}
+
+void
+gundo_action_store_truncate (GundoActionStore* self,
+                             guint             len)
+{
+  guint n_used;
+
+  g_return_if_fail (len <= self->len);
+
+  self->len = len;
+
+  /* hand back the blocks behind the last record, unless they were
+   * reserved */
+  n_used = (self->head + MAX (len, self->reserved) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  while (self->n_blocks > n_used)
+    store_free_block (self, self->blocks[--self->n_blocks]);
+}
+
+/* removes a range of (already freed) records, the records behind it move
+ * to @index. Whichever side of the range is shorter gets moved, so cutting
+ * the redo tail in front of a big group only moves the undoable records if
+ * there are fewer of them. */
+void
+gundo_action_store_remove_range (GundoActionStore* self,
+                                 guint             index,
+                                 guint             n_actions)
+{
+  guint n_behind;
+  guint i;
+
+  g_return_if_fail (index + n_actions <= self->len);
+
+  n_behind = self->len - index - n_actions;
+
+  if (index < n_behind)
+    {
+      for (i = index; i > 0; i--)
+        {
+          *gundo_action_store_index (self, i - 1 + n_actions) = *gundo_action_store_index (self, i - 1);
+        }
+
+      gundo_action_store_drop_head (self, n_actions);
+      return;
+    }
+
+  for (i = index + n_actions; i < self->len; i++)
+    {
+      *gundo_action_store_index (self, i - n_actions) = *gundo_action_store_index (self, i);
+    }
+
+  gundo_action_store_truncate (self, self->len - n_actions);
+}
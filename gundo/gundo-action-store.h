@@ -0,0 +1,79 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GUNDO_ACTION_STORE_H
+#define GUNDO_ACTION_STORE_H
+
+#include <gundo-sequence.h>
+
+G_BEGIN_DECLS
+
+/* The action store is the private container behind the action records of
+ * a GundoSequence. The records live in fixed-size blocks, so growing the
+ * store never copies records around and records can be dropped from either
+ * end without moving the remaining ones. Blocks that run empty are handed
+ * back to the allocator, unless gundo_action_store_reserve() set them
+ * aside. */
+
+typedef struct _UndoAction       UndoAction;
+typedef struct _GundoActionStore GundoActionStore;
+
+struct _UndoAction {
+    const GundoActionType *type;
+    gpointer data;
+};
+
+#define GUNDO_ACTION_STORE_BLOCK_SHIFT 8
+#define GUNDO_ACTION_STORE_BLOCK_SIZE  (1 << GUNDO_ACTION_STORE_BLOCK_SHIFT)
+
+struct _GundoActionStore {
+    UndoAction** blocks;
+    guint        n_blocks;
+    guint        blocks_size;
+    UndoAction * spare;
+    guint        head;
+    guint        len;
+    guint        reserved; /* records kept room for by the last reserve() */
+};
+
+#define gundo_action_store_index(store, i) \
+        (&(store)->blocks[((store)->head + (i)) >> GUNDO_ACTION_STORE_BLOCK_SHIFT] \
+                         [((store)->head + (i)) & (GUNDO_ACTION_STORE_BLOCK_SIZE - 1)])
+
+GundoActionStore* gundo_action_store_new         (void);
+void              gundo_action_store_free        (GundoActionStore* self);
+void              gundo_action_store_reserve     (GundoActionStore* self,
+                                                  guint             n_actions);
+void              gundo_action_store_append      (GundoActionStore* self,
+                                                  UndoAction const* action);
+void              gundo_action_store_drop_head   (GundoActionStore* self,
+                                                  guint             n_actions);
+void              gundo_action_store_remove_range(GundoActionStore* self,
+                                                  guint             index,
+                                                  guint             n_actions);
+void              gundo_action_store_truncate    (GundoActionStore* self,
+                                                  guint             len);
+
+G_END_DECLS
+
+#endif /* !GUNDO_ACTION_STORE_H */
@@ -0,0 +1,72 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gundo-branch.h"
+
+GundoBranch*
+gundo_branch_new (guint id,
+                  guint depth)
+{
+  GundoBranch* self = g_slice_new0 (GundoBranch);
+
+  self->id      = id;
+  self->depth   = depth;
+  self->actions = gundo_action_store_new ();
+
+  return self;
+}
+
+/* the records have to be freed (or moved elsewhere) by the sequence */
+void
+gundo_branch_free (GundoBranch* self)
+{
+  g_return_if_fail (!self->n_children);
+
+  gundo_branch_set_parent (self, NULL);
+  gundo_action_store_free (self->actions);
+
+  g_slice_free (GundoBranch, self);
+}
+
+void
+gundo_branch_set_parent (GundoBranch* self,
+                         GundoBranch* parent)
+{
+  if (self->parent)
+    self->parent->n_children--;
+
+  self->parent = parent;
+
+  if (parent)
+    parent->n_children++;
+}
+
+/* the ancestor of @self (or @self) that forks off the line */
+GundoBranch*
+gundo_branch_get_root (GundoBranch* self)
+{
+  while (self->parent)
+    self = self->parent;
+
+  return self;
+}
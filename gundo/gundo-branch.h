@@ -0,0 +1,61 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GUNDO_BRANCH_H
+#define GUNDO_BRANCH_H
+
+#include "gundo-action-store.h"
+
+G_BEGIN_DECLS
+
+/* A branch keeps steps that were cut off the line of a GundoSequence with
+ * #GundoSequence:branching set: the redo tail truncated by a new action, or
+ * the rest of the line left behind when switching to another branch. The
+ * branches form a tree. A branch forks off its parent after @depth steps,
+ * counted from the oldest step of the sequence; a branch without parent
+ * forks off the line itself. The steps a branch shares with its parent
+ * are only stored in the parent, so every branch ends in a tip of its own. */
+
+typedef struct _GundoBranch GundoBranch;
+
+struct _GundoBranch {
+  GundoBranch     * parent;
+  guint             n_children;
+  guint             id;
+  guint             depth;    /* the number of steps before the first one */
+  guint             n_steps;
+  guint64           age;      /* when the branch was cut off the line */
+  GundoActionStore* actions;
+  GundoMemoryUsage  usage;
+};
+
+GundoBranch* gundo_branch_new        (guint        id,
+                                      guint        depth);
+void         gundo_branch_free       (GundoBranch* self);
+void         gundo_branch_set_parent (GundoBranch* self,
+                                      GundoBranch* parent);
+GundoBranch* gundo_branch_get_root   (GundoBranch* self);
+
+G_END_DECLS
+
+#endif /* !GUNDO_BRANCH_H */
@@ -0,0 +1,345 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gundo-checkpoints.h"
+
+#include "gundo-stats.h"
+
+/* a new measurement weighs a quarter of an average, so the averages follow
+ * actions that get slower or faster without jumping on every outlier */
+#define AVERAGE(average, ns) ((average) ? (average) - (average) / 4 + (ns) / 4 : (ns))
+
+typedef struct {
+  guint    position;
+  gpointer snapshot;
+} Checkpoint;
+
+struct _GundoCheckpoints {
+  GundoSnapshotFunc snapshot;
+  GundoRestoreFunc  restore;
+  GDestroyNotify    free_snapshot;
+  gpointer          user_data;
+  GDestroyNotify    destroy;
+
+  GArray          * checkpoints;    /* sorted by position */
+  GHashTable      * costs;          /* the average latency of the callbacks
+                                     * of each action type */
+  guint64           step_cost;      /* the average cost of replaying a step */
+  guint64           restore_cost;   /* the average latency of restore */
+  guint64           walk_cost;      /* the average cost of passing a step on
+                                     * the way to a checkpoint */
+  guint             pending_steps;  /* stepped over since the last checkpoint */
+  guint64           pending_cost;
+};
+
+GundoCheckpoints*
+gundo_checkpoints_new (GundoSnapshotFunc snapshot,
+                       GundoRestoreFunc  restore,
+                       GDestroyNotify    free_snapshot,
+                       gpointer          user_data,
+                       GDestroyNotify    destroy)
+{
+  GundoCheckpoints* self = g_slice_new0 (GundoCheckpoints);
+
+  self->snapshot      = snapshot;
+  self->restore       = restore;
+  self->free_snapshot = free_snapshot;
+  self->user_data     = user_data;
+  self->destroy       = destroy;
+  self->checkpoints   = g_array_new (FALSE, FALSE, sizeof (Checkpoint));
+  self->costs         = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+  return self;
+}
+
+void
+gundo_checkpoints_free (GundoCheckpoints* self)
+{
+  gundo_checkpoints_drop_from (self, 0);
+  g_array_free (self->checkpoints, TRUE);
+  g_hash_table_destroy (self->costs);
+
+  if (self->destroy)
+    self->destroy (self->user_data);
+
+  g_slice_free (GundoCheckpoints, self);
+}
+
+/* the index of the first checkpoint at @position or later */
+static guint
+checkpoints_search (GundoCheckpoints* self,
+                    guint             position)
+{
+  guint low  = 0;
+  guint high = self->checkpoints->len;
+
+  while (low < high)
+    {
+      guint middle = low + (high - low) / 2;
+
+      if (g_array_index (self->checkpoints, Checkpoint, middle).position < position)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  return low;
+}
+
+static gboolean
+checkpoints_has (GundoCheckpoints* self,
+                 guint             position,
+                 guint           * index)
+{
+  *index = checkpoints_search (self, position);
+
+  return *index < self->checkpoints->len &&
+         g_array_index (self->checkpoints, Checkpoint, *index).position == position;
+}
+
+/* frees the snapshots of the checkpoints [@index, @index + @n) and removes
+ * them */
+static void
+checkpoints_remove (GundoCheckpoints* self,
+                    guint             index,
+                    guint             n)
+{
+  guint i;
+
+  if (!n)
+    return;
+
+  if (self->free_snapshot)
+    for (i = index; i < index + n; i++)
+      self->free_snapshot (g_array_index (self->checkpoints, Checkpoint, i).snapshot);
+
+  g_array_remove_range (self->checkpoints, index, n);
+}
+
+/* takes the latency @ns of an undo or redo callback of @type into its
+ * average */
+void
+gundo_checkpoints_measure (GundoCheckpoints     * self,
+                           GundoActionType const* type,
+                           guint64                ns)
+{
+  guint64* average = g_hash_table_lookup (self->costs, type);
+
+  if (!average)
+    {
+      average = g_new0 (guint64, 1);
+      g_hash_table_insert (self->costs, (gpointer) type, average);
+    }
+
+  *average = AVERAGE (*average, ns);
+}
+
+/* what undoing or redoing an action of @type is expected to cost, 0 if it
+ * was never measured */
+guint64
+gundo_checkpoints_estimate (GundoCheckpoints     * self,
+                            GundoActionType const* type)
+{
+  guint64* average = g_hash_table_lookup (self->costs, type);
+
+  return average ? *average : 0;
+}
+
+/* notes that a step costing @cost got to @position; the cost of a step
+ * that was actually replayed (@measured) also goes into the average cost
+ * of a step, which far jumps are planned with */
+void
+gundo_checkpoints_add_cost (GundoCheckpoints* self,
+                            guint             position,
+                            guint64           cost,
+                            gboolean          measured)
+{
+  guint index;
+
+  if (measured)
+    self->step_cost = AVERAGE (self->step_cost, cost);
+
+  if (checkpoints_has (self, position, &index))
+    {
+      self->pending_steps = 0;
+      self->pending_cost  = 0;
+      return;
+    }
+
+  self->pending_steps++;
+  self->pending_cost += cost;
+}
+
+/* whether the steps since the last checkpoint make up @interval steps or
+ * cost @max_cost nanoseconds; 0 disables either limit */
+gboolean
+gundo_checkpoints_is_due (GundoCheckpoints* self,
+                          guint             interval,
+                          guint64           max_cost)
+{
+  return (interval && self->pending_steps >= interval) ||
+         (max_cost && self->pending_cost >= max_cost);
+}
+
+/* snapshots the state of the application as the one at @position */
+void
+gundo_checkpoints_take (GundoCheckpoints* self,
+                        guint             position,
+                        guint             max_checkpoints)
+{
+  Checkpoint checkpoint;
+  guint      index;
+
+  self->pending_steps = 0;
+  self->pending_cost  = 0;
+
+  if (checkpoints_has (self, position, &index))
+    return;
+
+  checkpoint.position = position;
+  checkpoint.snapshot = self->snapshot (self->user_data);
+  g_array_insert_val (self->checkpoints, index, checkpoint);
+
+  gundo_checkpoints_thin (self, max_checkpoints);
+}
+
+/* looks for a checkpoint that gets to @to cheaper than replaying the steps
+ * from @from does, counting the walk from @from to the checkpoint as well.
+ * Without measurements, that is the one closest to @to, if it is closer
+ * than @from. */
+gboolean
+gundo_checkpoints_find (GundoCheckpoints* self,
+                        guint             from,
+                        guint             to,
+                        guint           * position)
+{
+  guint index = checkpoints_search (self, to);
+  guint direct = from > to ? from - to : to - from;
+  guint best = G_MAXUINT;
+  guint distance = G_MAXUINT;
+  guint walk;
+
+  if (index < self->checkpoints->len)
+    {
+      best     = g_array_index (self->checkpoints, Checkpoint, index).position;
+      distance = best - to;
+    }
+  if (index > 0 &&
+      to - g_array_index (self->checkpoints, Checkpoint, index - 1).position < distance)
+    {
+      best     = g_array_index (self->checkpoints, Checkpoint, index - 1).position;
+      distance = to - best;
+    }
+
+  if (distance >= direct)
+    return FALSE;
+  walk = from > best ? from - best : best - from;
+  if (self->step_cost &&
+      self->restore_cost + walk * self->walk_cost + distance * self->step_cost >=
+      direct * self->step_cost)
+    return FALSE;
+
+  *position = best;
+  return TRUE;
+}
+
+/* measures the walk over @n_steps steps to a checkpoint, which took @ns */
+void
+gundo_checkpoints_measure_walk (GundoCheckpoints* self,
+                                guint             n_steps,
+                                guint64           ns)
+{
+  if (n_steps)
+    self->walk_cost = AVERAGE (self->walk_cost, ns / n_steps);
+}
+
+/* hands the snapshot at @position back to the application */
+void
+gundo_checkpoints_restore (GundoCheckpoints* self,
+                           guint             position)
+{
+  guint   index;
+  guint64 start;
+
+  if (!checkpoints_has (self, position, &index))
+    g_return_if_reached ();
+
+  start = gundo_stats_now ();
+  self->restore (g_array_index (self->checkpoints, Checkpoint, index).snapshot, self->user_data);
+  self->restore_cost = AVERAGE (self->restore_cost, gundo_stats_now () - start);
+
+  self->pending_steps = 0;
+  self->pending_cost  = 0;
+}
+
+/* drops the checkpoints of the states before @position */
+void
+gundo_checkpoints_drop_before (GundoCheckpoints* self,
+                               guint             position)
+{
+  checkpoints_remove (self, 0, checkpoints_search (self, position));
+}
+
+/* drops the checkpoints of the states from @position on */
+void
+gundo_checkpoints_drop_from (GundoCheckpoints* self,
+                             guint             position)
+{
+  guint index = checkpoints_search (self, position);
+
+  checkpoints_remove (self, index, self->checkpoints->len - index);
+}
+
+/* drops checkpoints until there are at most @max_checkpoints (0 for no
+ * limit). The oldest and the latest one are kept as long as possible; of
+ * the others, the one whose neighbours are closest goes first, which
+ * keeps the rest spread over the history. */
+void
+gundo_checkpoints_thin (GundoCheckpoints* self,
+                        guint             max_checkpoints)
+{
+  while (max_checkpoints && self->checkpoints->len > max_checkpoints)
+    {
+      Checkpoint const* checkpoints = (Checkpoint const*) self->checkpoints->data;
+      guint             drop = 0;
+      guint             gap = G_MAXUINT;
+      guint             i;
+
+      for (i = 1; i + 1 < self->checkpoints->len; i++)
+        {
+          if (checkpoints[i + 1].position - checkpoints[i - 1].position < gap)
+            {
+              gap  = checkpoints[i + 1].position - checkpoints[i - 1].position;
+              drop = i;
+            }
+        }
+
+      checkpoints_remove (self, drop, 1);
+    }
+}
+
+guint
+gundo_checkpoints_get_n (GundoCheckpoints* self)
+{
+  return self->checkpoints->len;
+}
@@ -0,0 +1,86 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+
+#ifndef GUNDO_CHECKPOINTS_H
+#define GUNDO_CHECKPOINTS_H
+
+#include <gundo-sequence.h>
+
+G_BEGIN_DECLS
+
+/* The checkpoints are snapshots of the state of the application, taken by
+ * the snapshot callback it registered on a GundoSequence, so a far jump
+ * can restore the nearest one and only replay the steps from there. They
+ * are kept sorted by their position, counted from the oldest step ever
+ * added (evicted ones included), so evicting doesn't move them.
+ *
+ * When to take the next one depends on what replaying the steps since the
+ * last one would cost: each undo and redo callback is measured, and the
+ * latencies are averaged per action type. New steps are estimated from
+ * these averages, so a sequence of expensive actions gets checkpoints more
+ * often than one of cheap actions. */
+
+typedef struct _GundoCheckpoints GundoCheckpoints;
+
+GundoCheckpoints* gundo_checkpoints_new         (GundoSnapshotFunc       snapshot,
+                                                 GundoRestoreFunc        restore,
+                                                 GDestroyNotify          free_snapshot,
+                                                 gpointer                user_data,
+                                                 GDestroyNotify          destroy);
+void              gundo_checkpoints_free        (GundoCheckpoints      * self);
+void              gundo_checkpoints_measure     (GundoCheckpoints      * self,
+                                                 GundoActionType const * type,
+                                                 guint64                 ns);
+guint64           gundo_checkpoints_estimate    (GundoCheckpoints      * self,
+                                                 GundoActionType const * type);
+void              gundo_checkpoints_add_cost    (GundoCheckpoints      * self,
+                                                 guint                   position,
+                                                 guint64                 cost,
+                                                 gboolean                measured);
+gboolean          gundo_checkpoints_is_due      (GundoCheckpoints      * self,
+                                                 guint                   interval,
+                                                 guint64                 max_cost);
+void              gundo_checkpoints_take        (GundoCheckpoints      * self,
+                                                 guint                   position,
+                                                 guint                   max_checkpoints);
+gboolean          gundo_checkpoints_find        (GundoCheckpoints      * self,
+                                                 guint                   from,
+                                                 guint                   to,
+                                                 guint                 * position);
+void              gundo_checkpoints_measure_walk (GundoCheckpoints     * self,
+                                                 guint                   n_steps,
+                                                 guint64                 ns);
+void              gundo_checkpoints_restore     (GundoCheckpoints      * self,
+                                                 guint                   position);
+void              gundo_checkpoints_drop_before (GundoCheckpoints      * self,
+                                                 guint                   position);
+void              gundo_checkpoints_drop_from   (GundoCheckpoints      * self,
+                                                 guint                   position);
+void              gundo_checkpoints_thin        (GundoCheckpoints      * self,
+                                                 guint                   max_checkpoints);
+guint             gundo_checkpoints_get_n       (GundoCheckpoints      * self);
+
+G_END_DECLS
+
+#endif /* !GUNDO_CHECKPOINTS_H */
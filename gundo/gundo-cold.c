@@ -0,0 +1,654 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gundo-cold.h"
+
+#include <string.h>
+#include <gio/gio.h>
+
+#include "gundo-stats.h"
+
+/* a full batch gets compressed; bigger batches compress better, but
+ * loading a record back inflates its whole batch */
+#define BATCH_SIZE (64 * 1024)
+
+/* smaller actions would cost more as an entry than they save */
+#define MIN_LEN    64
+
+/* only the open batch is never looked at by the worker, so the state of
+ * the others may only be read with the mutex held */
+typedef enum {
+  BATCH_OPEN,    /* being appended to */
+  BATCH_QUEUED,  /* waiting for or in the hands of the worker */
+  BATCH_DONE
+} BatchState;
+
+typedef struct _ColdBatch ColdBatch;
+
+struct _ColdBatch {
+  ColdBatch * prev;       /* in the list of queued and done batches */
+  ColdBatch * next;
+  BatchState  state;
+  guint       n_live;     /* the entries still pointing here */
+  GByteArray* raw;        /* the serialized actions, until they are
+                           * compressed; kept if compressing didn't help */
+  guint8    * compressed;
+  gsize       raw_len;
+  gsize       compressed_len;
+};
+
+typedef struct {
+  ColdBatch            * batch;
+  GundoActionType const* type;
+  guint32                offset;
+  guint32                len       : 31;
+  guint32                is_inline : 1;
+} ColdEntry;
+
+struct _GundoCold {
+  GThread          * worker;
+  ColdBatch        * open;
+  GZlibDecompressor* decompressor;
+  ColdBatch        * cached;     /* the batch inflated into the cache */
+  GByteArray       * cache;
+  guint64            n_entries;
+  GundoActionStats   decompress;
+
+  /* everything below is protected by the mutex */
+  GMutex             mutex;
+  GCond              cond;       /* wakes the worker */
+  GCond              idle_cond;  /* signalled after each batch */
+  GQueue             queue;
+  ColdBatch        * batches;
+  guint              n_queued;
+  gsize              queued_bytes;
+  guint64            raw_bytes;
+  guint64            compressed_bytes;
+  gboolean           closing;
+};
+
+/* cold records are loaded back before they get undone or redone, and the
+ * sequence forgets their entries before discarding them */
+GundoActionType const gundo_cold_type = {
+  .undo = NULL,
+  .redo = NULL,
+  .free = NULL
+};
+
+static gpointer
+cold_worker (gpointer data);
+
+GundoCold*
+gundo_cold_new (void)
+{
+  GundoCold* self = g_slice_new0 (GundoCold);
+
+  self->decompressor = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW);
+  self->cache        = g_byte_array_new ();
+  g_mutex_init (&self->mutex);
+  g_cond_init (&self->cond);
+  g_cond_init (&self->idle_cond);
+  g_queue_init (&self->queue);
+
+  self->worker = g_thread_new ("gundo-compress", cold_worker, self);
+
+  return self;
+}
+
+static ColdBatch*
+cold_batch_new (void)
+{
+  ColdBatch* batch = g_slice_new0 (ColdBatch);
+
+  batch->state = BATCH_OPEN;
+  batch->raw   = g_byte_array_new ();
+
+  return batch;
+}
+
+static void
+cold_batch_free (ColdBatch* batch)
+{
+  if (batch->raw)
+    g_byte_array_free (batch->raw, TRUE);
+  g_free (batch->compressed);
+  g_slice_free (ColdBatch, batch);
+}
+
+/* unlinks a queued or done batch; called with the mutex held */
+static void
+cold_unlink (GundoCold* self,
+             ColdBatch* batch)
+{
+  if (batch->prev)
+    batch->prev->next = batch->next;
+  else
+    self->batches = batch->next;
+  if (batch->next)
+    batch->next->prev = batch->prev;
+}
+
+/* entries still around become invalid */
+void
+gundo_cold_free (GundoCold* self)
+{
+  g_mutex_lock (&self->mutex);
+  self->closing = TRUE;
+  g_cond_signal (&self->cond);
+  g_mutex_unlock (&self->mutex);
+
+  g_thread_join (self->worker);
+
+  while (self->batches)
+    {
+      ColdBatch* batch = self->batches;
+
+      self->batches = batch->next;
+      cold_batch_free (batch);
+    }
+  if (self->open)
+    cold_batch_free (self->open);
+
+  g_queue_clear (&self->queue);
+  g_cond_clear (&self->idle_cond);
+  g_cond_clear (&self->cond);
+  g_mutex_clear (&self->mutex);
+  g_object_unref (self->decompressor);
+  g_byte_array_free (self->cache, TRUE);
+  g_slice_free (GundoCold, self);
+}
+
+/* hands the open batch to the worker */
+static void
+cold_queue_open (GundoCold* self)
+{
+  ColdBatch* batch = self->open;
+
+  if (!batch || !batch->n_live)
+    return;
+
+  self->open     = NULL;
+  batch->state   = BATCH_QUEUED;
+  batch->raw_len = batch->raw->len;
+
+  g_mutex_lock (&self->mutex);
+  batch->next = self->batches;
+  if (self->batches)
+    self->batches->prev = batch;
+  self->batches = batch;
+  g_queue_push_tail (&self->queue, batch);
+  self->n_queued++;
+  self->queued_bytes += batch->raw_len;
+  g_cond_signal (&self->cond);
+  g_mutex_unlock (&self->mutex);
+}
+
+/* moves the payload of @action into the open batch; returns FALSE if it
+ * stays where it is, because its type can't be (de)serialized or it is too
+ * small to be worth it. The caller frees the payload @action held before */
+gboolean
+gundo_cold_add (GundoCold * self,
+                UndoAction* action)
+{
+  GundoActionType const* type = action->type;
+  ColdBatch            * batch;
+  ColdEntry            * entry;
+  gsize                  offset;
+  gsize                  len;
+
+  if (!self->open)
+    self->open = cold_batch_new ();
+  batch  = self->open;
+  offset = batch->raw->len;
+
+  if (type == &gundo_payload_arena_type)
+    {
+      len = gundo_payload_arena_get_len (action->data);
+      if (len < MIN_LEN || len > G_MAXINT32 - offset)
+        return FALSE;
+      g_byte_array_append (batch->raw, gundo_payload_arena_get_payload (action->data), len);
+    }
+  else if (type->serialize && type->deserialize)
+    {
+      type->serialize (action->data, batch->raw);
+      len = batch->raw->len - offset;
+      if (len < MIN_LEN || len > G_MAXINT32 - offset)
+        {
+          g_byte_array_set_size (batch->raw, offset);
+          return FALSE;
+        }
+    }
+  else
+    {
+      return FALSE;
+    }
+
+  entry = g_slice_new (ColdEntry);
+  entry->batch     = batch;
+  entry->offset    = offset;
+  entry->len       = len;
+  entry->is_inline = type == &gundo_payload_arena_type;
+  entry->type      = entry->is_inline ? gundo_payload_arena_get_type (action->data) : type;
+
+  action->type = &gundo_cold_type;
+  action->data = entry;
+
+  batch->n_live++;
+  self->n_entries++;
+
+  if (batch->raw->len >= BATCH_SIZE)
+    cold_queue_open (self);
+
+  return TRUE;
+}
+
+/* deflates @len @bytes; returns NULL if that doesn't make them smaller */
+static guint8*
+cold_compress (GConverter  * compressor,
+               guint8 const* bytes,
+               gsize         len,
+               gsize       * compressed_len)
+{
+  guint8* out = g_malloc (len);
+  gsize   n_read = 0;
+  gsize   n_written = 0;
+
+  g_converter_reset (compressor);
+
+  for (;;)
+    {
+      GConverterResult result;
+      gsize            read;
+      gsize            written;
+
+      if (n_written == len)
+        break;
+
+      result = g_converter_convert (compressor, bytes + n_read, len - n_read,
+                                    out + n_written, len - n_written,
+                                    G_CONVERTER_INPUT_AT_END, &read, &written, NULL);
+      n_read    += read;
+      n_written += written;
+
+      if (result == G_CONVERTER_FINISHED)
+        {
+          *compressed_len = n_written;
+          return g_realloc (out, n_written);
+        }
+      if (result == G_CONVERTER_ERROR)
+        break;
+    }
+
+  g_free (out);
+  return NULL;
+}
+
+/* the worker thread: compresses the queued batches, oldest first */
+static gpointer
+cold_worker (gpointer data)
+{
+  GundoCold      * self = data;
+  GZlibCompressor* compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW, -1);
+
+  g_mutex_lock (&self->mutex);
+
+  for (;;)
+    {
+      ColdBatch* batch;
+      guint8   * compressed;
+      gsize      compressed_len = 0;
+
+      while (!self->closing && g_queue_is_empty (&self->queue))
+        g_cond_wait (&self->cond, &self->mutex);
+
+      if (self->closing)
+        break;
+
+      /* the raw bytes of a queued batch don't change, so they can be read
+       * without the mutex */
+      batch = g_queue_pop_head (&self->queue);
+      g_mutex_unlock (&self->mutex);
+      compressed = cold_compress (G_CONVERTER (compressor), batch->raw->data,
+                                  batch->raw_len, &compressed_len);
+      g_mutex_lock (&self->mutex);
+
+      self->n_queued--;
+      self->queued_bytes -= batch->raw_len;
+
+      if (!batch->n_live)
+        {
+          /* all of its entries were forgotten in the meantime */
+          cold_unlink (self, batch);
+          g_free (compressed);
+          cold_batch_free (batch);
+        }
+      else
+        {
+          if (compressed)
+            {
+              g_byte_array_free (batch->raw, TRUE);
+              batch->raw            = NULL;
+              batch->compressed     = compressed;
+              batch->compressed_len = compressed_len;
+            }
+          batch->state = BATCH_DONE;
+          self->raw_bytes        += batch->raw_len;
+          self->compressed_bytes += compressed ? compressed_len : batch->raw_len;
+        }
+
+      g_cond_broadcast (&self->idle_cond);
+    }
+
+  g_mutex_unlock (&self->mutex);
+  g_object_unref (compressor);
+
+  return NULL;
+}
+
+/* inflates @batch into the cache, unless it is there already; fails if
+ * the compressed bytes are damaged */
+static gboolean
+cold_inflate (GundoCold* self,
+              ColdBatch* batch,
+              GError   ** error)
+{
+  gsize   n_read = 0;
+  gsize   n_written = 0;
+  guint64 start;
+
+  if (self->cached == batch)
+    return TRUE;
+
+  start = gundo_stats_now ();
+
+  self->cached = NULL;
+  g_byte_array_set_size (self->cache, batch->raw_len);
+  g_converter_reset (G_CONVERTER (self->decompressor));
+
+  for (;;)
+    {
+      GConverterResult result;
+      gsize            read;
+      gsize            written;
+
+      result = g_converter_convert (G_CONVERTER (self->decompressor),
+                                    batch->compressed + n_read, batch->compressed_len - n_read,
+                                    self->cache->data + n_written, batch->raw_len - n_written,
+                                    G_CONVERTER_INPUT_AT_END, &read, &written, NULL);
+      n_read    += read;
+      n_written += written;
+
+      if (result == G_CONVERTER_FINISHED)
+        break;
+      if (result == G_CONVERTER_ERROR || n_written == batch->raw_len)
+        {
+          g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                               "a compressed batch of undo actions is damaged");
+          return FALSE;
+        }
+    }
+
+  self->cached = batch;
+  gundo_stats_add (&self->decompress, gundo_stats_now () - start);
+
+  return TRUE;
+}
+
+/* drops a reference of @entry to its batch, freeing the batch with its
+ * last entry (or leaving that to the worker if it has the batch) */
+static void
+cold_release (GundoCold* self,
+              ColdEntry* entry)
+{
+  ColdBatch* batch = entry->batch;
+
+  g_slice_free (ColdEntry, entry);
+  self->n_entries--;
+
+  if (batch == self->open)
+    {
+      /* the open batch gets reused */
+      if (!--batch->n_live)
+        g_byte_array_set_size (batch->raw, 0);
+      return;
+    }
+
+  g_mutex_lock (&self->mutex);
+  if (!--batch->n_live && batch->state == BATCH_DONE)
+    {
+      cold_unlink (self, batch);
+      self->raw_bytes        -= batch->raw_len;
+      self->compressed_bytes -= batch->compressed ? batch->compressed_len : batch->raw_len;
+      if (self->cached == batch)
+        self->cached = NULL;
+      cold_batch_free (batch);
+    }
+  g_mutex_unlock (&self->mutex);
+}
+
+/* restores the action of @entry from @bytes, the bytes of its batch;
+ * fails if the action can't be deserialized */
+static gboolean
+cold_restore (ColdEntry const  * entry,
+              guint8 const     * bytes,
+              GundoPayloadArena* payloads,
+              UndoAction       * action,
+              GError          ** error)
+{
+  gpointer data;
+
+  if (entry->is_inline)
+    {
+      action->type = &gundo_payload_arena_type;
+      action->data = gundo_payload_arena_add (payloads, entry->type,
+                                              bytes + entry->offset, entry->len);
+      return TRUE;
+    }
+
+  data = entry->type->deserialize (bytes + entry->offset, entry->len);
+  if (!data)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                           "a compressed undo action can't be deserialized");
+      return FALSE;
+    }
+
+  action->type = entry->type;
+  action->data = data;
+  return TRUE;
+}
+
+/* turns the placeholder @action back into the real record, like
+ * gundo_spill_load() does; if the batch is damaged or the action can't be
+ * deserialized, @action stays a placeholder */
+gboolean
+gundo_cold_load (GundoCold        * self,
+                 GundoPayloadArena* payloads,
+                 UndoAction       * action,
+                 GError          ** error)
+{
+  ColdEntry* entry = action->data;
+  ColdBatch* batch = entry->batch;
+  gboolean   result;
+
+  if (batch == self->open)
+    {
+      result = cold_restore (entry, batch->raw->data, payloads, action, error);
+    }
+  else
+    {
+      /* the worker drops the raw bytes once it has compressed them */
+      g_mutex_lock (&self->mutex);
+      if (batch->raw)
+        {
+          result = cold_restore (entry, batch->raw->data, payloads, action, error);
+          g_mutex_unlock (&self->mutex);
+        }
+      else
+        {
+          g_mutex_unlock (&self->mutex);
+          result = cold_inflate (self, batch, error) &&
+                   cold_restore (entry, self->cache->data, payloads, action, error);
+        }
+    }
+
+  if (result)
+    cold_release (self, entry);
+
+  return result;
+}
+
+/* drops the entries of the cold records among [@index, @index +
+ * @n_actions) of @store, which are about to be discarded */
+void
+gundo_cold_forget (GundoCold       * self,
+                   GundoActionStore* store,
+                   guint             index,
+                   guint             n_actions)
+{
+  guint i;
+
+  for (i = index; i < index + n_actions; i++)
+    {
+      UndoAction* action = gundo_action_store_index (store, i);
+
+      if (action->type == &gundo_cold_type)
+        {
+          cold_release (self, action->data);
+          action->data = NULL;
+        }
+    }
+}
+
+/* compresses the open batch as well and waits for the worker to finish */
+void
+gundo_cold_flush (GundoCold* self)
+{
+  cold_queue_open (self);
+
+  g_mutex_lock (&self->mutex);
+  while (self->n_queued)
+    g_cond_wait (&self->idle_cond, &self->mutex);
+  g_mutex_unlock (&self->mutex);
+}
+
+/* the bytes held by the cold tier */
+gsize
+gundo_cold_get_size (GundoCold* self)
+{
+  gsize size = self->n_entries * sizeof (ColdEntry) + self->cache->len;
+
+  if (self->open)
+    size += self->open->raw->len;
+
+  g_mutex_lock (&self->mutex);
+  size += self->queued_bytes + self->compressed_bytes;
+  g_mutex_unlock (&self->mutex);
+
+  return size;
+}
+
+/* estimates the bytes the cold records among [@index, @index +
+ * @n_actions) of @store take, assuming the average compression ratio */
+gsize
+gundo_cold_get_range_size (GundoCold       * self,
+                           GundoActionStore* store,
+                           guint             index,
+                           guint             n_actions)
+{
+  guint64 raw_bytes;
+  guint64 compressed_bytes;
+  guint64 len = 0;
+  gsize   size = 0;
+  guint   i;
+
+  for (i = index; i < index + n_actions; i++)
+    {
+      UndoAction const* action = gundo_action_store_index (store, i);
+
+      if (action->type == &gundo_cold_type)
+        {
+          len  += ((ColdEntry const*) action->data)->len;
+          size += sizeof (ColdEntry);
+        }
+    }
+
+  if (!len)
+    return size;
+
+  g_mutex_lock (&self->mutex);
+  raw_bytes        = self->raw_bytes;
+  compressed_bytes = self->compressed_bytes;
+  g_mutex_unlock (&self->mutex);
+
+  if (raw_bytes)
+    len = len * compressed_bytes / raw_bytes;
+
+  return size + len;
+}
+
+void
+gundo_cold_get_stats (GundoCold            * self,
+                      GundoCompressionStats* stats)
+{
+  stats->n_actions  = self->n_entries;
+  stats->decompress = self->decompress;
+
+  g_mutex_lock (&self->mutex);
+  stats->raw_bytes        = self->raw_bytes;
+  stats->compressed_bytes = self->compressed_bytes;
+  g_mutex_unlock (&self->mutex);
+}
+
+/* looks into a cold record without loading it; the bytes are valid until
+ * the next call, NULL if the batch is damaged. Only to be used after
+ * gundo_cold_flush(), so the worker doesn't have any of the batches. */
+gconstpointer
+gundo_cold_get_record (GundoCold             * self,
+                       gpointer                record_data,
+                       GundoActionType const** type,
+                       gboolean              * is_inline,
+                       gsize                 * len,
+                       GError               ** error)
+{
+  ColdEntry const* entry = record_data;
+  ColdBatch      * batch = entry->batch;
+  guint8 const   * bytes;
+
+  if (batch->raw)
+    {
+      bytes = batch->raw->data;
+    }
+  else
+    {
+      if (!cold_inflate (self, batch, error))
+        return NULL;
+      bytes = self->cache->data;
+    }
+
+  *type      = entry->type;
+  *is_inline = entry->is_inline;
+  *len       = entry->len;
+
+  return bytes + entry->offset;
+}
@@ -0,0 +1,83 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+
+#ifndef GUNDO_COLD_H
+#define GUNDO_COLD_H
+
+#include "gundo-action-store.h"
+#include "gundo-payload-arena.h"
+
+G_BEGIN_DECLS
+
+/* The cold tier keeps the payloads of actions far away from the current
+ * state compressed in memory. A cold record gets the placeholder type
+ * gundo_cold_type, whose data is a small entry naming the real type and
+ * the place of its bytes in a batch; the batch is a buffer the serialized
+ * actions are appended to.
+ *
+ * Once a batch is full, it is handed to a worker thread that compresses it
+ * with a GZlibCompressor, so the thread using the sequence never waits for
+ * zlib. Loading a record back from a compressed batch inflates the whole
+ * batch into a cache, which the following records of a run of undos or
+ * redos get loaded from. A batch is freed with its last entry. A batch
+ * that fails to inflate leaves its records placeholders.
+ *
+ * Only the queued and compressed batches are shared with the worker; they
+ * are protected by the mutex. The open batch, the entries and the cache
+ * are left to the thread using the sequence. */
+
+typedef struct _GundoCold GundoCold;
+
+extern GundoActionType const gundo_cold_type;
+
+GundoCold*    gundo_cold_new            (void);
+void          gundo_cold_free           (GundoCold             * self);
+gboolean      gundo_cold_add            (GundoCold             * self,
+                                         UndoAction            * action);
+gboolean      gundo_cold_load           (GundoCold             * self,
+                                         GundoPayloadArena     * payloads,
+                                         UndoAction            * action,
+                                         GError               ** error);
+void          gundo_cold_forget         (GundoCold             * self,
+                                         GundoActionStore      * store,
+                                         guint                   index,
+                                         guint                   n_actions);
+void          gundo_cold_flush          (GundoCold             * self);
+gsize         gundo_cold_get_size       (GundoCold             * self);
+gsize         gundo_cold_get_range_size (GundoCold             * self,
+                                         GundoActionStore      * store,
+                                         guint                   index,
+                                         guint                   n_actions);
+void          gundo_cold_get_stats      (GundoCold             * self,
+                                         GundoCompressionStats * stats);
+gconstpointer gundo_cold_get_record     (GundoCold             * self,
+                                         gpointer                record_data,
+                                         GundoActionType const** type,
+                                         gboolean              * is_inline,
+                                         gsize                 * len,
+                                         GError               ** error);
+
+G_END_DECLS
+
+#endif /* !GUNDO_COLD_H */
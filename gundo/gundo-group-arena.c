@@ -0,0 +1,145 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gundo-group-arena.h"
+
+#define CHUNK_SIZE 65536
+
+#define ALIGN(size) (((size) + G_MEM_ALIGN - 1) & ~(gsize) (G_MEM_ALIGN - 1))
+
+typedef struct _ArenaChunk ArenaChunk;
+
+struct _ArenaChunk {
+  ArenaChunk* next;
+  gsize       size;
+};
+
+#define CHUNK_HEADER_SIZE ALIGN (sizeof (ArenaChunk))
+
+struct _GundoGroupArena {
+  ArenaChunk* chunks; /* the newest one first */
+  gsize       used;   /* bytes used in the newest chunk */
+  gsize       size;   /* bytes held by all chunks */
+};
+
+static void
+arena_nop (gpointer data G_GNUC_UNUSED)
+{
+}
+
+static void
+arena_free (gpointer data)
+{
+  gundo_group_arena_free (data);
+}
+
+static gsize
+arena_size (gpointer data)
+{
+  return ((GundoGroupArena*) data)->size;
+}
+
+/* the arena is nothing but memory, so it can be freed from any thread */
+GundoActionType const gundo_group_arena_type = {
+  .undo  = arena_nop,
+  .redo  = arena_nop,
+  .free  = arena_free,
+  .size  = arena_size,
+  .flags = GUNDO_ACTION_FREE_THREADSAFE
+};
+
+GundoGroupArena*
+gundo_group_arena_new (void)
+{
+  return g_slice_new0 (GundoGroupArena);
+}
+
+void
+gundo_group_arena_free (GundoGroupArena* self)
+{
+  while (self->chunks)
+    {
+      ArenaChunk* next = self->chunks->next;
+
+      g_free (self->chunks);
+      self->chunks = next;
+    }
+
+  g_slice_free (GundoGroupArena, self);
+}
+
+static ArenaChunk*
+arena_add_chunk (GundoGroupArena* self,
+                 gsize            size)
+{
+  ArenaChunk* chunk = g_malloc (size);
+
+  chunk->size = size;
+  self->size += size;
+
+  return chunk;
+}
+
+gpointer
+gundo_group_arena_alloc (GundoGroupArena* self,
+                         gsize            size)
+{
+  gpointer mem;
+
+  size = ALIGN (MAX (size, 1));
+
+  if (size > (CHUNK_SIZE - CHUNK_HEADER_SIZE) / 4)
+    {
+      /* big allocations get a chunk of their own, behind the newest one
+       * so the space left in that one isn't lost */
+      ArenaChunk* chunk = arena_add_chunk (self, CHUNK_HEADER_SIZE + size);
+
+      if (self->chunks)
+        {
+          chunk->next = self->chunks->next;
+          self->chunks->next = chunk;
+        }
+      else
+        {
+          chunk->next = NULL;
+          self->chunks = chunk;
+          self->used = chunk->size;
+        }
+
+      return (gchar*) chunk + CHUNK_HEADER_SIZE;
+    }
+
+  if (!self->chunks || self->used + size > self->chunks->size)
+    {
+      ArenaChunk* chunk = arena_add_chunk (self, CHUNK_SIZE);
+
+      chunk->next = self->chunks;
+      self->chunks = chunk;
+      self->used = CHUNK_HEADER_SIZE;
+    }
+
+  mem = (gchar*) self->chunks + self->used;
+  self->used += size;
+
+  return mem;
+}
@@ -0,0 +1,48 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GUNDO_GROUP_ARENA_H
+#define GUNDO_GROUP_ARENA_H
+
+#include <gundo-sequence.h>
+
+G_BEGIN_DECLS
+
+/* The group arena is a bump allocator for the payloads of the actions of a
+ * group. Nothing is freed before the whole arena goes away. A closed group
+ * keeps its arena in a record of type gundo_group_arena_type, whose free
+ * callback releases the arena, so the arena dies whenever the records of
+ * the group are freed. */
+
+typedef struct _GundoGroupArena GundoGroupArena;
+
+extern GundoActionType const gundo_group_arena_type;
+
+GundoGroupArena* gundo_group_arena_new   (void);
+void             gundo_group_arena_free  (GundoGroupArena* self);
+gpointer         gundo_group_arena_alloc (GundoGroupArena* self,
+                                          gsize            size);
+
+G_END_DECLS
+
+#endif /* !GUNDO_GROUP_ARENA_H */
@@ -0,0 +1,517 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gundo-history-file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#define MAGIC        "GUNDOHF"
+#define MAGIC_SIZE   8
+#define VERSION      1
+#define HEADER_SIZE  16
+
+typedef struct {
+  guint64 index_offset;
+  guint32 n_records;
+  guint32 n_steps;
+  guint32 n_undos;
+  guint32 n_types;
+  gchar   magic[MAGIC_SIZE];
+} FileTrailer;
+
+struct _GundoHistoryFileWriter {
+  FILE      * stream;
+  gchar     * filename;
+  gchar     * tmp_name;
+  guint64     offset;
+  GByteArray* index;
+};
+
+struct _GundoHistoryFile {
+  GMappedFile                 * mapping;
+  gchar const                 * contents;
+  GundoHistoryFileEntry const * entries;
+  guint                         n_records;
+  guint                         n_steps;
+  guint                         n_undos;
+  GundoActionType const* const* types;
+};
+
+/* placeholders are neither undone nor redone before they get materialized,
+ * and they don't own anything */
+GundoActionType const gundo_history_file_lazy_type = {
+  .undo = NULL,
+  .redo = NULL,
+  .free = NULL
+};
+
+static void
+set_io_error (GError     ** error,
+              const gchar * filename,
+              int           saved_errno)
+{
+  g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+               "%s: %s", filename, g_strerror (saved_errno));
+}
+
+static void
+set_format_error (GError     ** error,
+                  const gchar * filename,
+                  const gchar * reason)
+{
+  g_set_error (error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_INVALID_FILE,
+               "%s: %s", filename, reason);
+}
+
+/* the file is written next to @filename and only renamed over it once it
+ * is complete, so a failed save never leaves a truncated history behind. It
+ * gets the permissions of the file it replaces. */
+GundoHistoryFileWriter*
+gundo_history_file_writer_new (const gchar* filename,
+                               GError    ** error)
+{
+  GundoHistoryFileWriter* self;
+  gchar                   header[HEADER_SIZE] = MAGIC;
+  guint32                 version = GUINT32_TO_LE (VERSION);
+  GStatBuf                old;
+  gboolean                replace;
+  int                     fd;
+
+  self = g_slice_new0 (GundoHistoryFileWriter);
+  self->filename = g_strdup (filename);
+  self->tmp_name = g_strdup_printf ("%s.XXXXXX", filename);
+  self->index    = g_byte_array_new ();
+
+  replace = !g_stat (filename, &old);
+  fd = g_mkstemp_full (self->tmp_name, O_RDWR, replace ? old.st_mode & 07777 : 0666);
+  /* the umask applied to the mode above, but the old file didn't care */
+  if (fd >= 0 && replace && fchmod (fd, old.st_mode & 07777))
+    {
+      int saved_errno = errno;
+
+      close (fd);
+      g_unlink (self->tmp_name);
+      fd = -1;
+      errno = saved_errno;
+    }
+  if (fd < 0 || !(self->stream = fdopen (fd, "wb")))
+    {
+      set_io_error (error, self->tmp_name, errno);
+      if (fd >= 0)
+        {
+          close (fd);
+          g_unlink (self->tmp_name);
+        }
+      g_byte_array_free (self->index, TRUE);
+      g_free (self->tmp_name);
+      g_free (self->filename);
+      g_slice_free (GundoHistoryFileWriter, self);
+      return NULL;
+    }
+
+  memcpy (header + MAGIC_SIZE, &version, sizeof (version));
+  fwrite (header, 1, HEADER_SIZE, self->stream);
+  self->offset = HEADER_SIZE;
+
+  return self;
+}
+
+static void
+writer_free (GundoHistoryFileWriter* self)
+{
+  g_byte_array_free (self->index, TRUE);
+  g_free (self->tmp_name);
+  g_free (self->filename);
+  g_slice_free (GundoHistoryFileWriter, self);
+}
+
+/* appends a record; returns its index. Write errors are sticky and only
+ * reported by gundo_history_file_writer_finish() */
+guint
+gundo_history_file_writer_add (GundoHistoryFileWriter* self,
+                               guint32                 kind,
+                               gconstpointer           bytes,
+                               guint32                 len)
+{
+  GundoHistoryFileEntry entry;
+  gboolean              marker = kind == GUNDO_HISTORY_FILE_GROUP_BEGIN ||
+                                 kind == GUNDO_HISTORY_FILE_GROUP_END;
+
+  entry.offset = GUINT64_TO_LE (self->offset);
+  entry.len    = GUINT32_TO_LE (len);
+  entry.kind   = GUINT32_TO_LE (kind);
+
+  if (!marker && len)
+    {
+      fwrite (bytes, 1, len, self->stream);
+      self->offset += len;
+    }
+
+  g_byte_array_append (self->index, (guint8 const*) &entry, sizeof (entry));
+
+  return self->index->len / sizeof (entry) - 1;
+}
+
+/* fixes up the record count of the group marker at @index */
+void
+gundo_history_file_writer_set_len (GundoHistoryFileWriter* self,
+                                   guint                   index,
+                                   guint32                 len)
+{
+  ((GundoHistoryFileEntry*) self->index->data)[index].len = GUINT32_TO_LE (len);
+}
+
+void
+gundo_history_file_writer_abort (GundoHistoryFileWriter* self)
+{
+  fclose (self->stream);
+  g_unlink (self->tmp_name);
+  writer_free (self);
+}
+
+/* makes the rename of a file in @filename's directory durable */
+static int
+sync_dir (const gchar* filename)
+{
+  gchar* dirname = g_path_get_dirname (filename);
+  int    saved_errno = 0;
+  int    fd;
+
+  fd = g_open (dirname, O_RDONLY, 0);
+  if (fd < 0 || fsync (fd))
+    saved_errno = errno;
+  if (fd >= 0)
+    close (fd);
+
+  g_free (dirname);
+
+  return saved_errno;
+}
+
+/* writes the index and the trailer, syncs the file to disk and puts it in
+ * place; frees @self in any case */
+gboolean
+gundo_history_file_writer_finish (GundoHistoryFileWriter* self,
+                                  guint                   n_steps,
+                                  guint                   n_undos,
+                                  guint                   n_types,
+                                  GError               ** error)
+{
+  static gchar const padding[sizeof (guint64)] = { 0 };
+  FileTrailer        trailer;
+  gsize              n_padding;
+  int                saved_errno = 0;
+
+  /* the index gets read in place, so it has to be aligned */
+  n_padding = (sizeof (guint64) - self->offset % sizeof (guint64)) % sizeof (guint64);
+  fwrite (padding, 1, n_padding, self->stream);
+  self->offset += n_padding;
+
+  trailer.index_offset = GUINT64_TO_LE (self->offset);
+  trailer.n_records    = GUINT32_TO_LE (self->index->len / sizeof (GundoHistoryFileEntry));
+  trailer.n_steps      = GUINT32_TO_LE (n_steps);
+  trailer.n_undos      = GUINT32_TO_LE (n_undos);
+  trailer.n_types      = GUINT32_TO_LE (n_types);
+  memcpy (trailer.magic, MAGIC, MAGIC_SIZE);
+
+  fwrite (self->index->data, 1, self->index->len, self->stream);
+  fwrite (&trailer, 1, sizeof (trailer), self->stream);
+
+  if (ferror (self->stream) || fflush (self->stream))
+    saved_errno = errno ? errno : EIO;
+  /* without the sync, a crash right after the rename could leave an empty
+   * file in place of the old one */
+  if (!saved_errno && fsync (fileno (self->stream)))
+    saved_errno = errno;
+  if (fclose (self->stream) && !saved_errno)
+    saved_errno = errno;
+  if (!saved_errno && g_rename (self->tmp_name, self->filename))
+    saved_errno = errno;
+
+  if (saved_errno)
+    {
+      set_io_error (error, self->filename, saved_errno);
+      g_unlink (self->tmp_name);
+      writer_free (self);
+      return FALSE;
+    }
+
+  /* the new file is in place, but its directory entry might not be on the
+   * disk yet */
+  saved_errno = sync_dir (self->filename);
+  if (saved_errno)
+    set_io_error (error, self->filename, saved_errno);
+
+  writer_free (self);
+  return !saved_errno;
+}
+
+/* checks that the top-level records form @n_steps steps, that every entry
+ * points into the payload area and that the types can be loaded */
+static gboolean
+file_check_index (GundoHistoryFile* self,
+                  const gchar     * filename,
+                  guint64           data_end,
+                  guint             n_types,
+                  GError         ** error)
+{
+  guint n_steps = 0;
+  guint i;
+
+  for (i = 0; i < self->n_records; i++)
+    {
+      GundoHistoryFileEntry const* entry = self->entries + i;
+      guint32                      kind = GUINT32_FROM_LE (entry->kind);
+      guint32                      len = GUINT32_FROM_LE (entry->len);
+      guint64                      offset = GUINT64_FROM_LE (entry->offset);
+
+      if (kind == GUNDO_HISTORY_FILE_GROUP_BEGIN)
+        {
+          GundoHistoryFileEntry const* end;
+
+          /* the records inside of the group get checked as the loop
+           * goes on; nested groups only need to be well-formed */
+          if (len == 0 || i + 2 > self->n_records || len > self->n_records - i - 2)
+            break;
+
+          end = self->entries + i + len + 1;
+          if (GUINT32_FROM_LE (end->kind) != GUNDO_HISTORY_FILE_GROUP_END ||
+              GUINT32_FROM_LE (end->len) != len)
+            break;
+        }
+      else if (kind != GUNDO_HISTORY_FILE_GROUP_END)
+        {
+          GundoActionType const* type;
+
+          if ((kind & ~GUNDO_HISTORY_FILE_INLINE) >= n_types ||
+              offset < HEADER_SIZE || offset > data_end || len > data_end - offset)
+            break;
+
+          type = self->types[kind & ~GUNDO_HISTORY_FILE_INLINE];
+          if (!(kind & GUNDO_HISTORY_FILE_INLINE) && !type->deserialize)
+            {
+              g_set_error (error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED,
+                           "%s: action type %u can't be deserialized",
+                           filename, kind);
+              return FALSE;
+            }
+        }
+    }
+
+  if (i < self->n_records)
+    {
+      set_format_error (error, filename, "corrupt history index");
+      return FALSE;
+    }
+
+  /* count the steps along the top level */
+  for (i = 0; i < self->n_records; n_steps++)
+    {
+      GundoHistoryFileEntry const* entry = self->entries + i;
+
+      if (GUINT32_FROM_LE (entry->kind) == GUNDO_HISTORY_FILE_GROUP_END)
+        break;
+      if (GUINT32_FROM_LE (entry->kind) == GUNDO_HISTORY_FILE_GROUP_BEGIN)
+        i += GUINT32_FROM_LE (entry->len) + 2;
+      else
+        i++;
+    }
+
+  if (i < self->n_records || n_steps != self->n_steps || self->n_undos > n_steps)
+    {
+      set_format_error (error, filename, "corrupt history index");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+GundoHistoryFile*
+gundo_history_file_open (const gchar                 * filename,
+                         GundoActionType const* const* types,
+                         guint                         n_types,
+                         GError                     ** error)
+{
+  GundoHistoryFile* self;
+  GMappedFile     * mapping;
+  FileTrailer       trailer;
+  gchar const     * contents;
+  gsize             length;
+  guint64           index_offset;
+  guint32           version;
+
+  mapping = g_mapped_file_new (filename, FALSE, error);
+  if (!mapping)
+    return NULL;
+
+  contents = g_mapped_file_get_contents (mapping);
+  length   = g_mapped_file_get_length (mapping);
+
+  if (length < HEADER_SIZE + sizeof (trailer) ||
+      memcmp (contents, MAGIC, MAGIC_SIZE))
+    {
+      set_format_error (error, filename, "not a history file");
+      g_mapped_file_unref (mapping);
+      return NULL;
+    }
+
+  memcpy (&version, contents + MAGIC_SIZE, sizeof (version));
+  memcpy (&trailer, contents + length - sizeof (trailer), sizeof (trailer));
+  if (GUINT32_FROM_LE (version) != VERSION ||
+      memcmp (trailer.magic, MAGIC, MAGIC_SIZE))
+    {
+      set_format_error (error, filename, "unsupported or truncated history file");
+      g_mapped_file_unref (mapping);
+      return NULL;
+    }
+
+  if (GUINT32_FROM_LE (trailer.n_types) > n_types)
+    {
+      g_set_error (error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED,
+                   "%s: the history uses %u action types, only %u are known",
+                   filename, GUINT32_FROM_LE (trailer.n_types), n_types);
+      g_mapped_file_unref (mapping);
+      return NULL;
+    }
+
+  self = g_slice_new0 (GundoHistoryFile);
+  self->mapping   = mapping;
+  self->contents  = contents;
+  self->n_records = GUINT32_FROM_LE (trailer.n_records);
+  self->n_steps   = GUINT32_FROM_LE (trailer.n_steps);
+  self->n_undos   = GUINT32_FROM_LE (trailer.n_undos);
+  self->types     = g_new (GundoActionType const*, n_types);
+  memcpy ((gpointer) self->types, types, n_types * sizeof (*types));
+
+  index_offset = GUINT64_FROM_LE (trailer.index_offset);
+  if (index_offset % sizeof (guint64) || index_offset < HEADER_SIZE ||
+      index_offset > length - sizeof (trailer) ||
+      (length - sizeof (trailer) - index_offset) / sizeof (GundoHistoryFileEntry) != self->n_records ||
+      (length - sizeof (trailer) - index_offset) % sizeof (GundoHistoryFileEntry))
+    {
+      set_format_error (error, filename, "corrupt history index");
+      gundo_history_file_free (self);
+      return NULL;
+    }
+
+  self->entries = (GundoHistoryFileEntry const*) (contents + index_offset);
+
+  if (!file_check_index (self, filename, index_offset, GUINT32_FROM_LE (trailer.n_types), error))
+    {
+      gundo_history_file_free (self);
+      return NULL;
+    }
+
+  return self;
+}
+
+void
+gundo_history_file_free (GundoHistoryFile* self)
+{
+  g_mapped_file_unref (self->mapping);
+  g_free ((gpointer) self->types);
+  g_slice_free (GundoHistoryFile, self);
+}
+
+guint
+gundo_history_file_get_n_records (GundoHistoryFile* self)
+{
+  return self->n_records;
+}
+
+guint
+gundo_history_file_get_n_steps (GundoHistoryFile* self)
+{
+  return self->n_steps;
+}
+
+guint
+gundo_history_file_get_n_undos (GundoHistoryFile* self)
+{
+  return self->n_undos;
+}
+
+GundoHistoryFileEntry const*
+gundo_history_file_get_entry (GundoHistoryFile* self,
+                              guint             index)
+{
+  return self->entries + index;
+}
+
+GundoActionType const*
+gundo_history_file_get_type (GundoHistoryFile           * self,
+                             GundoHistoryFileEntry const* entry)
+{
+  return self->types[GUINT32_FROM_LE (entry->kind) & ~GUNDO_HISTORY_FILE_INLINE];
+}
+
+gconstpointer
+gundo_history_file_get_bytes (GundoHistoryFile           * self,
+                              GundoHistoryFileEntry const* entry)
+{
+  return self->contents + GUINT64_FROM_LE (entry->offset);
+}
+
+/* turns the placeholder @action into the real record; inline payloads get
+ * copied into @payloads, everything else is handed to the deserialize
+ * callback of its type. If that returns %NULL, @action stays a placeholder
+ * and @error is set. */
+gboolean
+gundo_history_file_materialize (GundoHistoryFile * self,
+                                GundoPayloadArena* payloads,
+                                UndoAction       * action,
+                                GError          ** error)
+{
+  GundoHistoryFileEntry const* entry = action->data;
+  guint32                      kind = GUINT32_FROM_LE (entry->kind);
+  GundoActionType const      * type = gundo_history_file_get_type (self, entry);
+  gconstpointer                bytes = gundo_history_file_get_bytes (self, entry);
+  guint32                      len = GUINT32_FROM_LE (entry->len);
+
+  gpointer                     data;
+
+  if (kind & GUNDO_HISTORY_FILE_INLINE)
+    {
+      action->type = &gundo_payload_arena_type;
+      action->data = gundo_payload_arena_add (payloads, type, bytes, len);
+      return TRUE;
+    }
+
+  data = type->deserialize (bytes, len);
+  if (!data)
+    {
+      g_set_error (error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_INVALID_FILE,
+                   "record %u of the history file can't be deserialized",
+                   (guint) (entry - self->entries));
+      return FALSE;
+    }
+
+  action->type = type;
+  action->data = data;
+  return TRUE;
+}
@@ -0,0 +1,101 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GUNDO_HISTORY_FILE_H
+#define GUNDO_HISTORY_FILE_H
+
+#include "gundo-action-store.h"
+#include "gundo-payload-arena.h"
+
+G_BEGIN_DECLS
+
+/* A history file holds the records of a GundoSequence in a binary
+ * container: a header, the serialized payloads back to back, an index with
+ * one entry per record and a trailer pointing at the index. All numbers are
+ * little endian.
+ *
+ * A loaded file stays mapped. Its records start out as placeholders of type
+ * gundo_history_file_lazy_type, whose data points at their index entry.
+ * They get materialized (deserialized) only once they are about to be
+ * undone or redone, so opening a file costs a walk over the index, no
+ * matter how big the payloads are. */
+
+typedef struct _GundoHistoryFile       GundoHistoryFile;
+typedef struct _GundoHistoryFileEntry  GundoHistoryFileEntry;
+typedef struct _GundoHistoryFileWriter GundoHistoryFileWriter;
+
+struct _GundoHistoryFileEntry {
+  guint64 offset;
+  guint32 len;    /* the number of records inside, for group markers */
+  guint32 kind;
+};
+
+/* the kind of an entry is the index of its type in the type table, with
+ * GUNDO_HISTORY_FILE_INLINE set for actions added inline */
+#define GUNDO_HISTORY_FILE_INLINE      0x80000000u
+#define GUNDO_HISTORY_FILE_GROUP_BEGIN 0xffffffffu
+#define GUNDO_HISTORY_FILE_GROUP_END   0xfffffffeu
+
+#define GUNDO_HISTORY_FILE_MAX_TYPES   0x10000u
+
+extern GundoActionType const gundo_history_file_lazy_type;
+
+GundoHistoryFileWriter* gundo_history_file_writer_new     (const gchar            * filename,
+                                                           GError                ** error);
+guint                   gundo_history_file_writer_add     (GundoHistoryFileWriter * self,
+                                                           guint32                  kind,
+                                                           gconstpointer            bytes,
+                                                           guint32                  len);
+void                    gundo_history_file_writer_set_len (GundoHistoryFileWriter * self,
+                                                           guint                    index,
+                                                           guint32                  len);
+gboolean                gundo_history_file_writer_finish  (GundoHistoryFileWriter * self,
+                                                           guint                    n_steps,
+                                                           guint                    n_undos,
+                                                           guint                    n_types,
+                                                           GError                ** error);
+void                    gundo_history_file_writer_abort   (GundoHistoryFileWriter * self);
+
+GundoHistoryFile*       gundo_history_file_open           (const gchar            * filename,
+                                                           GundoActionType const* const* types,
+                                                           guint                    n_types,
+                                                           GError                ** error);
+void                    gundo_history_file_free           (GundoHistoryFile       * self);
+guint                   gundo_history_file_get_n_records  (GundoHistoryFile       * self);
+guint                   gundo_history_file_get_n_steps    (GundoHistoryFile       * self);
+guint                   gundo_history_file_get_n_undos    (GundoHistoryFile       * self);
+GundoHistoryFileEntry const*
+                        gundo_history_file_get_entry      (GundoHistoryFile       * self,
+                                                           guint                    index);
+GundoActionType const*  gundo_history_file_get_type       (GundoHistoryFile       * self,
+                                                           GundoHistoryFileEntry const* entry);
+gconstpointer           gundo_history_file_get_bytes      (GundoHistoryFile       * self,
+                                                           GundoHistoryFileEntry const* entry);
+gboolean                gundo_history_file_materialize    (GundoHistoryFile       * self,
+                                                           GundoPayloadArena      * payloads,
+                                                           UndoAction             * action,
+                                                           GError                ** error);
+
+G_END_DECLS
+
+#endif /* !GUNDO_HISTORY_FILE_H */
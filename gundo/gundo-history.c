@@ -29,7 +29,10 @@
 
 #include <gundo/gundo-history.h>
 
+#include <string.h>
+
 #include "gobject-helpers.h"
+#include "gundo-trace-points.h"
 
 /**
  * GundoHistoryIface:
@@ -40,6 +43,13 @@
  * @get_n_undos: the function slot for gundo_history_get_n_undos()
  * @redo: the function slot for gundo_history_redo()
  * @undo: the function slot for gundo_history_undo()
+ * @go_to: the signal slot for the <link linkend="GundoHistory-go-to">go-to</link>
+ * signal; can be %NULL, in which case gundo_history_goto() calls @undo or
+ * @redo repeatedly
+ * @get_memory_usage: the function slot for gundo_history_get_memory_usage();
+ * can be %NULL if the history can't tell
+ * @get_position: the function slot for gundo_history_get_position(); can be
+ * %NULL, in which case @get_n_undos is used
  *
  * The %GTypeInterface for an undo/redo history.
  */
@@ -47,15 +57,98 @@
 
 enum {
   SIGNAL_CHANGED,
+  SIGNAL_STACKS_CHANGED,
   SIGNAL_REDO,
   SIGNAL_UNDO,
+  SIGNAL_GO_TO,
   N_SIGNALS
 };
 
 static guint signals[N_SIGNALS] = {0};
 
+/* the state of gundo_history_freeze_notify(), kept as qdata of the history */
+typedef struct {
+  guint    count;
+  gboolean changed;   /* whether ::changed has been held back */
+  gboolean stacks_changed; /* whether ::stacks-changed has been held back */
+  gboolean can_undo;  /* the states to compare against on thaw */
+  gboolean can_redo;
+  guint    n_undos;
+  guint    n_redos;
+} NotifyFreeze;
+
+/* the number of histories with frozen notifications, which spares the
+ * others the qdata lookup; histories in any thread count, and one that is
+ * finalized while frozen is taken off by history_free_freeze() */
+static gint n_frozen = 0;
+
+static GQuark
+history_freeze_quark (void)
+{
+  static GQuark quark = 0;
+
+  if (!quark)
+    quark = g_quark_from_static_string ("gundo-history-notify-freeze");
+
+  return quark;
+}
+
+static void
+history_free_freeze (gpointer data)
+{
+  NotifyFreeze* freeze = data;
+
+  if (freeze->count)
+    g_atomic_int_add (&n_frozen, -1);
+
+  g_free (freeze);
+}
+
+static NotifyFreeze*
+history_get_freeze (GundoHistory* self)
+{
+  NotifyFreeze* freeze;
+
+  if (G_LIKELY (!g_atomic_int_get (&n_frozen)))
+    return NULL;
+
+  freeze = g_object_get_qdata (G_OBJECT (self), history_freeze_quark ());
+
+  return freeze && freeze->count ? freeze : NULL;
+}
+
 G_DEFINE_IFACE_FULL(GundoHistory, gundo_history, G_TYPE_INTERFACE);
 
+/* whether emitting @signal_id on @self would only run the default class
+ * closure, so the slot can be called directly: nobody is connected, and
+ * @self isn't an instance of a subclass of the implementing type, which
+ * could have overridden the class closure */
+static gboolean
+history_emission_is_default (GundoHistory* self,
+                             guint         signal_id)
+{
+  gpointer parent;
+
+  if (g_signal_has_handler_pending (self, signal_id, 0, TRUE))
+    return FALSE;
+
+  parent = g_type_class_peek_parent (G_OBJECT_GET_CLASS (self));
+
+  return !parent || !g_type_interface_peek (parent, GUNDO_TYPE_HISTORY);
+}
+
+static GundoHistoryChange*
+history_change_copy (GundoHistoryChange const* change)
+{
+  GundoHistoryChange* copy = g_new (GundoHistoryChange, 1);
+
+  *copy = *change;
+
+  return copy;
+}
+
+G_DEFINE_BOXED_TYPE (GundoHistoryChange, gundo_history_change, history_change_copy, g_free);
+
 /**
  * gundo_history_can_redo:
  * @self: a #GundoHistory
@@ -96,13 +189,81 @@ gundo_history_can_undo (GundoHistory* self)
  * @self: a #GundoHistory
  *
  * Emit the #GundoHistory::changed signal to notify viewers about a change.
+ * While notifications are frozen, the emission is held back until
+ * gundo_history_thaw_notify().
  */
 void
 gundo_history_changed (GundoHistory* self)
 {
+  NotifyFreeze*      freeze;
+  guint64            start;
+
   g_return_if_fail (GUNDO_IS_HISTORY (self));
 
+  freeze = history_get_freeze (self);
+  if (G_UNLIKELY (freeze))
+    {
+      freeze->changed = TRUE;
+      return;
+    }
+
+  start = GUNDO_TRACE_BEGIN ();
   g_signal_emit (self, signals[SIGNAL_CHANGED], 0);
+  GUNDO_TRACE_END ("changed", self, 0, 0, start);
+}
+
+/**
+ * GundoStackChange:
+ * @position: the index of the first row that changed, counted from the
+ * current state: 0 is the latest undoable (or the next redoable) change
+ * @n_removed: the number of changes removed at @position
+ * @n_added: the number of changes added at @position, after the removal
+ *
+ * A range of changes that was replaced on one side of a #GundoHistory.
+ */
+
+/**
+ * GundoHistoryChange:
+ * @undo: the change of the undoable side
+ * @redo: the change of the redoable side
+ *
+ * Describes an update of a #GundoHistory, see #GundoHistory::stacks-changed.
+ * It is registered as the boxed type %GUNDO_TYPE_HISTORY_CHANGE, so
+ * bindings can marshal it.
+ */
+
+/**
+ * gundo_history_stacks_changed:
+ * @self: a #GundoHistory
+ * @change: what happened to the undoable and redoable changes
+ *
+ * Emit the #GundoHistory::stacks-changed signal. Implementations call this
+ * after every update of their undoable or redoable changes, before
+ * gundo_history_changed(). While notifications are frozen, the ranges
+ * are collected into a single one that replaces both sides completely,
+ * which is emitted on thaw.
+ */
+void
+gundo_history_stacks_changed (GundoHistory            * self,
+                              GundoHistoryChange const* change)
+{
+  NotifyFreeze* freeze;
+
+  g_return_if_fail (GUNDO_IS_HISTORY (self));
+  g_return_if_fail (change);
+
+  if (!change->undo.n_removed && !change->undo.n_added &&
+      !change->redo.n_removed && !change->redo.n_added)
+    return;
+
+  freeze = history_get_freeze (self);
+  if (G_UNLIKELY (freeze))
+    {
+      freeze->stacks_changed = TRUE;
+      return;
+    }
+
+  g_signal_emit (self, signals[SIGNAL_STACKS_CHANGED], 0, change);
 }
 
 /**
@@ -126,7 +287,9 @@ gundo_history_get_n_redos (GundoHistory* self)
  * gundo_history_get_n_undos:
  * @self: a #GundoHistory
  *
- * Query the number of undoable changes.
+ * Query the number of undoable changes. A #GundoSequence reports all of its
+ * changes here as long as any of them can be undone, use
+ * gundo_history_get_position() for the number of changes that are done.
  *
  * Returns: the number of undoable changes.
  */
@@ -139,38 +302,364 @@ gundo_history_get_n_undos (GundoHistory* self)
   return GUNDO_HISTORY_GET_IFACE (self)->get_n_undos (self);
 }
 
+/**
+ * gundo_history_get_position:
+ * @self: a #GundoHistory
+ *
+ * Query the number of changes that are done and could be undone one by
+ * one, which is the position gundo_history_goto() expects. Together with
+ * gundo_history_get_n_redos() this covers all changes of @self.
+ *
+ * Returns: the current position in @self.
+ */
+guint
+gundo_history_get_position (GundoHistory* self)
+{
+  GundoHistoryIface* iface;
+
+  g_return_val_if_fail (GUNDO_IS_HISTORY (self), 0);
+
+  iface = GUNDO_HISTORY_GET_IFACE (self);
+  if (iface->get_position)
+    return iface->get_position (self);
+
+  return gundo_history_get_n_undos (self);
+}
+
 /**
  * gundo_history_redo:
  * @self: a #GundoHistory
  *
- * Redoes the last action that was undone.
+ * Redoes the last action that was undone. The #GundoHistory::redo signal is
+ * only emitted if there are handlers connected to it or @self is an
+ * instance of a subclass of the type implementing #GundoHistory, which
+ * might have overridden its class closure; otherwise the history is called
+ * directly, and emission hooks added with g_signal_add_emission_hook() don't
+ * run. While notifications are frozen, the signal isn't emitted at all and
+ * #GundoHistory::changed is emitted on thaw instead.
  *
  * <emphasis>Prerequisitions</emphasis>: no group is being constructed && gundo_history_can_redo().
  */
 void
 gundo_history_redo (GundoHistory* self)
 {
+  GundoHistoryIface* iface;
+  NotifyFreeze*      freeze;
+  guint64            start;
+
   g_return_if_fail (GUNDO_IS_HISTORY (self));
-  g_return_if_fail (gundo_history_can_redo (self));
 
-  g_signal_emit (self, signals[SIGNAL_REDO], 0);
+  iface = GUNDO_HISTORY_GET_IFACE (self);
+  g_return_if_fail (iface->can_redo (self));
+
+  start = GUNDO_TRACE_BEGIN ();
+
+  freeze = history_get_freeze (self);
+  if (G_UNLIKELY (freeze))
+    {
+      /* the viewers learn about it from ::changed on thaw */
+      iface->redo (self);
+      freeze->changed = TRUE;
+    }
+  else if (history_emission_is_default (self, signals[SIGNAL_REDO]))
+    iface->redo (self);
+  else
+    g_signal_emit (self, signals[SIGNAL_REDO], 0);
+
+  GUNDO_TRACE_END ("redo", self, 0, 0, start);
 }
 
 /**
  * gundo_history_undo:
  * @self: a #GundoHistory
  *
- * Undoes the action at the end of the history.
+ * Undoes the action at the end of the history. The #GundoHistory::undo
+ * signal is only emitted if there are handlers connected to it or @self is
+ * an instance of a subclass of the type implementing #GundoHistory, which
+ * might have overridden its class closure; otherwise the history is called
+ * directly, and emission hooks added with g_signal_add_emission_hook() don't
+ * run. While notifications are frozen, the signal isn't emitted at all and
+ * #GundoHistory::changed is emitted on thaw instead.
  *
  * <emphasis>Prerequisites</emphasis>: no group is being constructed && gundo_history_can_undo().
  */
 void
 gundo_history_undo (GundoHistory* self)
 {
+  GundoHistoryIface* iface;
+  NotifyFreeze*      freeze;
+  guint64            start;
+
+  g_return_if_fail (GUNDO_IS_HISTORY (self));
+
+  iface = GUNDO_HISTORY_GET_IFACE (self);
+  g_return_if_fail (iface->can_undo (self));
+
+  start = GUNDO_TRACE_BEGIN ();
+
+  freeze = history_get_freeze (self);
+  if (G_UNLIKELY (freeze))
+    {
+      /* the viewers learn about it from ::changed on thaw */
+      iface->undo (self);
+      freeze->changed = TRUE;
+    }
+  else if (history_emission_is_default (self, signals[SIGNAL_UNDO]))
+    iface->undo (self);
+  else
+    g_signal_emit (self, signals[SIGNAL_UNDO], 0);
+
+  GUNDO_TRACE_END ("undo", self, 0, 0, start);
+}
+
+/**
+ * gundo_history_goto:
+ * @self: a #GundoHistory
+ * @position: the position to end up at, see gundo_history_get_position()
+ *
+ * Undoes or redoes as many changes as it takes to reach @position, where 0
+ * means that all changes are undone and
+ * gundo_history_get_position() + gundo_history_get_n_redos() means that all
+ * of them are done.
+ *
+ * As long as handlers are connected to #GundoHistory::undo or
+ * #GundoHistory::redo, this emits them for every single change. Otherwise
+ * it emits #GundoHistory::go-to once, and implementations run the changes
+ * back-to-back and notify about #GundoHistory:can-undo and
+ * #GundoHistory:can-redo at most once, which makes jumps much cheaper than
+ * calling gundo_history_undo() repeatedly. Viewers learn about the jump
+ * from #GundoHistory::stacks-changed.
+ *
+ * <emphasis>Prerequisites</emphasis>: no group is being constructed.
+ */
+void
+gundo_history_goto (GundoHistory* self,
+                    guint         position)
+{
+  GundoHistoryIface* iface;
+  NotifyFreeze*      freeze;
+  guint              n_undos;
+  guint64            start;
+
+  g_return_if_fail (GUNDO_IS_HISTORY (self));
+
+  n_undos = gundo_history_get_position (self);
+  g_return_if_fail (position <= n_undos + gundo_history_get_n_redos (self));
+
+  if (position == n_undos)
+    return;
+
+  start = GUNDO_TRACE_BEGIN ();
+
+  iface = GUNDO_HISTORY_GET_IFACE (self);
+  freeze = history_get_freeze (self);
+  if (!iface->go_to ||
+      (!freeze &&
+       (g_signal_has_handler_pending (self, signals[SIGNAL_UNDO], 0, TRUE) ||
+        g_signal_has_handler_pending (self, signals[SIGNAL_REDO], 0, TRUE))))
+    {
+      for (; n_undos > position; n_undos--)
+        gundo_history_undo (self);
+      for (; n_undos < position; n_undos++)
+        gundo_history_redo (self);
+    }
+  else if (G_UNLIKELY (freeze))
+    {
+      /* the viewers learn about it from ::changed on thaw */
+      iface->go_to (self, position);
+      freeze->changed = TRUE;
+    }
+  else
+    g_signal_emit (self, signals[SIGNAL_GO_TO], 0, position);
+
+  GUNDO_TRACE_END ("goto", self, 0, 0, start);
+}
+
+/**
+ * gundo_history_redo_n:
+ * @self: a #GundoHistory
+ * @n_steps: the number of changes to redo
+ *
+ * Redoes the last @n_steps changes that were undone, see
+ * gundo_history_goto().
+ */
+void
+gundo_history_redo_n (GundoHistory* self,
+                      guint         n_steps)
+{
+  g_return_if_fail (GUNDO_IS_HISTORY (self));
+  g_return_if_fail (n_steps <= gundo_history_get_n_redos (self));
+
+  gundo_history_goto (self, gundo_history_get_position (self) + n_steps);
+}
+
+/**
+ * gundo_history_undo_n:
+ * @self: a #GundoHistory
+ * @n_steps: the number of changes to undo
+ *
+ * Undoes the latest @n_steps changes, see gundo_history_goto().
+ */
+void
+gundo_history_undo_n (GundoHistory* self,
+                      guint         n_steps)
+{
+  g_return_if_fail (GUNDO_IS_HISTORY (self));
+  g_return_if_fail (n_steps <= gundo_history_get_position (self));
+
+  gundo_history_goto (self, gundo_history_get_position (self) - n_steps);
+}
+
+/**
+ * GundoMemoryUsage:
+ * @records: the bytes held by the records of the actions.
+ * @groups: the bytes held for groups: their records and the memory they
+ * allocated with gundo_sequence_group_alloc().
+ * @payloads: the bytes held by the data of the actions, as reported by the
+ * size callbacks of their #GundoActionType, or by the copies made by
+ * gundo_sequence_add_action_inline().
+ *
+ * The memory held by one side of a #GundoHistory.
+ */
+
+/**
+ * gundo_history_get_memory_usage:
+ * @self: a #GundoHistory
+ * @undo_usage: return location for the memory held by the undoable changes
+ * (and a group being constructed), or %NULL
+ * @redo_usage: return location for the memory held by the redoable changes,
+ * or %NULL
+ *
+ * Find out how much memory @self holds. Histories that can't tell report
+ * 0 bytes.
+ */
+void
+gundo_history_get_memory_usage (GundoHistory    * self,
+                                GundoMemoryUsage* undo_usage,
+                                GundoMemoryUsage* redo_usage)
+{
+  GundoMemoryUsage undo;
+  GundoMemoryUsage redo;
+
+  g_return_if_fail (GUNDO_IS_HISTORY (self));
+
+  memset (&undo, 0, sizeof (undo));
+  memset (&redo, 0, sizeof (redo));
+
+  if (GUNDO_HISTORY_GET_IFACE (self)->get_memory_usage)
+    GUNDO_HISTORY_GET_IFACE (self)->get_memory_usage (self, &undo, &redo);
+
+  if (undo_usage)
+    *undo_usage = undo;
+  if (redo_usage)
+    *redo_usage = redo;
+}
+
+/**
+ * gundo_history_freeze_notify:
+ * @self: a #GundoHistory
+ *
+ * Holds back the notifications of @self until gundo_history_thaw_notify()
+ * is called as often as this function: #GundoHistory::changed,
+ * #GundoHistory::stacks-changed and the
+ * notifications about #GundoHistory:can-undo and #GundoHistory:can-redo.
+ * gundo_history_undo() and gundo_history_redo() don't emit their signals
+ * while frozen either. Use this to run a batch of operations with a single
+ * update of the viewers.
+ */
+void
+gundo_history_freeze_notify (GundoHistory* self)
+{
+  NotifyFreeze* freeze;
+
   g_return_if_fail (GUNDO_IS_HISTORY (self));
-  g_return_if_fail (gundo_history_can_undo (self));
 
-  g_signal_emit (self, signals[SIGNAL_UNDO], 0);
+  freeze = g_object_get_qdata (G_OBJECT (self), history_freeze_quark ());
+  if (!freeze)
+    {
+      freeze = g_new0 (NotifyFreeze, 1);
+      g_object_set_qdata_full (G_OBJECT (self), history_freeze_quark (), freeze,
+                               history_free_freeze);
+    }
+
+  if (!freeze->count++)
+    {
+      g_atomic_int_inc (&n_frozen);
+      freeze->changed        = FALSE;
+      freeze->stacks_changed = FALSE;
+      freeze->can_undo = gundo_history_can_undo (self);
+      freeze->can_redo = gundo_history_can_redo (self);
+      freeze->n_undos  = gundo_history_get_position (self);
+      freeze->n_redos  = gundo_history_get_n_redos (self);
+    }
+}
+
+/**
+ * gundo_history_thaw_notify:
+ * @self: a #GundoHistory
+ *
+ * Reverts the effect of a call to gundo_history_freeze_notify(). The last
+ * thaw emits #GundoHistory::stacks-changed and #GundoHistory::changed once
+ * if anything happened in the meantime, and notifies about #GundoHistory:can-undo and
+ * #GundoHistory:can-redo only if they differ from what they were when
+ * @self got frozen.
+ */
+void
+gundo_history_thaw_notify (GundoHistory* self)
+{
+  NotifyFreeze* freeze;
+
+  g_return_if_fail (GUNDO_IS_HISTORY (self));
+
+  freeze = history_get_freeze (self);
+  g_return_if_fail (freeze);
+
+  if (--freeze->count)
+    return;
+
+  g_atomic_int_add (&n_frozen, -1);
+
+  g_object_ref (self);
+
+  if (freeze->stacks_changed)
+    {
+      GundoHistoryChange change;
+
+      change.undo.position  = 0;
+      change.undo.n_removed = freeze->n_undos;
+      change.undo.n_added   = gundo_history_get_position (self);
+      change.redo.position  = 0;
+      change.redo.n_removed = freeze->n_redos;
+      change.redo.n_added   = gundo_history_get_n_redos (self);
+
+      gundo_history_stacks_changed (self, &change);
+    }
+  if (freeze->changed)
+    gundo_history_changed (self);
+  if (freeze->can_undo != gundo_history_can_undo (self))
+    g_object_notify (G_OBJECT (self), "can-undo");
+  if (freeze->can_redo != gundo_history_can_redo (self))
+    g_object_notify (G_OBJECT (self), "can-redo");
+
+  g_object_unref (self);
+}
+
+/**
+ * gundo_history_is_notify_frozen:
+ * @self: a #GundoHistory
+ *
+ * Find out whether the notifications of @self are frozen. Implementations
+ * skip their notifications about #GundoHistory:can-undo and
+ * #GundoHistory:can-redo while they are.
+ *
+ * Returns: %TRUE if gundo_history_freeze_notify() is in effect.
+ */
+gboolean
+gundo_history_is_notify_frozen (GundoHistory* self)
+{
+  g_return_val_if_fail (GUNDO_IS_HISTORY (self), FALSE);
+
+  return history_get_freeze (self) != NULL;
 }
 
 /* GInterface stuff */
@@ -212,6 +701,11 @@ gundo_history_class_init (gpointer iface)
    * emitted when users perform undoable tasks, undo tasks or redo tasks.
    * Classes implementing this interface can use gundo_history_changed() to emit
    * the signal.
+   *
+   * #GundoSequence emits it right before it records new changes, and its
+   * class handler drops the changes that could have been redone. Undo,
+   * redo and jumps are announced by #GundoHistory::undo,
+   * #GundoHistory::redo and #GundoHistory::go-to instead.
    */
         signals[SIGNAL_CHANGED] = g_signal_new ("changed", G_TYPE_FROM_INTERFACE (iface),
                                                 G_SIGNAL_ACTION | G_SIGNAL_RUN_FIRST,
@@ -220,6 +714,23 @@ gundo_history_class_init (gpointer iface)
                                                 g_cclosure_marshal_VOID__VOID,
                                                 G_TYPE_NONE, 0);
 
+  /**
+   * GundoHistory::stacks-changed:
+   * @change: a #GundoHistoryChange describing the update
+   *
+   * This signal gets emitted (via gundo_history_stacks_changed()) whenever
+   * changes were added to or removed from either side of the history: by
+   * new changes, undo, redo, jumps and changes being discarded. Viewers
+   * can apply @change to their rows without querying the history.
+   */
+        signals[SIGNAL_STACKS_CHANGED] = g_signal_new ("stacks-changed", G_TYPE_FROM_INTERFACE (iface),
+                                                       G_SIGNAL_RUN_LAST,
+                                                       0,
+                                                       NULL, NULL,
+                                                       g_cclosure_marshal_VOID__BOXED,
+                                                       G_TYPE_NONE, 1,
+                                                       GUNDO_TYPE_HISTORY_CHANGE | G_SIGNAL_TYPE_STATIC_SCOPE);
+
   /**
    * GundoHistory::redo:
    *
@@ -245,6 +756,24 @@ gundo_history_class_init (gpointer iface)
                                              NULL, NULL,
                                              g_cclosure_marshal_VOID__VOID,
                                              G_TYPE_NONE, 0);
+
+  /**
+   * GundoHistory::go-to:
+   * @position: the position to jump to
+   *
+   * This action signal can be emitted (usually via gundo_history_goto()) to
+   * undo or redo several changes at once, until the history is at
+   * @position. gundo_history_goto() emits #GundoHistory::undo and
+   * #GundoHistory::redo for every change instead while handlers are
+   * connected to them.
+   */
+        signals[SIGNAL_GO_TO] = g_signal_new ("go-to", G_TYPE_FROM_INTERFACE (iface),
+                                              G_SIGNAL_ACTION | G_SIGNAL_RUN_FIRST,
+                                              G_STRUCT_OFFSET (GundoHistoryIface, go_to),
+                                              NULL, NULL,
+                                              g_cclosure_marshal_VOID__UINT,
+                                              G_TYPE_NONE, 1,
+                                              G_TYPE_UINT);
 }
 
 /* vim:set et: */
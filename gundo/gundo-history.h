@@ -30,21 +30,42 @@ G_BEGIN_DECLS
 
 typedef struct _GundoHistory GundoHistory;
 typedef struct _GundoHistoryIface GundoHistoryIface;
+typedef struct _GundoMemoryUsage  GundoMemoryUsage;
+typedef struct _GundoStackChange  GundoStackChange;
+typedef struct _GundoHistoryChange GundoHistoryChange;
 
 #define GUNDO_TYPE_HISTORY         (gundo_history_get_type())
 #define GUNDO_HISTORY(i)           (G_TYPE_CHECK_INSTANCE_CAST((i), GUNDO_TYPE_HISTORY, GundoHistory))
 #define GUNDO_IS_HISTORY(i)        (G_TYPE_CHECK_INSTANCE_TYPE((i), GUNDO_TYPE_HISTORY))
 #define GUNDO_HISTORY_GET_IFACE(i) (G_TYPE_INSTANCE_GET_INTERFACE((i), GUNDO_TYPE_HISTORY, GundoHistoryIface))
 
+#define GUNDO_TYPE_HISTORY_CHANGE  (gundo_history_change_get_type())
+
 GType    gundo_history_get_type(void);
+GType    gundo_history_change_get_type (void);
 
 gboolean gundo_history_can_redo      (GundoHistory* self);
 gboolean gundo_history_can_undo      (GundoHistory* self);
 void     gundo_history_changed       (GundoHistory* self);
 guint    gundo_history_get_n_redos   (GundoHistory* self);
 guint    gundo_history_get_n_undos   (GundoHistory* self);
+guint    gundo_history_get_position  (GundoHistory* self);
 void     gundo_history_redo          (GundoHistory* self);
 void     gundo_history_undo          (GundoHistory* self);
+void     gundo_history_redo_n        (GundoHistory* self,
+                                      guint         n_steps);
+void     gundo_history_undo_n        (GundoHistory* self,
+                                      guint         n_steps);
+void     gundo_history_goto          (GundoHistory* self,
+                                      guint         position);
+void     gundo_history_get_memory_usage (GundoHistory    * self,
+                                         GundoMemoryUsage* undo_usage,
+                                         GundoMemoryUsage* redo_usage);
+void     gundo_history_freeze_notify (GundoHistory* self);
+void     gundo_history_thaw_notify   (GundoHistory* self);
+gboolean gundo_history_is_notify_frozen (GundoHistory* self);
+void     gundo_history_stacks_changed (GundoHistory            * self,
+                                       GundoHistoryChange const* change);
 
 void     gundo_history_install_properties(GObjectClass* go_class,
 					  guint id_undo,
@@ -68,6 +89,35 @@ struct _GundoHistoryIface
 
         void     (*redo)          (GundoHistory* self);
         void     (*undo)          (GundoHistory* self);
+
+        void     (*go_to)         (GundoHistory* self,
+                                   guint         position);
+
+        void     (*get_memory_usage) (GundoHistory    * self,
+                                      GundoMemoryUsage* undo_usage,
+                                      GundoMemoryUsage* redo_usage);
+
+        guint    (*get_position)  (GundoHistory* self);
+};
+
+struct _GundoMemoryUsage
+  {
+        gsize records;
+        gsize groups;
+        gsize payloads;
+};
+
+struct _GundoStackChange
+  {
+        guint position;
+        guint n_removed;
+        guint n_added;
+};
+
+struct _GundoHistoryChange
+  {
+        GundoStackChange undo;
+        GundoStackChange redo;
 };
 
 G_END_DECLS
@@ -0,0 +1,472 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gundo-journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAGIC       "GUNDOJL"
+#define MAGIC_SIZE  8
+#define VERSION     1
+#define HEADER_SIZE 16
+
+typedef struct {
+  guint32 len;
+  guint32 arg;
+  guint32 op;
+  guint32 check;
+} RecordHeader;
+
+struct _GundoJournal {
+  int         fd;
+  gchar     * filename;
+  GThread   * writer;
+
+  /* everything below is protected by the mutex */
+  GMutex      mutex;
+  GCond       cond;         /* wakes the writer */
+  GCond       synced_cond;  /* signalled after each batch */
+  GByteArray* pending;      /* the batch being appended to */
+  GByteArray* spare;        /* the buffer for the next batch, unless the
+                             * writer has it */
+  gsize       record_start;
+  gint64      batch_start;  /* when the first record of the batch came */
+  guint64     n_appended;   /* bytes handed to the journal */
+  guint64     n_synced;     /* bytes written and synced */
+  guint64     n_requested;  /* bytes gundo_journal_sync() waits for */
+  guint       sync_interval;
+  gsize       sync_size;
+  gboolean    closing;
+  GError    * error;        /* the first failure, nothing gets written after */
+};
+
+/* FNV-1a; enough to tell a torn record from a complete one */
+static guint32
+checksum (guint32        hash,
+          gconstpointer  bytes,
+          gsize          len)
+{
+  guint8 const* p = bytes;
+  gsize         i;
+
+  for (i = 0; i < len; i++)
+    hash = (hash ^ p[i]) * 16777619u;
+
+  return hash;
+}
+
+static guint32
+record_checksum (RecordHeader const* header,
+                 gconstpointer       bytes)
+{
+  RecordHeader copy = *header;
+
+  copy.check = 0;
+
+  return checksum (checksum (2166136261u, &copy, sizeof (copy)),
+                   bytes, GUINT32_FROM_LE (header->len));
+}
+
+/* calls @func for the records of the journal at @filename, stopping at the
+ * first one that wasn't written completely; @n_valid is set to the length
+ * of the part of the file that was read. A missing file is an empty
+ * journal. */
+gboolean
+gundo_journal_replay (const gchar          * filename,
+                      GundoJournalReplayFunc func,
+                      gpointer               user_data,
+                      guint64              * n_valid,
+                      GError              ** error)
+{
+  GMappedFile* mapping;
+  GError     * tmp_error = NULL;
+  gchar const* contents;
+  gsize        length;
+  gsize        offset;
+  guint32      version;
+  gboolean     result = TRUE;
+
+  *n_valid = 0;
+
+  mapping = g_mapped_file_new (filename, FALSE, &tmp_error);
+  if (!mapping)
+    {
+      if (g_error_matches (tmp_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        {
+          g_error_free (tmp_error);
+          return TRUE;
+        }
+      g_propagate_error (error, tmp_error);
+      return FALSE;
+    }
+
+  contents = g_mapped_file_get_contents (mapping);
+  length   = g_mapped_file_get_length (mapping);
+
+  /* a crash while the header was written leaves an empty journal */
+  if (length < HEADER_SIZE && (!length || !memcmp (contents, MAGIC, MIN (length, MAGIC_SIZE))))
+    {
+      g_mapped_file_unref (mapping);
+      return TRUE;
+    }
+
+  if (length < HEADER_SIZE || memcmp (contents, MAGIC, MAGIC_SIZE))
+    {
+      g_set_error (error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_INVALID_FILE,
+                   "%s: not a journal", filename);
+      g_mapped_file_unref (mapping);
+      return FALSE;
+    }
+
+  memcpy (&version, contents + MAGIC_SIZE, sizeof (version));
+  if (GUINT32_FROM_LE (version) != VERSION)
+    {
+      g_set_error (error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_INVALID_FILE,
+                   "%s: unsupported journal version", filename);
+      g_mapped_file_unref (mapping);
+      return FALSE;
+    }
+
+  for (offset = HEADER_SIZE; length - offset >= sizeof (RecordHeader); )
+    {
+      RecordHeader header;
+      gchar const* bytes = contents + offset + sizeof (header);
+      guint32      len;
+
+      memcpy (&header, contents + offset, sizeof (header));
+      len = GUINT32_FROM_LE (header.len);
+      if (len > length - offset - sizeof (header) ||
+          record_checksum (&header, bytes) != GUINT32_FROM_LE (header.check))
+        break;
+
+      if (!func (GUINT32_FROM_LE (header.op), GUINT32_FROM_LE (header.arg),
+                 bytes, len, user_data, error))
+        {
+          result = FALSE;
+          break;
+        }
+
+      offset += sizeof (header) + len;
+    }
+
+  *n_valid = result ? offset : 0;
+  g_mapped_file_unref (mapping);
+
+  return result;
+}
+
+static gpointer
+journal_writer (gpointer data);
+
+/* opens the journal at @filename for appending, dropping whatever follows
+ * the first @n_valid bytes */
+GundoJournal*
+gundo_journal_new (const gchar* filename,
+                   guint64      n_valid,
+                   guint        sync_interval,
+                   gsize        sync_size,
+                   GError    ** error)
+{
+  GundoJournal* self;
+  int           fd;
+
+  fd = open (filename, O_WRONLY | O_CREAT, 0666);
+  if (fd < 0 ||
+      ftruncate (fd, n_valid) ||
+      lseek (fd, n_valid, SEEK_SET) < 0)
+    {
+      int saved_errno = errno;
+
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                   "%s: %s", filename, g_strerror (saved_errno));
+      if (fd >= 0)
+        close (fd);
+      return NULL;
+    }
+
+  self = g_slice_new0 (GundoJournal);
+  self->fd            = fd;
+  self->filename      = g_strdup (filename);
+  self->pending       = g_byte_array_new ();
+  self->spare         = g_byte_array_new ();
+  self->sync_interval = sync_interval;
+  self->sync_size     = sync_size;
+  self->n_appended    = n_valid;
+  self->n_synced      = n_valid;
+  self->n_requested   = n_valid;
+  g_mutex_init (&self->mutex);
+  g_cond_init (&self->cond);
+  g_cond_init (&self->synced_cond);
+
+  if (!n_valid)
+    {
+      gchar   header[HEADER_SIZE] = MAGIC;
+      guint32 version = GUINT32_TO_LE (VERSION);
+
+      memcpy (header + MAGIC_SIZE, &version, sizeof (version));
+      g_byte_array_append (self->pending, (guint8 const*) header, HEADER_SIZE);
+      self->n_appended  = HEADER_SIZE;
+      self->batch_start = g_get_monotonic_time ();
+    }
+
+  self->writer = g_thread_new ("gundo-journal", journal_writer, self);
+
+  return self;
+}
+
+/* writes out and syncs everything appended so far, then stops the writer;
+ * returns FALSE if anything couldn't be written */
+gboolean
+gundo_journal_free (GundoJournal* self,
+                    GError     ** error)
+{
+  gboolean result = TRUE;
+
+  g_mutex_lock (&self->mutex);
+  self->closing = TRUE;
+  g_cond_signal (&self->cond);
+  g_mutex_unlock (&self->mutex);
+
+  g_thread_join (self->writer);
+
+  if (close (self->fd) && !self->error)
+    g_set_error (&self->error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                 "%s: %s", self->filename, g_strerror (errno));
+
+  if (self->error)
+    {
+      g_propagate_error (error, self->error);
+      result = FALSE;
+    }
+
+  g_byte_array_free (self->pending, TRUE);
+  if (self->spare)
+    g_byte_array_free (self->spare, TRUE);
+  g_cond_clear (&self->synced_cond);
+  g_cond_clear (&self->cond);
+  g_mutex_clear (&self->mutex);
+  g_free (self->filename);
+  g_slice_free (GundoJournal, self);
+
+  return result;
+}
+
+void
+gundo_journal_set_sync (GundoJournal* self,
+                        guint         sync_interval,
+                        gsize         sync_size)
+{
+  g_mutex_lock (&self->mutex);
+  self->sync_interval = sync_interval;
+  self->sync_size     = sync_size;
+  g_cond_signal (&self->cond);
+  g_mutex_unlock (&self->mutex);
+}
+
+/* starts a record; its payload is to be appended to the returned buffer
+ * before gundo_journal_end_record() is called. The journal stays locked in
+ * between, so keep it short. */
+GByteArray*
+gundo_journal_begin_record (GundoJournal * self,
+                            GundoJournalOp op,
+                            guint32        arg)
+{
+  RecordHeader header;
+
+  header.len   = 0;
+  header.arg   = GUINT32_TO_LE (arg);
+  header.op    = GUINT32_TO_LE (op);
+  header.check = 0;
+
+  g_mutex_lock (&self->mutex);
+
+  self->record_start = self->pending->len;
+  g_byte_array_append (self->pending, (guint8 const*) &header, sizeof (header));
+
+  return self->pending;
+}
+
+void
+gundo_journal_end_record (GundoJournal* self)
+{
+  RecordHeader* header = (RecordHeader*) (self->pending->data + self->record_start);
+  gsize         size = self->pending->len - self->record_start;
+
+  if (self->error || size - sizeof (*header) > G_MAXUINT32)
+    {
+      if (!self->error)
+        g_set_error (&self->error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED,
+                     "%s: an action is too big to be journaled", self->filename);
+      g_byte_array_set_size (self->pending, self->record_start);
+      g_mutex_unlock (&self->mutex);
+      return;
+    }
+
+  header->len   = GUINT32_TO_LE (size - sizeof (*header));
+  header->check = GUINT32_TO_LE (record_checksum (header, header + 1));
+
+  self->n_appended += size;
+
+  /* the writer only needs to know about the first record of a batch (to
+   * start waiting for the interval) and about a full batch */
+  if (!self->record_start)
+    {
+      self->batch_start = g_get_monotonic_time ();
+      g_cond_signal (&self->cond);
+    }
+  else if (self->pending->len >= self->sync_size &&
+           self->record_start < self->sync_size)
+    {
+      g_cond_signal (&self->cond);
+    }
+
+  g_mutex_unlock (&self->mutex);
+}
+
+/* stops journaling, e.g. because an operation can't be recorded; takes
+ * over @error, which gundo_journal_sync() and gundo_journal_free() report */
+void
+gundo_journal_fail (GundoJournal* self,
+                    GError      * error)
+{
+  g_mutex_lock (&self->mutex);
+  if (!self->error)
+    self->error = error;
+  else
+    g_error_free (error);
+  g_mutex_unlock (&self->mutex);
+}
+
+/* waits until everything appended so far is on disk */
+gboolean
+gundo_journal_sync (GundoJournal* self,
+                    GError     ** error)
+{
+  gboolean result = TRUE;
+
+  g_mutex_lock (&self->mutex);
+
+  self->n_requested = self->n_appended;
+  g_cond_signal (&self->cond);
+  while (self->n_synced < self->n_requested)
+    g_cond_wait (&self->synced_cond, &self->mutex);
+
+  if (self->error)
+    {
+      if (error)
+        *error = g_error_copy (self->error);
+      result = FALSE;
+    }
+
+  g_mutex_unlock (&self->mutex);
+
+  return result;
+}
+
+static int
+journal_write (int           fd,
+               GByteArray  * batch)
+{
+  gsize written = 0;
+
+  while (written < batch->len)
+    {
+      gssize n = write (fd, batch->data + written, batch->len - written);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return n < 0 ? errno : EIO;
+      written += n;
+    }
+
+  return fsync (fd) ? errno : 0;
+}
+
+/* the writer thread: waits for a batch to be due, then writes and syncs it
+ * while the next batch is being filled */
+static gpointer
+journal_writer (gpointer data)
+{
+  GundoJournal* self = data;
+
+  g_mutex_lock (&self->mutex);
+
+  for (;;)
+    {
+      GByteArray* batch;
+      guint64     end;
+      int         saved_errno;
+
+      while (!self->closing &&
+             self->n_requested <= self->n_synced &&
+             self->pending->len < self->sync_size)
+        {
+          if (!self->pending->len)
+            g_cond_wait (&self->cond, &self->mutex);
+          else if (!g_cond_wait_until (&self->cond, &self->mutex,
+                                       self->batch_start + self->sync_interval * (gint64) 1000))
+            break;
+        }
+
+      if (!self->pending->len)
+        {
+          if (self->closing)
+            break;
+          continue;
+        }
+
+      batch = self->pending;
+      end   = self->n_appended;
+      self->pending = self->spare;
+      self->spare   = NULL;
+
+      if (self->error)
+        {
+          /* nothing gets written after a failure */
+          saved_errno = 0;
+          g_byte_array_set_size (batch, 0);
+        }
+      else
+        {
+          g_mutex_unlock (&self->mutex);
+          saved_errno = journal_write (self->fd, batch);
+          g_byte_array_set_size (batch, 0);
+          g_mutex_lock (&self->mutex);
+        }
+
+      self->spare = batch;
+      if (saved_errno && !self->error)
+        g_set_error (&self->error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                     "%s: %s", self->filename, g_strerror (saved_errno));
+      self->n_synced = end;
+      g_cond_broadcast (&self->synced_cond);
+    }
+
+  g_mutex_unlock (&self->mutex);
+
+  return NULL;
+}
@@ -0,0 +1,87 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GUNDO_JOURNAL_H
+#define GUNDO_JOURNAL_H
+
+#include <gundo-sequence.h>
+
+G_BEGIN_DECLS
+
+/* The journal is an append-only log of the operations on a GundoSequence.
+ * Records are appended to an in-memory batch by the thread using the
+ * sequence; a writer thread writes the batches out and syncs them, once the
+ * oldest record of a batch is older than the sync interval or the batch is
+ * bigger than the sync size (whatever comes first). So appending never
+ * waits for the disk, and a burst of operations shares a single fsync.
+ *
+ * Every record carries a checksum. Replaying a journal stops at the first
+ * incomplete or damaged record, which is where a crash interrupted the
+ * writer; gundo_journal_new() cuts the file there before appending. */
+
+typedef struct _GundoJournal GundoJournal;
+
+typedef enum {
+  GUNDO_JOURNAL_ADD = 1,     /* arg: type index, bytes: serialized data */
+  GUNDO_JOURNAL_ADD_INLINE,  /* arg: type index, bytes: the payload */
+  GUNDO_JOURNAL_GROUP_BEGIN,
+  GUNDO_JOURNAL_GROUP_END,
+  GUNDO_JOURNAL_GROUP_ABORT,
+  GUNDO_JOURNAL_GO_TO,       /* arg: the number of undoable steps */
+  GUNDO_JOURNAL_SWITCH_BRANCH /* arg: the branch id */
+} GundoJournalOp;
+
+typedef gboolean (*GundoJournalReplayFunc) (GundoJournalOp op,
+                                            guint32        arg,
+                                            gconstpointer  bytes,
+                                            gsize          len,
+                                            gpointer       user_data,
+                                            GError      ** error);
+
+gboolean      gundo_journal_replay       (const gchar          * filename,
+                                          GundoJournalReplayFunc func,
+                                          gpointer               user_data,
+                                          guint64              * n_valid,
+                                          GError              ** error);
+GundoJournal* gundo_journal_new          (const gchar          * filename,
+                                          guint64                n_valid,
+                                          guint                  sync_interval,
+                                          gsize                  sync_size,
+                                          GError              ** error);
+gboolean      gundo_journal_free         (GundoJournal         * self,
+                                          GError              ** error);
+void          gundo_journal_set_sync     (GundoJournal         * self,
+                                          guint                  sync_interval,
+                                          gsize                  sync_size);
+GByteArray*   gundo_journal_begin_record (GundoJournal         * self,
+                                          GundoJournalOp         op,
+                                          guint32                arg);
+void          gundo_journal_end_record   (GundoJournal         * self);
+void          gundo_journal_fail         (GundoJournal         * self,
+                                          GError               * error);
+gboolean      gundo_journal_sync         (GundoJournal         * self,
+                                          GError              ** error);
+
+G_END_DECLS
+
+#endif /* !GUNDO_JOURNAL_H */
@@ -0,0 +1,180 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gundo-payload-arena.h"
+
+#include <string.h>
+
+#define CHUNK_SIZE 16384
+
+#define ALIGN(size) (((size) + G_MEM_ALIGN - 1) & ~(gsize) (G_MEM_ALIGN - 1))
+
+typedef struct {
+  guint ref_count;
+  gsize used;
+} PayloadChunk;
+
+typedef struct {
+  GundoActionType const* type;
+  PayloadChunk         * chunk; /* NULL for payloads too big for a chunk */
+  gsize                  len;
+} PayloadHeader;
+
+#define CHUNK_HEADER_SIZE   ALIGN (sizeof (PayloadChunk))
+#define PAYLOAD_HEADER_SIZE ALIGN (sizeof (PayloadHeader))
+
+#define PAYLOAD(header) ((gpointer) ((gchar*) (header) + PAYLOAD_HEADER_SIZE))
+
+struct _GundoPayloadArena {
+  PayloadChunk* current;
+};
+
+/* chunks are referenced by each of their payloads and by the arena as long
+ * as it allocates from them; they are only touched from the main thread */
+static void
+chunk_unref (PayloadChunk* chunk)
+{
+  if (!--chunk->ref_count)
+    g_free (chunk);
+}
+
+static void
+payload_undo (gpointer data)
+{
+  PayloadHeader* header = data;
+
+  header->type->undo (PAYLOAD (header));
+}
+
+static void
+payload_redo (gpointer data)
+{
+  PayloadHeader* header = data;
+
+  header->type->redo (PAYLOAD (header));
+}
+
+static void
+payload_free (gpointer data)
+{
+  PayloadHeader* header = data;
+
+  if (header->type->free)
+    header->type->free (PAYLOAD (header));
+
+  if (header->chunk)
+    chunk_unref (header->chunk);
+  else
+    g_free (header);
+}
+
+static gsize
+payload_size (gpointer data)
+{
+  PayloadHeader* header = data;
+
+  return PAYLOAD_HEADER_SIZE + ALIGN (header->len);
+}
+
+GundoActionType const gundo_payload_arena_type = {
+  .undo = payload_undo,
+  .redo = payload_redo,
+  .free = payload_free,
+  .size = payload_size
+};
+
+GundoPayloadArena*
+gundo_payload_arena_new (void)
+{
+  return g_slice_new0 (GundoPayloadArena);
+}
+
+/* payloads that are still alive keep their chunks alive */
+void
+gundo_payload_arena_free (GundoPayloadArena* self)
+{
+  if (self->current)
+    chunk_unref (self->current);
+
+  g_slice_free (GundoPayloadArena, self);
+}
+
+/* copies @len bytes of payload for an action of @type; returns the data for
+ * a record of type gundo_payload_arena_type */
+gpointer
+gundo_payload_arena_add (GundoPayloadArena    * self,
+                         GundoActionType const* type,
+                         gconstpointer          bytes,
+                         gsize                  len)
+{
+  PayloadHeader* header;
+  gsize          size = PAYLOAD_HEADER_SIZE + ALIGN (len);
+
+  if (len > GUNDO_PAYLOAD_ARENA_MAX_INLINE)
+    {
+      header = g_malloc (size);
+      header->chunk = NULL;
+    }
+  else
+    {
+      if (!self->current || self->current->used + size > CHUNK_SIZE)
+        {
+          if (self->current)
+            chunk_unref (self->current);
+
+          self->current = g_malloc (CHUNK_SIZE);
+          self->current->ref_count = 1;
+          self->current->used      = CHUNK_HEADER_SIZE;
+        }
+
+      header = (PayloadHeader*) ((gchar*) self->current + self->current->used);
+      header->chunk = self->current;
+
+      self->current->used += size;
+      self->current->ref_count++;
+    }
+
+  header->type = type;
+  header->len  = len;
+  memcpy (PAYLOAD (header), bytes, len);
+
+  return header;
+}
+
+GundoActionType const*
+gundo_payload_arena_get_type (gpointer record_data)
+{
+  return ((PayloadHeader*) record_data)->type;
+}
+
+gpointer
+gundo_payload_arena_get_payload (gpointer record_data)
+{
+  return PAYLOAD (record_data);
+}
+
+gsize
+gundo_payload_arena_get_len (gpointer record_data)
+{
+  return ((PayloadHeader*) record_data)->len;
+}
@@ -0,0 +1,58 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GUNDO_PAYLOAD_ARENA_H
+#define GUNDO_PAYLOAD_ARENA_H
+
+#include <gundo-sequence.h>
+
+G_BEGIN_DECLS
+
+/* The payload arena keeps copies of small action payloads packed into large
+ * chunks, so recording an action doesn't cost a malloc/free pair of its
+ * own. Every payload is prefixed by a header naming its real action type.
+ * The record of such an action has the wrapper type
+ * gundo_payload_arena_type, whose callbacks forward to the real type, so
+ * the rest of the sequence doesn't need to know about the arena. A chunk is
+ * freed once its last payload is freed, even after the arena is gone. */
+
+typedef struct _GundoPayloadArena GundoPayloadArena;
+
+/* payloads bigger than this get an allocation of their own */
+#define GUNDO_PAYLOAD_ARENA_MAX_INLINE 512
+
+extern GundoActionType const gundo_payload_arena_type;
+
+GundoPayloadArena*     gundo_payload_arena_new         (void);
+void                   gundo_payload_arena_free        (GundoPayloadArena    * self);
+gpointer               gundo_payload_arena_add         (GundoPayloadArena    * self,
+                                                        GundoActionType const* type,
+                                                        gconstpointer          bytes,
+                                                        gsize                  len);
+GundoActionType const* gundo_payload_arena_get_type    (gpointer               record_data);
+gpointer               gundo_payload_arena_get_payload (gpointer               record_data);
+gsize                  gundo_payload_arena_get_len     (gpointer               record_data);
+
+G_END_DECLS
+
+#endif /* !GUNDO_PAYLOAD_ARENA_H */
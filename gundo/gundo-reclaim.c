@@ -0,0 +1,258 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+
+#include "gundo-reclaim.h"
+
+/* the number of actions freed per idle callback */
+#define RECLAIM_CHUNK 128
+/* the number of actions waiting for the idle handler at most; nothing
+ * guarantees that the main loop runs, so past this they get freed right
+ * away instead of piling up */
+#define RECLAIM_MAX_IDLE (64 * 1024)
+
+typedef struct {
+  gconstpointer owner;
+  UndoAction  * actions;
+  guint         n_actions;
+  guint         n_freed;
+} ReclaimBatch;
+
+/* idle batches are only touched from the main thread */
+static GQueue       idle_batches = G_QUEUE_INIT;
+static guint        idle_source = 0;
+static guint        idle_n_pending = 0;
+
+/* the number of batches in the worker per owner */
+static GThreadPool* worker = NULL;
+static GMutex       worker_mutex;
+static GCond        worker_cond;
+static GHashTable * worker_pending = NULL;
+
+/* returns the number of actions it freed */
+static guint
+batch_free (ReclaimBatch* batch,
+            guint         n_actions)
+{
+  guint start = batch->n_freed;
+  guint end = MIN (batch->n_freed + n_actions, batch->n_actions);
+
+  for (; batch->n_freed < end; batch->n_freed++)
+    {
+      UndoAction* action = &batch->actions[batch->n_freed];
+
+      action->type->free (action->data);
+    }
+
+  return end - start;
+}
+
+static void
+batch_destroy (ReclaimBatch* batch)
+{
+  g_free (batch->actions);
+  g_slice_free (ReclaimBatch, batch);
+}
+
+static gboolean
+reclaim_idle (gpointer user_data G_GNUC_UNUSED)
+{
+  ReclaimBatch* batch = g_queue_peek_head (&idle_batches);
+
+  idle_n_pending -= batch_free (batch, RECLAIM_CHUNK);
+  if (batch->n_freed == batch->n_actions)
+    {
+      g_queue_pop_head (&idle_batches);
+      batch_destroy (batch);
+    }
+
+  if (g_queue_is_empty (&idle_batches))
+    {
+      idle_source = 0;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+reclaim_worker (gpointer data,
+                gpointer user_data G_GNUC_UNUSED)
+{
+  ReclaimBatch* batch = data;
+  gconstpointer owner = batch->owner;
+  guint         n_pending;
+
+  batch_free (batch, batch->n_actions);
+  batch_destroy (batch);
+
+  g_mutex_lock (&worker_mutex);
+  n_pending = GPOINTER_TO_UINT (g_hash_table_lookup (worker_pending, owner)) - 1;
+  if (n_pending)
+    g_hash_table_insert (worker_pending, (gpointer) owner, GUINT_TO_POINTER (n_pending));
+  else
+    g_hash_table_remove (worker_pending, owner);
+  g_cond_broadcast (&worker_cond);
+  g_mutex_unlock (&worker_mutex);
+}
+
+static ReclaimBatch*
+batch_new (gconstpointer owner,
+           guint         n_actions)
+{
+  ReclaimBatch* batch = g_slice_new (ReclaimBatch);
+
+  batch->owner     = owner;
+  batch->actions   = g_new (UndoAction, n_actions);
+  batch->n_actions = 0;
+  batch->n_freed   = 0;
+
+  return batch;
+}
+
+static void
+reclaim_queue_idle (ReclaimBatch* batch)
+{
+  g_queue_push_tail (&idle_batches, batch);
+  idle_n_pending += batch->n_actions;
+
+  if (!idle_source)
+    idle_source = g_idle_add_full (G_PRIORITY_LOW, reclaim_idle, NULL, NULL);
+}
+
+static void
+reclaim_queue_worker (ReclaimBatch* batch)
+{
+  guint n_pending;
+
+  if (!worker)
+    worker = g_thread_pool_new (reclaim_worker, NULL, 1, FALSE, NULL);
+
+  g_mutex_lock (&worker_mutex);
+  if (!worker_pending)
+    worker_pending = g_hash_table_new (NULL, NULL);
+  n_pending = GPOINTER_TO_UINT (g_hash_table_lookup (worker_pending, batch->owner));
+  g_hash_table_insert (worker_pending, (gpointer) batch->owner, GUINT_TO_POINTER (n_pending + 1));
+  g_mutex_unlock (&worker_mutex);
+
+  g_thread_pool_push (worker, batch, NULL);
+}
+
+/* hands the (not yet freed) records [@index, @index + @n_actions) of @store
+ * over to the reclamation queue; the records can be dropped from @store
+ * right away */
+void
+gundo_reclaim_push (gconstpointer     owner,
+                    GundoActionStore* store,
+                    guint             index,
+                    guint             n_actions)
+{
+  ReclaimBatch* idle = NULL;
+  ReclaimBatch* threaded = NULL;
+  guint         n_idle = 0;
+  guint         n_threaded = 0;
+  gboolean      free_now;
+  guint         i;
+
+  /* size the batches first, so each only gets its own share */
+  for (i = index; i < index + n_actions; i++)
+    {
+      UndoAction* action = gundo_action_store_index (store, i);
+
+      if (!action->type->free)
+        continue;
+
+      if (action->type->flags & GUNDO_ACTION_FREE_THREADSAFE)
+        n_threaded++;
+      else
+        n_idle++;
+    }
+
+  free_now = idle_n_pending + n_idle > RECLAIM_MAX_IDLE;
+  if (n_idle && !free_now)
+    idle = batch_new (owner, n_idle);
+  if (n_threaded)
+    threaded = batch_new (owner, n_threaded);
+
+  for (i = index; i < index + n_actions; i++)
+    {
+      UndoAction  * action = gundo_action_store_index (store, i);
+      ReclaimBatch* batch;
+
+      if (!action->type->free)
+        continue;
+
+      if (action->type->flags & GUNDO_ACTION_FREE_THREADSAFE)
+        batch = threaded;
+      else if (free_now)
+        {
+          action->type->free (action->data);
+          continue;
+        }
+      else
+        batch = idle;
+
+      batch->actions[batch->n_actions++] = *action;
+    }
+
+  if (idle)
+    reclaim_queue_idle (idle);
+  if (threaded)
+    reclaim_queue_worker (threaded);
+}
+
+/* frees everything queued for @owner (everything for %NULL) right away and
+ * waits for the worker thread to finish the batches of @owner */
+void
+gundo_reclaim_flush (gconstpointer owner)
+{
+  GList* iter = idle_batches.head;
+
+  while (iter)
+    {
+      ReclaimBatch* batch = iter->data;
+      GList       * next = iter->next;
+
+      if (!owner || batch->owner == owner)
+        {
+          idle_n_pending -= batch_free (batch, batch->n_actions);
+          g_queue_delete_link (&idle_batches, iter);
+          batch_destroy (batch);
+        }
+
+      iter = next;
+    }
+
+  if (g_queue_is_empty (&idle_batches) && idle_source)
+    {
+      g_source_remove (idle_source);
+      idle_source = 0;
+    }
+
+  g_mutex_lock (&worker_mutex);
+  while (worker_pending &&
+         (owner ? g_hash_table_lookup (worker_pending, owner) != NULL
+                : g_hash_table_size (worker_pending) > 0))
+    g_cond_wait (&worker_cond, &worker_mutex);
+  g_mutex_unlock (&worker_mutex);
+}
@@ -0,0 +1,47 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+
+#ifndef GUNDO_RECLAIM_H
+#define GUNDO_RECLAIM_H
+
+#include "gundo-action-store.h"
+
+G_BEGIN_DECLS
+
+/* The reclamation queue takes over actions discarded by a GundoSequence and
+ * frees them off the critical path: in small chunks from an idle handler
+ * or, for types flagged with GUNDO_ACTION_FREE_THREADSAFE, in a worker
+ * thread. Once too many actions wait for the idle handler, new ones are
+ * freed right away. The queue outlives the sequences, so finalizing a
+ * sequence can hand its actions over as well. */
+
+void gundo_reclaim_push  (gconstpointer     owner,
+                          GundoActionStore* store,
+                          guint             index,
+                          guint             n_actions);
+void gundo_reclaim_flush (gconstpointer     owner);
+
+G_END_DECLS
+
+#endif /* !GUNDO_RECLAIM_H */
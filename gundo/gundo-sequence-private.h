@@ -0,0 +1,103 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GUNDO_SEQUENCE_PRIVATE_H
+#define GUNDO_SEQUENCE_PRIVATE_H
+
+#include "gundo-sequence.h"
+
+G_BEGIN_DECLS
+
+struct _GundoSequencePrivate
+{
+	struct _GundoActionStore* actions;
+	guint          n_committed;
+	guint          open_group;
+	guint          group_depth;
+
+	guint          n_steps;
+	guint          n_undos;
+	guint          n_pushed;
+	guint          n_truncated;
+	/* evicted steps the viewers haven't been told about yet */
+	guint          n_evicted_pending;
+	guint          can_undo : 1;
+	guint          can_redo : 1;
+	/* ::changed went out ahead of the step that is being built */
+	guint          changed_emitted : 1;
+
+	GundoMemoryUsage usage;
+	GundoMemoryUsage redo_usage;
+	guint          redo_usage_index;
+	gsize          max_size;
+	guint          max_depth;
+	guint          n_evicted;
+
+	gboolean       deferred_free;
+	gboolean       instrumented;
+	struct _GundoStats*        stats;
+
+	struct _GundoPayloadArena* payloads;
+	struct _GundoGroupArena*   group_arena;
+
+	gboolean       branching;
+	guint          branch;
+	guint          last_branch;
+	guint64        branch_age;
+	GPtrArray*     branches;
+	GundoMemoryUsage branch_usage;
+	guint          max_branches;
+	gsize          max_branch_size;
+
+	struct _GundoHistoryFile*  file;
+	GError*        restore_error;
+
+	struct _GundoJournal*      journal;
+	const GundoActionType**    journal_types;
+	guint          n_journal_types;
+	guint          journal_sync_interval;
+	gsize          journal_sync_size;
+
+	struct _GundoSpill*        spill;
+	guint          spill_depth;
+	guint          spill_mark;
+	guint          spill_steps;
+	/* spilled records may be found below this, on either side */
+	guint          spill_end;
+
+	struct _GundoCold*         cold;
+	guint          compress_distance;
+	guint          cold_mark;
+	guint          cold_steps;
+	guint          cold_redo_records;
+	guint          cold_redo_steps;
+
+	struct _GundoCheckpoints*  checkpoints;
+	guint          checkpoint_interval;
+	guint64        checkpoint_cost;
+	guint          max_checkpoints;
+};
+
+G_END_DECLS
+
+#endif /* !GUNDO_SEQUENCE_PRIVATE_H */
@@ -23,13 +23,84 @@
  * @short_description: sequence of undo/redo actions
  *
  * A #GundoSequence contains a list of undoable/redoable actions. Action can be
- * added with gundo_sequence_add_action().
+ * added with gundo_sequence_add_action(), or with
+ * gundo_sequence_add_action_inline() for small payloads the sequence should
+ * keep a copy of.
+ *
+ * A sequence can be given a memory budget with the #GundoSequence:max-size
+ * property. Once the actions in the sequence cost more than that, the oldest
+ * undoable actions get evicted from the sequence (and freed).
+ *
+ * Discarding a long redo tail (or finalizing a long sequence) can mean a lot
+ * of calls to free callbacks. With #GundoSequence:deferred-free set, these
+ * are run later, in small chunks from an idle handler (or in a worker thread
+ * for types with %GUNDO_ACTION_FREE_THREADSAFE). Call
+ * gundo_sequence_flush_discarded() to free them deterministically.
+ *
+ * To find out which action types make undo or redo slow, set
+ * #GundoSequence:instrumented. The sequence then records call counts and
+ * latencies per #GundoActionType, which can be queried with
+ * gundo_sequence_get_action_stats().
+ *
+ * Usually, adding an action after undoing some discards the actions that
+ * could have been redone. With #GundoSequence:branching set, they are kept
+ * as a branch instead, forming an undo tree. Steps shared by several
+ * branches are stored once. gundo_sequence_foreach_branch() lists the tips
+ * of the branches and gundo_sequence_switch_branch() jumps to one of them,
+ * undoing and redoing only the steps between the current state and the
+ * common ancestor. #GundoSequence:max-branches and
+ * #GundoSequence:max-branch-size bound the memory held by the branches.
+ *
+ * gundo_sequence_save() writes the actions to a file, using the serialize
+ * callbacks of their types, and gundo_sequence_load() brings them back in
+ * another session. Loading only reads the index of the file: the actions
+ * are deserialized one by one, once undoing or redoing reaches them, so
+ * opening a long history is quick and memory only grows with the part of
+ * it that gets visited.
+ *
+ * To survive crashes, a sequence can write a journal of everything done to
+ * it, see gundo_sequence_open_journal(). The journal is written and synced
+ * to disk by a thread of its own, so recording actions never waits for
+ * the disk.
+ *
+ * For long sessions, the payloads of old actions can be moved out of the
+ * heap into a memory-mapped scratch file, see gundo_sequence_open_spill().
+ * Only the latest #GundoSequence:spill-depth undoable steps stay in
+ * memory; older ones are deserialized again as undoing reaches them.
+ *
+ * Without a disk to spill to, #GundoSequence:compress-distance keeps the
+ * payloads of the steps far from the current state (in either direction)
+ * compressed in memory instead. They are compressed in batches by a
+ * worker thread and decompressed as undoing or redoing reaches them, see
+ * gundo_sequence_get_compression_stats().
+ *
+ * Jumping far with gundo_history_goto() calls the callbacks of every step
+ * in between, which takes long if they are expensive. An application that
+ * can snapshot its state registers a snapshot and a restore callback with
+ * gundo_sequence_set_checkpoint_funcs(). The sequence then takes
+ * checkpoints as the history grows and is replayed, and a far jump
+ * restores the checkpoint closest to its target and only replays the
+ * steps from there.
  */
 /* FIXME: write more */
  
 #include <stdio.h>
+#include <string.h>
 #include <glib.h>
 #include "gundo.h"
+#include "gundo-action-store.h"
+#include "gundo-branch.h"
+#include "gundo-checkpoints.h"
+#include "gundo-cold.h"
+#include "gundo-group-arena.h"
+#include "gundo-history-file.h"
+#include "gundo-journal.h"
+#include "gundo-payload-arena.h"
+#include "gundo-reclaim.h"
+#include "gundo-sequence-private.h"
+#include "gundo-spill.h"
+#include "gundo-stats.h"
+#include "gundo-trace-points.h"
 
 /**
  * GundoActionType:
@@ -37,6 +108,16 @@
  * @redo: Function called to redo the action.
  * @free: Function called to free the action_data.  Can be NULL, in which case
  * the action_data is not free'd.
+ * @size: Function called to find out how many bytes the action_data occupies.
+ * Can be NULL, in which case only the size of the action record is accounted.
+ * @flags: #GundoActionFlags describing the action type.
+ * @merge: Function called to fold a new action into the latest one. Can be
+ * NULL, in which case every action is recorded on its own.
+ * @serialize: Function called to write the action_data to a history file.
+ * Can be NULL, in which case sequences holding such actions can't be saved
+ * and the actions are never spilled or compressed.
+ * @deserialize: Function called to read the action_data back from a
+ * history file. Can be NULL, in which case such actions can't be loaded.
  *
  * An GundoActionType defines the operations that can be applied to an undo
  * action that has been added to an GundoSequence.  All operations are of
@@ -51,10 +132,36 @@
  * 
  * free: Frees the data about an action of this type. Can be %NULL, in which
  * case the data is not freed.
+ *
+ * size: Reports the payload size of an action of this type. Can be %NULL.
+ * This is only used to enforce the #GundoSequence:max-size budget.
+ *
+ * merge: Folds the data of a new action into the data of the latest undoable
+ * action of the same type. Can be %NULL. See #GundoActionMergeFunc.
+ *
+ * serialize, deserialize: Convert the data to bytes and back. Can be %NULL.
+ * See gundo_sequence_save() and gundo_sequence_load().
  * 
  * @see #gundo_sequence_add_action
  */
 
+/**
+ * GundoActionEntry:
+ * @type: The type of the action.
+ * @data: Data about the action.
+ *
+ * An action to be added with gundo_sequence_add_actions().
+ */
+
+/**
+ * GundoActionFlags:
+ * @GUNDO_ACTION_FREE_THREADSAFE: the free callback of the type may be called
+ * from any thread. Discarded actions of such a type are freed in a worker
+ * thread if the sequence has #GundoSequence:deferred-free set.
+ *
+ * Flags describing a #GundoActionType.
+ */
+
 /**
  * GundoActionCallback:
  * @action_data: Data about the action.  The action_data pointer must be
@@ -66,46 +173,279 @@
  * @see #GundoActionType
  */
 
+/**
+ * GundoActionSizeFunc:
+ * @action_data: Data about the action.
+ *
+ * The type of function called to query the number of bytes held by the
+ * action_data of an action. The returned value must not change while the
+ * action is part of a #GundoSequence.
+ *
+ * Returns: the size of @action_data in bytes.
+ */
+
+/**
+ * GundoActionMergeFunc:
+ * @action_data: Data about the latest undoable action.
+ * @new_data: Data about the action that is being added.
+ *
+ * The type of function called by gundo_sequence_add_action() to fold a new
+ * action into the latest undoable one, e.g. to record a run of keystrokes
+ * as a single step. It is only called if both actions have the same type,
+ * there is nothing to redo and no group boundary lies between them.
+ *
+ * If the function returns %TRUE, undoing @action_data must undo both
+ * actions from now on, and @new_data is freed with the free callback of the
+ * type right away. If it returns %FALSE, the new action is added as usual.
+ *
+ * Returns: %TRUE if @new_data was merged into @action_data.
+ */
+
+/**
+ * GundoActionSerializeFunc:
+ * @action_data: Data about the action.
+ * @buffer: the buffer to append the serialized data to.
+ *
+ * The type of function called by gundo_sequence_save() to turn the
+ * action_data of an action into bytes. The bytes must not depend on the
+ * address of anything, as they will be read back in another process.
+ */
+
+/**
+ * GundoActionDeserializeFunc:
+ * @bytes: the bytes written by the #GundoActionSerializeFunc of the type.
+ * @len: the number of @bytes.
+ *
+ * The type of function called to restore the action_data of an action
+ * loaded with gundo_sequence_load(). It is called right before the action
+ * is first undone or redone, and to load back actions spilled by
+ * gundo_sequence_open_spill() or compressed (see
+ * #GundoSequence:compress-distance). @bytes point into a mapping of the
+ * file or a buffer and are only valid during the call.
+ *
+ * Returns: the action_data, owned by the sequence just like data passed to
+ * gundo_sequence_add_action(). %NULL marks the bytes of a loaded file as
+ * damaged, see gundo_sequence_get_restore_error().
+ */
+
+/**
+ * GundoSequenceError:
+ * @GUNDO_SEQUENCE_ERROR_INVALID_FILE: the file is not a history file, or it
+ * is damaged.
+ * @GUNDO_SEQUENCE_ERROR_UNSUPPORTED: an action type is missing from the
+ * type table, or it can't be (de)serialized.
+ *
+ * Error codes returned by gundo_sequence_save() and gundo_sequence_load().
+ */
+
+/**
+ * GundoActionOp:
+ * @GUNDO_ACTION_OP_ADD: adding an action with gundo_sequence_add_action()
+ * or gundo_sequence_add_action_inline(), including merging it and the
+ * commit of the history.
+ * @GUNDO_ACTION_OP_UNDO: the undo callback.
+ * @GUNDO_ACTION_OP_REDO: the redo callback.
+ * @GUNDO_ACTION_OP_FREE: the free callback, if it is run right away.
+ * @GUNDO_ACTION_N_OPS: the number of operations.
+ *
+ * The operations measured by an instrumented #GundoSequence.
+ */
+
+/**
+ * GundoActionStats:
+ * @n_calls: the number of calls.
+ * @total_ns: the cumulative latency of all calls in nanoseconds.
+ * @max_ns: the latency of the slowest call in nanoseconds.
+ * @histogram: the number of calls per latency; bucket i counts the calls
+ * that took from 2^i to 2^(i+1) nanoseconds, bucket 0 includes the ones
+ * that took no time and the last bucket the ones that took longer.
+ *
+ * The measurements of an operation on the actions of a #GundoActionType.
+ */
+
+/**
+ * GundoCompressionStats:
+ * @n_actions: the number of actions whose payloads are compressed, or
+ * waiting in a batch to be compressed.
+ * @raw_bytes: the size of the payloads in the batches that have been
+ * compressed and are still held.
+ * @compressed_bytes: the size of these batches compressed; @raw_bytes
+ * divided by this is the compression ratio.
+ * @decompress: the latencies of decompressing a batch when undoing or
+ * redoing reached one of its actions.
+ *
+ * The state of the compression of a #GundoSequence, see
+ * gundo_sequence_get_compression_stats().
+ */
+
+/**
+ * GundoActionStatsFunc:
+ * @type: an action type.
+ * @op: the operation.
+ * @stats: the measurements of @op on the actions of @type.
+ * @user_data: the data passed to gundo_sequence_foreach_action_stats().
+ *
+ * The type of function called by gundo_sequence_foreach_action_stats().
+ */
+
+/**
+ * GundoBranchFunc:
+ * @branch: the id of a branch.
+ * @fork: the number of steps the branch shares with the current line.
+ * @n_steps: the number of steps from the oldest one to the tip of the
+ * branch.
+ * @user_data: the data passed to gundo_sequence_foreach_branch().
+ *
+ * The type of function called by gundo_sequence_foreach_branch().
+ */
+
+/**
+ * GundoSnapshotFunc:
+ * @user_data: the data passed to gundo_sequence_set_checkpoint_funcs().
+ *
+ * The type of function called to take a checkpoint: it captures the state
+ * of the application right now, after the callbacks of all steps up to
+ * the current one were run.
+ *
+ * Returns: the snapshot, freed with the free_snapshot function passed to
+ * gundo_sequence_set_checkpoint_funcs().
+ */
+
+/**
+ * GundoRestoreFunc:
+ * @snapshot: a snapshot returned by the #GundoSnapshotFunc.
+ * @user_data: the data passed to gundo_sequence_set_checkpoint_funcs().
+ *
+ * The type of function called to bring the state of the application back
+ * to @snapshot. @snapshot still belongs to the sequence, which may restore
+ * it again later.
+ */
+
 /**
  * GundoSequence:
+ * @next_redo: the index of the first redoable record; read-only
+ * @group: %NULL, or @seq itself while a group is being built; read-only
  *
  * A #GObject implementing the #GundoHistory interface.
+ *
+ * <warning><para>Groups don't have a sequence of their own anymore, so
+ * @group is only a marker and must not be followed: it points back to the
+ * sequence itself no matter how deeply groups are nested. Code that walks
+ * down to the innermost group with
+ * <literal>while (s->group) s = s->group;</literal> loops forever; compare
+ * it against %NULL instead.</para></warning>
  */
 
 enum {
 	PROP_0,
 	PROP_CAN_UNDO,
-	PROP_CAN_REDO
-};
-
-typedef struct _UndoAction UndoAction;
-struct _UndoAction {
-    const GundoActionType *type;
-    gpointer data;
+	PROP_CAN_REDO,
+	PROP_MAX_SIZE,
+	PROP_MAX_DEPTH,
+	PROP_N_EVICTED,
+	PROP_DEFERRED_FREE,
+	PROP_INSTRUMENTED,
+	PROP_UNDO_MEMORY_USAGE,
+	PROP_REDO_MEMORY_USAGE,
+	PROP_BRANCHING,
+	PROP_MAX_BRANCHES,
+	PROP_MAX_BRANCH_SIZE,
+	PROP_JOURNAL_SYNC_INTERVAL,
+	PROP_JOURNAL_SYNC_SIZE,
+	PROP_SPILL_DEPTH,
+	PROP_COMPRESS_DISTANCE,
+	PROP_CHECKPOINT_INTERVAL,
+	PROP_CHECKPOINT_COST,
+	PROP_MAX_CHECKPOINTS
 };
 
 static void gundo_sequence_class_init( GundoSequenceClass* );
 static void gundo_sequence_init( GundoSequence* );
-static void group_undo( GundoSequence *seq );
-static void group_redo( GundoSequence *seq );
-static void free_actions( int actc, UndoAction *actv );
+static void free_actions( GundoActionStore *store, guint index, guint n_actions );
+static void sequence_discard( GundoSequence *seq, guint index, guint n_actions );
+static void sequence_discard_store( GundoSequence *seq, GundoActionStore *store, guint index, guint n_actions );
+static void sequence_discard_moved( GundoSequence *seq, guint index, UndoAction const *moved );
+static void sequence_drop_branches( GundoSequence *seq, guint first, guint end );
+static gboolean sequence_step_forward( GundoSequence *seq );
+static gboolean sequence_step_back( GundoSequence *seq );
+static gboolean sequence_materialize( GundoSequence *seq, guint index, guint n_actions );
+static gsize usage_get_total( GundoMemoryUsage const *usage );
 
+/* Groups are stored inline in the action array of the sequence: a group is
+ * a span of action records framed by a begin and an end marker. Both markers
+ * carry the number of records between them, so a group can be stepped over
+ * from either side. While a group is still being constructed, its begin
+ * marker carries the distance to the begin marker of the enclosing open
+ * group instead (0 for the outermost one). This makes the open groups a
+ * stack with seq->priv->open_group pointing at the innermost one, so none of the
+ * group operations depend on the nesting depth. */
+static GundoActionType gundo_group_begin = { .undo = NULL, .redo = NULL };
+static GundoActionType gundo_group_end   = { .undo = NULL, .redo = NULL };
 
-static GundoActionType gundo_action_group = {
-    (GundoActionCallback)group_undo,
-    (GundoActionCallback)group_redo,
-    (GundoActionCallback)g_object_unref
-};
+#define IS_GROUP_MARKER(action) ((action)->type == &gundo_group_begin || \
+                                 (action)->type == &gundo_group_end)
 
 static void gs_history_iface_init(GundoHistoryIface* iface);
 
 G_DEFINE_TYPE_WITH_CODE(GundoSequence, gundo_sequence, G_TYPE_OBJECT,
+			G_ADD_PRIVATE(GundoSequence)
 			G_IMPLEMENT_INTERFACE(GUNDO_TYPE_HISTORY, gs_history_iface_init));
 
 static void gundo_sequence_init( GundoSequence *seq ) {
-    seq->actions = g_array_new( FALSE, FALSE, sizeof(UndoAction) );
+    seq->priv = gundo_sequence_get_instance_private (seq);
+    seq->priv->actions = gundo_action_store_new();
     seq->next_redo = 0;
+    seq->priv->n_committed = 0;
     seq->group = NULL;
+    seq->priv->open_group = 0;
+    seq->priv->group_depth = 0;
+    seq->priv->n_steps = 0;
+    seq->priv->n_undos = 0;
+    seq->priv->n_pushed = 0;
+    seq->priv->n_truncated = 0;
+    seq->priv->n_evicted_pending = 0;
+    seq->priv->can_undo = FALSE;
+    seq->priv->can_redo = FALSE;
+    memset( &seq->priv->usage, 0, sizeof(seq->priv->usage) );
+    memset( &seq->priv->redo_usage, 0, sizeof(seq->priv->redo_usage) );
+    seq->priv->redo_usage_index = 0;
+    seq->priv->max_size = 0;
+    seq->priv->max_depth = 0;
+    seq->priv->n_evicted = 0;
+    seq->priv->deferred_free = FALSE;
+    seq->priv->instrumented = FALSE;
+    seq->priv->stats = NULL;
+    seq->priv->payloads = NULL;
+    seq->priv->group_arena = NULL;
+    seq->priv->branching = FALSE;
+    seq->priv->branch = 0;
+    seq->priv->last_branch = 0;
+    seq->priv->branch_age = 0;
+    seq->priv->branches = g_ptr_array_new();
+    memset( &seq->priv->branch_usage, 0, sizeof(seq->priv->branch_usage) );
+    seq->priv->max_branches = 0;
+    seq->priv->max_branch_size = 0;
+    seq->priv->file = NULL;
+    seq->priv->journal = NULL;
+    seq->priv->journal_types = NULL;
+    seq->priv->n_journal_types = 0;
+    seq->priv->journal_sync_interval = 100;
+    seq->priv->journal_sync_size = 256 * 1024;
+    seq->priv->spill = NULL;
+    seq->priv->spill_depth = 100;
+    seq->priv->spill_mark = 0;
+    seq->priv->spill_steps = 0;
+    seq->priv->spill_end = 0;
+    seq->priv->cold = NULL;
+    seq->priv->compress_distance = 0;
+    seq->priv->cold_mark = 0;
+    seq->priv->cold_steps = 0;
+    seq->priv->cold_redo_records = 0;
+    seq->priv->cold_redo_steps = 0;
+    seq->priv->checkpoints = NULL;
+    seq->priv->checkpoint_interval = 0;
+    seq->priv->checkpoint_cost = 100 * 1000 * 1000;
+    seq->priv->max_checkpoints = 16;
 }
 
 static void
@@ -115,13 +455,42 @@ gs_finalize(GObject *object) {
 	g_return_if_fail(object);
 
 	seq = GUNDO_SEQUENCE(object);
-	free_actions(seq->actions->len, (UndoAction*)seq->actions->data);
-	
-	if(seq->group) {
-		g_object_unref(G_OBJECT(seq->group));
-		seq->group = NULL;
+	if(seq->priv->journal) {
+		GError *error = NULL;
+
+		if(!gundo_sequence_close_journal(seq, &error)) {
+			g_warning("%s", error->message);
+			g_error_free(error);
+		}
+	}
+	sequence_drop_branches(seq, 0, G_MAXUINT);
+	g_ptr_array_free(seq->priv->branches, TRUE);
+	sequence_discard(seq, 0, seq->priv->actions->len);
+	gundo_action_store_free(seq->priv->actions);
+	if(seq->priv->payloads) {
+		gundo_payload_arena_free(seq->priv->payloads);
+	}
+	if(seq->priv->stats) {
+		gundo_stats_free(seq->priv->stats);
+	}
+	if(seq->priv->group_arena) {
+		gundo_group_arena_free(seq->priv->group_arena);
+	}
+	if(seq->priv->file) {
+		gundo_history_file_free(seq->priv->file);
+	}
+	if(seq->priv->restore_error) {
+		g_error_free(seq->priv->restore_error);
+	}
+	if(seq->priv->spill) {
+		gundo_spill_free(seq->priv->spill);
+	}
+	if(seq->priv->cold) {
+		gundo_cold_free(seq->priv->cold);
+	}
+	if(seq->priv->checkpoints) {
+		gundo_checkpoints_free(seq->priv->checkpoints);
 	}
-	g_array_free(seq->actions, TRUE);
 
 	if(G_OBJECT_CLASS(gundo_sequence_parent_class)->finalize) {
 		G_OBJECT_CLASS(gundo_sequence_parent_class)->finalize(object);
@@ -130,14 +499,67 @@ gs_finalize(GObject *object) {
 
 static void
 gs_get_property(GObject* object, guint prop_id, GValue* value, GParamSpec* pspec) {
-	GundoHistory* history = GUNDO_HISTORY(object);
-	
+	GundoMemoryUsage usage;
+
 	switch(prop_id) {
 	case PROP_CAN_REDO:
-		g_value_set_boolean(value, gundo_history_can_redo(history));
+		g_value_set_boolean(value, GUNDO_SEQUENCE(object)->priv->can_redo);
 		break;
 	case PROP_CAN_UNDO:
-		g_value_set_boolean(value, gundo_history_can_undo(history));
+		g_value_set_boolean(value, GUNDO_SEQUENCE(object)->priv->can_undo);
+		break;
+	case PROP_MAX_SIZE:
+		g_value_set_uint64(value, GUNDO_SEQUENCE(object)->priv->max_size);
+		break;
+	case PROP_MAX_DEPTH:
+		g_value_set_uint(value, GUNDO_SEQUENCE(object)->priv->max_depth);
+		break;
+	case PROP_N_EVICTED:
+		g_value_set_uint(value, GUNDO_SEQUENCE(object)->priv->n_evicted);
+		break;
+	case PROP_DEFERRED_FREE:
+		g_value_set_boolean(value, GUNDO_SEQUENCE(object)->priv->deferred_free);
+		break;
+	case PROP_INSTRUMENTED:
+		g_value_set_boolean(value, GUNDO_SEQUENCE(object)->priv->instrumented);
+		break;
+	case PROP_UNDO_MEMORY_USAGE:
+		gundo_history_get_memory_usage(GUNDO_HISTORY(object), &usage, NULL);
+		g_value_set_uint64(value, usage_get_total(&usage));
+		break;
+	case PROP_REDO_MEMORY_USAGE:
+		gundo_history_get_memory_usage(GUNDO_HISTORY(object), NULL, &usage);
+		g_value_set_uint64(value, usage_get_total(&usage));
+		break;
+	case PROP_BRANCHING:
+		g_value_set_boolean(value, GUNDO_SEQUENCE(object)->priv->branching);
+		break;
+	case PROP_MAX_BRANCHES:
+		g_value_set_uint(value, GUNDO_SEQUENCE(object)->priv->max_branches);
+		break;
+	case PROP_MAX_BRANCH_SIZE:
+		g_value_set_uint64(value, GUNDO_SEQUENCE(object)->priv->max_branch_size);
+		break;
+	case PROP_JOURNAL_SYNC_INTERVAL:
+		g_value_set_uint(value, GUNDO_SEQUENCE(object)->priv->journal_sync_interval);
+		break;
+	case PROP_JOURNAL_SYNC_SIZE:
+		g_value_set_uint64(value, GUNDO_SEQUENCE(object)->priv->journal_sync_size);
+		break;
+	case PROP_SPILL_DEPTH:
+		g_value_set_uint(value, GUNDO_SEQUENCE(object)->priv->spill_depth);
+		break;
+	case PROP_COMPRESS_DISTANCE:
+		g_value_set_uint(value, GUNDO_SEQUENCE(object)->priv->compress_distance);
+		break;
+	case PROP_CHECKPOINT_INTERVAL:
+		g_value_set_uint(value, GUNDO_SEQUENCE(object)->priv->checkpoint_interval);
+		break;
+	case PROP_CHECKPOINT_COST:
+		g_value_set_uint64(value, GUNDO_SEQUENCE(object)->priv->checkpoint_cost);
+		break;
+	case PROP_MAX_CHECKPOINTS:
+		g_value_set_uint(value, GUNDO_SEQUENCE(object)->priv->max_checkpoints);
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -148,9 +570,54 @@ gs_get_property(GObject* object, guint prop_id, GValue* value, GParamSpec* pspec
 static void
 gs_set_property(GObject* object, guint prop_id, GValue const* value, GParamSpec* pspec) {
 	switch(prop_id) {
+	case PROP_MAX_SIZE:
+		gundo_sequence_set_max_size(GUNDO_SEQUENCE(object), g_value_get_uint64(value));
+		break;
+	case PROP_MAX_DEPTH:
+		gundo_sequence_set_max_depth(GUNDO_SEQUENCE(object), g_value_get_uint(value));
+		break;
+	case PROP_DEFERRED_FREE:
+		gundo_sequence_set_deferred_free(GUNDO_SEQUENCE(object), g_value_get_boolean(value));
+		break;
+	case PROP_INSTRUMENTED:
+		gundo_sequence_set_instrumented(GUNDO_SEQUENCE(object), g_value_get_boolean(value));
+		break;
+	case PROP_BRANCHING:
+		gundo_sequence_set_branching(GUNDO_SEQUENCE(object), g_value_get_boolean(value));
+		break;
+	case PROP_MAX_BRANCHES:
+		gundo_sequence_set_max_branches(GUNDO_SEQUENCE(object), g_value_get_uint(value));
+		break;
+	case PROP_MAX_BRANCH_SIZE:
+		gundo_sequence_set_max_branch_size(GUNDO_SEQUENCE(object), g_value_get_uint64(value));
+		break;
+	case PROP_JOURNAL_SYNC_INTERVAL:
+		gundo_sequence_set_journal_sync_interval(GUNDO_SEQUENCE(object), g_value_get_uint(value));
+		break;
+	case PROP_JOURNAL_SYNC_SIZE:
+		gundo_sequence_set_journal_sync_size(GUNDO_SEQUENCE(object), g_value_get_uint64(value));
+		break;
+	case PROP_SPILL_DEPTH:
+		gundo_sequence_set_spill_depth(GUNDO_SEQUENCE(object), g_value_get_uint(value));
+		break;
+	case PROP_COMPRESS_DISTANCE:
+		gundo_sequence_set_compress_distance(GUNDO_SEQUENCE(object), g_value_get_uint(value));
+		break;
+	case PROP_CHECKPOINT_INTERVAL:
+		gundo_sequence_set_checkpoint_interval(GUNDO_SEQUENCE(object), g_value_get_uint(value));
+		break;
+	case PROP_CHECKPOINT_COST:
+		gundo_sequence_set_checkpoint_cost(GUNDO_SEQUENCE(object), g_value_get_uint64(value));
+		break;
+	case PROP_MAX_CHECKPOINTS:
+		gundo_sequence_set_max_checkpoints(GUNDO_SEQUENCE(object), g_value_get_uint(value));
+		break;
 	case PROP_CAN_REDO:
 	case PROP_CAN_UNDO:
-		// these two cannot be set
+	case PROP_N_EVICTED:
+	case PROP_UNDO_MEMORY_USAGE:
+	case PROP_REDO_MEMORY_USAGE:
+		// these cannot be set
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 		break;
@@ -165,6 +632,244 @@ gundo_sequence_class_init(GundoSequenceClass *self_class) {
 	go_class->set_property = gs_set_property;
 
 	gundo_history_install_properties(go_class, PROP_CAN_UNDO, PROP_CAN_REDO);
+
+	/**
+	 * GundoSequence:max-size:
+	 *
+	 * The memory budget of this sequence in bytes. When adding an action
+	 * makes the size of the sequence exceed this budget, the oldest undoable
+	 * actions are freed until the sequence fits again. The most recent
+	 * action is never evicted. 0 means there is no budget.
+	 *
+	 * The size of an action is the size of its record plus whatever the
+	 * #GundoActionType size callback reports for its payload, see
+	 * gundo_sequence_get_size().
+	 */
+	g_object_class_install_property(go_class, PROP_MAX_SIZE,
+					g_param_spec_uint64("max-size",
+							    "max size",
+							    "The memory budget in bytes (0 for unlimited)",
+							    0, G_MAXSIZE, 0,
+							    G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:max-depth:
+	 *
+	 * The maximum number of undoable steps kept by this sequence. Adding
+	 * a step to a full sequence frees the oldest one, and lowering the
+	 * depth frees the steps beyond it right away. Groups count as a
+	 * single step. 0 means the depth is unlimited.
+	 */
+	g_object_class_install_property(go_class, PROP_MAX_DEPTH,
+					g_param_spec_uint("max-depth",
+							  "max depth",
+							  "The maximum number of undoable steps (0 for unlimited)",
+							  0, G_MAXUINT, 0,
+							  G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:n-evicted:
+	 *
+	 * The number of undoable steps that have been evicted from this
+	 * sequence to keep it within its #GundoSequence:max-size or its
+	 * #GundoSequence:max-depth. A group counts as a single step.
+	 */
+	g_object_class_install_property(go_class, PROP_N_EVICTED,
+					g_param_spec_uint("n-evicted",
+							  "n evicted",
+							  "The number of steps evicted to fit the budget",
+							  0, G_MAXUINT, 0,
+							  G_PARAM_READABLE));
+	/**
+	 * GundoSequence:deferred-free:
+	 *
+	 * Whether actions discarded by this sequence (a truncated redo tail,
+	 * evicted or aborted actions and, on finalization, all actions) are
+	 * freed later instead of right away. See
+	 * gundo_sequence_flush_discarded(). The idle handler needs the
+	 * default main loop to run; once too many actions are waiting for
+	 * it, further ones are freed right away.
+	 */
+	g_object_class_install_property(go_class, PROP_DEFERRED_FREE,
+					g_param_spec_boolean("deferred-free",
+							     "deferred free",
+							     "Free discarded actions from an idle handler or a worker thread",
+							     FALSE,
+							     G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:instrumented:
+	 *
+	 * Whether this sequence measures the operations on its actions per
+	 * #GundoActionType, see gundo_sequence_get_action_stats(). Without it,
+	 * the sequence doesn't look at a clock at all.
+	 */
+	g_object_class_install_property(go_class, PROP_INSTRUMENTED,
+					g_param_spec_boolean("instrumented",
+							     "instrumented",
+							     "Measure the operations on the actions per action type",
+							     FALSE,
+							     G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:undo-memory-usage:
+	 *
+	 * The number of bytes held by the undoable actions of this sequence
+	 * (and a group being constructed), see gundo_history_get_memory_usage().
+	 * Reading it is cheap, but it is not notified about, so poll it.
+	 */
+	g_object_class_install_property(go_class, PROP_UNDO_MEMORY_USAGE,
+					g_param_spec_uint64("undo-memory-usage",
+							    "undo memory usage",
+							    "The bytes held by the undoable actions",
+							    0, G_MAXUINT64, 0,
+							    G_PARAM_READABLE));
+	/**
+	 * GundoSequence:redo-memory-usage:
+	 *
+	 * The number of bytes held by the redoable actions of this sequence,
+	 * including the ones only kept by other branches (see
+	 * #GundoSequence:branching), see gundo_history_get_memory_usage().
+	 * Reading it is cheap, but it is not notified about, so poll it.
+	 */
+	g_object_class_install_property(go_class, PROP_REDO_MEMORY_USAGE,
+					g_param_spec_uint64("redo-memory-usage",
+							    "redo memory usage",
+							    "The bytes held by the redoable actions",
+							    0, G_MAXUINT64, 0,
+							    G_PARAM_READABLE));
+	/**
+	 * GundoSequence:branching:
+	 *
+	 * Whether this sequence keeps the redoable actions as a branch when an
+	 * action is added, instead of discarding them. See
+	 * gundo_sequence_switch_branch(). Turning it off discards all branches
+	 * but the current one.
+	 */
+	g_object_class_install_property(go_class, PROP_BRANCHING,
+					g_param_spec_boolean("branching",
+							     "branching",
+							     "Keep the redoable actions as a branch when adding an action",
+							     FALSE,
+							     G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:max-branches:
+	 *
+	 * The maximum number of branches kept besides the current one. When
+	 * there are more, the least recently left branches are discarded,
+	 * starting with the ones without branches of their own. 0 means there
+	 * is no limit.
+	 */
+	g_object_class_install_property(go_class, PROP_MAX_BRANCHES,
+					g_param_spec_uint("max-branches",
+							  "max branches",
+							  "The maximum number of branches kept besides the current one (0 for unlimited)",
+							  0, G_MAXUINT, 0,
+							  G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:max-branch-size:
+	 *
+	 * The memory budget in bytes for the actions that are only part of
+	 * branches other than the current one. Branches are discarded like for
+	 * #GundoSequence:max-branches until they fit. 0 means there is no
+	 * budget.
+	 */
+	g_object_class_install_property(go_class, PROP_MAX_BRANCH_SIZE,
+					g_param_spec_uint64("max-branch-size",
+							    "max branch size",
+							    "The memory budget for the other branches in bytes (0 for unlimited)",
+							    0, G_MAXSIZE, 0,
+							    G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:journal-sync-interval:
+	 *
+	 * The longest time in milliseconds a journaled operation waits before
+	 * it is synced to disk, see gundo_sequence_open_journal(). Operations
+	 * coming in during that time are synced together. 0 syncs as soon as
+	 * the journal gets to it.
+	 */
+	g_object_class_install_property(go_class, PROP_JOURNAL_SYNC_INTERVAL,
+					g_param_spec_uint("journal-sync-interval",
+							  "journal sync interval",
+							  "The time in milliseconds journaled operations may wait to be synced",
+							  0, G_MAXUINT, 100,
+							  G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:journal-sync-size:
+	 *
+	 * The number of bytes of journaled operations that make the journal
+	 * sync right away, without waiting for the
+	 * #GundoSequence:journal-sync-interval.
+	 */
+	g_object_class_install_property(go_class, PROP_JOURNAL_SYNC_SIZE,
+					g_param_spec_uint64("journal-sync-size",
+							    "journal sync size",
+							    "The number of journaled bytes that get synced right away",
+							    1, G_MAXSIZE, 256 * 1024,
+							    G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:spill-depth:
+	 *
+	 * The number of latest undoable steps whose actions always stay in
+	 * memory once the sequence spills, see gundo_sequence_open_spill().
+	 * The actions of older steps are moved to the spill file.
+	 */
+	g_object_class_install_property(go_class, PROP_SPILL_DEPTH,
+					g_param_spec_uint("spill-depth",
+							  "spill depth",
+							  "The number of latest undoable steps kept in memory when spilling",
+							  1, G_MAXUINT, 100,
+							  G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:compress-distance:
+	 *
+	 * The number of steps on either side of the current state whose
+	 * actions stay uncompressed. The payloads of the steps further away
+	 * are compressed in memory, see
+	 * gundo_sequence_set_compress_distance(). 0 means nothing gets
+	 * compressed.
+	 */
+	g_object_class_install_property(go_class, PROP_COMPRESS_DISTANCE,
+					g_param_spec_uint("compress-distance",
+							  "compress distance",
+							  "The number of steps on either side of the current state kept uncompressed (0 for no compression)",
+							  0, G_MAXUINT, 0,
+							  G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:checkpoint-interval:
+	 *
+	 * The number of steps after which a checkpoint is taken at the
+	 * latest, see gundo_sequence_set_checkpoint_funcs(). 0 leaves it to
+	 * #GundoSequence:checkpoint-cost.
+	 */
+	g_object_class_install_property(go_class, PROP_CHECKPOINT_INTERVAL,
+					g_param_spec_uint("checkpoint-interval",
+							  "checkpoint interval",
+							  "The number of steps between checkpoints (0 for no fixed interval)",
+							  0, G_MAXUINT, 0,
+							  G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:checkpoint-cost:
+	 *
+	 * The time in nanoseconds replaying the steps since the last
+	 * checkpoint may take before the next one is taken, see
+	 * gundo_sequence_set_checkpoint_funcs(). 0 leaves it to
+	 * #GundoSequence:checkpoint-interval.
+	 */
+	g_object_class_install_property(go_class, PROP_CHECKPOINT_COST,
+					g_param_spec_uint64("checkpoint-cost",
+							    "checkpoint cost",
+							    "The replay time in nanoseconds between checkpoints (0 for no limit)",
+							    0, G_MAXUINT64, 100 * 1000 * 1000,
+							    G_PARAM_READWRITE));
+	/**
+	 * GundoSequence:max-checkpoints:
+	 *
+	 * The number of checkpoints kept at most. Once there are more, the
+	 * ones closest to their neighbours are dropped. 0 means no limit.
+	 */
+	g_object_class_install_property(go_class, PROP_MAX_CHECKPOINTS,
+					g_param_spec_uint("max-checkpoints",
+							  "max checkpoints",
+							  "The number of checkpoints kept at most (0 for no limit)",
+							  0, G_MAXUINT, 16,
+							  G_PARAM_READWRITE));
 }
 
 
@@ -186,234 +891,3585 @@ gundo_sequence_new (void)
                        NULL);
 }
 
+GQuark
+gundo_sequence_error_quark (void)
+{
+  return g_quark_from_static_string ("gundo-sequence-error-quark");
+}
+
+
+static gsize
+usage_get_total (GundoMemoryUsage const* usage)
+{
+  return usage->records + usage->groups + usage->payloads;
+}
 
 static void
-sequence_changed (GundoHistory* history)
+usage_add (GundoMemoryUsage      * usage,
+           GundoMemoryUsage const* other)
 {
-  GundoSequence* seq = GUNDO_SEQUENCE (history);
+  usage->records  += other->records;
+  usage->groups   += other->groups;
+  usage->payloads += other->payloads;
+}
 
-  if (seq->next_redo < seq->actions->len)
-    {
-      free_actions (seq->actions->len - seq->next_redo,
-                    (UndoAction*)seq->actions->data + seq->next_redo);
+static void
+usage_subtract (GundoMemoryUsage      * usage,
+                GundoMemoryUsage const* other)
+{
+  usage->records  -= other->records;
+  usage->groups   -= other->groups;
+  usage->payloads -= other->payloads;
+}
 
-      g_array_set_size (seq->actions, seq->next_redo);
+/* adds the memory held by @action to @usage */
+static void
+action_add_usage (UndoAction const* action,
+                  GundoMemoryUsage* usage)
+{
+  if (IS_GROUP_MARKER (action))
+    {
+      usage->groups += sizeof (UndoAction);
+    }
+  else if (action->type == &gundo_group_arena_type)
+    {
+      usage->groups += sizeof (UndoAction) + action->type->size (action->data);
+    }
+  else
+    {
+      usage->records += sizeof (UndoAction);
+      if (action->type->size)
+        usage->payloads += action->type->size (action->data);
     }
 }
 
-
-/**
- * gundo_sequence_add_action:
- * @seq: The undo sequence to which to add an action.
- * @type: The type of the action.
- * @data: Data about the action.  The data is destroyed by calling the
- * "free" callback of the action type.
- *
- * Adds an action to the end of the GundoSequence.  Any actions that
- * have been undone but not redone are destroyed.  If any groups have
- * been started, the action is appended to the end of the most recently
- * started group.
- */
-void
-gundo_sequence_add_action(GundoSequence        * seq,
-                          GundoActionType const* type,
-                          gpointer               data)
+static void
+actions_get_usage (GundoActionStore* store,
+                   guint             index,
+                   guint             n_actions,
+                   GundoMemoryUsage* usage)
 {
-        g_return_if_fail (seq);
-
-	if( seq->group ) {
-		gundo_sequence_add_action( seq->group, type, data );
-	} else {
-		UndoAction action;
-		gboolean could_undo = gundo_history_can_undo(GUNDO_HISTORY(seq));
-		gboolean could_redo = gundo_history_can_redo(GUNDO_HISTORY(seq));
+  guint i;
 
-                gundo_history_changed (GUNDO_HISTORY (seq));
+  memset (usage, 0, sizeof (*usage));
 
-		action.type = type;
-		action.data = data;
+  for (i = index; i < index + n_actions; i++)
+    action_add_usage (gundo_action_store_index (store, i), usage);
+}
 
-		g_array_append_val( seq->actions, action );
-		seq->next_redo++;
+/* stops accounting the records [@index, @index + @n_actions) */
+static void
+sequence_unaccount (GundoSequence* seq,
+                    guint          index,
+                    guint          n_actions)
+{
+  GundoMemoryUsage usage;
 
-		if(!could_undo) {
-			// now we definitely can undo
-			g_object_notify(G_OBJECT(seq), "can-undo");
-		}
-		if(could_redo) {
-			// now we definitely can't redo
-			g_object_notify(G_OBJECT(seq), "can-redo");
-		}
-        }
+  actions_get_usage (seq->priv->actions, index, n_actions, &usage);
+  usage_subtract (&seq->priv->usage, &usage);
 }
 
-/**
- * gundo_sequence_start_group:
- * @seq: a #GundoSequence
- * 
- * Starts a new group of actions that are treated as a single action.
- * E.g. a single call to undo and redo undoes or redoes all actions of
- * the group.  This is useful if a single action by the user causes
- * the program to issue multiple internal actions.  Groups can be
- * nested.
- */
-void gundo_sequence_start_group( GundoSequence *seq ) {
-    if( seq->group ) {
-        gundo_sequence_start_group( seq->group );
-    } else {
-        seq->group = gundo_sequence_new();
+/* brings the usage of the redo side up to date with the position; this
+ * only looks at the records that were undone or redone since the last
+ * time, so undo and redo don't need to account anything */
+static void
+sequence_sync_redo_usage (GundoSequence* seq)
+{
+  GundoMemoryUsage moved;
+
+  if (seq->next_redo < seq->priv->redo_usage_index)
+    {
+      actions_get_usage (seq->priv->actions, seq->next_redo,
+                         seq->priv->redo_usage_index - seq->next_redo, &moved);
+      usage_add (&seq->priv->redo_usage, &moved);
     }
+  else if (seq->next_redo > seq->priv->redo_usage_index)
+    {
+      actions_get_usage (seq->priv->actions, seq->priv->redo_usage_index,
+                         seq->next_redo - seq->priv->redo_usage_index, &moved);
+      usage_subtract (&seq->priv->redo_usage, &moved);
+    }
+
+  seq->priv->redo_usage_index = seq->next_redo;
 }
 
-/**
- * gundo_sequence_end_group:
- * @seq: a #GundoSequence
- * 
- * Ends a group, adding it to the end of the undo sequence, or its parent
- * group.
- */
-void gundo_sequence_end_group( GundoSequence *seq ) {
-    g_return_if_fail( seq->group != NULL );
-    
-    if( seq->group->group ) {
-        gundo_sequence_end_group( seq->group );
-    } else {
-        GundoSequence *group = seq->group;
-        seq->group = NULL;
-        
-        if( group->actions->len > 0 ) {
-            gundo_sequence_add_action( seq, &gundo_action_group, group );
-        } else {
-            g_object_unref(G_OBJECT(group));
-        }
-    }
+/* the number of records of the step starting with @first */
+static guint
+step_get_n_records (UndoAction const* first)
+{
+  if (first->type == &gundo_group_begin)
+    return GPOINTER_TO_UINT (first->data) + 2;
+
+  return 1;
 }
 
-/**
- * gundo_sequence_abort_group:
- * @seq: a #GundoSequence
- *
- * Aborts the construction of a group, freeing all of its actions.
- */
-void gundo_sequence_abort_group( GundoSequence *seq ) {
-    g_return_if_fail( seq->group != NULL );
-    
-    if( seq->group->group ) {
-        gundo_sequence_abort_group( seq->group );
-    } else {
-        GundoSequence *group = seq->group;
-        seq->group = 0;
-        g_object_unref(G_OBJECT(group));
-    }
+/* the number of records of the step ending with @last */
+static guint
+step_get_n_records_before (UndoAction const* last)
+{
+  if (last->type == &gundo_group_end)
+    return GPOINTER_TO_UINT (last->data) + 2;
+
+  return 1;
 }
 
-static void
-sequence_redo (GundoHistory* history)
+/* the type an instrumented action is accounted to: the type of the action
+ * wrapped by the payload arena, NULL for records private to the sequence */
+static GundoActionType const*
+action_get_stats_type (UndoAction const* action)
 {
-        GundoSequence* seq = GUNDO_SEQUENCE (history);
-	UndoAction *action;
-	gboolean could_undo;
+  if (action->type == &gundo_payload_arena_type)
+    return gundo_payload_arena_get_type (action->data);
+  if (IS_GROUP_MARKER (action) || action->type == &gundo_group_arena_type)
+    return NULL;
+
+  return action->type;
+}
 
-	g_return_if_fail( seq->group == NULL );
-	g_return_if_fail( gundo_history_can_redo(GUNDO_HISTORY(seq) ));
+/* calls the undo or redo callbacks of the records [@index, @index +
+ * @n_actions), measuring each call for the stats and the checkpoints, as
+ * far as they are there; returns the time all calls took */
+static guint64
+actions_call_instrumented (GundoSequence* seq,
+                           guint          index,
+                           guint          n_actions,
+                           GundoActionOp  op)
+{
+  guint64 total = 0;
+  guint   i;
 
-	could_undo = gundo_history_can_undo(GUNDO_HISTORY(seq));
+  for (i = 0; i < n_actions; i++)
+    {
+      guint                  pos = op == GUNDO_ACTION_OP_UNDO ? index + n_actions - 1 - i : index + i;
+      UndoAction           * action = gundo_action_store_index (seq->priv->actions, pos);
+      GundoActionType const* type = action_get_stats_type (action);
+      guint64                start;
+      guint64                ns;
 
-	action = &g_array_index( seq->actions, UndoAction, seq->next_redo );
-	seq->next_redo++;
-	(action->type->redo)( action->data );
+      if (!type)
+        continue;
 
-	if(!could_undo) {
-		// now we can definitely undo
-		g_object_notify(G_OBJECT(seq), "can-undo");
-	}
-	if(!gundo_history_can_redo(GUNDO_HISTORY(seq))) {
-		// so we can't redo anymore
-		g_object_notify(G_OBJECT(seq), "can-redo");
-	}
-}
+      start = gundo_stats_now ();
+      if (op == GUNDO_ACTION_OP_UNDO)
+        action->type->undo (action->data);
+      else
+        action->type->redo (action->data);
+      ns = gundo_stats_now () - start;
 
+      if (seq->priv->instrumented)
+        gundo_stats_record (seq->priv->stats, type, op, ns);
+      if (seq->priv->checkpoints)
+        gundo_checkpoints_measure (seq->priv->checkpoints, type, ns);
+      total += ns;
+    }
 
-static void group_undo( GundoSequence *self ) {
-	GundoHistory* history = GUNDO_HISTORY(self);
-	while(gundo_history_can_undo(history)) {
-		gundo_history_undo(history);
-	}
+  return total;
 }
 
-
 static void
-group_redo(GundoSequence *self)
+actions_undo (GundoActionStore* store,
+              guint             index,
+              guint             n_actions)
 {
-	GundoHistory* history = GUNDO_HISTORY(self);
-	while(gundo_history_can_redo (history)) {
-		gundo_history_redo (history);
-	}
-}
+  guint i;
 
+  for (i = index + n_actions; i > index; i--)
+    {
+      UndoAction* action = gundo_action_store_index (store, i - 1);
 
-static void free_actions( int actc, UndoAction *actv ) {
-    int i;
-    
-    for( i = 0; i < actc; i++ ) {
-        if( (actv[i].type->free) ) (actv[i].type->free)( actv[i].data );
+      if (!IS_GROUP_MARKER (action))
+        action->type->undo (action->data);
     }
 }
 
-/* GundoHistory implementation */
+static void
+actions_redo (GundoActionStore* store,
+              guint             index,
+              guint             n_actions)
+{
+  guint i;
 
-static gboolean
-gs_can_redo(GundoHistory *history) {
-	GundoSequence* self = GUNDO_SEQUENCE(history);
-	return self->next_redo < self->actions->len;
-}
+  for (i = index; i < index + n_actions; i++)
+    {
+      UndoAction* action = gundo_action_store_index (store, i);
 
-static gboolean
-gs_can_undo(GundoHistory *history) {
-	GundoSequence* self = GUNDO_SEQUENCE(history);
-	return self->next_redo > 0;
+      if (!IS_GROUP_MARKER (action))
+        action->type->redo (action->data);
+    }
 }
 
-static guint
-sequence_get_n_redos (GundoHistory* history)
+/* what replaying the records [@index, @index + @n_actions) is expected to
+ * cost, going by the measured callbacks of their types */
+static guint64
+actions_estimate (GundoSequence* seq,
+                  guint          index,
+                  guint          n_actions)
 {
-  return GUNDO_SEQUENCE (history)->actions->len - GUNDO_SEQUENCE (history)->next_redo;
+  guint64 cost = 0;
+  guint   i;
+
+  for (i = index; i < index + n_actions; i++)
+    {
+      GundoActionType const* type = action_get_stats_type (gundo_action_store_index (seq->priv->actions, i));
+
+      if (type)
+        cost += gundo_checkpoints_estimate (seq->priv->checkpoints, type);
+    }
+
+  return cost;
 }
 
+/* the number of records of the @n_steps steps starting at @index */
 static guint
-sequence_get_n_changes (GundoHistory* history)
+steps_get_n_records (GundoActionStore* store,
+                     guint             index,
+                     guint             n_steps)
 {
-  if (GUNDO_SEQUENCE (history)->next_redo)
-    return GUNDO_SEQUENCE (history)->actions->len;
-  else
-    return GUNDO_SEQUENCE (history)->next_redo;
+  guint n_records = 0;
+
+  for (; n_steps; n_steps--)
+    n_records += step_get_n_records (gundo_action_store_index (store, index + n_records));
+
+  return n_records;
 }
 
 static void
-gs_undo(GundoHistory* history) {
-	GundoSequence* self;
-	UndoAction   * action;
-	gboolean       could_redo;
+actions_copy (GundoActionStore* dest,
+              GundoActionStore* src,
+              guint             index,
+              guint             n_actions)
+{
+  guint i;
 
-	self = GUNDO_SEQUENCE(history);
+  gundo_action_store_reserve (dest, n_actions);
 
-	g_return_if_fail(self->group == NULL);
-	g_return_if_fail(gundo_history_can_undo(history));
+  for (i = index; i < index + n_actions; i++)
+    gundo_action_store_append (dest, gundo_action_store_index (src, i));
+}
 
-	could_redo = gundo_history_can_redo(history);
+/* frees the actions of @branch, which must not be in the list anymore */
+static void
+sequence_free_branch (GundoSequence* seq,
+                      GundoBranch  * branch)
+{
+  sequence_discard_store (seq, branch->actions, 0, branch->actions->len);
+  usage_subtract (&seq->priv->branch_usage, &branch->usage);
+  gundo_branch_free (branch);
+}
 
-	self->next_redo--;
-	action = &g_array_index( self->actions, UndoAction, self->next_redo );
-				(action->type->undo)( action->data );
+/* frees the branches forking off the line at a depth in [@first, @end),
+ * along with the branches forking off them */
+static void
+sequence_drop_branches (GundoSequence* seq,
+                        guint          first,
+                        guint          end)
+{
+  GPtrArray* dropped;
+  guint      i;
+
+  if (!seq->priv->branches->len)
+    return;
+
+  dropped = g_ptr_array_new ();
+
+  for (i = 0; i < seq->priv->branches->len; )
+    {
+      GundoBranch* branch = g_ptr_array_index (seq->priv->branches, i);
+      guint        depth = gundo_branch_get_root (branch)->depth;
+
+      if (depth >= first && depth < end)
+        {
+          g_ptr_array_add (dropped, branch);
+          g_ptr_array_remove_index (seq->priv->branches, i);
+        }
+      else
+        {
+          i++;
+        }
+    }
+
+  /* they may be each other's parents */
+  for (i = 0; i < dropped->len; i++)
+    gundo_branch_set_parent (g_ptr_array_index (dropped, i), NULL);
+  for (i = 0; i < dropped->len; i++)
+    sequence_free_branch (seq, g_ptr_array_index (dropped, i));
+
+  g_ptr_array_free (dropped, TRUE);
+}
+
+/* discards the least recently left branches without branches of their own
+ * until the branches fit into their limits */
+static void
+sequence_enforce_branch_limits (GundoSequence* seq)
+{
+  while (seq->priv->branches->len &&
+         ((seq->priv->max_branches && seq->priv->branches->len > seq->priv->max_branches) ||
+          (seq->priv->max_branch_size && usage_get_total (&seq->priv->branch_usage) > seq->priv->max_branch_size)))
+    {
+      GundoBranch* oldest = NULL;
+      guint        i;
+
+      for (i = 0; i < seq->priv->branches->len; i++)
+        {
+          GundoBranch* branch = g_ptr_array_index (seq->priv->branches, i);
+
+          if (!branch->n_children && (!oldest || branch->age < oldest->age))
+            oldest = branch;
+        }
+
+      g_ptr_array_remove (seq->priv->branches, oldest);
+      sequence_free_branch (seq, oldest);
+    }
+}
+
+/* drops the committed steps from the first one after @index (at @depth)
+ * with a spilled record that couldn't be loaded back, along with the
+ * branches forking off them; they can't be redone, and the spill forgets
+ * about them once they are cut off the line */
+static void
+sequence_drop_unspilled (GundoSequence* seq,
+                         guint          index,
+                         guint          depth)
+{
+  guint n_records;
+  guint i;
+
+  for (; index < seq->priv->n_committed; depth++)
+    {
+      n_records = step_get_n_records (gundo_action_store_index (seq->priv->actions, index));
+      for (i = index; i < index + n_records; i++)
+        if (gundo_action_store_index (seq->priv->actions, i)->type == &gundo_spill_type)
+          break;
+      if (i < index + n_records)
+        break;
+      index += n_records;
+    }
+
+  n_records = seq->priv->n_committed - index;
+  gundo_spill_truncate (seq->priv->spill, seq->priv->actions, index, n_records);
+  sequence_unaccount (seq, index, n_records);
+  sequence_discard (seq, index, n_records);
+  gundo_action_store_remove_range (seq->priv->actions, index, n_records);
+
+  seq->priv->n_committed  = index;
+  seq->priv->n_truncated += seq->priv->n_steps - depth;
+  seq->priv->n_steps      = depth;
+
+  sequence_drop_branches (seq, depth + 1, G_MAXUINT);
+}
+
+/* moves the committed steps from @depth on, starting with the record at
+ * @index, into a new branch that takes over the id of the line; the caller
+ * updates the position */
+static void
+sequence_cut_branch (GundoSequence* seq,
+                     guint          index,
+                     guint          depth)
+{
+  GundoBranch* branch = gundo_branch_new (seq->priv->branch, depth);
+  guint        n_records = seq->priv->n_committed - index;
+  guint        i;
+
+  /* the spill only knows the records of the line */
+  if (G_UNLIKELY (seq->priv->spill_end > index))
+    {
+      if (!sequence_materialize (seq, index, seq->priv->spill_end - index))
+        sequence_drop_unspilled (seq, index, depth);
+      seq->priv->spill_end = index;
+      n_records = seq->priv->n_committed - index;
+    }
+
+  branch->n_steps = seq->priv->n_steps - depth;
+  branch->age     = ++seq->priv->branch_age;
+
+  actions_copy (branch->actions, seq->priv->actions, index, n_records);
+  actions_get_usage (seq->priv->actions, index, n_records, &branch->usage);
+  usage_subtract (&seq->priv->usage, &branch->usage);
+  usage_add (&seq->priv->branch_usage, &branch->usage);
+
+  gundo_action_store_remove_range (seq->priv->actions, index, n_records);
+
+  /* the branches forking off the steps that were cut fork off the new
+   * branch now */
+  for (i = 0; i < seq->priv->branches->len; i++)
+    {
+      GundoBranch* other = g_ptr_array_index (seq->priv->branches, i);
+
+      if (!other->parent && other->depth > depth)
+        gundo_branch_set_parent (other, branch);
+    }
+
+  g_ptr_array_add (seq->priv->branches, branch);
+}
+
+/* appends the steps of @branch up to @end to the line, which has to end
+ * where @branch forks off; what is left of @branch forks off the line at
+ * @end afterwards */
+static void
+sequence_graft_branch (GundoSequence* seq,
+                       GundoBranch  * branch,
+                       guint          end)
+{
+  guint            n_steps = end - branch->depth;
+  guint            n_records = steps_get_n_records (branch->actions, 0, n_steps);
+  GundoMemoryUsage usage;
+  guint            i;
+
+  actions_copy (seq->priv->actions, branch->actions, 0, n_records);
+  actions_get_usage (branch->actions, 0, n_records, &usage);
+  usage_add (&seq->priv->usage, &usage);
+  usage_subtract (&branch->usage, &usage);
+  usage_subtract (&seq->priv->branch_usage, &usage);
+
+  gundo_action_store_drop_head (branch->actions, n_records);
+
+  seq->priv->n_committed += n_records;
+  seq->priv->n_steps     += n_steps;
+  branch->depth     = end;
+  branch->n_steps  -= n_steps;
+
+  /* the branches forking off the grafted steps fork off the line now */
+  for (i = 0; i < seq->priv->branches->len; i++)
+    {
+      GundoBranch* other = g_ptr_array_index (seq->priv->branches, i);
+
+      if (other->parent == branch && other->depth <= end)
+        gundo_branch_set_parent (other, NULL);
+    }
+
+  gundo_branch_set_parent (branch, NULL);
+
+  if (!branch->n_steps)
+    {
+      g_ptr_array_remove (seq->priv->branches, branch);
+      gundo_branch_free (branch);
+    }
+}
+
+/* tells the viewers about the changes of the undoable and redoable steps;
+ * the redoable ones only ever change next to the current state */
+static void
+sequence_stacks_changed (GundoSequence* seq,
+                         guint          undo_position,
+                         guint          n_undos_removed,
+                         guint          n_undos_added,
+                         guint          n_redos_removed,
+                         guint          n_redos_added)
+{
+  GundoHistoryChange change;
+
+  change.undo.position  = undo_position;
+  change.undo.n_removed = n_undos_removed;
+  change.undo.n_added   = n_undos_added;
+  change.redo.position  = 0;
+  change.redo.n_removed = n_redos_removed;
+  change.redo.n_added   = n_redos_added;
+
+  gundo_history_stacks_changed (GUNDO_HISTORY (seq), &change);
+}
+
+/* reports the steps evicted by sequence_evict_quietly(), which the viewers
+ * still have at the bottom, and then the steps pushed (and the redoable
+ * ones they replaced) since the last time */
+static void
+sequence_flush_pushed (GundoSequence* seq)
+{
+  if (G_UNLIKELY (seq->priv->n_evicted_pending))
+    {
+      sequence_stacks_changed (seq, seq->priv->n_undos - seq->priv->n_pushed,
+                               seq->priv->n_evicted_pending, 0, 0, 0);
+      seq->priv->n_evicted_pending = 0;
+      g_object_notify (G_OBJECT (seq), "n-evicted");
+    }
+
+  if (!seq->priv->n_pushed && !seq->priv->n_truncated)
+    return;
+
+  sequence_stacks_changed (seq, 0, 0, seq->priv->n_pushed, seq->priv->n_truncated, 0);
+
+  seq->priv->n_pushed    = 0;
+  seq->priv->n_truncated = 0;
+}
+
+/* drops the oldest @n_steps undoable steps without telling anybody */
+static void
+sequence_drop_oldest (GundoSequence* seq,
+                      guint          n_steps)
+{
+  guint   n_evict = 0;
+  guint64 start = GUNDO_TRACE_BEGIN ();
+  guint   i;
+
+  for (i = 0; i < n_steps; i++)
+    n_evict += step_get_n_records (gundo_action_store_index (seq->priv->actions, n_evict));
+
+  sequence_sync_redo_usage (seq);
+  sequence_unaccount (seq, 0, n_evict);
+  if (G_UNLIKELY (seq->priv->spill))
+    {
+      gundo_spill_forget (seq->priv->spill, seq->priv->actions, 0, n_evict);
+      seq->priv->spill_mark  -= MIN (seq->priv->spill_mark, n_evict);
+      seq->priv->spill_steps -= MIN (seq->priv->spill_steps, n_steps);
+      seq->priv->spill_end   -= MIN (seq->priv->spill_end, n_evict);
+    }
+  seq->priv->cold_mark  -= MIN (seq->priv->cold_mark, n_evict);
+  seq->priv->cold_steps -= MIN (seq->priv->cold_steps, n_steps);
+  sequence_discard (seq, 0, n_evict);
+  gundo_action_store_drop_head (seq->priv->actions, n_evict);
+
+  seq->next_redo   -= n_evict;
+  seq->priv->redo_usage_index = seq->next_redo;
+  seq->priv->n_committed -= n_evict;
+  if (seq->priv->open_group)
+    seq->priv->open_group -= n_evict;
+  seq->priv->n_steps     -= n_steps;
+  seq->priv->n_undos     -= n_steps;
+  seq->priv->n_evicted   += n_steps;
+
+  if (G_UNLIKELY (seq->priv->checkpoints))
+    gundo_checkpoints_drop_before (seq->priv->checkpoints, seq->priv->n_evicted);
+
+  /* branches can't fork off steps that are gone */
+  if (seq->priv->branches->len)
+    {
+      sequence_drop_branches (seq, 0, n_steps);
+      for (i = 0; i < seq->priv->branches->len; i++)
+        ((GundoBranch*) g_ptr_array_index (seq->priv->branches, i))->depth -= n_steps;
+    }
+
+  GUNDO_TRACE_END ("evict", seq, 0, n_evict, start);
+}
+
+/* evict the oldest @n_steps undoable steps */
+static void
+sequence_evict (GundoSequence* seq,
+                guint          n_steps)
+{
+  if (!n_steps)
+    return;
+
+  /* the viewers have to know about the new steps before their rows can be
+   * counted from the bottom */
+  sequence_flush_pushed (seq);
+  sequence_drop_oldest (seq, n_steps);
+
+  g_object_notify (G_OBJECT (seq), "n-evicted");
+  sequence_stacks_changed (seq, seq->priv->n_undos, n_steps, 0, 0, 0);
+}
+
+/* evicts the oldest @n_steps undoable steps while steps are being pushed,
+ * leaving the report to sequence_flush_pushed(): the steps the viewers
+ * haven't heard of yet just don't get reported at all */
+static void
+sequence_evict_quietly (GundoSequence* seq,
+                        guint          n_steps)
+{
+  guint n_known = MIN (n_steps, seq->priv->n_undos - seq->priv->n_pushed);
+
+  sequence_drop_oldest (seq, n_steps);
+
+  seq->priv->n_evicted_pending += n_known;
+  seq->priv->n_pushed          -= n_steps - n_known;
+}
+
+/* counts the oldest undoable steps that have to go for @seq to fit into
+ * its budget again; the latest undoable step is kept so an add never
+ * evicts itself */
+static guint
+sequence_get_budget_excess (GundoSequence* seq)
+{
+  guint n_evict = 0;
+  guint n_steps = 0;
+  gsize size = usage_get_total (&seq->priv->usage);
+  gsize evicted_size = 0;
+
+  if (!seq->priv->max_size)
+    return 0;
+
+  /* the compressed payloads are held by the cold tier, not the records */
+  if (G_UNLIKELY (seq->priv->cold))
+    size += gundo_cold_get_size (seq->priv->cold);
+  if (size <= seq->priv->max_size)
+    return 0;
+
+  while (n_steps + 1 < seq->priv->n_undos &&
+         size - evicted_size > seq->priv->max_size)
+    {
+      guint            n_records = step_get_n_records (gundo_action_store_index (seq->priv->actions, n_evict));
+      GundoMemoryUsage usage;
+
+      actions_get_usage (seq->priv->actions, n_evict, n_records, &usage);
+      evicted_size += usage_get_total (&usage);
+      if (G_UNLIKELY (seq->priv->cold))
+        evicted_size += gundo_cold_get_range_size (seq->priv->cold, seq->priv->actions, n_evict, n_records);
+      n_evict += n_records;
+      n_steps++;
+    }
+
+  return n_steps;
+}
+
+/* evict the oldest undoable steps until @seq fits into its budget again */
+static void
+sequence_enforce_budget (GundoSequence* seq)
+{
+  sequence_evict (seq, sequence_get_budget_excess (seq));
+}
+
+/* discards the redo tail */
+static void
+sequence_truncate (GundoSequence* seq)
+{
+  if (seq->next_redo < seq->priv->n_committed)
+    {
+      guint   n_redo = seq->priv->n_committed - seq->next_redo;
+      guint64 start = GUNDO_TRACE_BEGIN ();
+
+      /* this also moves the records of an open group right behind the
+       * undoable ones */
+      if (seq->priv->branching)
+        {
+          sequence_cut_branch (seq, seq->next_redo, seq->priv->n_undos);
+        }
+      else
+        {
+          if (G_UNLIKELY (seq->priv->spill_end > seq->next_redo))
+            {
+              gundo_spill_truncate (seq->priv->spill, seq->priv->actions, seq->next_redo, n_redo);
+              seq->priv->spill_end = seq->next_redo;
+            }
+          sequence_unaccount (seq, seq->next_redo, n_redo);
+          sequence_discard (seq, seq->next_redo, n_redo);
+          gundo_action_store_remove_range (seq->priv->actions, seq->next_redo, n_redo);
+        }
+
+      seq->priv->n_committed = seq->next_redo;
+      seq->priv->n_truncated += seq->priv->n_steps - seq->priv->n_undos;
+      seq->priv->n_steps     = seq->priv->n_undos;
+      if (seq->priv->open_group)
+        seq->priv->open_group -= n_redo;
+
+      memset (&seq->priv->redo_usage, 0, sizeof (seq->priv->redo_usage));
+      seq->priv->cold_redo_records = 0;
+      seq->priv->cold_redo_steps   = 0;
+
+      if (G_UNLIKELY (seq->priv->checkpoints))
+        gundo_checkpoints_drop_from (seq->priv->checkpoints, seq->priv->n_evicted + seq->priv->n_undos + 1);
+
+      if (seq->priv->branching)
+        {
+          seq->priv->branch = ++seq->priv->last_branch;
+          sequence_enforce_branch_limits (seq);
+        }
+
+      GUNDO_TRACE_END ("truncate", seq, 0, n_redo, start);
+    }
+}
+
+/* updates the cached can-undo and can-redo states after the position
+ * changed, notifying about the ones that flipped */
+static void
+sequence_update_state (GundoSequence* seq)
+{
+  gboolean can_undo = seq->priv->n_undos > 0;
+  gboolean can_redo = seq->next_redo < seq->priv->n_committed;
+  gboolean frozen;
+  guint64  start;
+
+  if (seq->priv->can_undo == can_undo && seq->priv->can_redo == can_redo)
+    return;
+
+  /* gundo_history_thaw_notify() compares the states itself */
+  frozen = gundo_history_is_notify_frozen (GUNDO_HISTORY (seq));
+
+  if (seq->priv->can_undo != can_undo)
+    {
+      start = GUNDO_TRACE_BEGIN ();
+      seq->priv->can_undo = can_undo;
+      if (!frozen)
+        g_object_notify (G_OBJECT (seq), "can-undo");
+      GUNDO_TRACE_END ("notify::can-undo", seq, 0, 0, start);
+    }
+  if (seq->priv->can_redo != can_redo)
+    {
+      start = GUNDO_TRACE_BEGIN ();
+      seq->priv->can_redo = can_redo;
+      if (!frozen)
+        g_object_notify (G_OBJECT (seq), "can-redo");
+      GUNDO_TRACE_END ("notify::can-redo", seq, 0, 0, start);
+    }
+}
+
+/* turn all records behind the committed ones into a new undoable step,
+ * without trimming the history or emitting anything yet */
+static void
+sequence_push_step (GundoSequence* seq)
+{
+  guint first;
+
+  sequence_truncate (seq);
+
+  first = seq->priv->n_committed;
+  seq->priv->n_committed = seq->priv->actions->len;
+  seq->next_redo   = seq->priv->n_committed;
+  seq->priv->redo_usage_index = seq->next_redo;
+  seq->priv->n_steps++;
+  seq->priv->n_undos++;
+  seq->priv->n_pushed++;
+
+  if (G_UNLIKELY (seq->priv->checkpoints))
+    gundo_checkpoints_add_cost (seq->priv->checkpoints, seq->priv->n_evicted + seq->priv->n_undos,
+                                actions_estimate (seq, first, seq->priv->n_committed - first), FALSE);
+}
+
+/* moves the actions of the undoable steps below the spill depth to the
+ * spill file, oldest first; the ones that can't be serialized stay */
+static void
+sequence_spill (GundoSequence* seq)
+{
+  guint   first = seq->priv->spill_mark;
+  guint64 start;
+
+  if (seq->priv->n_undos <= seq->priv->spill_depth ||
+      seq->priv->spill_steps >= seq->priv->n_undos - seq->priv->spill_depth)
+    return;
+
+  /* the file has to stay ordered like the records, so nothing gets spilled
+   * while records a checkpoint jumped over are still spilled above */
+  while (seq->priv->spill_end > seq->priv->spill_mark &&
+         gundo_action_store_index (seq->priv->actions, seq->priv->spill_end - 1)->type != &gundo_spill_type)
+    seq->priv->spill_end--;
+  if (seq->priv->spill_end > seq->priv->spill_mark)
+    return;
+
+  start = GUNDO_TRACE_BEGIN ();
+
+  sequence_sync_redo_usage (seq);
+
+  while (seq->priv->spill_steps < seq->priv->n_undos - seq->priv->spill_depth)
+    {
+      guint n_records = step_get_n_records (gundo_action_store_index (seq->priv->actions, seq->priv->spill_mark));
+      guint i;
+
+      for (i = seq->priv->spill_mark; i < seq->priv->spill_mark + n_records; i++)
+        {
+          UndoAction     * action = gundo_action_store_index (seq->priv->actions, i);
+          UndoAction       moved = *action;
+          GundoMemoryUsage before;
+          GundoMemoryUsage after;
+
+          if (IS_GROUP_MARKER (action) || action->type == &gundo_group_arena_type ||
+              action->type == &gundo_history_file_lazy_type)
+            continue;
+
+          memset (&before, 0, sizeof (before));
+          action_add_usage (action, &before);
+          if (!gundo_spill_add (seq->priv->spill, action))
+            continue;
+          sequence_discard_moved (seq, i, &moved);
+          memset (&after, 0, sizeof (after));
+          action_add_usage (action, &after);
+
+          usage_subtract (&seq->priv->usage, &before);
+          usage_add (&seq->priv->usage, &after);
+        }
+
+      seq->priv->spill_mark += n_records;
+      seq->priv->spill_steps++;
+    }
+  seq->priv->spill_end = seq->priv->spill_mark;
+
+  gundo_spill_compact (seq->priv->spill, seq->priv->actions, seq->priv->spill_mark);
+
+  GUNDO_TRACE_END ("spill", seq, 0, seq->priv->spill_mark - first, start);
+}
+
+/* moves the payloads of the records [@index, @index + @n_records) to the
+ * cold tier, where possible */
+static void
+sequence_compress_records (GundoSequence* seq,
+                           guint          index,
+                           guint          n_records)
+{
+  guint i;
+
+  for (i = index; i < index + n_records; i++)
+    {
+      UndoAction     * action = gundo_action_store_index (seq->priv->actions, i);
+      UndoAction       moved = *action;
+      GundoMemoryUsage before;
+      GundoMemoryUsage after;
+
+      if (IS_GROUP_MARKER (action) || action->type == &gundo_group_arena_type ||
+          action->type == &gundo_history_file_lazy_type ||
+          action->type == &gundo_spill_type || action->type == &gundo_cold_type)
+        continue;
+
+      memset (&before, 0, sizeof (before));
+      action_add_usage (action, &before);
+      if (!gundo_cold_add (seq->priv->cold, action))
+        continue;
+      sequence_discard_moved (seq, i, &moved);
+      memset (&after, 0, sizeof (after));
+      action_add_usage (action, &after);
+
+      usage_subtract (&seq->priv->usage, &before);
+      usage_add (&seq->priv->usage, &after);
+      if (i >= seq->next_redo)
+        {
+          usage_subtract (&seq->priv->redo_usage, &before);
+          usage_add (&seq->priv->redo_usage, &after);
+        }
+    }
+}
+
+/* compresses the payloads of the steps further than the compress distance
+ * away from the current state: the undoable ones from the oldest up, the
+ * redoable ones from the newest down */
+static void
+sequence_compress (GundoSequence* seq)
+{
+  guint   distance = seq->priv->compress_distance;
+  guint   n_redos = seq->priv->n_steps - seq->priv->n_undos;
+  guint   n_records = 0;
+  guint64 start;
+
+  if ((seq->priv->n_undos <= distance || seq->priv->cold_steps >= seq->priv->n_undos - distance) &&
+      (n_redos <= distance || seq->priv->cold_redo_steps >= n_redos - distance))
+    return;
+
+  start = GUNDO_TRACE_BEGIN ();
+
+  sequence_sync_redo_usage (seq);
+
+  while (seq->priv->n_undos > distance && seq->priv->cold_steps < seq->priv->n_undos - distance)
+    {
+      guint n_step = step_get_n_records (gundo_action_store_index (seq->priv->actions, seq->priv->cold_mark));
+
+      sequence_compress_records (seq, seq->priv->cold_mark, n_step);
+      seq->priv->cold_mark += n_step;
+      seq->priv->cold_steps++;
+      n_records += n_step;
+    }
+
+  while (n_redos > distance && seq->priv->cold_redo_steps < n_redos - distance)
+    {
+      guint end = seq->priv->n_committed - seq->priv->cold_redo_records;
+      guint n_step = step_get_n_records_before (gundo_action_store_index (seq->priv->actions, end - 1));
+
+      sequence_compress_records (seq, end - n_step, n_step);
+      seq->priv->cold_redo_records += n_step;
+      seq->priv->cold_redo_steps++;
+      n_records += n_step;
+    }
+
+  GUNDO_TRACE_END ("compress", seq, 0, n_records, start);
+}
+
+/* takes a checkpoint of the current state once the steps since the last
+ * one got too many or too expensive */
+static void
+sequence_checkpoint (GundoSequence* seq)
+{
+  guint64 start;
+
+  if (!gundo_checkpoints_is_due (seq->priv->checkpoints, seq->priv->checkpoint_interval, seq->priv->checkpoint_cost))
+    return;
+
+  start = GUNDO_TRACE_BEGIN ();
+  gundo_checkpoints_take (seq->priv->checkpoints, seq->priv->n_evicted + seq->priv->n_undos, seq->priv->max_checkpoints);
+  GUNDO_TRACE_END ("checkpoint", seq, 0, 0, start);
+}
+
+/* trim the history to its limits after steps were pushed and tell the
+ * viewers about them */
+static void
+sequence_publish (GundoSequence* seq)
+{
+  sequence_flush_pushed (seq);
+
+  if (seq->priv->max_depth && seq->priv->n_undos > seq->priv->max_depth)
+    sequence_evict (seq, seq->priv->n_undos - seq->priv->max_depth);
+  /* spilled actions cost less, so this comes before the budget */
+  if (G_UNLIKELY (seq->priv->spill))
+    sequence_spill (seq);
+  if (G_UNLIKELY (seq->priv->compress_distance))
+    sequence_compress (seq);
+  sequence_enforce_budget (seq);
+  if (G_UNLIKELY (seq->priv->checkpoints))
+    sequence_checkpoint (seq);
+
+  sequence_update_state (seq);
+}
+
+/* turn all records behind the committed ones into a new undoable step;
+ * GundoHistory::changed comes first, and its class handler makes room */
+static void
+sequence_commit (GundoSequence* seq)
+{
+  if (!seq->priv->changed_emitted)
+    gundo_history_changed (GUNDO_HISTORY (seq));
+  seq->priv->changed_emitted = FALSE;
+  sequence_push_step (seq);
+  sequence_publish (seq);
+}
+
+static guint
+types_find (GundoActionType const* const* types,
+            guint                         n_types,
+            GundoActionType const       * type)
+{
+  guint i;
+
+  for (i = 0; i < n_types && types[i] != type; i++)
+    ;
+
+  return i;
+}
+
+/* appends an operation without payload to the journal */
+static void
+sequence_journal (GundoSequence* seq,
+                  GundoJournalOp op,
+                  guint32        arg)
+{
+  gundo_journal_begin_record (seq->priv->journal, op, arg);
+  gundo_journal_end_record (seq->priv->journal);
+}
+
+/* journals the addition of an action; @inline_len is the size of the
+ * payload for inline actions, -1 for the others */
+static void
+sequence_journal_action (GundoSequence        * seq,
+                         GundoActionType const* type,
+                         gconstpointer          data,
+                         gssize                 inline_len)
+{
+  guint       index = types_find (seq->priv->journal_types, seq->priv->n_journal_types, type);
+  GByteArray* buffer;
+
+  if (index == seq->priv->n_journal_types || (inline_len < 0 && !type->serialize))
+    {
+      /* the journal can't be replayed past this action, so stop it */
+      gundo_journal_fail (seq->priv->journal,
+                          g_error_new (GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED,
+                                       "an action type can't be journaled"));
+      return;
+    }
+
+  if (inline_len >= 0)
+    {
+      buffer = gundo_journal_begin_record (seq->priv->journal, GUNDO_JOURNAL_ADD_INLINE, index);
+      g_byte_array_append (buffer, data, inline_len);
+    }
+  else
+    {
+      buffer = gundo_journal_begin_record (seq->priv->journal, GUNDO_JOURNAL_ADD, index);
+      type->serialize ((gpointer) data, buffer);
+    }
+
+  gundo_journal_end_record (seq->priv->journal);
+}
+
+
+/* tries to fold @data into the latest record of @seq, which has to be
+ * the latest undoable action or the latest action of the open group. An
+ * @inline_payload (the caller's bytes of an inline action) only merges
+ * into an inline copy of the same type and is never freed, a heap payload
+ * only merges into another heap payload and is freed once merged. */
+static gboolean
+sequence_merge (GundoSequence        * seq,
+                GundoActionType const* type,
+                gpointer               data,
+                gboolean               inline_payload)
+{
+  UndoAction           * last;
+  GundoActionType const* last_type;
+  gpointer               last_data;
+  gboolean               merged;
+  guint                  len = seq->priv->actions->len;
+
+  if (!type->merge)
+    return FALSE;
+
+  /* outside of groups, the latest record has to be undoable */
+  if (!len || (!seq->priv->open_group && seq->next_redo != len))
+    return FALSE;
+
+  last = gundo_action_store_index (seq->priv->actions, len - 1);
+  last_type = last->type;
+  last_data = last->data;
+  if (inline_payload)
+    {
+      if (last_type != &gundo_payload_arena_type)
+        return FALSE;
+
+      last_type = gundo_payload_arena_get_type (last->data);
+      last_data = gundo_payload_arena_get_payload (last->data);
+    }
+
+  /* group markers never match, so merging doesn't cross group boundaries */
+  if (last_type != type)
+    return FALSE;
+
+  /* the payload may grow or shrink while merging */
+  sequence_unaccount (seq, len - 1, 1);
+  merged = type->merge (last_data, data);
+  action_add_usage (last, &seq->priv->usage);
+  if (!merged)
+    return FALSE;
+
+  if (!inline_payload && type->free)
+    type->free (data);
+
+  /* inside of groups, sequence_publish() takes care of the rest once the
+   * group is committed, nothing is evicted while it's being built */
+  if (seq->priv->open_group)
+    return TRUE;
+
+  /* this changed the state at the latest checkpoint */
+  if (G_UNLIKELY (seq->priv->checkpoints))
+    gundo_checkpoints_drop_from (seq->priv->checkpoints, seq->priv->n_evicted + seq->priv->n_undos);
+
+  sequence_enforce_budget (seq);
+
+  return TRUE;
+}
+
+/* merges an action (unless !@may_merge) or appends its record; returns
+ * TRUE if it was appended */
+static gboolean
+sequence_append (GundoSequence        * seq,
+                 GundoActionType const* type,
+                 gpointer               data,
+                 gboolean               may_merge)
+{
+	UndoAction action;
+
+	if( may_merge && sequence_merge( seq, type, data, FALSE ) ) {
+		return FALSE;
+	}
+
+	action.type = type;
+	action.data = data;
+
+	gundo_action_store_append( seq->priv->actions, &action );
+	action_add_usage (&action, &seq->priv->usage);
+
+	return TRUE;
+}
+
+/* adds an action, recording it right away unless a group is open */
+static void
+sequence_add (GundoSequence        * seq,
+              GundoActionType const* type,
+              gpointer               data)
+{
+	if( sequence_append( seq, type, data, TRUE ) && !seq->priv->open_group ) {
+		sequence_commit (seq);
+	}
+}
+
+/**
+ * gundo_sequence_add_action:
+ * @seq: The undo sequence to which to add an action.
+ * @type: The type of the action.
+ * @data: Data about the action.  The data is destroyed by calling the
+ * "free" callback of the action type.
+ *
+ * Adds an action to the end of the GundoSequence.  Any actions that
+ * have been undone but not redone are destroyed.  If any groups have
+ * been started, the action is appended to the end of the most recently
+ * started group.
+ *
+ * If the sequence has a #GundoSequence:max-size and the new action makes
+ * it exceed that budget, the oldest undoable actions get freed.
+ *
+ * If @type has a merge callback, the action may get folded into the
+ * latest undoable action instead (see #GundoActionMergeFunc). The history
+ * doesn't change in that case, so no signals are emitted.
+ */
+void
+gundo_sequence_add_action(GundoSequence        * seq,
+                          GundoActionType const* type,
+                          gpointer               data)
+{
+	GundoActionType const* stats_type;
+	guint64                start;
+	guint64                trace_start;
+
+        g_return_if_fail (seq);
+
+	trace_start = GUNDO_TRACE_BEGIN();
+
+	if( G_UNLIKELY( seq->priv->journal ) ) {
+		sequence_journal_action( seq, type, data, -1 );
+	}
+
+	if( G_LIKELY( !seq->priv->instrumented ) ) {
+		sequence_add( seq, type, data );
+	} else {
+		stats_type = type == &gundo_payload_arena_type ? gundo_payload_arena_get_type( data ) : type;
+		start = gundo_stats_now();
+		sequence_add( seq, type, data );
+		gundo_stats_record( seq->priv->stats, stats_type, GUNDO_ACTION_OP_ADD, gundo_stats_now() - start );
+	}
+
+	GUNDO_TRACE_END( "add_action", seq, seq->priv->group_depth, 0, trace_start );
+}
+
+/**
+ * gundo_sequence_add_action_inline:
+ * @seq: The undo sequence to which to add an action.
+ * @type: The type of the action.
+ * @bytes: The payload of the action.
+ * @len: The size of @bytes.
+ *
+ * Adds an action like gundo_sequence_add_action(), but @seq keeps a copy of
+ * @bytes instead of taking over a pointer. Small payloads are packed into
+ * larger blocks of memory owned by @seq, which saves an allocation per
+ * action and keeps the payloads of subsequent actions close together.
+ *
+ * The callbacks of @type get a pointer to the copy. As the copy belongs to
+ * @seq, the free callback of @type (which can well be %NULL) must only
+ * release resources the payload refers to, never the payload itself. The
+ * size of the copy is accounted by @seq, so the size callback of @type isn't
+ * used for inline actions.
+ *
+ * An inline action only gets merged into a latest action that was added
+ * inline with the same @type. @bytes stay with the caller either way, so
+ * the free callback is not called for them after a merge.
+ */
+void
+gundo_sequence_add_action_inline (GundoSequence        * seq,
+                                  GundoActionType const* type,
+                                  gconstpointer          bytes,
+                                  gsize                  len)
+{
+  gboolean instrumented;
+  guint64  start = 0;
+  guint64  trace_start;
+
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+  g_return_if_fail (bytes || !len);
+
+  trace_start = GUNDO_TRACE_BEGIN ();
+
+  if (G_UNLIKELY (seq->priv->journal))
+    sequence_journal_action (seq, type, bytes, len);
+
+  instrumented = seq->priv->instrumented;
+  if (G_UNLIKELY (instrumented))
+    start = gundo_stats_now ();
+
+  if (!sequence_merge (seq, type, (gpointer) bytes, TRUE))
+    {
+      if (!seq->priv->payloads)
+        seq->priv->payloads = gundo_payload_arena_new ();
+
+      sequence_add (seq, &gundo_payload_arena_type,
+                    gundo_payload_arena_add (seq->priv->payloads, type, bytes, len));
+    }
+
+  if (G_UNLIKELY (instrumented))
+    gundo_stats_record (seq->priv->stats, type, GUNDO_ACTION_OP_ADD, gundo_stats_now () - start);
+
+  GUNDO_TRACE_END ("add_action_inline", seq, seq->priv->group_depth, 0, trace_start);
+}
+
+/**
+ * gundo_sequence_add_actions:
+ * @seq: The undo sequence to which to add the actions.
+ * @entries: the actions to add.
+ * @n_entries: the number of @entries.
+ * @as_group: whether to add the actions as a group.
+ *
+ * Adds @n_entries actions in one go. The result is the same as calling
+ * gundo_sequence_add_action() for each of them (or wrapping those calls
+ * into gundo_sequence_start_group() and gundo_sequence_end_group() if
+ * @as_group is %TRUE), but the storage is reserved once, the redo tail is
+ * truncated once, and #GundoHistory::changed and the notifications are
+ * emitted at most once for the whole batch.
+ *
+ * Unless @as_group is %TRUE, #GundoSequence:max-depth is enforced while
+ * the actions are added, so a long batch doesn't keep more steps than
+ * that around; #GundoSequence:max-size is only enforced once all actions
+ * are added. Either way, #GundoSequence:n-evicted and
+ * #GundoHistory::stacks-changed are only emitted at the end.
+ */
+void
+gundo_sequence_add_actions (GundoSequence         * seq,
+                            GundoActionEntry const* entries,
+                            guint                   n_entries,
+                            gboolean                as_group)
+{
+  gboolean may_merge = TRUE;
+  guint64  trace_start;
+  guint    i;
+
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+  g_return_if_fail (entries || !n_entries);
+
+  if (!n_entries)
+    return;
+
+  trace_start = GUNDO_TRACE_BEGIN ();
+
+  /* drop the redo tail first, so the reservation doesn't hold on to its
+   * blocks; the first action still starts a step of its own, as it would
+   * have with the tail in place */
+  if (!seq->priv->open_group && seq->next_redo < seq->priv->n_committed)
+    {
+      gundo_history_changed (GUNDO_HISTORY (seq));
+      sequence_truncate (seq);
+      seq->priv->changed_emitted = TRUE;
+      may_merge = as_group;
+    }
+
+  gundo_action_store_reserve (seq->priv->actions, n_entries + (as_group ? 2 : 0));
+
+  if (as_group)
+    gundo_sequence_start_group (seq);
+
+  for (i = 0; i < n_entries; i++)
+    {
+      GundoActionType const* type = entries[i].type;
+      gpointer               data = entries[i].data;
+      guint64                start = 0;
+
+      if (G_UNLIKELY (seq->priv->journal))
+        sequence_journal_action (seq, type, data, -1);
+
+      if (G_UNLIKELY (seq->priv->instrumented))
+        start = gundo_stats_now ();
+
+      if (sequence_append (seq, type, data, may_merge) && !seq->priv->open_group)
+        {
+          if (!seq->priv->changed_emitted)
+            gundo_history_changed (GUNDO_HISTORY (seq));
+          seq->priv->changed_emitted = TRUE;
+          sequence_push_step (seq);
+
+          /* a big batch would have all of its payloads around otherwise */
+          if (seq->priv->max_depth && seq->priv->n_undos > seq->priv->max_depth)
+            sequence_evict_quietly (seq, seq->priv->n_undos - seq->priv->max_depth);
+        }
+
+      may_merge = TRUE;
+
+      if (G_UNLIKELY (seq->priv->instrumented))
+        gundo_stats_record (seq->priv->stats,
+                            type == &gundo_payload_arena_type ? gundo_payload_arena_get_type (data) : type,
+                            GUNDO_ACTION_OP_ADD, gundo_stats_now () - start);
+    }
+
+  if (as_group)
+    gundo_sequence_end_group (seq);
+  else if (seq->priv->changed_emitted)
+    sequence_publish (seq);
+  seq->priv->changed_emitted = FALSE;
+
+  GUNDO_TRACE_END ("add_actions", seq, seq->priv->group_depth, n_entries, trace_start);
+}
+
+/**
+ * gundo_sequence_start_group:
+ * @seq: a #GundoSequence
+ * 
+ * Starts a new group of actions that are treated as a single action.
+ * E.g. a single call to undo and redo undoes or redoes all actions of
+ * the group.  This is useful if a single action by the user causes
+ * the program to issue multiple internal actions.  Groups can be
+ * nested.
+ *
+ * Building a group is quiet: the actions are only appended, and no signals
+ * are emitted until the outermost group is ended with
+ * gundo_sequence_end_group(), which emits #GundoHistory::changed once.
+ */
+void gundo_sequence_start_group( GundoSequence *seq ) {
+    UndoAction begin;
+    guint64 start = GUNDO_TRACE_BEGIN();
+
+    if( G_UNLIKELY( seq->priv->journal ) ) {
+        sequence_journal( seq, GUNDO_JOURNAL_GROUP_BEGIN, 0 );
+    }
+
+    begin.type = &gundo_group_begin;
+    begin.data = GUINT_TO_POINTER( seq->priv->open_group ? seq->priv->actions->len + 1 - seq->priv->open_group : 0 );
+
+    gundo_action_store_append( seq->priv->actions, &begin );
+    seq->priv->usage.groups += sizeof(UndoAction);
+    seq->priv->open_group = seq->priv->actions->len;
+    seq->priv->group_depth++;
+    seq->group = seq;
+
+    GUNDO_TRACE_END( "start_group", seq, seq->priv->group_depth, 0, start );
+}
+
+/* hands the arena of the outermost open group over to a record at the end
+ * of the group (if @keep), or frees it */
+static void
+sequence_close_arena (GundoSequence* seq,
+                      gboolean       keep)
+{
+  if (keep)
+    {
+      UndoAction record;
+
+      record.type = &gundo_group_arena_type;
+      record.data = seq->priv->group_arena;
+
+      gundo_action_store_append (seq->priv->actions, &record);
+      action_add_usage (&record, &seq->priv->usage);
+    }
+  else
+    {
+      gundo_group_arena_free (seq->priv->group_arena);
+    }
+
+  seq->priv->group_arena = NULL;
+}
+
+/* pops the innermost open group, returns the position of its begin marker */
+static guint
+sequence_pop_group (GundoSequence* seq)
+{
+  guint begin = seq->priv->open_group - 1;
+  guint link  = GPOINTER_TO_UINT (gundo_action_store_index (seq->priv->actions, begin)->data);
+
+  seq->priv->open_group = link ? begin + 1 - link : 0;
+  seq->priv->group_depth--;
+  if (!seq->priv->open_group)
+    seq->group = NULL;
+
+  return begin;
+}
+
+/**
+ * gundo_sequence_end_group:
+ * @seq: a #GundoSequence
+ * 
+ * Ends a group, adding it to the end of the undo sequence, or its parent
+ * group.
+ */
+void gundo_sequence_end_group( GundoSequence *seq ) {
+    guint begin;
+    guint n_records;
+    UndoAction end;
+    guint64 start;
+    guint depth = seq->priv->group_depth;
+
+    g_return_if_fail( seq->priv->open_group != 0 );
+
+    start = GUNDO_TRACE_BEGIN();
+
+    if( G_UNLIKELY( seq->priv->journal ) ) {
+        sequence_journal( seq, GUNDO_JOURNAL_GROUP_END, 0 );
+    }
+
+    begin = sequence_pop_group( seq );
+
+    if( !seq->priv->open_group && seq->priv->group_arena ) {
+        sequence_close_arena( seq, seq->priv->actions->len > begin + 1 );
+    }
+
+    n_records = seq->priv->actions->len - begin - 1;
+
+    if( n_records == 0 ) {
+        /* empty groups are dropped right away */
+        gundo_action_store_truncate( seq->priv->actions, begin );
+        seq->priv->usage.groups -= sizeof(UndoAction);
+        GUNDO_TRACE_END( "end_group", seq, depth, 0, start );
+        return;
+    }
+
+    gundo_action_store_index( seq->priv->actions, begin )->data = GUINT_TO_POINTER( n_records );
+
+    end.type = &gundo_group_end;
+    end.data = GUINT_TO_POINTER( n_records );
+    gundo_action_store_append( seq->priv->actions, &end );
+    seq->priv->usage.groups += sizeof(UndoAction);
+
+    if( !seq->priv->open_group ) {
+        sequence_commit( seq );
+    }
+
+    GUNDO_TRACE_END( "end_group", seq, depth, n_records, start );
+}
+
+/**
+ * gundo_sequence_abort_group:
+ * @seq: a #GundoSequence
+ *
+ * Aborts the construction of a group, freeing all of its actions.
+ */
+void gundo_sequence_abort_group( GundoSequence *seq ) {
+    guint begin;
+    guint n_records;
+    guint64 start;
+    guint depth = seq->priv->group_depth;
+
+    g_return_if_fail( seq->priv->open_group != 0 );
+
+    start = GUNDO_TRACE_BEGIN();
+
+    if( G_UNLIKELY( seq->priv->journal ) ) {
+        sequence_journal( seq, GUNDO_JOURNAL_GROUP_ABORT, 0 );
+    }
+
+    begin = sequence_pop_group( seq );
+    n_records = seq->priv->actions->len - begin;
+
+    sequence_unaccount( seq, begin, n_records );
+    sequence_discard( seq, begin, n_records );
+    gundo_action_store_truncate( seq->priv->actions, begin );
+
+    if( !seq->priv->open_group && seq->priv->group_arena ) {
+        sequence_close_arena( seq, FALSE );
+    }
+
+    GUNDO_TRACE_END( "abort_group", seq, depth, n_records, start );
+}
+
+/**
+ * gundo_sequence_group_alloc:
+ * @seq: a #GundoSequence
+ * @size: the number of bytes to allocate
+ *
+ * Allocates memory for the payload of an action of the group that is being
+ * constructed. The memory is bump-allocated from an arena shared by all
+ * open groups and gets released in one go together with the outermost of
+ * them, when it is aborted or when its actions get freed (because they were
+ * truncated or evicted, or with @seq).
+ *
+ * This saves a malloc/free pair for each of the actions of a big group.
+ * Actions with such a payload usually have a type without a free callback.
+ * If the type has one, it must not access the payload, as the arena may
+ * already be gone by the time it is called.
+ *
+ * Returns: @size bytes of memory, suitably aligned for any type.
+ */
+gpointer
+gundo_sequence_group_alloc (GundoSequence* seq,
+                            gsize          size)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), NULL);
+  g_return_val_if_fail (seq->priv->open_group != 0, NULL);
+
+  if (!seq->priv->group_arena)
+    seq->priv->group_arena = gundo_group_arena_new ();
+
+  return gundo_group_arena_alloc (seq->priv->group_arena, size);
+}
+
+/**
+ * gundo_sequence_get_size:
+ * @seq: a #GundoSequence
+ *
+ * Get the number of bytes held by the actions of @seq: the action records
+ * plus whatever the #GundoActionType size callbacks report for their
+ * payloads. See gundo_history_get_memory_usage() for a breakdown.
+ *
+ * Returns: the accounted size of @seq in bytes.
+ */
+gsize
+gundo_sequence_get_size (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return usage_get_total (&seq->priv->usage);
+}
+
+/**
+ * gundo_sequence_get_max_size:
+ * @seq: a #GundoSequence
+ *
+ * Get the memory budget of @seq. See #GundoSequence:max-size.
+ *
+ * Returns: the budget in bytes, 0 if @seq is unlimited.
+ */
+gsize
+gundo_sequence_get_max_size (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->max_size;
+}
+
+/**
+ * gundo_sequence_set_max_size:
+ * @seq: a #GundoSequence
+ * @max_size: the new budget in bytes, 0 to disable it
+ *
+ * Set the memory budget of @seq. If @seq already exceeds the new budget,
+ * the oldest undoable actions get evicted right away.
+ */
+void
+gundo_sequence_set_max_size (GundoSequence* seq,
+                             gsize          max_size)
+{
+  guint n_steps;
+
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  if (seq->priv->max_size == max_size)
+    return;
+
+  seq->priv->max_size = max_size;
+  g_object_notify (G_OBJECT (seq), "max-size");
+
+  /* the steps evicted from the bottom change the history just like the
+   * ones trimmed after an add */
+  n_steps = sequence_get_budget_excess (seq);
+  if (n_steps)
+    {
+      gundo_history_changed (GUNDO_HISTORY (seq));
+      sequence_evict (seq, n_steps);
+      sequence_update_state (seq);
+    }
+}
+
+/**
+ * gundo_sequence_get_max_depth:
+ * @seq: a #GundoSequence
+ *
+ * Get the maximum number of undoable steps kept by @seq, see
+ * #GundoSequence:max-depth.
+ *
+ * Returns: the maximum depth, or 0 if it is unlimited.
+ */
+guint
+gundo_sequence_get_max_depth (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->max_depth;
+}
+
+/**
+ * gundo_sequence_set_max_depth:
+ * @seq: a #GundoSequence
+ * @max_depth: the new maximum number of undoable steps, 0 for unlimited
+ *
+ * Set the maximum number of undoable steps kept by @seq. If @seq already
+ * holds more, the oldest ones get evicted right away.
+ */
+void
+gundo_sequence_set_max_depth (GundoSequence* seq,
+                              guint          max_depth)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  if (seq->priv->max_depth == max_depth)
+    return;
+
+  seq->priv->max_depth = max_depth;
+  g_object_notify (G_OBJECT (seq), "max-depth");
+
+  if (max_depth && seq->priv->n_undos > max_depth)
+    {
+      gundo_history_changed (GUNDO_HISTORY (seq));
+      sequence_evict (seq, seq->priv->n_undos - max_depth);
+      sequence_update_state (seq);
+    }
+}
+
+/**
+ * gundo_sequence_get_n_evicted:
+ * @seq: a #GundoSequence
+ *
+ * Get the number of undoable steps that were evicted from @seq to keep it
+ * within its budget. A group counts as a single step, however many actions
+ * it holds.
+ *
+ * Returns: the number of evicted steps.
+ */
+guint
+gundo_sequence_get_n_evicted (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->n_evicted;
+}
+
+/**
+ * gundo_sequence_reserve:
+ * @seq: a #GundoSequence
+ * @n_actions: the number of actions that are about to be added
+ *
+ * Allocate the storage for @n_actions more actions up front, so adding them
+ * won't need to allocate. Use this before recording a large number of
+ * actions at once (e.g. from a script).
+ */
+void
+gundo_sequence_reserve (GundoSequence* seq,
+                        guint          n_actions)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  gundo_action_store_reserve (seq->priv->actions, n_actions);
+}
+
+/**
+ * gundo_sequence_get_deferred_free:
+ * @seq: a #GundoSequence
+ *
+ * Get whether @seq frees discarded actions later. See
+ * #GundoSequence:deferred-free.
+ *
+ * Returns: %TRUE if discarded actions are freed later.
+ */
+gboolean
+gundo_sequence_get_deferred_free (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+
+  return seq->priv->deferred_free;
+}
+
+/**
+ * gundo_sequence_set_deferred_free:
+ * @seq: a #GundoSequence
+ * @deferred_free: whether to free discarded actions later
+ *
+ * Set whether @seq frees discarded actions later. See
+ * #GundoSequence:deferred-free.
+ */
+void
+gundo_sequence_set_deferred_free (GundoSequence* seq,
+                                  gboolean       deferred_free)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  deferred_free = deferred_free != FALSE;
+  if (seq->priv->deferred_free == deferred_free)
+    return;
+
+  seq->priv->deferred_free = deferred_free;
+  g_object_notify (G_OBJECT (seq), "deferred-free");
+}
+
+/**
+ * gundo_sequence_flush_discarded:
+ * @seq: a #GundoSequence, or %NULL
+ *
+ * Free the actions discarded by @seq that are still waiting to be freed
+ * (see #GundoSequence:deferred-free). Pass %NULL to free the pending
+ * actions of all sequences, including finalized ones. Either way, this
+ * waits for the worker thread to finish freeing the thread-safe actions
+ * of @seq (or of all sequences for %NULL).
+ */
+void
+gundo_sequence_flush_discarded (GundoSequence* seq)
+{
+  g_return_if_fail (!seq || GUNDO_IS_SEQUENCE (seq));
+
+  gundo_reclaim_flush (seq);
+}
+
+/**
+ * gundo_sequence_get_instrumented:
+ * @seq: a #GundoSequence
+ *
+ * Get whether @seq measures the operations on its actions. See
+ * #GundoSequence:instrumented.
+ *
+ * Returns: %TRUE if @seq is instrumented.
+ */
+gboolean
+gundo_sequence_get_instrumented (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+
+  return seq->priv->instrumented;
+}
+
+/**
+ * gundo_sequence_set_instrumented:
+ * @seq: a #GundoSequence
+ * @instrumented: whether to measure the operations on the actions
+ *
+ * Set whether @seq measures the operations on its actions. Turning the
+ * instrumentation off keeps the measurements collected so far, see
+ * gundo_sequence_reset_action_stats().
+ */
+void
+gundo_sequence_set_instrumented (GundoSequence* seq,
+                                 gboolean       instrumented)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  instrumented = instrumented != FALSE;
+  if (seq->priv->instrumented == instrumented)
+    return;
+
+  if (instrumented && !seq->priv->stats)
+    seq->priv->stats = gundo_stats_new ();
+
+  seq->priv->instrumented = instrumented;
+  g_object_notify (G_OBJECT (seq), "instrumented");
+}
+
+/**
+ * gundo_sequence_get_action_stats:
+ * @seq: a #GundoSequence
+ * @type: an action type
+ * @op: the operation
+ * @stats: return location for the measurements
+ *
+ * Get the measurements of @op on the actions of @type, collected while
+ * @seq was #GundoSequence:instrumented. The actions of a group are
+ * accounted to their own types, as are the ones added with
+ * gundo_sequence_add_action_inline(). Actions freed later because of
+ * #GundoSequence:deferred-free are not measured.
+ *
+ * Returns: %TRUE if @op was measured for @type and @stats was filled in.
+ */
+gboolean
+gundo_sequence_get_action_stats (GundoSequence        * seq,
+                                 GundoActionType const* type,
+                                 GundoActionOp          op,
+                                 GundoActionStats     * stats)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+  g_return_val_if_fail (type, FALSE);
+  g_return_val_if_fail (op < GUNDO_ACTION_N_OPS, FALSE);
+  g_return_val_if_fail (stats, FALSE);
+
+  return seq->priv->stats && gundo_stats_lookup (seq->priv->stats, type, op, stats);
+}
+
+/**
+ * gundo_sequence_foreach_action_stats:
+ * @seq: a #GundoSequence
+ * @func: the function to call
+ * @user_data: the data to pass to @func
+ *
+ * Call @func for each action type and operation that @seq measured, in no
+ * particular order. See gundo_sequence_get_action_stats().
+ */
+void
+gundo_sequence_foreach_action_stats (GundoSequence      * seq,
+                                     GundoActionStatsFunc func,
+                                     gpointer             user_data)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+  g_return_if_fail (func);
+
+  if (seq->priv->stats)
+    gundo_stats_foreach (seq->priv->stats, func, user_data);
+}
+
+/**
+ * gundo_sequence_reset_action_stats:
+ * @seq: a #GundoSequence
+ *
+ * Drop the measurements collected by @seq so far.
+ */
+void
+gundo_sequence_reset_action_stats (GundoSequence* seq)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  if (seq->priv->stats)
+    gundo_stats_reset (seq->priv->stats);
+}
+
+/**
+ * gundo_sequence_get_branching:
+ * @seq: a #GundoSequence
+ *
+ * Get whether @seq keeps branches. See #GundoSequence:branching.
+ *
+ * Returns: %TRUE if @seq keeps the redoable actions as a branch.
+ */
+gboolean
+gundo_sequence_get_branching (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+
+  return seq->priv->branching;
+}
+
+/**
+ * gundo_sequence_set_branching:
+ * @seq: a #GundoSequence
+ * @branching: whether to keep the redoable actions as a branch
+ *
+ * Set whether @seq keeps branches. See #GundoSequence:branching.
+ */
+void
+gundo_sequence_set_branching (GundoSequence* seq,
+                              gboolean       branching)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  branching = branching != FALSE;
+  if (seq->priv->branching == branching)
+    return;
+
+  if (!branching)
+    sequence_drop_branches (seq, 0, G_MAXUINT);
+
+  seq->priv->branching = branching;
+  g_object_notify (G_OBJECT (seq), "branching");
+}
+
+/**
+ * gundo_sequence_get_max_branches:
+ * @seq: a #GundoSequence
+ *
+ * Get the maximum number of branches @seq keeps besides the current one.
+ * See #GundoSequence:max-branches.
+ *
+ * Returns: the maximum number of branches, 0 if there is no limit.
+ */
+guint
+gundo_sequence_get_max_branches (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->max_branches;
+}
+
+/**
+ * gundo_sequence_set_max_branches:
+ * @seq: a #GundoSequence
+ * @max_branches: the maximum number of branches, 0 for no limit
+ *
+ * Set the maximum number of branches @seq keeps besides the current one.
+ * Branches beyond it are discarded right away. See
+ * #GundoSequence:max-branches.
+ */
+void
+gundo_sequence_set_max_branches (GundoSequence* seq,
+                                 guint          max_branches)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  if (seq->priv->max_branches == max_branches)
+    return;
+
+  seq->priv->max_branches = max_branches;
+  g_object_notify (G_OBJECT (seq), "max-branches");
+
+  sequence_enforce_branch_limits (seq);
+}
+
+/**
+ * gundo_sequence_get_max_branch_size:
+ * @seq: a #GundoSequence
+ *
+ * Get the memory budget for the branches of @seq other than the current
+ * one. See #GundoSequence:max-branch-size.
+ *
+ * Returns: the budget in bytes, 0 if there is none.
+ */
+gsize
+gundo_sequence_get_max_branch_size (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->max_branch_size;
+}
+
+/**
+ * gundo_sequence_set_max_branch_size:
+ * @seq: a #GundoSequence
+ * @max_size: the budget in bytes, 0 to disable it
+ *
+ * Set the memory budget for the branches of @seq other than the current
+ * one. Branches that don't fit are discarded right away. See
+ * #GundoSequence:max-branch-size.
+ */
+void
+gundo_sequence_set_max_branch_size (GundoSequence* seq,
+                                    gsize          max_size)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  if (seq->priv->max_branch_size == max_size)
+    return;
+
+  seq->priv->max_branch_size = max_size;
+  g_object_notify (G_OBJECT (seq), "max-branch-size");
+
+  sequence_enforce_branch_limits (seq);
+}
+
+/**
+ * gundo_sequence_get_branch:
+ * @seq: a #GundoSequence
+ *
+ * Get the id of the current branch of @seq, the one undo and redo move
+ * along. Ids stay the same while a branch isn't the current one.
+ *
+ * Returns: the id of the current branch.
+ */
+guint
+gundo_sequence_get_branch (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->branch;
+}
+
+/**
+ * gundo_sequence_get_n_branches:
+ * @seq: a #GundoSequence
+ *
+ * Get the number of branches @seq keeps besides the current one.
+ *
+ * Returns: the number of branches.
+ */
+guint
+gundo_sequence_get_n_branches (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->branches->len;
+}
+
+/**
+ * gundo_sequence_foreach_branch:
+ * @seq: a #GundoSequence
+ * @func: the function to call
+ * @user_data: the data to pass to @func
+ *
+ * Call @func for each branch of @seq besides the current one, from the
+ * least to the most recently left one.
+ */
+void
+gundo_sequence_foreach_branch (GundoSequence * seq,
+                               GundoBranchFunc func,
+                               gpointer        user_data)
+{
+  guint i;
+
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+  g_return_if_fail (func);
+
+  for (i = 0; i < seq->priv->branches->len; i++)
+    {
+      GundoBranch* branch = g_ptr_array_index (seq->priv->branches, i);
+
+      func (branch->id, gundo_branch_get_root (branch)->depth,
+            branch->depth + branch->n_steps, user_data);
+    }
+}
+
+/**
+ * gundo_sequence_switch_branch:
+ * @seq: a #GundoSequence
+ * @branch: the id of a branch
+ *
+ * Make @branch the current branch of @seq and go to its tip. This undoes
+ * the steps back to the latest step @branch shares with the current line
+ * and redoes the steps of @branch from there, so the cost depends on the
+ * distance to the common ancestor only. The rest of the current line is
+ * kept as a branch. Switching to the current branch goes to its tip.
+ *
+ * <emphasis>Prerequisites</emphasis>: no group is being constructed.
+ *
+ * Returns: %TRUE on success, %FALSE if @seq has no branch @branch (e.g.
+ * because it has been discarded).
+ */
+gboolean
+gundo_sequence_switch_branch (GundoSequence* seq,
+                              guint          branch)
+{
+  GundoBranch* target = NULL;
+  GPtrArray  * chain;
+  guint        n_undos;
+  guint        n_redos;
+  guint        depth;
+  guint        index;
+  guint        i;
+  guint64      start;
+
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+  g_return_val_if_fail (!seq->priv->open_group, FALSE);
+
+  if (branch == seq->priv->branch)
+    {
+      gundo_history_goto (GUNDO_HISTORY (seq), seq->priv->n_steps);
+      return TRUE;
+    }
+
+  for (i = 0; i < seq->priv->branches->len && !target; i++)
+    {
+      if (((GundoBranch*) g_ptr_array_index (seq->priv->branches, i))->id == branch)
+        target = g_ptr_array_index (seq->priv->branches, i);
+    }
+
+  if (!target)
+    return FALSE;
+
+  start   = GUNDO_TRACE_BEGIN ();
+  n_undos = seq->priv->n_undos;
+  n_redos = seq->priv->n_steps - seq->priv->n_undos;
+  depth   = gundo_branch_get_root (target)->depth;
+
+  /* back to the common ancestor */
+  while (seq->priv->n_undos > depth)
+    {
+      if (!sequence_step_back (seq))
+        {
+          /* a step on the way can't be restored, so stay on this branch */
+          while (seq->priv->n_undos < n_undos)
+            sequence_step_forward (seq);
+          return FALSE;
+        }
+    }
+
+  /* keep the rest of the line */
+  index = seq->next_redo + steps_get_n_records (seq->priv->actions, seq->next_redo, depth - seq->priv->n_undos);
+  if (index < seq->priv->n_committed)
+    sequence_cut_branch (seq, index, depth);
+  seq->priv->n_committed = index;
+  seq->priv->n_steps     = depth;
+  seq->priv->cold_redo_records = 0;
+  seq->priv->cold_redo_steps   = 0;
+  if (G_UNLIKELY (seq->priv->checkpoints))
+    gundo_checkpoints_drop_from (seq->priv->checkpoints, seq->priv->n_evicted + depth + 1);
+
+  /* graft the target and its ancestors onto the line, oldest first */
+  chain = g_ptr_array_new ();
+  for (; target; target = target->parent)
+    g_ptr_array_add (chain, target);
+  for (i = chain->len; i > 0; i--)
+    {
+      GundoBranch* link = g_ptr_array_index (chain, i - 1);
+      GundoBranch* next = i > 1 ? g_ptr_array_index (chain, i - 2) : NULL;
+
+      sequence_graft_branch (seq, link, next ? next->depth : link->depth + link->n_steps);
+    }
+  g_ptr_array_free (chain, TRUE);
+
+  seq->priv->branch = branch;
+
+  /* and on to its tip, or up to a step that can't be restored */
+  while (seq->priv->n_undos < seq->priv->n_steps && sequence_step_forward (seq))
+    ;
+
+  memset (&seq->priv->redo_usage, 0, sizeof (seq->priv->redo_usage));
+  seq->priv->redo_usage_index = seq->priv->n_committed;
+
+  sequence_stacks_changed (seq, 0, n_undos - MIN (n_undos, depth), seq->priv->n_undos - MIN (n_undos, depth),
+                           n_redos, seq->priv->n_steps - seq->priv->n_undos);
+  sequence_enforce_branch_limits (seq);
+  sequence_publish (seq);
+
+  if (G_UNLIKELY (seq->priv->journal))
+    sequence_journal (seq, GUNDO_JOURNAL_SWITCH_BRANCH, branch);
+
+  GUNDO_TRACE_END ("switch_branch", seq, 0, seq->priv->n_steps - MIN (n_undos, depth), start);
+
+  return TRUE;
+}
+
+/* the number of records a group marker frames in a saved file: the arena
+ * of an outermost group isn't saved, its record is the last one inside */
+static guint32
+marker_get_n_saved (GundoActionStore* store,
+                    guint             index)
+{
+  UndoAction const* marker = gundo_action_store_index (store, index);
+  guint             n_records = GPOINTER_TO_UINT (marker->data);
+  guint             last = marker->type == &gundo_group_begin ? index + n_records : index - 1;
+
+  if (gundo_action_store_index (store, last)->type == &gundo_group_arena_type)
+    n_records--;
+
+  return n_records;
+}
+
+/**
+ * gundo_sequence_save:
+ * @seq: a #GundoSequence
+ * @filename: the file to write to.
+ * @types: the table of action types that may occur in @seq.
+ * @n_types: the number of @types.
+ * @error: return location for a #GError, or %NULL.
+ *
+ * Writes the undoable and redoable actions of @seq to @filename, so they
+ * can be restored with gundo_sequence_load(). The actions are converted by
+ * the serialize callbacks of their types; inline actions (see
+ * gundo_sequence_add_action_inline()) are saved as their payload bytes.
+ * Types are recorded by their position in @types, so gundo_sequence_load()
+ * has to be given a table that starts with the same types.
+ *
+ * Only the current line of history gets saved, branches (see
+ * #GundoSequence:branching) are left out. Actions loaded from a file
+ * before, spilled (see gundo_sequence_open_spill()) or compressed (see
+ * #GundoSequence:compress-distance) are copied over without being
+ * deserialized. @filename is only replaced once the new file is
+ * complete.
+ *
+ * Returns: %TRUE on success, %FALSE if @error was set.
+ */
+gboolean
+gundo_sequence_save (GundoSequence                * seq,
+                     const gchar                  * filename,
+                     GundoActionType const* const * types,
+                     guint                          n_types,
+                     GError                      ** error)
+{
+  GundoHistoryFileWriter* writer;
+  GByteArray            * buffer;
+  guint                   type_index = 0;
+  guint64                 start;
+  guint                   i;
+
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+  g_return_val_if_fail (seq->priv->open_group == 0, FALSE);
+  g_return_val_if_fail (filename, FALSE);
+  g_return_val_if_fail (types || !n_types, FALSE);
+  g_return_val_if_fail (n_types <= GUNDO_HISTORY_FILE_MAX_TYPES, FALSE);
+  g_return_val_if_fail (!error || !*error, FALSE);
+
+  start = GUNDO_TRACE_BEGIN ();
+
+  writer = gundo_history_file_writer_new (filename, error);
+  if (!writer)
+    return FALSE;
+
+  buffer = g_byte_array_new ();
+
+  /* compressed records are read from the batches, which the worker must
+   * not have anymore */
+  if (G_UNLIKELY (seq->priv->cold))
+    gundo_cold_flush (seq->priv->cold);
+
+  for (i = 0; i < seq->priv->n_committed; i++)
+    {
+      UndoAction const     * action = gundo_action_store_index (seq->priv->actions, i);
+      GundoActionType const* type = action->type;
+      gconstpointer          bytes;
+      gsize                  len;
+      guint32                kind = 0;
+
+      if (type == &gundo_group_arena_type)
+        continue;
+
+      if (type == &gundo_group_begin || type == &gundo_group_end)
+        {
+          gundo_history_file_writer_add (writer,
+                                         type == &gundo_group_begin ?
+                                         GUNDO_HISTORY_FILE_GROUP_BEGIN : GUNDO_HISTORY_FILE_GROUP_END,
+                                         NULL, marker_get_n_saved (seq->priv->actions, i));
+          continue;
+        }
+
+      if (type == &gundo_history_file_lazy_type)
+        {
+          GundoHistoryFileEntry const* entry = action->data;
+
+          type  = gundo_history_file_get_type (seq->priv->file, entry);
+          kind  = GUINT32_FROM_LE (entry->kind) & GUNDO_HISTORY_FILE_INLINE;
+          bytes = gundo_history_file_get_bytes (seq->priv->file, entry);
+          len   = GUINT32_FROM_LE (entry->len);
+        }
+      else if (type == &gundo_spill_type)
+        {
+          gboolean is_inline;
+
+          bytes = gundo_spill_get_record (seq->priv->spill, action->data, &type, &is_inline, &len);
+          kind  = is_inline ? GUNDO_HISTORY_FILE_INLINE : 0;
+        }
+      else if (type == &gundo_cold_type)
+        {
+          gboolean is_inline;
+
+          bytes = gundo_cold_get_record (seq->priv->cold, action->data, &type, &is_inline, &len, error);
+          if (!bytes)
+            break;
+          kind  = is_inline ? GUNDO_HISTORY_FILE_INLINE : 0;
+        }
+      else if (type == &gundo_payload_arena_type)
+        {
+          type  = gundo_payload_arena_get_type (action->data);
+          kind  = GUNDO_HISTORY_FILE_INLINE;
+          bytes = gundo_payload_arena_get_payload (action->data);
+          len   = gundo_payload_arena_get_len (action->data);
+        }
+      else if (type->serialize)
+        {
+          g_byte_array_set_size (buffer, 0);
+          type->serialize (action->data, buffer);
+          bytes = buffer->data;
+          len   = buffer->len;
+        }
+      else
+        {
+          g_set_error (error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED,
+                       "%s: an action type can't be serialized", filename);
+          break;
+        }
+
+      /* actions tend to come in runs of the same type */
+      if (type_index >= n_types || types[type_index] != type)
+        type_index = types_find (types, n_types, type);
+
+      if (type_index == n_types)
+        {
+          g_set_error (error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED,
+                       "%s: an action type is missing from the type table", filename);
+          break;
+        }
+      if (len > G_MAXUINT32)
+        {
+          g_set_error (error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED,
+                       "%s: an action is too big to be saved", filename);
+          break;
+        }
+
+      gundo_history_file_writer_add (writer, kind | type_index, bytes, len);
+    }
+
+  g_byte_array_free (buffer, TRUE);
+
+  if (i < seq->priv->n_committed)
+    {
+      gundo_history_file_writer_abort (writer);
+      return FALSE;
+    }
+
+  if (!gundo_history_file_writer_finish (writer, seq->priv->n_steps, seq->priv->n_undos, n_types, error))
+    return FALSE;
+
+  GUNDO_TRACE_END ("save", seq, 0, seq->priv->n_committed, start);
+
+  return TRUE;
+}
+
+/**
+ * gundo_sequence_load:
+ * @seq: an empty #GundoSequence
+ * @filename: a file written by gundo_sequence_save().
+ * @types: the table of action types the file was saved with. It may have
+ * more types at its end.
+ * @n_types: the number of @types.
+ * @error: return location for a #GError, or %NULL.
+ *
+ * Restores the actions saved in @filename into @seq, with the same
+ * undoable and redoable steps. @seq must not have any actions yet; its
+ * properties can be set up before loading.
+ *
+ * The file is mapped into memory and only its index is read up front.
+ * Each action is deserialized right before it is undone or redone for the
+ * first time, with the deserialize callback of its type (or copied, for
+ * inline actions). Until then an action only costs its record, so
+ * gundo_history_get_memory_usage() grows as the history gets visited. The
+ * file must not be modified while @seq uses it, but it can be replaced,
+ * e.g. by saving @seq to it again.
+ *
+ * As the payloads are only deserialized later, a deserialize callback that
+ * returns %NULL can't fail the load itself. The step of that action is
+ * neither undone nor redone then: undo, redo and jumps stop in front of
+ * it, and gundo_sequence_get_restore_error() reports why.
+ *
+ * Returns: %TRUE on success, %FALSE if @error was set.
+ */
+gboolean
+gundo_sequence_load (GundoSequence                * seq,
+                     const gchar                  * filename,
+                     GundoActionType const* const * types,
+                     guint                          n_types,
+                     GError                      ** error)
+{
+  GundoHistoryFile* file;
+  guint             n_records;
+  guint             n_undos;
+  guint64           start;
+  guint             i;
+
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+  g_return_val_if_fail (seq->priv->actions->len == 0 && !seq->priv->file && !seq->priv->journal, FALSE);
+  g_return_val_if_fail (filename, FALSE);
+  g_return_val_if_fail (types || !n_types, FALSE);
+  g_return_val_if_fail (!error || !*error, FALSE);
+
+  start = GUNDO_TRACE_BEGIN ();
+
+  file = gundo_history_file_open (filename, types, n_types, error);
+  if (!file)
+    return FALSE;
+
+  gundo_history_changed (GUNDO_HISTORY (seq));
+
+  seq->priv->file = file;
+  n_records = gundo_history_file_get_n_records (file);
+  gundo_action_store_reserve (seq->priv->actions, n_records);
+
+  for (i = 0; i < n_records; i++)
+    {
+      GundoHistoryFileEntry const* entry = gundo_history_file_get_entry (file, i);
+      UndoAction                   action;
+
+      switch (GUINT32_FROM_LE (entry->kind))
+        {
+        case GUNDO_HISTORY_FILE_GROUP_BEGIN:
+          action.type = &gundo_group_begin;
+          action.data = GUINT_TO_POINTER (GUINT32_FROM_LE (entry->len));
+          break;
+        case GUNDO_HISTORY_FILE_GROUP_END:
+          action.type = &gundo_group_end;
+          action.data = GUINT_TO_POINTER (GUINT32_FROM_LE (entry->len));
+          break;
+        default:
+          action.type = &gundo_history_file_lazy_type;
+          action.data = (gpointer) entry;
+          break;
+        }
+
+      gundo_action_store_append (seq->priv->actions, &action);
+      action_add_usage (&action, &seq->priv->usage);
+    }
+
+  seq->priv->n_steps     = gundo_history_file_get_n_steps (file);
+  seq->priv->n_committed = n_records;
+  seq->priv->redo_usage_index = n_records;
+
+  n_undos = gundo_history_file_get_n_undos (file);
+  for (seq->priv->n_undos = 0; seq->priv->n_undos < n_undos; seq->priv->n_undos++)
+    seq->next_redo += step_get_n_records (gundo_action_store_index (seq->priv->actions, seq->next_redo));
+
+  /* none of them snapshotted a state of this history */
+  if (G_UNLIKELY (seq->priv->checkpoints))
+    gundo_checkpoints_drop_from (seq->priv->checkpoints, 0);
+
+  sequence_stacks_changed (seq, 0, 0, seq->priv->n_undos, 0, seq->priv->n_steps - seq->priv->n_undos);
+  sequence_publish (seq);
+
+  GUNDO_TRACE_END ("load", seq, 0, n_records, start);
+
+  return TRUE;
+}
+
+/**
+ * gundo_sequence_get_restore_error:
+ * @seq: a #GundoSequence
+ * @error: return location for a #GError, or %NULL.
+ *
+ * Find out whether an action of @seq couldn't be restored before it was
+ * about to be undone or redone, because its deserialize callback returned
+ * %NULL for the bytes in the file given to gundo_sequence_load(), in the
+ * spill file (see gundo_sequence_open_spill()) or in the compressed memory
+ * (see #GundoSequence:compress-distance), or because the compressed batch
+ * holding it is damaged (%G_IO_ERROR_INVALID_DATA). The step of such an
+ * action stays where it is, so undo, redo and jumps stop in front of it.
+ * Only the first failure is kept. A spilled action that can't be restored
+ * when the redoable steps become a branch (see #GundoSequence:branching)
+ * is dropped along with the steps after it, as they couldn't be redone.
+ *
+ * Returns: %TRUE if all actions could be restored so far, %FALSE if
+ * @error was set.
+ */
+gboolean
+gundo_sequence_get_restore_error (GundoSequence* seq,
+                                  GError      ** error)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+  g_return_val_if_fail (!error || !*error, FALSE);
+
+  if (!seq->priv->restore_error)
+    return TRUE;
+
+  g_propagate_error (error, g_error_copy (seq->priv->restore_error));
+  return FALSE;
+}
+
+typedef struct {
+  GundoSequence               * seq;
+  GundoActionType const* const* types;
+  guint                         n_types;
+  guint                         n_replayed;
+} JournalReplay;
+
+/* repeats a journaled operation on the sequence being recovered */
+static gboolean
+sequence_replay (GundoJournalOp op,
+                 guint32        arg,
+                 gconstpointer  bytes,
+                 gsize          len,
+                 gpointer       user_data,
+                 GError      ** error)
+{
+  JournalReplay        * replay = user_data;
+  GundoSequence        * seq = replay->seq;
+  GundoActionType const* type = NULL;
+  gpointer               data;
+
+  if (op == GUNDO_JOURNAL_ADD || op == GUNDO_JOURNAL_ADD_INLINE)
+    {
+      if (arg >= replay->n_types || (op == GUNDO_JOURNAL_ADD && !replay->types[arg]->deserialize))
+        {
+          g_set_error (error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED,
+                       "action type %u of the journal can't be restored", arg);
+          return FALSE;
+        }
+      type = replay->types[arg];
+    }
+
+  switch (op)
+    {
+    case GUNDO_JOURNAL_ADD:
+      /* the action gets applied again, just like it was before it got
+       * added in the first place */
+      data = type->deserialize (bytes, len);
+      if (!data)
+        {
+          g_set_error (error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_INVALID_FILE,
+                       "an action of the journal can't be deserialized");
+          return FALSE;
+        }
+      type->redo (data);
+      gundo_sequence_add_action (seq, type, data);
+      replay->n_replayed++;
+      return TRUE;
+    case GUNDO_JOURNAL_ADD_INLINE:
+      data = g_malloc (len);
+      memcpy (data, bytes, len);
+      type->redo (data);
+      gundo_sequence_add_action_inline (seq, type, data, len);
+      g_free (data);
+      replay->n_replayed++;
+      return TRUE;
+    case GUNDO_JOURNAL_GROUP_BEGIN:
+      gundo_sequence_start_group (seq);
+      replay->n_replayed++;
+      return TRUE;
+    case GUNDO_JOURNAL_GROUP_END:
+      if (!seq->priv->open_group)
+        break;
+      gundo_sequence_end_group (seq);
+      replay->n_replayed++;
+      return TRUE;
+    case GUNDO_JOURNAL_GROUP_ABORT:
+      if (!seq->priv->open_group)
+        break;
+      gundo_sequence_abort_group (seq);
+      replay->n_replayed++;
+      return TRUE;
+    case GUNDO_JOURNAL_GO_TO:
+      if (seq->priv->open_group || arg > seq->priv->n_steps)
+        break;
+      gundo_history_goto (GUNDO_HISTORY (seq), arg);
+      replay->n_replayed++;
+      return TRUE;
+    case GUNDO_JOURNAL_SWITCH_BRANCH:
+      if (seq->priv->open_group || !gundo_sequence_switch_branch (seq, arg))
+        break;
+      replay->n_replayed++;
+      return TRUE;
+    }
+
+  g_set_error (error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_INVALID_FILE,
+               "the journal doesn't match the sequence");
+  return FALSE;
+}
+
+/**
+ * gundo_sequence_open_journal:
+ * @seq: an empty #GundoSequence
+ * @filename: the file to keep the journal in.
+ * @types: the table of action types that may occur in @seq.
+ * @n_types: the number of @types.
+ * @n_replayed: return location for the number of operations replayed from
+ * an existing journal, or %NULL.
+ * @error: return location for a #GError, or %NULL.
+ *
+ * Starts journaling the operations on @seq to @filename, so its history
+ * can be recovered after a crash: adding actions, groups, undoing,
+ * redoing and switching branches. Actions are journaled with the
+ * serialize callbacks of their types and recorded by their position in
+ * @types. Actions of types without serialize callback, or missing from
+ * @types, can't be journaled; the journal stops at the first of them, and
+ * gundo_sequence_sync_journal() reports the error.
+ *
+ * Journaling doesn't wait for the disk: the operations are handed to a
+ * writer thread, which syncs them to disk in batches, see
+ * #GundoSequence:journal-sync-interval and
+ * #GundoSequence:journal-sync-size. Only the serialization of the
+ * actions happens on the calling thread, as merge callbacks may still
+ * change the data of an action after it was added.
+ *
+ * If @filename holds a journal already, it is replayed into @seq first,
+ * and the journal continues where it left off. Replaying runs the redo
+ * callback of every action before adding it, and the undo and redo
+ * callbacks of the steps that were undone or redone. This recovers the
+ * state of the application along with the history, provided it starts out
+ * in the state it was in when the journal was started. Set @seq up like
+ * the sequence that wrote the journal, as its budget or branching affects
+ * the result. A damaged record at the end of the journal (written while the
+ * application crashed) is dropped, and groups still open at its end get
+ * aborted.
+ *
+ * If replaying fails (e.g. because an action type is missing from @types),
+ * or the journal can't be opened for writing afterwards, @seq isn't
+ * journaled. The operations replayed until then stay in @seq, as their
+ * callbacks already ran: @n_replayed tells how many there were, and
+ * groups they left open are aborted. Undo them, or carry on without a
+ * journal.
+ *
+ * The journal only grows. Start a new one (e.g. after saving the document
+ * the history belongs to) to get rid of it.
+ *
+ * Returns: %TRUE on success, %FALSE if @error was set.
+ */
+gboolean
+gundo_sequence_open_journal (GundoSequence                * seq,
+                             const gchar                  * filename,
+                             GundoActionType const* const * types,
+                             guint                          n_types,
+                             guint                        * n_replayed,
+                             GError                      ** error)
+{
+  JournalReplay replay;
+  guint64       n_valid;
+  gboolean      replayed;
+
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+  g_return_val_if_fail (seq->priv->actions->len == 0 && !seq->priv->file && !seq->priv->journal, FALSE);
+  g_return_val_if_fail (filename, FALSE);
+  g_return_val_if_fail (types || !n_types, FALSE);
+  g_return_val_if_fail (!error || !*error, FALSE);
+
+  replay.seq        = seq;
+  replay.types      = types;
+  replay.n_types    = n_types;
+  replay.n_replayed = 0;
+
+  gundo_history_freeze_notify (GUNDO_HISTORY (seq));
+  replayed = gundo_journal_replay (filename, sequence_replay, &replay, &n_valid, error);
+  gundo_history_thaw_notify (GUNDO_HISTORY (seq));
+
+  if (n_replayed)
+    *n_replayed = replay.n_replayed;
+
+  if (replayed)
+    seq->priv->journal = gundo_journal_new (filename, n_valid,
+                                      seq->priv->journal_sync_interval, seq->priv->journal_sync_size,
+                                      error);
+  if (seq->priv->journal)
+    {
+      seq->priv->journal_types = g_new (GundoActionType const*, n_types);
+      memcpy (seq->priv->journal_types, types, n_types * sizeof (*types));
+      seq->priv->n_journal_types = n_types;
+    }
+
+  /* the rest of these groups is lost with the crash or the failure; with a
+   * journal, this gets recorded too */
+  while (seq->priv->open_group)
+    gundo_sequence_abort_group (seq);
+
+  return seq->priv->journal != NULL;
+}
+
+/**
+ * gundo_sequence_sync_journal:
+ * @seq: a #GundoSequence with a journal
+ * @error: return location for a #GError, or %NULL.
+ *
+ * Waits until all operations journaled so far are synced to disk.
+ *
+ * Returns: %TRUE on success, %FALSE if journaling failed, in which case
+ * @error is set.
+ */
+gboolean
+gundo_sequence_sync_journal (GundoSequence* seq,
+                             GError      ** error)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+  g_return_val_if_fail (seq->priv->journal, FALSE);
+  g_return_val_if_fail (!error || !*error, FALSE);
+
+  return gundo_journal_sync (seq->priv->journal, error);
+}
+
+/**
+ * gundo_sequence_close_journal:
+ * @seq: a #GundoSequence with a journal
+ * @error: return location for a #GError, or %NULL.
+ *
+ * Syncs the journal of @seq and stops journaling. This happens
+ * automatically when @seq is finalized.
+ *
+ * Returns: %TRUE on success, %FALSE if journaling failed, in which case
+ * @error is set.
+ */
+gboolean
+gundo_sequence_close_journal (GundoSequence* seq,
+                              GError      ** error)
+{
+  GundoJournal* journal;
+
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+  g_return_val_if_fail (seq->priv->journal, FALSE);
+  g_return_val_if_fail (!error || !*error, FALSE);
+
+  journal = seq->priv->journal;
+  seq->priv->journal = NULL;
+  g_free (seq->priv->journal_types);
+  seq->priv->journal_types = NULL;
+  seq->priv->n_journal_types = 0;
+
+  return gundo_journal_free (journal, error);
+}
+
+/**
+ * gundo_sequence_get_journal_sync_interval:
+ * @seq: a #GundoSequence
+ *
+ * Get the #GundoSequence:journal-sync-interval of @seq.
+ *
+ * Returns: the interval in milliseconds.
+ */
+guint
+gundo_sequence_get_journal_sync_interval (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->journal_sync_interval;
+}
+
+/**
+ * gundo_sequence_set_journal_sync_interval:
+ * @seq: a #GundoSequence
+ * @interval: the interval in milliseconds
+ *
+ * Set the #GundoSequence:journal-sync-interval of @seq.
+ */
+void
+gundo_sequence_set_journal_sync_interval (GundoSequence* seq,
+                                          guint          interval)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  if (seq->priv->journal_sync_interval == interval)
+    return;
+
+  seq->priv->journal_sync_interval = interval;
+  if (seq->priv->journal)
+    gundo_journal_set_sync (seq->priv->journal, seq->priv->journal_sync_interval, seq->priv->journal_sync_size);
+
+  g_object_notify (G_OBJECT (seq), "journal-sync-interval");
+}
+
+/**
+ * gundo_sequence_get_journal_sync_size:
+ * @seq: a #GundoSequence
+ *
+ * Get the #GundoSequence:journal-sync-size of @seq.
+ *
+ * Returns: the size in bytes.
+ */
+gsize
+gundo_sequence_get_journal_sync_size (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->journal_sync_size;
+}
+
+/**
+ * gundo_sequence_set_journal_sync_size:
+ * @seq: a #GundoSequence
+ * @size: the size in bytes, at least 1
+ *
+ * Set the #GundoSequence:journal-sync-size of @seq.
+ */
+void
+gundo_sequence_set_journal_sync_size (GundoSequence* seq,
+                                      gsize          size)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+  g_return_if_fail (size > 0);
+
+  if (seq->priv->journal_sync_size == size)
+    return;
+
+  seq->priv->journal_sync_size = size;
+  if (seq->priv->journal)
+    gundo_journal_set_sync (seq->priv->journal, seq->priv->journal_sync_interval, seq->priv->journal_sync_size);
+
+  g_object_notify (G_OBJECT (seq), "journal-sync-size");
+}
+
+/**
+ * gundo_sequence_open_spill:
+ * @seq: a #GundoSequence
+ * @filename: the scratch file to spill to, or %NULL for a temporary file.
+ * @error: return location for a #GError, or %NULL.
+ *
+ * Makes @seq move the actions of old undoable steps out of memory: all
+ * but the latest #GundoSequence:spill-depth undoable steps get their
+ * actions serialized into @filename and freed (with the free callbacks of
+ * their types), leaving only their records in memory. Undoing a spilled
+ * step deserializes its actions again, right before their undo callbacks
+ * are called; redoable steps are never spilled. Inline actions are
+ * spilled as their payload bytes, and actions of types without serialize
+ * or deserialize callbacks stay in memory.
+ *
+ * The file is mapped into memory, so the spilled actions are backed by the
+ * file rather than by the heap or swap, and are only read in when undoing
+ * reaches them. While undoing, the kernel is asked to read ahead the next
+ * spilled actions in the background, so a long run of undos doesn't wait
+ * for the disk at each step. Spilled actions only count for
+ * #GundoSequence:max-size with their record, which keeps long histories
+ * within a fixed memory budget.
+ *
+ * @filename is truncated and unlinked right away, so it never outlives
+ * @seq. A %NULL @filename creates the file in g_get_tmp_dir(), which
+ * might be memory-backed itself.
+ *
+ * Returns: %TRUE on success, %FALSE if @error was set.
+ */
+gboolean
+gundo_sequence_open_spill (GundoSequence* seq,
+                           const gchar  * filename,
+                           GError      ** error)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+  g_return_val_if_fail (!seq->priv->spill, FALSE);
+  g_return_val_if_fail (!error || !*error, FALSE);
+
+  seq->priv->spill = gundo_spill_new (filename, error);
+  if (!seq->priv->spill)
+    return FALSE;
+
+  sequence_spill (seq);
+
+  return TRUE;
+}
+
+/**
+ * gundo_sequence_close_spill:
+ * @seq: a #GundoSequence with a spill file
+ * @error: return location for a #GError, or %NULL.
+ *
+ * Loads all spilled actions of @seq back into memory and stops spilling.
+ * This happens automatically when @seq is finalized (without loading the
+ * actions).
+ *
+ * If some of the spilled actions can't be loaded back, because their
+ * deserialize callback returns %NULL, @seq keeps the spill file open for
+ * them and @error is set to the failure kept for
+ * gundo_sequence_get_restore_error().
+ *
+ * Returns: %TRUE on success, %FALSE if spilling failed at some point (e.g.
+ * because the disk was full) or spilled actions couldn't be loaded back,
+ * in which case @error is set. The actions that couldn't be spilled stayed
+ * in memory, so none of them got lost.
+ */
+gboolean
+gundo_sequence_close_spill (GundoSequence* seq,
+                            GError      ** error)
+{
+  gboolean result;
+  guint    end;
+  guint    i;
+
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), FALSE);
+  g_return_val_if_fail (seq->priv->spill, FALSE);
+  g_return_val_if_fail (!error || !*error, FALSE);
+
+  end = MAX (seq->priv->spill_mark, seq->priv->spill_end);
+  sequence_materialize (seq, 0, end);
+
+  /* the placeholders left need the file */
+  for (i = 0; i < end; i++)
+    {
+      if (gundo_action_store_index (seq->priv->actions, i)->type == &gundo_spill_type)
+        {
+          gundo_sequence_get_restore_error (seq, error);
+          return FALSE;
+        }
+    }
+
+  result = gundo_spill_get_error (seq->priv->spill, error);
+  gundo_spill_free (seq->priv->spill);
+  seq->priv->spill       = NULL;
+  seq->priv->spill_mark  = 0;
+  seq->priv->spill_steps = 0;
+  seq->priv->spill_end   = 0;
+
+  return result;
+}
+
+/**
+ * gundo_sequence_get_spill_depth:
+ * @seq: a #GundoSequence
+ *
+ * Get the #GundoSequence:spill-depth of @seq.
+ *
+ * Returns: the number of undoable steps kept in memory.
+ */
+guint
+gundo_sequence_get_spill_depth (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->spill_depth;
+}
+
+/**
+ * gundo_sequence_set_spill_depth:
+ * @seq: a #GundoSequence
+ * @depth: the number of latest undoable steps to keep in memory, at least 1.
+ *
+ * Set the #GundoSequence:spill-depth of @seq. Lowering it spills the steps
+ * below the new depth right away; raising it doesn't load any back.
+ */
+void
+gundo_sequence_set_spill_depth (GundoSequence* seq,
+                                guint          depth)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+  g_return_if_fail (depth > 0);
+
+  if (seq->priv->spill_depth == depth)
+    return;
+
+  seq->priv->spill_depth = depth;
+  if (seq->priv->spill)
+    sequence_spill (seq);
+
+  g_object_notify (G_OBJECT (seq), "spill-depth");
+}
+
+/**
+ * gundo_sequence_get_compress_distance:
+ * @seq: a #GundoSequence
+ *
+ * Get the #GundoSequence:compress-distance of @seq.
+ *
+ * Returns: the number of steps on either side of the current state kept
+ * uncompressed, 0 if nothing gets compressed.
+ */
+guint
+gundo_sequence_get_compress_distance (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->compress_distance;
+}
+
+/**
+ * gundo_sequence_set_compress_distance:
+ * @seq: a #GundoSequence
+ * @distance: the number of steps on either side of the current state to
+ * keep uncompressed, or 0 to stop compressing.
+ *
+ * Set the #GundoSequence:compress-distance of @seq. The actions of the
+ * steps further than @distance away from the current state, undoable or
+ * redoable, get their payloads compressed in memory: they are serialized
+ * (inline actions are taken as their payload bytes) and freed with the
+ * free callbacks of their types. Undoing or redoing a compressed step
+ * deserializes its actions again, right before their callbacks are
+ * called. Actions of types without serialize or deserialize callbacks, and
+ * ones that serialize to less than 64 bytes, stay as they are.
+ *
+ * The serialized actions are collected in batches of 64 KiB, which a
+ * worker thread compresses with zlib, so adding, undoing and redoing don't
+ * wait for the compression. Reaching a compressed action decompresses its
+ * whole batch, which the following steps of a run of undos or redos are
+ * loaded from. Compressed payloads count for #GundoSequence:max-size with
+ * their compressed size, but not for gundo_sequence_get_size(), which only
+ * counts their records; see gundo_sequence_get_compression_stats()
+ * instead.
+ *
+ * Lowering @distance compresses the steps beyond it right away; raising it
+ * doesn't decompress any. Setting it to 0 decompresses the current line of
+ * history; the actions kept in other branches (see
+ * #GundoSequence:branching) stay compressed until they are visited.
+ */
+void
+gundo_sequence_set_compress_distance (GundoSequence* seq,
+                                      guint          distance)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  if (seq->priv->compress_distance == distance)
+    return;
+
+  seq->priv->compress_distance = distance;
+
+  if (distance)
+    {
+      if (!seq->priv->cold)
+        seq->priv->cold = gundo_cold_new ();
+      sequence_compress (seq);
+    }
+  else if (seq->priv->cold)
+    {
+      sequence_materialize (seq, 0, seq->priv->n_committed);
+      seq->priv->cold_mark         = 0;
+      seq->priv->cold_steps        = 0;
+      seq->priv->cold_redo_records = 0;
+      seq->priv->cold_redo_steps   = 0;
+    }
+
+  g_object_notify (G_OBJECT (seq), "compress-distance");
+}
+
+/**
+ * gundo_sequence_flush_compression:
+ * @seq: a #GundoSequence
+ *
+ * Hands the batch of compressed actions of @seq that isn't full yet to the
+ * worker thread as well, and waits until all batches are compressed. This
+ * is mostly useful before reading gundo_sequence_get_compression_stats().
+ */
+void
+gundo_sequence_flush_compression (GundoSequence* seq)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  if (seq->priv->cold)
+    gundo_cold_flush (seq->priv->cold);
+}
+
+/**
+ * gundo_sequence_get_compression_stats:
+ * @seq: a #GundoSequence
+ * @stats: return location for the statistics.
+ *
+ * Tells how well the payloads of @seq compress and how long decompressing
+ * them takes when undoing or redoing reaches them, see
+ * #GundoSequence:compress-distance. All of @stats is 0 if @seq never
+ * compressed anything.
+ */
+void
+gundo_sequence_get_compression_stats (GundoSequence        * seq,
+                                      GundoCompressionStats* stats)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+  g_return_if_fail (stats);
+
+  if (seq->priv->cold)
+    gundo_cold_get_stats (seq->priv->cold, stats);
+  else
+    memset (stats, 0, sizeof (*stats));
+}
+
+/**
+ * gundo_sequence_set_checkpoint_funcs:
+ * @seq: a #GundoSequence
+ * @snapshot: the function capturing the state of the application, or %NULL
+ * to stop taking checkpoints.
+ * @restore: the function bringing the state of the application back to a
+ * snapshot.
+ * @free_snapshot: the function freeing a snapshot, or %NULL.
+ * @user_data: the data passed to @snapshot and @restore.
+ * @destroy: the function called on @user_data once @seq doesn't need it
+ * anymore, or %NULL.
+ *
+ * Makes gundo_history_goto() jump far without replaying every step in
+ * between. @seq calls @snapshot to take a checkpoint of the current state
+ * once the steps since the last one add up to
+ * #GundoSequence:checkpoint-interval, or once replaying them would take
+ * #GundoSequence:checkpoint-cost. The current state is checkpointed right
+ * away.
+ *
+ * What replaying a step takes is estimated from the undo and redo
+ * callbacks of the actions it holds: @seq measures them as they are
+ * called and keeps an average per #GundoActionType. So the more expensive
+ * the actions are, the closer together the checkpoints get. Undoing and
+ * redoing takes checkpoints as well, which covers steps whose types
+ * weren't measured yet when they were added.
+ *
+ * A jump then moves to the checkpoint closest to its target, if getting
+ * there from the checkpoint is cheaper than from the current state,
+ * without calling any callbacks or loading the actions it passes (from a
+ * history file, the spill or the compressed memory); it calls @restore
+ * with the snapshot of the checkpoint and replays the remaining steps as
+ * usual.
+ *
+ * Adding an action after undoing some drops the checkpoints of the states
+ * that can't be redone anymore (including the ones of branches, see
+ * #GundoSequence:branching), as does merging an action into the latest
+ * step and evicting the steps before a checkpoint.
+ * #GundoSequence:max-checkpoints bounds the number of snapshots held.
+ *
+ * Replacing the functions drops all checkpoints.
+ */
+void
+gundo_sequence_set_checkpoint_funcs (GundoSequence   * seq,
+                                     GundoSnapshotFunc snapshot,
+                                     GundoRestoreFunc  restore,
+                                     GDestroyNotify    free_snapshot,
+                                     gpointer          user_data,
+                                     GDestroyNotify    destroy)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+  g_return_if_fail (!snapshot == !restore);
+
+  if (seq->priv->checkpoints)
+    {
+      gundo_checkpoints_free (seq->priv->checkpoints);
+      seq->priv->checkpoints = NULL;
+    }
+
+  if (!snapshot)
+    return;
+
+  seq->priv->checkpoints = gundo_checkpoints_new (snapshot, restore, free_snapshot, user_data, destroy);
+
+  if (!seq->priv->open_group)
+    gundo_checkpoints_take (seq->priv->checkpoints, seq->priv->n_evicted + seq->priv->n_undos, seq->priv->max_checkpoints);
+}
+
+/**
+ * gundo_sequence_get_checkpoint_interval:
+ * @seq: a #GundoSequence
+ *
+ * Get the #GundoSequence:checkpoint-interval of @seq.
+ *
+ * Returns: the number of steps after which a checkpoint is taken at the
+ * latest, 0 if only #GundoSequence:checkpoint-cost counts.
+ */
+guint
+gundo_sequence_get_checkpoint_interval (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->checkpoint_interval;
+}
+
+/**
+ * gundo_sequence_set_checkpoint_interval:
+ * @seq: a #GundoSequence
+ * @interval: the number of steps after which a checkpoint is taken at the
+ * latest, or 0.
+ *
+ * Set the #GundoSequence:checkpoint-interval of @seq, see
+ * gundo_sequence_set_checkpoint_funcs().
+ */
+void
+gundo_sequence_set_checkpoint_interval (GundoSequence* seq,
+                                        guint          interval)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  if (seq->priv->checkpoint_interval == interval)
+    return;
+
+  seq->priv->checkpoint_interval = interval;
+  g_object_notify (G_OBJECT (seq), "checkpoint-interval");
+}
+
+/**
+ * gundo_sequence_get_checkpoint_cost:
+ * @seq: a #GundoSequence
+ *
+ * Get the #GundoSequence:checkpoint-cost of @seq.
+ *
+ * Returns: the time in nanoseconds replaying the steps between two
+ * checkpoints may take, 0 if only #GundoSequence:checkpoint-interval
+ * counts.
+ */
+guint64
+gundo_sequence_get_checkpoint_cost (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->checkpoint_cost;
+}
+
+/**
+ * gundo_sequence_set_checkpoint_cost:
+ * @seq: a #GundoSequence
+ * @cost: the time in nanoseconds replaying the steps between two
+ * checkpoints may take, or 0.
+ *
+ * Set the #GundoSequence:checkpoint-cost of @seq, see
+ * gundo_sequence_set_checkpoint_funcs(). The default of 100 ms keeps a jump
+ * from replaying for much longer than that, if the snapshots are cheap
+ * compared to it.
+ */
+void
+gundo_sequence_set_checkpoint_cost (GundoSequence* seq,
+                                    guint64        cost)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  if (seq->priv->checkpoint_cost == cost)
+    return;
+
+  seq->priv->checkpoint_cost = cost;
+  g_object_notify (G_OBJECT (seq), "checkpoint-cost");
+}
+
+/**
+ * gundo_sequence_get_max_checkpoints:
+ * @seq: a #GundoSequence
+ *
+ * Get the #GundoSequence:max-checkpoints of @seq.
+ *
+ * Returns: the number of checkpoints kept at most, 0 if there is no limit.
+ */
+guint
+gundo_sequence_get_max_checkpoints (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->max_checkpoints;
+}
+
+/**
+ * gundo_sequence_set_max_checkpoints:
+ * @seq: a #GundoSequence
+ * @max_checkpoints: the number of checkpoints to keep at most, or 0 for no
+ * limit.
+ *
+ * Set the #GundoSequence:max-checkpoints of @seq. If there are more
+ * checkpoints already, the ones closest to their neighbours are dropped
+ * right away, keeping the oldest and the latest one.
+ */
+void
+gundo_sequence_set_max_checkpoints (GundoSequence* seq,
+                                    guint          max_checkpoints)
+{
+  g_return_if_fail (GUNDO_IS_SEQUENCE (seq));
+
+  if (seq->priv->max_checkpoints == max_checkpoints)
+    return;
+
+  seq->priv->max_checkpoints = max_checkpoints;
+  if (seq->priv->checkpoints)
+    gundo_checkpoints_thin (seq->priv->checkpoints, max_checkpoints);
+
+  g_object_notify (G_OBJECT (seq), "max-checkpoints");
+}
+
+/**
+ * gundo_sequence_get_n_checkpoints:
+ * @seq: a #GundoSequence
+ *
+ * Get the number of checkpoints @seq holds, see
+ * gundo_sequence_set_checkpoint_funcs().
+ *
+ * Returns: the number of snapshots held.
+ */
+guint
+gundo_sequence_get_n_checkpoints (GundoSequence* seq)
+{
+  g_return_val_if_fail (GUNDO_IS_SEQUENCE (seq), 0);
+
+  return seq->priv->checkpoints ? gundo_checkpoints_get_n (seq->priv->checkpoints) : 0;
+}
+
+/* deserializes the records [@index, @index + @n_actions) that are still
+ * placeholders for actions of a loaded file, spilled or compressed ones;
+ * their payloads get accounted on the side of the history they are on
+ * right now. Spilled records are loaded newest first, the way they are
+ * laid out in the spill file. Returns FALSE if some of them couldn't be
+ * restored; they stay placeholders, and the first failure is kept for
+ * gundo_sequence_get_restore_error(). */
+static gboolean
+sequence_materialize (GundoSequence* seq,
+                      guint          index,
+                      guint          n_actions)
+{
+  gboolean result = TRUE;
+  GError * error = NULL;
+  guint    i;
+
+  sequence_sync_redo_usage (seq);
+
+  for (i = index + n_actions; i > index; i--)
+    {
+      UndoAction     * action = gundo_action_store_index (seq->priv->actions, i - 1);
+      GundoMemoryUsage before;
+      GundoMemoryUsage after;
+
+      if (action->type != &gundo_history_file_lazy_type &&
+          action->type != &gundo_spill_type &&
+          action->type != &gundo_cold_type)
+        continue;
+
+      if (!seq->priv->payloads)
+        seq->priv->payloads = gundo_payload_arena_new ();
+
+      memset (&before, 0, sizeof (before));
+      memset (&after, 0, sizeof (after));
+      action_add_usage (action, &before);
+      if (action->type == &gundo_spill_type ?
+          !gundo_spill_load (seq->priv->spill, seq->priv->payloads, action, &error) :
+          action->type == &gundo_cold_type ?
+          !gundo_cold_load (seq->priv->cold, seq->priv->payloads, action, &error) :
+          !gundo_history_file_materialize (seq->priv->file, seq->priv->payloads, action, &error))
+        {
+          if (!seq->priv->restore_error)
+            seq->priv->restore_error = error;
+          else
+            g_error_free (error);
+          error  = NULL;
+          result = FALSE;
+          continue;
+        }
+      action_add_usage (action, &after);
+
+      usage_subtract (&seq->priv->usage, &before);
+      usage_add (&seq->priv->usage, &after);
+      if (i - 1 >= seq->next_redo)
+        {
+          usage_subtract (&seq->priv->redo_usage, &before);
+          usage_add (&seq->priv->redo_usage, &after);
+        }
+    }
+  return result;
+}
+
+/* calls the undo or redo callbacks of a step while checkpointing, which
+ * measures them and takes a checkpoint once the steps since the last one
+ * add up. */
+static void
+sequence_call_checkpointed (GundoSequence* seq,
+                            guint          index,
+                            guint          n_records,
+                            GundoActionOp  op)
+{
+  guint64 cost;
+
+  cost = actions_call_instrumented (seq, index, n_records, op);
+  gundo_checkpoints_add_cost (seq->priv->checkpoints, seq->priv->n_evicted + seq->priv->n_undos, cost, TRUE);
+  sequence_checkpoint (seq);
+}
+
+/* redoes the next redoable step; returns FALSE, without moving, if its
+ * actions couldn't be restored */
+static gboolean
+sequence_step_forward (GundoSequence* seq)
+{
+  guint   n_records = step_get_n_records (gundo_action_store_index (seq->priv->actions, seq->next_redo));
+  guint64 start = GUNDO_TRACE_BEGIN ();
+
+  /* a checkpoint may have left spilled records on the redo side */
+  if (G_UNLIKELY (seq->priv->file || seq->priv->cold || seq->next_redo < seq->priv->spill_end) &&
+      !sequence_materialize (seq, seq->next_redo, n_records))
+    return FALSE;
+
+  seq->next_redo += n_records;
+  seq->priv->n_undos++;
+  if (G_UNLIKELY (seq->priv->cold_redo_records > seq->priv->n_committed - seq->next_redo))
+    {
+      seq->priv->cold_redo_records = seq->priv->n_committed - seq->next_redo;
+      seq->priv->cold_redo_steps   = seq->priv->n_steps - seq->priv->n_undos;
+    }
+  if (G_UNLIKELY (seq->priv->checkpoints))
+    sequence_call_checkpointed (seq, seq->next_redo - n_records, n_records, GUNDO_ACTION_OP_REDO);
+  else if (G_UNLIKELY (seq->priv->instrumented))
+    actions_call_instrumented (seq, seq->next_redo - n_records, n_records, GUNDO_ACTION_OP_REDO);
+  else
+    actions_redo (seq->priv->actions, seq->next_redo - n_records, n_records);
+
+  GUNDO_TRACE_END ("redo-actions", seq, 0, n_records, start);
 
-	if(!could_redo) {
-		// now we definitely can redo
-		g_object_notify(G_OBJECT(self), "can-redo");
+  return TRUE;
+}
+
+/* undoes the latest undoable step; returns FALSE, without moving, if its
+ * actions couldn't be restored */
+static gboolean
+sequence_step_back (GundoSequence* seq)
+{
+  guint   n_records = step_get_n_records_before (gundo_action_store_index (seq->priv->actions, seq->next_redo - 1));
+  guint64 start = GUNDO_TRACE_BEGIN ();
+
+  /* the records below the spill end may be spilled */
+  if (G_UNLIKELY (seq->priv->file || seq->priv->cold || seq->next_redo - n_records < seq->priv->spill_end) &&
+      !sequence_materialize (seq, seq->next_redo - n_records, n_records))
+    return FALSE;
+
+  seq->next_redo -= n_records;
+  seq->priv->n_undos--;
+  if (G_UNLIKELY (seq->priv->spill_mark > seq->next_redo))
+    {
+      if (seq->priv->spill_end == seq->priv->spill_mark)
+        seq->priv->spill_end = seq->next_redo;
+      seq->priv->spill_mark  = seq->next_redo;
+      seq->priv->spill_steps = seq->priv->n_undos;
+    }
+  if (G_UNLIKELY (seq->priv->cold_mark > seq->next_redo))
+    {
+      seq->priv->cold_mark  = seq->next_redo;
+      seq->priv->cold_steps = seq->priv->n_undos;
+    }
+  if (G_UNLIKELY (seq->priv->checkpoints))
+    sequence_call_checkpointed (seq, seq->next_redo, n_records, GUNDO_ACTION_OP_UNDO);
+  else if (G_UNLIKELY (seq->priv->instrumented))
+    actions_call_instrumented (seq, seq->next_redo, n_records, GUNDO_ACTION_OP_UNDO);
+  else
+    actions_undo (seq->priv->actions, seq->next_redo, n_records);
+
+  GUNDO_TRACE_END ("undo-actions", seq, 0, n_records, start);
+
+  return TRUE;
+}
+
+static void
+sequence_redo (GundoHistory* history)
+{
+        GundoSequence* seq = GUNDO_SEQUENCE (history);
+
+	g_return_if_fail( seq->priv->open_group == 0 );
+	g_return_if_fail( seq->priv->can_redo );
+
+	if( !sequence_step_forward( seq ) ) {
+		return;
+	}
+	if( G_UNLIKELY( seq->priv->spill ) ) {
+		sequence_spill( seq );
 	}
-	if(!gundo_history_can_undo(history)) {
-		// so, we can't undo anymore
-		g_object_notify(G_OBJECT(self), "can-undo");
+	if( G_UNLIKELY( seq->priv->compress_distance ) ) {
+		sequence_compress( seq );
 	}
+	if( G_UNLIKELY( seq->priv->journal ) ) {
+		sequence_journal( seq, GUNDO_JOURNAL_GO_TO, seq->priv->n_undos );
+	}
+	sequence_stacks_changed( seq, 0, 0, 1, 1, 0 );
+	sequence_update_state( seq );
+}
+
+static void free_actions( GundoActionStore *store, guint index, guint n_actions ) {
+    guint i;
+
+    for( i = index; i < index + n_actions; i++ ) {
+        UndoAction *action = gundo_action_store_index( store, i );
+        if( (action->type->free) ) (action->type->free)( action->data );
+    }
+}
+
+static void free_actions_instrumented( GundoSequence *seq, GundoActionStore *store, guint index, guint n_actions ) {
+    guint i;
+
+    for( i = index; i < index + n_actions; i++ ) {
+        UndoAction *action = gundo_action_store_index( store, i );
+        GundoActionType const *type = action_get_stats_type( action );
+        guint64 start;
+
+        if( !action->type->free ) {
+            continue;
+        }
+
+        start = gundo_stats_now();
+        action->type->free( action->data );
+        if( type ) {
+            gundo_stats_record( seq->priv->stats, type, GUNDO_ACTION_OP_FREE, gundo_stats_now() - start );
+        }
+    }
+}
+
+/* frees the records [@index, @index + @n_actions) of @store, or queues them
+ * for reclamation; the caller drops them from the store afterwards */
+static void sequence_discard_store( GundoSequence *seq, GundoActionStore *store, guint index, guint n_actions ) {
+    if( G_UNLIKELY( seq->priv->cold ) )
+        gundo_cold_forget( seq->priv->cold, store, index, n_actions );
+
+    if( seq->priv->deferred_free )
+        gundo_reclaim_push( seq, store, index, n_actions );
+    else if( G_UNLIKELY( seq->priv->instrumented ) )
+        free_actions_instrumented( seq, store, index, n_actions );
+    else
+        free_actions( store, index, n_actions );
+}
+
+static void sequence_discard( GundoSequence *seq, guint index, guint n_actions ) {
+    sequence_discard_store( seq, seq->priv->actions, index, n_actions );
+}
+
+/* frees what record @index held as @moved, before its payload was moved to
+ * the spill file or the cold tier */
+static void sequence_discard_moved( GundoSequence *seq, guint index, UndoAction const *moved ) {
+    UndoAction *action = gundo_action_store_index( seq->priv->actions, index );
+    UndoAction  tier = *action;
+
+    *action = *moved;
+    sequence_discard( seq, index, 1 );
+    *action = tier;
+}
+
+/* GundoHistory implementation */
+
+static gboolean
+gs_can_redo(GundoHistory *history) {
+	return GUNDO_SEQUENCE(history)->priv->can_redo;
+}
+
+static gboolean
+gs_can_undo(GundoHistory *history) {
+	return GUNDO_SEQUENCE(history)->priv->can_undo;
+}
+
+static guint
+sequence_get_n_redos (GundoHistory* history)
+{
+  return GUNDO_SEQUENCE (history)->priv->n_steps - GUNDO_SEQUENCE (history)->priv->n_undos;
+}
+
+static guint
+sequence_get_n_changes (GundoHistory* history)
+{
+  if (GUNDO_SEQUENCE (history)->priv->n_undos)
+    return GUNDO_SEQUENCE (history)->priv->n_steps;
+  else
+    return 0;
+}
+
+static guint
+sequence_get_position (GundoHistory* history)
+{
+  return GUNDO_SEQUENCE (history)->priv->n_undos;
+}
+
+/* the class handler of GundoHistory::changed, which is emitted right before
+ * new steps get committed: the redo tail makes room for them. Emissions
+ * without pending steps (like the ones held back while frozen) leave the
+ * history alone. */
+static void
+sequence_changed (GundoHistory* history)
+{
+  GundoSequence* seq = GUNDO_SEQUENCE (history);
+
+  if (!seq->priv->open_group && seq->priv->actions->len > seq->priv->n_committed &&
+      seq->next_redo < seq->priv->n_committed)
+    {
+      sequence_truncate (seq);
+      sequence_update_state (seq);
+    }
+}
+
+static void
+gs_undo(GundoHistory* history) {
+	GundoSequence* self;
+
+	self = GUNDO_SEQUENCE(history);
+
+	g_return_if_fail(self->priv->open_group == 0);
+	g_return_if_fail(self->priv->can_undo);
+
+	if (!sequence_step_back (self))
+		return;
+	if (G_UNLIKELY (self->priv->compress_distance))
+		sequence_compress (self);
+	if (G_UNLIKELY (self->priv->journal))
+		sequence_journal (self, GUNDO_JOURNAL_GO_TO, self->priv->n_undos);
+	sequence_stacks_changed (self, 0, 1, 0, 0, 1);
+	sequence_update_state (self);
+}
+
+/* moves to the checkpoint that gets closest to @position for less than
+ * replaying the steps from the current state, if there is one, and
+ * restores it. The steps on the way are only passed: their records stay
+ * what they are, loaded or not, and only the marks move along. */
+static void
+sequence_restore_checkpoint (GundoSequence* seq,
+                             guint          position)
+{
+  guint   checkpoint;
+  guint   n_walked;
+  guint64 start;
+  guint64 walk_start;
+
+  if (!gundo_checkpoints_find (seq->priv->checkpoints, seq->priv->n_evicted + seq->priv->n_undos,
+                               seq->priv->n_evicted + position, &checkpoint))
+    return;
+
+  start      = GUNDO_TRACE_BEGIN ();
+  walk_start = gundo_stats_now ();
+
+  checkpoint -= seq->priv->n_evicted;
+  n_walked    = seq->priv->n_undos > checkpoint ? seq->priv->n_undos - checkpoint : checkpoint - seq->priv->n_undos;
+  while (seq->priv->n_undos > checkpoint)
+    {
+      seq->next_redo -= step_get_n_records_before (gundo_action_store_index (seq->priv->actions, seq->next_redo - 1));
+      seq->priv->n_undos--;
+    }
+  while (seq->priv->n_undos < checkpoint)
+    {
+      seq->next_redo += step_get_n_records (gundo_action_store_index (seq->priv->actions, seq->next_redo));
+      seq->priv->n_undos++;
+    }
+
+  /* the spilled and compressed records passed are on the redo side now */
+  if (seq->priv->spill_mark > seq->next_redo)
+    {
+      seq->priv->spill_end   = MAX (seq->priv->spill_end, seq->priv->spill_mark);
+      seq->priv->spill_mark  = seq->next_redo;
+      seq->priv->spill_steps = seq->priv->n_undos;
+    }
+  if (seq->priv->cold_mark > seq->next_redo)
+    {
+      seq->priv->cold_mark  = seq->next_redo;
+      seq->priv->cold_steps = seq->priv->n_undos;
+    }
+  if (seq->priv->cold_redo_records > seq->priv->n_committed - seq->next_redo)
+    {
+      seq->priv->cold_redo_records = seq->priv->n_committed - seq->next_redo;
+      seq->priv->cold_redo_steps   = seq->priv->n_steps - seq->priv->n_undos;
+    }
+  gundo_checkpoints_measure_walk (seq->priv->checkpoints, n_walked, gundo_stats_now () - walk_start);
+
+  gundo_checkpoints_restore (seq->priv->checkpoints, seq->priv->n_evicted + checkpoint);
+
+  GUNDO_TRACE_END ("restore-checkpoint", seq, 0, n_walked, start);
+}
+
+static void
+sequence_go_to (GundoHistory* history,
+                guint         position)
+{
+  GundoSequence* seq = GUNDO_SEQUENCE (history);
+  guint          n_undos = seq->priv->n_undos;
+
+  g_return_if_fail (seq->priv->open_group == 0);
+  g_return_if_fail (position <= seq->priv->n_steps);
+
+  if (position == seq->priv->n_undos)
+    return;
+
+  if (G_UNLIKELY (seq->priv->checkpoints))
+    sequence_restore_checkpoint (seq, position);
+
+  /* the jump stops in front of a step that can't be restored */
+  while (seq->priv->n_undos > position && sequence_step_back (seq))
+    ;
+  while (seq->priv->n_undos < position && sequence_step_forward (seq))
+    ;
+
+  /* restoring a checkpoint may have gone back further than the target */
+  if (G_UNLIKELY (seq->priv->spill))
+    sequence_spill (seq);
+  if (G_UNLIKELY (seq->priv->compress_distance))
+    sequence_compress (seq);
+
+  if (n_undos > seq->priv->n_undos)
+    sequence_stacks_changed (seq, 0, n_undos - seq->priv->n_undos, 0, 0, n_undos - seq->priv->n_undos);
+  else
+    sequence_stacks_changed (seq, 0, 0, seq->priv->n_undos - n_undos, seq->priv->n_undos - n_undos, 0);
+
+  if (G_UNLIKELY (seq->priv->journal))
+    sequence_journal (seq, GUNDO_JOURNAL_GO_TO, seq->priv->n_undos);
+
+  sequence_update_state (seq);
+}
+
+static void
+sequence_get_memory_usage (GundoHistory    * history,
+                           GundoMemoryUsage* undo_usage,
+                           GundoMemoryUsage* redo_usage)
+{
+  GundoSequence* seq = GUNDO_SEQUENCE (history);
+
+  sequence_sync_redo_usage (seq);
+
+  *redo_usage = seq->priv->redo_usage;
+  *undo_usage = seq->priv->usage;
+  usage_subtract (undo_usage, redo_usage);
+  usage_add (redo_usage, &seq->priv->branch_usage);
 }
 
 static void
@@ -429,6 +4485,10 @@ gs_history_iface_init (GundoHistoryIface* iface)
 
   iface->undo          = gs_undo;
   iface->redo          = sequence_redo;
+  iface->go_to         = sequence_go_to;
+
+  iface->get_memory_usage = sequence_get_memory_usage;
+  iface->get_position  = sequence_get_position;
 }
 
 
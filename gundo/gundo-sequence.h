@@ -25,11 +25,13 @@
 #define GUNDO_SEQUENCE_H
 
 #include <glib-object.h>
+#include <gundo-history.h>
 
 G_BEGIN_DECLS
 
 typedef struct _GundoSequence GundoSequence;
 typedef struct _GObjectClass  GundoSequenceClass;
+typedef struct _GundoSequencePrivate GundoSequencePrivate;
 
 #define GUNDO_TYPE_SEQUENCE         (gundo_sequence_get_type())
 #define GUNDO_SEQUENCE(i)           (G_TYPE_CHECK_INSTANCE_CAST((i), GUNDO_TYPE_SEQUENCE, GundoSequence))
@@ -38,30 +40,216 @@ typedef struct _GObjectClass  GundoSequenceClass;
 #define GUNDO_IS_SEQUENCE_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE((c), GUNDO_TYPE_SEQUENCE))
 #define GUNDO_SEQUENCE_GET_CLASS(i) (G_TYPE_INSTANCE_GET_CLASS((i), GUNDO_TYPE_SEQUENCE, GundoSequenceClass))
 
-typedef void (*GundoActionCallback)( gpointer action_data );
+typedef void  (*GundoActionCallback)( gpointer action_data );
+typedef gsize (*GundoActionSizeFunc)( gpointer action_data );
+typedef gboolean (*GundoActionMergeFunc)( gpointer action_data,
+                                          gpointer new_data );
+typedef void     (*GundoActionSerializeFunc)( gpointer    action_data,
+                                              GByteArray *buffer );
+typedef gpointer (*GundoActionDeserializeFunc)( gconstpointer bytes,
+                                                gsize         len );
 typedef struct _GundoActionType GundoActionType;
+typedef struct _GundoActionEntry GundoActionEntry;
+
+typedef enum {
+    GUNDO_ACTION_FREE_THREADSAFE = 1 << 0
+} GundoActionFlags;
+
+typedef enum {
+    GUNDO_ACTION_OP_ADD,
+    GUNDO_ACTION_OP_UNDO,
+    GUNDO_ACTION_OP_REDO,
+    GUNDO_ACTION_OP_FREE,
+    GUNDO_ACTION_N_OPS
+} GundoActionOp;
+
+#define GUNDO_SEQUENCE_ERROR (gundo_sequence_error_quark())
+
+typedef enum {
+    GUNDO_SEQUENCE_ERROR_INVALID_FILE,
+    GUNDO_SEQUENCE_ERROR_UNSUPPORTED
+} GundoSequenceError;
+
+#define GUNDO_ACTION_STATS_N_BUCKETS 32
+
+typedef struct _GundoActionStats GundoActionStats;
+
+struct _GundoActionStats {
+    guint64 n_calls;
+    guint64 total_ns;
+    guint64 max_ns;
+    guint64 histogram[GUNDO_ACTION_STATS_N_BUCKETS];
+};
+
+typedef struct _GundoCompressionStats GundoCompressionStats;
+
+struct _GundoCompressionStats {
+    guint64 n_actions;
+    guint64 raw_bytes;
+    guint64 compressed_bytes;
+    GundoActionStats decompress;
+};
+
+typedef void (*GundoActionStatsFunc)( const GundoActionType *type,
+                                      GundoActionOp          op,
+                                      const GundoActionStats *stats,
+                                      gpointer               user_data );
+
+typedef void (*GundoBranchFunc)( guint    branch,
+                                 guint    fork,
+                                 guint    n_steps,
+                                 gpointer user_data );
+
+typedef gpointer (*GundoSnapshotFunc)( gpointer user_data );
+typedef void     (*GundoRestoreFunc)( gpointer snapshot,
+                                      gpointer user_data );
 
 GType          gundo_sequence_get_type   (void);
+GQuark         gundo_sequence_error_quark(void);
 GundoSequence *gundo_sequence_new        (void);
 void           gundo_sequence_add_action (GundoSequence *seq,
                                           const GundoActionType *type,
                                           gpointer data);
+void           gundo_sequence_add_action_inline (GundoSequence *seq,
+                                                 const GundoActionType *type,
+                                                 gconstpointer  bytes,
+                                                 gsize          len);
+void           gundo_sequence_add_actions (GundoSequence *seq,
+                                           const GundoActionEntry *entries,
+                                           guint          n_entries,
+                                           gboolean       as_group);
 void           gundo_sequence_start_group(GundoSequence *seq );
 void           gundo_sequence_end_group  (GundoSequence *seq );
 void           gundo_sequence_abort_group(GundoSequence *seq );
+gpointer       gundo_sequence_group_alloc(GundoSequence *seq,
+                                          gsize          size);
+gsize          gundo_sequence_get_size       (GundoSequence *seq );
+gsize          gundo_sequence_get_max_size   (GundoSequence *seq );
+void           gundo_sequence_set_max_size   (GundoSequence *seq,
+                                              gsize          max_size);
+guint          gundo_sequence_get_max_depth  (GundoSequence *seq );
+void           gundo_sequence_set_max_depth  (GundoSequence *seq,
+                                              guint          max_depth);
+guint          gundo_sequence_get_n_evicted  (GundoSequence *seq );
+void           gundo_sequence_reserve        (GundoSequence *seq,
+                                              guint          n_actions);
+gboolean       gundo_sequence_get_deferred_free (GundoSequence *seq );
+void           gundo_sequence_set_deferred_free (GundoSequence *seq,
+                                                 gboolean       deferred_free);
+void           gundo_sequence_flush_discarded   (GundoSequence *seq );
+gboolean       gundo_sequence_get_instrumented  (GundoSequence *seq );
+void           gundo_sequence_set_instrumented  (GundoSequence *seq,
+                                                 gboolean       instrumented);
+gboolean       gundo_sequence_get_action_stats  (GundoSequence *seq,
+                                                 const GundoActionType *type,
+                                                 GundoActionOp  op,
+                                                 GundoActionStats *stats);
+void           gundo_sequence_foreach_action_stats (GundoSequence *seq,
+                                                    GundoActionStatsFunc func,
+                                                    gpointer       user_data);
+void           gundo_sequence_reset_action_stats   (GundoSequence *seq );
+gboolean       gundo_sequence_get_branching     (GundoSequence *seq );
+void           gundo_sequence_set_branching     (GundoSequence *seq,
+                                                 gboolean       branching);
+guint          gundo_sequence_get_max_branches  (GundoSequence *seq );
+void           gundo_sequence_set_max_branches  (GundoSequence *seq,
+                                                 guint          max_branches);
+gsize          gundo_sequence_get_max_branch_size (GundoSequence *seq );
+void           gundo_sequence_set_max_branch_size (GundoSequence *seq,
+                                                   gsize          max_size);
+guint          gundo_sequence_get_branch        (GundoSequence *seq );
+guint          gundo_sequence_get_n_branches    (GundoSequence *seq );
+void           gundo_sequence_foreach_branch    (GundoSequence *seq,
+                                                 GundoBranchFunc func,
+                                                 gpointer       user_data);
+gboolean       gundo_sequence_switch_branch     (GundoSequence *seq,
+                                                 guint          branch);
+gboolean       gundo_sequence_save              (GundoSequence *seq,
+                                                 const gchar   *filename,
+                                                 const GundoActionType * const *types,
+                                                 guint          n_types,
+                                                 GError       **error);
+gboolean       gundo_sequence_load              (GundoSequence *seq,
+                                                 const gchar   *filename,
+                                                 const GundoActionType * const *types,
+                                                 guint          n_types,
+                                                 GError       **error);
+gboolean       gundo_sequence_get_restore_error (GundoSequence *seq,
+                                                 GError       **error);
+gboolean       gundo_sequence_open_journal      (GundoSequence *seq,
+                                                 const gchar   *filename,
+                                                 const GundoActionType * const *types,
+                                                 guint          n_types,
+                                                 guint         *n_replayed,
+                                                 GError       **error);
+gboolean       gundo_sequence_sync_journal      (GundoSequence *seq,
+                                                 GError       **error);
+gboolean       gundo_sequence_close_journal     (GundoSequence *seq,
+                                                 GError       **error);
+guint          gundo_sequence_get_journal_sync_interval (GundoSequence *seq );
+void           gundo_sequence_set_journal_sync_interval (GundoSequence *seq,
+                                                         guint          interval);
+gsize          gundo_sequence_get_journal_sync_size     (GundoSequence *seq );
+void           gundo_sequence_set_journal_sync_size     (GundoSequence *seq,
+                                                         gsize          size);
+gboolean       gundo_sequence_open_spill        (GundoSequence *seq,
+                                                 const gchar   *filename,
+                                                 GError       **error);
+gboolean       gundo_sequence_close_spill       (GundoSequence *seq,
+                                                 GError       **error);
+guint          gundo_sequence_get_spill_depth   (GundoSequence *seq );
+void           gundo_sequence_set_spill_depth   (GundoSequence *seq,
+                                                 guint          depth);
+guint          gundo_sequence_get_compress_distance (GundoSequence *seq );
+void           gundo_sequence_set_compress_distance (GundoSequence *seq,
+                                                     guint          distance);
+void           gundo_sequence_flush_compression     (GundoSequence *seq );
+void           gundo_sequence_get_compression_stats (GundoSequence *seq,
+                                                     GundoCompressionStats *stats);
+void           gundo_sequence_set_checkpoint_funcs  (GundoSequence *seq,
+                                                     GundoSnapshotFunc snapshot,
+                                                     GundoRestoreFunc restore,
+                                                     GDestroyNotify free_snapshot,
+                                                     gpointer       user_data,
+                                                     GDestroyNotify destroy);
+guint          gundo_sequence_get_checkpoint_interval (GundoSequence *seq );
+void           gundo_sequence_set_checkpoint_interval (GundoSequence *seq,
+                                                       guint          interval);
+guint64        gundo_sequence_get_checkpoint_cost   (GundoSequence *seq );
+void           gundo_sequence_set_checkpoint_cost   (GundoSequence *seq,
+                                                     guint64        cost);
+guint          gundo_sequence_get_max_checkpoints   (GundoSequence *seq );
+void           gundo_sequence_set_max_checkpoints   (GundoSequence *seq,
+                                                     guint          max_checkpoints);
+guint          gundo_sequence_get_n_checkpoints     (GundoSequence *seq );
 
 struct _GundoSequence
 {
 	GObject        base_object;
-	GArray       * actions;
 	guint          next_redo;
+	/* only a marker: NULL, or the sequence itself while a group is open,
+	 * however deeply it is nested. Never follow it, walking down with
+	 * "while (s->group) s = s->group;" loops forever. */
 	GundoSequence* group;
+
+	/*< private >*/
+	GundoSequencePrivate* priv;
 };
 
 struct _GundoActionType {
     GundoActionCallback undo;
     GundoActionCallback redo;
     GundoActionCallback free;
+    GundoActionSizeFunc size;
+    GundoActionFlags    flags;
+    GundoActionMergeFunc merge;
+    GundoActionSerializeFunc   serialize;
+    GundoActionDeserializeFunc deserialize;
+};
+
+struct _GundoActionEntry {
+    const GundoActionType *type;
+    gpointer               data;
 };
 
 G_END_DECLS
@@ -0,0 +1,444 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gundo-spill.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#define MIN_CAPACITY (1024 * 1024)
+
+/* how far below a loaded record the kernel is asked to read ahead */
+#define READ_AHEAD   (256 * 1024)
+
+/* holes smaller than this are not worth moving the bytes for */
+#define MIN_HOLE     (1024 * 1024)
+
+#define ALIGN(size) (((size) + 7) & ~(guint64) 7)
+
+/* precedes the bytes of every spilled record; the file never leaves the
+ * process, so it can name the type by its address */
+typedef struct {
+  GundoActionType const* type;
+  guint32                len;
+  guint32                is_inline;
+} SpillHeader;
+
+#define RECORD_SIZE(len) ALIGN (sizeof (SpillHeader) + (len))
+
+#define RECORD_OFFSET(data) ((guint64) GPOINTER_TO_SIZE (data))
+
+struct _GundoSpill {
+  int         fd;
+  gchar     * filename;
+  gchar     * map;
+  guint64     capacity;
+  guint64     end;
+  guint64     head;     /* nothing before this is spilled anymore */
+  guint64     stale;    /* the bytes of records loaded out of order */
+  guint64     advised;  /* read ahead has been requested from here on */
+  gsize       page_size;
+  GByteArray* buffer;
+  GError    * error;    /* the first failure, nothing gets spilled after */
+};
+
+/* placeholders are loaded back before they get undone or redone, and they
+ * don't own anything */
+GundoActionType const gundo_spill_type = {
+  .undo = NULL,
+  .redo = NULL,
+  .free = NULL
+};
+
+static void
+set_io_error (GError     ** error,
+              const gchar * filename,
+              int           saved_errno)
+{
+  g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+               "%s: %s", filename, g_strerror (saved_errno));
+}
+
+/* the file is only scratch space: it gets unlinked right away, so nothing
+ * is left behind, even after a crash */
+GundoSpill*
+gundo_spill_new (const gchar* filename,
+                 GError    ** error)
+{
+  GundoSpill* self;
+  gchar     * name = NULL;
+  int         fd;
+
+  if (filename)
+    {
+      fd = g_open (filename, O_RDWR | O_CREAT | O_TRUNC, 0600);
+      if (fd < 0)
+        {
+          set_io_error (error, filename, errno);
+          return NULL;
+        }
+      name = g_strdup (filename);
+    }
+  else
+    {
+      fd = g_file_open_tmp ("gundo-spill-XXXXXX", &name, error);
+      if (fd < 0)
+        return NULL;
+    }
+
+  g_unlink (name);
+
+  self = g_slice_new0 (GundoSpill);
+  self->fd        = fd;
+  self->filename  = name;
+  self->page_size = sysconf (_SC_PAGESIZE);
+  self->buffer    = g_byte_array_new ();
+
+  return self;
+}
+
+/* placeholders still around become invalid */
+void
+gundo_spill_free (GundoSpill* self)
+{
+  if (self->map)
+    munmap (self->map, self->capacity);
+  close (self->fd);
+
+  if (self->error)
+    g_error_free (self->error);
+  g_byte_array_free (self->buffer, TRUE);
+  g_free (self->filename);
+  g_slice_free (GundoSpill, self);
+}
+
+/* maps @capacity bytes of the file; the old mapping is only dropped once
+ * the new one is there, so a failure leaves the spilled bytes readable */
+static gboolean
+spill_resize (GundoSpill* self,
+              guint64     capacity,
+              GError   ** error)
+{
+  gchar* map;
+  int    result;
+
+  if (capacity > self->capacity)
+    {
+      /* allocate the blocks up front: running out of space while writing
+       * to the mapping would raise SIGBUS */
+      result = posix_fallocate (self->fd, self->capacity, capacity - self->capacity);
+      if (result)
+        {
+          set_io_error (error, self->filename, result);
+          return FALSE;
+        }
+    }
+
+  map = mmap (NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, self->fd, 0);
+  if (map == MAP_FAILED)
+    {
+      set_io_error (error, self->filename, errno);
+      return FALSE;
+    }
+
+  if (self->map)
+    munmap (self->map, self->capacity);
+
+  /* if this fails, the file just stays bigger than needed */
+  if (capacity < self->capacity && ftruncate (self->fd, capacity) < 0)
+    errno = 0;
+
+  self->map      = map;
+  self->capacity = capacity;
+
+  return TRUE;
+}
+
+/* moves @action into the file; returns FALSE if it stays where it is,
+ * because its type can't be (de)serialized or the file failed. The caller
+ * frees the payload @action held before */
+gboolean
+gundo_spill_add (GundoSpill* self,
+                 UndoAction* action)
+{
+  GundoActionType const* type = action->type;
+  SpillHeader            header;
+  gconstpointer          bytes;
+  gsize                  len;
+
+  if (self->error)
+    return FALSE;
+
+  if (type == &gundo_payload_arena_type)
+    {
+      header.type      = gundo_payload_arena_get_type (action->data);
+      header.is_inline = TRUE;
+      bytes = gundo_payload_arena_get_payload (action->data);
+      len   = gundo_payload_arena_get_len (action->data);
+    }
+  else if (type->serialize && type->deserialize)
+    {
+      header.type      = type;
+      header.is_inline = FALSE;
+      g_byte_array_set_size (self->buffer, 0);
+      type->serialize (action->data, self->buffer);
+      bytes = self->buffer->data;
+      len   = self->buffer->len;
+    }
+  else
+    {
+      return FALSE;
+    }
+
+  if (len > G_MAXUINT32)
+    return FALSE;
+
+  if (self->end + RECORD_SIZE (len) > self->capacity)
+    {
+      guint64 capacity = MAX (self->capacity, MIN_CAPACITY);
+
+      while (self->end + RECORD_SIZE (len) > capacity)
+        capacity *= 2;
+
+      if (!spill_resize (self, capacity, &self->error))
+        return FALSE;
+    }
+
+  header.len = len;
+  memcpy (self->map + self->end, &header, sizeof (header));
+  memcpy (self->map + self->end + sizeof (header), bytes, len);
+
+  action->type = &gundo_spill_type;
+  action->data = GSIZE_TO_POINTER (self->end);
+
+  self->end    += RECORD_SIZE (len);
+  self->advised = self->end;
+
+  return TRUE;
+}
+
+/* undoing tends to go on, so have the kernel start reading the records
+ * below @offset; it does that in the background */
+static void
+spill_read_ahead (GundoSpill* self,
+                  guint64     offset)
+{
+  guint64 low;
+
+  if (offset >= self->advised + READ_AHEAD / 2)
+    return;
+
+  low = offset > READ_AHEAD ? offset - READ_AHEAD : 0;
+  low -= low % self->page_size;
+
+  if (low < self->advised)
+    posix_madvise (self->map + low, self->advised - low, POSIX_MADV_WILLNEED);
+
+  self->advised = low;
+}
+
+/* keeps the marks within the end of the file after it moved down */
+static void
+spill_trim (GundoSpill* self)
+{
+  if (self->end <= self->head)
+    self->end = self->head = 0;
+  self->stale   = MIN (self->stale, self->end - self->head);
+  self->advised = MIN (self->advised, self->end);
+}
+
+/* turns the placeholder @action back into the real record, like
+ * gundo_history_file_materialize() does; if the action can't be
+ * deserialized, @action stays a placeholder and its bytes stay in the file */
+gboolean
+gundo_spill_load (GundoSpill       * self,
+                  GundoPayloadArena* payloads,
+                  UndoAction       * action,
+                  GError          ** error)
+{
+  guint64       offset = RECORD_OFFSET (action->data);
+  SpillHeader   header;
+  gconstpointer bytes = self->map + offset + sizeof (header);
+
+  spill_read_ahead (self, offset);
+
+  memcpy (&header, self->map + offset, sizeof (header));
+  if (header.is_inline)
+    {
+      action->type = &gundo_payload_arena_type;
+      action->data = gundo_payload_arena_add (payloads, header.type, bytes, header.len);
+    }
+  else
+    {
+      gpointer data = header.type->deserialize (bytes, header.len);
+
+      if (!data)
+        {
+          g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                               "a spilled undo action can't be deserialized");
+          return FALSE;
+        }
+
+      action->type = header.type;
+      action->data = data;
+    }
+
+  /* records are loaded back from the newest one down, unless a jump left
+   * some of them behind on the redo side */
+  if (offset + RECORD_SIZE (header.len) == self->end)
+    self->end = offset;
+  else
+    self->stale += RECORD_SIZE (header.len);
+  spill_trim (self);
+
+  return TRUE;
+}
+
+/* notes that the records [@index, @index + @n_actions) of @store, the
+ * newest ones, are about to be discarded; the file ends in front of them
+ * afterwards */
+void
+gundo_spill_truncate (GundoSpill      * self,
+                      GundoActionStore* store,
+                      guint             index,
+                      guint             n_actions)
+{
+  guint i;
+
+  for (i = index; i < index + n_actions; i++)
+    {
+      UndoAction const* action = gundo_action_store_index (store, i);
+
+      if (action->type == &gundo_spill_type)
+        {
+          self->end = MIN (self->end, RECORD_OFFSET (action->data));
+          break;
+        }
+    }
+  spill_trim (self);
+}
+
+/* notes that the records [@index, @index + @n_actions) of @store, the
+ * oldest ones, are about to be discarded. This doesn't touch the file, so
+ * the hole they leave is only known up to the size of the last one. */
+void
+gundo_spill_forget (GundoSpill      * self,
+                    GundoActionStore* store,
+                    guint             index,
+                    guint             n_actions)
+{
+  guint i;
+
+  for (i = index + n_actions; i > index; i--)
+    {
+      UndoAction const* action = gundo_action_store_index (store, i - 1);
+
+      if (action->type == &gundo_spill_type)
+        {
+          self->head = MAX (self->head, RECORD_OFFSET (action->data));
+          break;
+        }
+    }
+  spill_trim (self);
+}
+
+/* closes the holes left by discarded records and by the ones loaded out
+ * of order once they take up more of the file than the records left,
+ * which all have to be among the first @n_actions records of @store */
+void
+gundo_spill_compact (GundoSpill      * self,
+                     GundoActionStore* store,
+                     guint             n_actions)
+{
+  guint64 capacity = self->capacity;
+  guint64 cursor = 0;
+  guint   i;
+
+  if (self->head + self->stale < MAX (self->end - self->head - self->stale, MIN_HOLE))
+    return;
+
+  /* the records are in the file in the order of the store, so this only
+   * moves them down */
+  for (i = 0; i < n_actions; i++)
+    {
+      UndoAction * action = gundo_action_store_index (store, i);
+      guint64      offset;
+      SpillHeader  header;
+
+      if (action->type != &gundo_spill_type)
+        continue;
+
+      offset = RECORD_OFFSET (action->data);
+      memcpy (&header, self->map + offset, sizeof (header));
+      if (offset != cursor)
+        memmove (self->map + cursor, self->map + offset, RECORD_SIZE (header.len));
+      action->data = GSIZE_TO_POINTER (cursor);
+      cursor += RECORD_SIZE (header.len);
+    }
+
+  self->end     = cursor;
+  self->head    = 0;
+  self->stale   = 0;
+  self->advised = cursor;
+
+  while (capacity / 2 >= MIN_CAPACITY && capacity / 2 >= 2 * self->end)
+    capacity /= 2;
+  if (capacity < self->capacity)
+    spill_resize (self, capacity, NULL);
+}
+
+/* reports the first failure of @self */
+gboolean
+gundo_spill_get_error (GundoSpill* self,
+                       GError   ** error)
+{
+  if (!self->error)
+    return TRUE;
+
+  g_propagate_error (error, g_error_copy (self->error));
+  return FALSE;
+}
+
+/* looks into a spilled record without loading it */
+gconstpointer
+gundo_spill_get_record (GundoSpill            * self,
+                        gpointer                record_data,
+                        GundoActionType const** type,
+                        gboolean              * is_inline,
+                        gsize                 * len)
+{
+  guint64     offset = RECORD_OFFSET (record_data);
+  SpillHeader header;
+
+  memcpy (&header, self->map + offset, sizeof (header));
+  *type      = header.type;
+  *is_inline = header.is_inline;
+  *len       = header.len;
+
+  return self->map + offset + sizeof (header);
+}
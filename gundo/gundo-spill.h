@@ -0,0 +1,85 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GUNDO_SPILL_H
+#define GUNDO_SPILL_H
+
+#include "gundo-action-store.h"
+#include "gundo-payload-arena.h"
+
+G_BEGIN_DECLS
+
+/* The spill keeps the payloads of cold undoable actions in a shared
+ * mapping of a scratch file, so they are backed by the file rather than by
+ * the heap. A spilled record gets the placeholder type gundo_spill_type,
+ * whose data is the offset of its bytes in the file, behind a small header
+ * naming the real type; the record is all it costs in memory until it is
+ * loaded back.
+ *
+ * The sequence spills its oldest steps first and loads them back from the
+ * newest one down, so the bytes in the file are ordered like the records
+ * and loading a step back just moves the end of the file down again. What
+ * gets evicted leaves a hole at the start, which is closed by moving the
+ * remaining bytes down once it is bigger than they are.
+ *
+ * Restoring a checkpoint jumps over steps without loading them, so spilled
+ * records can end up on the redo side, where they get loaded oldest
+ * first. Their bytes count as a hole too. The sequence doesn't spill more
+ * while any of them are left, which keeps the file ordered like the
+ * records. */
+
+typedef struct _GundoSpill GundoSpill;
+
+extern GundoActionType const gundo_spill_type;
+
+GundoSpill*   gundo_spill_new        (const gchar           * filename,
+                                      GError               ** error);
+void          gundo_spill_free       (GundoSpill            * self);
+gboolean      gundo_spill_add        (GundoSpill            * self,
+                                      UndoAction            * action);
+gboolean      gundo_spill_load       (GundoSpill            * self,
+                                      GundoPayloadArena     * payloads,
+                                      UndoAction            * action,
+                                      GError               ** error);
+void          gundo_spill_forget     (GundoSpill            * self,
+                                      GundoActionStore      * store,
+                                      guint                   index,
+                                      guint                   n_actions);
+void          gundo_spill_truncate   (GundoSpill            * self,
+                                      GundoActionStore      * store,
+                                      guint                   index,
+                                      guint                   n_actions);
+void          gundo_spill_compact    (GundoSpill            * self,
+                                      GundoActionStore      * store,
+                                      guint                   n_actions);
+gboolean      gundo_spill_get_error  (GundoSpill            * self,
+                                      GError               ** error);
+gconstpointer gundo_spill_get_record (GundoSpill            * self,
+                                      gpointer                record_data,
+                                      GundoActionType const** type,
+                                      gboolean              * is_inline,
+                                      gsize                 * len);
+
+G_END_DECLS
+
+#endif /* !GUNDO_SPILL_H */
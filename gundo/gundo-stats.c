@@ -0,0 +1,159 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gundo-stats.h"
+
+#include <time.h>
+
+typedef struct {
+  GundoActionStats ops[GUNDO_ACTION_N_OPS];
+} TypeStats;
+
+struct _GundoStats {
+  GHashTable* types; /* GundoActionType* => TypeStats* */
+};
+
+static void
+type_stats_free (gpointer data)
+{
+  g_slice_free (TypeStats, data);
+}
+
+GundoStats*
+gundo_stats_new (void)
+{
+  GundoStats* self = g_slice_new (GundoStats);
+
+  self->types = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                       NULL, type_stats_free);
+
+  return self;
+}
+
+void
+gundo_stats_free (GundoStats* self)
+{
+  g_hash_table_destroy (self->types);
+  g_slice_free (GundoStats, self);
+}
+
+void
+gundo_stats_reset (GundoStats* self)
+{
+  g_hash_table_remove_all (self->types);
+}
+
+/* bucket i counts the latencies in [2^i, 2^(i+1)) ns, the first one
+ * includes 0 and the last one everything beyond */
+static guint
+histogram_bucket (guint64 ns)
+{
+  guint bucket = 0;
+
+  while (ns > 1 && bucket < GUNDO_ACTION_STATS_N_BUCKETS - 1)
+    {
+      ns >>= 1;
+      bucket++;
+    }
+
+  return bucket;
+}
+
+/* adds a call that took @ns to @stats */
+void
+gundo_stats_add (GundoActionStats* stats,
+                 guint64           ns)
+{
+  stats->n_calls++;
+  stats->total_ns += ns;
+  if (ns > stats->max_ns)
+    stats->max_ns = ns;
+  stats->histogram[histogram_bucket (ns)]++;
+}
+
+void
+gundo_stats_record (GundoStats           * self,
+                    GundoActionType const* type,
+                    GundoActionOp          op,
+                    guint64                ns)
+{
+  TypeStats* type_stats = g_hash_table_lookup (self->types, type);
+
+  if (!type_stats)
+    {
+      type_stats = g_slice_new0 (TypeStats);
+      g_hash_table_insert (self->types, (gpointer) type, type_stats);
+    }
+
+  gundo_stats_add (&type_stats->ops[op], ns);
+}
+
+gboolean
+gundo_stats_lookup (GundoStats           * self,
+                    GundoActionType const* type,
+                    GundoActionOp          op,
+                    GundoActionStats     * stats)
+{
+  TypeStats* type_stats = g_hash_table_lookup (self->types, type);
+
+  if (!type_stats || !type_stats->ops[op].n_calls)
+    return FALSE;
+
+  *stats = type_stats->ops[op];
+  return TRUE;
+}
+
+void
+gundo_stats_foreach (GundoStats         * self,
+                     GundoActionStatsFunc func,
+                     gpointer             user_data)
+{
+  GHashTableIter iter;
+  gpointer       type;
+  gpointer       type_stats;
+
+  g_hash_table_iter_init (&iter, self->types);
+  while (g_hash_table_iter_next (&iter, &type, &type_stats))
+    {
+      guint op;
+
+      for (op = 0; op < GUNDO_ACTION_N_OPS; op++)
+        {
+          GundoActionStats* stats = &((TypeStats*) type_stats)->ops[op];
+
+          if (stats->n_calls)
+            func (type, op, stats, user_data);
+        }
+    }
+}
+
+/* a monotonic clock with nanosecond resolution */
+guint64
+gundo_stats_now (void)
+{
+  struct timespec now;
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+
+  return (guint64) now.tv_sec * G_GUINT64_CONSTANT (1000000000) + now.tv_nsec;
+}
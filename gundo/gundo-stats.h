@@ -0,0 +1,58 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GUNDO_STATS_H
+#define GUNDO_STATS_H
+
+#include <gundo-sequence.h>
+
+G_BEGIN_DECLS
+
+/* The stats collect the per-type instrumentation of a GundoSequence: call
+ * counts, latencies and a log2 latency histogram for each operation. They
+ * are only touched from the main thread. */
+
+typedef struct _GundoStats GundoStats;
+
+GundoStats* gundo_stats_new     (void);
+void        gundo_stats_free    (GundoStats            * self);
+void        gundo_stats_reset   (GundoStats            * self);
+void        gundo_stats_add     (GundoActionStats      * stats,
+                                 guint64                 ns);
+void        gundo_stats_record  (GundoStats            * self,
+                                 GundoActionType const * type,
+                                 GundoActionOp           op,
+                                 guint64                 ns);
+gboolean    gundo_stats_lookup  (GundoStats            * self,
+                                 GundoActionType const * type,
+                                 GundoActionOp           op,
+                                 GundoActionStats      * stats);
+void        gundo_stats_foreach (GundoStats            * self,
+                                 GundoActionStatsFunc    func,
+                                 gpointer                user_data);
+
+guint64     gundo_stats_now     (void);
+
+G_END_DECLS
+
+#endif /* !GUNDO_STATS_H */
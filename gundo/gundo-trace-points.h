@@ -0,0 +1,58 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GUNDO_TRACE_POINTS_H
+#define GUNDO_TRACE_POINTS_H
+
+#include "gundo-stats.h"
+
+G_BEGIN_DECLS
+
+/* Trace points record a span into the trace ring of gundo-trace.c while a
+ * trace is running. Without one, a trace point costs a predicted branch:
+ *
+ *   guint64 start = GUNDO_TRACE_BEGIN ();
+ *   ...
+ *   GUNDO_TRACE_END ("undo", self, 0, 0, start);
+ *
+ * The arguments of GUNDO_TRACE_END() are only evaluated if the span began
+ * while the trace was running. */
+
+extern gint gundo_trace_running;
+
+void gundo_trace_event (gchar const * name,
+                        gconstpointer seq,
+                        guint         depth,
+                        guint         n_actions,
+                        guint64       start);
+
+#define GUNDO_TRACE_BEGIN() (G_UNLIKELY (g_atomic_int_get (&gundo_trace_running)) ? gundo_stats_now () : 0)
+
+#define GUNDO_TRACE_END(name, seq, depth, n_actions, start) G_STMT_START { \
+  if (G_UNLIKELY (start))                                                  \
+    gundo_trace_event ((name), (seq), (depth), (n_actions), (start));      \
+} G_STMT_END
+
+G_END_DECLS
+
+#endif /* !GUNDO_TRACE_POINTS_H */
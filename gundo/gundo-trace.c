@@ -0,0 +1,401 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *     Sven Herzberg  <herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+/**
+ * SECTION:gundotrace
+ * @short_description: timeline of history operations
+ *
+ * While a trace is running, libgundo records a span for each operation on
+ * a history into a ring buffer: adding actions, building groups, undo and
+ * redo (both with and without the signal handlers connected to them),
+ * truncating the redo tail and the change notifications. Each span carries
+ * the sequence it belongs to and the group nesting depth.
+ *
+ * The ring can be written to a file in the Chrome trace event format with
+ * gundo_trace_dump(), to be loaded into chrome://tracing or Perfetto. For
+ * long sessions, gundo_trace_set_watermark() streams the ring to a file
+ * whenever it fills up to a watermark.
+ *
+ * Operations of all threads are traced, each span carries the id of the
+ * thread that recorded it.
+ */
+
+#include <gundo/gundo-trace.h>
+#include "gundo-trace-points.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#define DEFAULT_CAPACITY 65536
+
+typedef struct {
+  gchar const * name;
+  gconstpointer seq;
+  guint64       start;
+  guint64       end;
+  guint         depth;
+  guint         n_actions;
+  guint         tid;
+} TraceEvent;
+
+/* only read with g_atomic_int_get(), see GUNDO_TRACE_BEGIN() */
+gint gundo_trace_running = FALSE;
+
+/* protects the ring and the watermark file, which are shared by all
+ * threads */
+static GMutex      trace_mutex;
+
+/* the ring holds the @ring_len latest events, starting at @ring_first */
+static TraceEvent* ring = NULL;
+static guint       ring_capacity = 0;
+static guint       ring_first = 0;
+static guint       ring_len = 0;
+
+static guint       ring_watermark = 0;
+static FILE      * watermark_file = NULL;
+static gchar     * watermark_filename = NULL;
+static guint64     watermark_n_written = 0;
+
+/* the id of the current thread, offset by one so 0 means unknown */
+static GPrivate    trace_tid = G_PRIVATE_INIT (NULL);
+#ifndef __linux__
+static gint        trace_n_threads = 0;
+#endif
+
+static guint
+trace_get_tid (void)
+{
+  guint tid = GPOINTER_TO_UINT (g_private_get (&trace_tid));
+
+  if (G_UNLIKELY (!tid))
+    {
+#ifdef __linux__
+      tid = (guint) syscall (SYS_gettid) + 1;
+#else
+      tid = (guint) g_atomic_int_add (&trace_n_threads, 1) + 2;
+#endif
+      g_private_set (&trace_tid, GUINT_TO_POINTER (tid));
+    }
+
+  return tid - 1;
+}
+
+/* writes @string as a JSON string literal */
+static void
+trace_write_string (FILE       * file,
+                    gchar const* string)
+{
+  gchar const* c;
+
+  fputc ('"', file);
+  for (c = string; *c; c++)
+    {
+      if (*c == '"' || *c == '\\')
+        fprintf (file, "\\%c", *c);
+      else if ((guchar) *c < 0x20)
+        fprintf (file, "\\u%04x", (guint) (guchar) *c);
+      else
+        fputc (*c, file);
+    }
+  fputc ('"', file);
+}
+
+static void
+trace_write_event (FILE            * file,
+                   TraceEvent const* event,
+                   gboolean          first)
+{
+  fputs (first ? "{\"name\":" : ",\n{\"name\":", file);
+  trace_write_string (file, event->name);
+  fprintf (file,
+           ",\"cat\":\"gundo\",\"ph\":\"X\","
+           "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u,"
+           "\"args\":{\"seq\":\"%p\",\"depth\":%u",
+           event->start / 1000.0,
+           (event->end - event->start) / 1000.0,
+           (int) getpid (),
+           event->tid,
+           event->seq,
+           event->depth);
+  if (event->n_actions)
+    fprintf (file, ",\"actions\":%u", event->n_actions);
+  fputs ("}}", file);
+}
+
+/* writes the events in the ring, the first one with a leading separator
+ * unless @first */
+static void
+trace_write_ring (FILE   * file,
+                  gboolean first)
+{
+  guint i;
+
+  for (i = 0; i < ring_len; i++)
+    {
+      trace_write_event (file, &ring[(ring_first + i) % ring_capacity], first);
+      first = FALSE;
+    }
+}
+
+static gboolean
+trace_set_file_error (GError     **error,
+                      gchar const* filename)
+{
+  int saved_errno = errno;
+
+  g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+               "Could not write the trace to %s: %s",
+               filename, g_strerror (saved_errno));
+
+  return FALSE;
+}
+
+/* moves the ring over to the watermark file */
+static void
+trace_flush_watermark (void)
+{
+  trace_write_ring (watermark_file, !watermark_n_written);
+  watermark_n_written += ring_len;
+  ring_len = 0;
+
+  if (fflush (watermark_file))
+    {
+      g_warning ("Could not write the trace to %s: %s",
+                 watermark_filename, g_strerror (errno));
+    }
+}
+
+static void
+trace_close_watermark (void)
+{
+  if (!watermark_file)
+    return;
+
+  if (ring_len)
+    trace_flush_watermark ();
+
+  fputs ("\n]\n", watermark_file);
+  fclose (watermark_file);
+  watermark_file = NULL;
+
+  g_free (watermark_filename);
+  watermark_filename = NULL;
+  ring_watermark = 0;
+}
+
+void
+gundo_trace_event (gchar const * name,
+                   gconstpointer seq,
+                   guint         depth,
+                   guint         n_actions,
+                   guint64       start)
+{
+  TraceEvent* event;
+  guint64     end = gundo_stats_now ();
+  guint       tid = trace_get_tid ();
+
+  g_mutex_lock (&trace_mutex);
+
+  /* the trace might have been stopped within the span */
+  if (!gundo_trace_running)
+    {
+      g_mutex_unlock (&trace_mutex);
+      return;
+    }
+
+  if (ring_len == ring_capacity)
+    {
+      /* drop the oldest event */
+      ring_first = (ring_first + 1) % ring_capacity;
+      ring_len--;
+    }
+
+  event = &ring[(ring_first + ring_len) % ring_capacity];
+  event->name      = name;
+  event->seq       = seq;
+  event->start     = start;
+  event->end       = end;
+  event->depth     = depth;
+  event->n_actions = n_actions;
+  event->tid       = tid;
+  ring_len++;
+
+  if (ring_watermark && ring_len >= ring_watermark)
+    trace_flush_watermark ();
+
+  g_mutex_unlock (&trace_mutex);
+}
+
+/**
+ * gundo_trace_start:
+ * @capacity: the number of events to keep, 0 for the default
+ *
+ * Start recording a trace into a ring buffer for @capacity events. Once the
+ * ring is full, the oldest events are dropped. Events that were recorded
+ * before are discarded, and a watermark file that is still open gets the
+ * remaining events and is closed, see gundo_trace_set_watermark().
+ */
+void
+gundo_trace_start (guint capacity)
+{
+  if (!capacity)
+    capacity = DEFAULT_CAPACITY;
+
+  g_mutex_lock (&trace_mutex);
+
+  trace_close_watermark ();
+
+  if (capacity != ring_capacity)
+    {
+      g_free (ring);
+      ring = g_new (TraceEvent, capacity);
+      ring_capacity = capacity;
+    }
+
+  ring_first = 0;
+  ring_len = 0;
+  g_atomic_int_set (&gundo_trace_running, TRUE);
+
+  g_mutex_unlock (&trace_mutex);
+}
+
+/**
+ * gundo_trace_stop:
+ *
+ * Stop recording the trace. The events recorded so far can still be
+ * written with gundo_trace_dump(). A watermark file gets the remaining
+ * events and is closed, see gundo_trace_set_watermark().
+ */
+void
+gundo_trace_stop (void)
+{
+  g_mutex_lock (&trace_mutex);
+  g_atomic_int_set (&gundo_trace_running, FALSE);
+  trace_close_watermark ();
+  g_mutex_unlock (&trace_mutex);
+}
+
+/**
+ * gundo_trace_is_running:
+ *
+ * Get whether a trace is being recorded.
+ *
+ * Returns: %TRUE between gundo_trace_start() and gundo_trace_stop().
+ */
+gboolean
+gundo_trace_is_running (void)
+{
+  return g_atomic_int_get (&gundo_trace_running);
+}
+
+/**
+ * gundo_trace_dump:
+ * @filename: the file to write
+ * @error: return location for a #GError, or %NULL
+ *
+ * Write the events in the ring to @filename in the Chrome trace event
+ * format. The events stay in the ring.
+ *
+ * Returns: %TRUE on success, %FALSE if @error was set.
+ */
+gboolean
+gundo_trace_dump (gchar const* filename,
+                  GError     **error)
+{
+  FILE* file;
+
+  g_return_val_if_fail (filename, FALSE);
+  g_return_val_if_fail (!error || !*error, FALSE);
+
+  file = fopen (filename, "w");
+  if (!file)
+    return trace_set_file_error (error, filename);
+
+  fputs ("[\n", file);
+  g_mutex_lock (&trace_mutex);
+  trace_write_ring (file, TRUE);
+  g_mutex_unlock (&trace_mutex);
+  fputs ("\n]\n", file);
+
+  if (fclose (file))
+    return trace_set_file_error (error, filename);
+
+  return TRUE;
+}
+
+/**
+ * gundo_trace_set_watermark:
+ * @watermark: the number of events that trigger a write, 0 to turn it off
+ * @filename: the file to write, can be %NULL if @watermark is 0
+ * @error: return location for a #GError, or %NULL
+ *
+ * Stream the trace to @filename: whenever the ring holds @watermark events,
+ * they are appended to @filename and dropped from the ring. @watermark
+ * should be at most the capacity of the ring, so no events get lost. The
+ * file is a valid trace at any time, as the closing bracket of the Chrome
+ * trace format is optional; it is written once the file is closed by
+ * gundo_trace_stop() or by changing the watermark.
+ *
+ * Returns: %TRUE on success, %FALSE if @filename could not be opened.
+ */
+gboolean
+gundo_trace_set_watermark (guint        watermark,
+                           gchar const* filename,
+                           GError     **error)
+{
+  g_return_val_if_fail (!watermark || filename, FALSE);
+  g_return_val_if_fail (!error || !*error, FALSE);
+
+  g_mutex_lock (&trace_mutex);
+
+  trace_close_watermark ();
+
+  if (!watermark)
+    {
+      g_mutex_unlock (&trace_mutex);
+      return TRUE;
+    }
+
+  watermark_file = fopen (filename, "w");
+  if (!watermark_file)
+    {
+      g_mutex_unlock (&trace_mutex);
+      return trace_set_file_error (error, filename);
+    }
+
+  fputs ("[\n", watermark_file);
+  ring_watermark = watermark;
+  watermark_filename = g_strdup (filename);
+  watermark_n_written = 0;
+
+  if (ring_len >= ring_watermark)
+    trace_flush_watermark ();
+
+  g_mutex_unlock (&trace_mutex);
+
+  return TRUE;
+}
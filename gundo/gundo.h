@@ -23,6 +23,7 @@
 #include <gundo-history.h>
 #include <gundo-history-view.h>
 #include <gundo-sequence.h>
+#include <gundo-trace.h>
 
 #endif /* !GUNDO_H */
 
@@ -0,0 +1,733 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *	Sven Herzberg		<herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+/* Runs the benchmarks of the history engine and prints one line per
+ * measurement, tab separated:
+ *
+ *   benchmark  actions  ns_per_op  allocs_per_op  peak_rss_kib
+ *
+ * Each workload runs in a process of its own, so the peak RSS belongs to
+ * that workload alone. Allocations are only counted where malloc() can be
+ * interposed (glibc); elsewhere they are reported as -1.
+ *
+ * Usage: gundo-bench [--max-actions=N] [WORKLOAD...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <gundo.h>
+
+#ifdef __GLIBC__
+#include <errno.h>
+#include <malloc.h>
+
+/* count every allocation made by the benchmark; the journal writes from
+ * a thread of its own, so the counter is updated atomically */
+static guint64 n_allocs = 0;
+
+static inline void count_alloc( void ) {
+    __atomic_fetch_add( &n_allocs, 1, __ATOMIC_RELAXED );
+}
+
+static inline guint64 get_allocs( void ) {
+    return __atomic_load_n( &n_allocs, __ATOMIC_RELAXED );
+}
+
+extern void* __libc_malloc( size_t size );
+extern void* __libc_calloc( size_t n, size_t size );
+extern void* __libc_realloc( void* mem, size_t size );
+extern void* __libc_memalign( size_t alignment, size_t size );
+
+void* malloc( size_t size ) {
+    count_alloc();
+    return __libc_malloc( size );
+}
+
+void* calloc( size_t n, size_t size ) {
+    count_alloc();
+    return __libc_calloc( n, size );
+}
+
+void* realloc( void* mem, size_t size ) {
+    count_alloc();
+    return __libc_realloc( mem, size );
+}
+
+void* memalign( size_t alignment, size_t size ) {
+    count_alloc();
+    return __libc_memalign( alignment, size );
+}
+
+int posix_memalign( void** mem, size_t alignment, size_t size ) {
+    count_alloc();
+    *mem = __libc_memalign( alignment, size );
+    return *mem ? 0 : ENOMEM;
+}
+
+#define ALLOCS_SUPPORTED TRUE
+#else
+#define get_allocs() ((guint64) 0)
+#define ALLOCS_SUPPORTED FALSE
+#endif
+
+static void nop( gpointer p ) {}
+
+static GundoActionType bench_action = { .undo = nop, .redo = nop };
+
+typedef struct {
+    gint64  start;
+    guint64 allocs;
+} Measurement;
+
+static void measure_start( Measurement *m ) {
+    m->allocs = get_allocs();
+    m->start = g_get_monotonic_time();
+}
+
+static void measure_report( Measurement *m, const char *name, guint64 n_actions, guint64 n_ops ) {
+    gint64 elapsed = g_get_monotonic_time() - m->start;
+    guint64 allocs = get_allocs() - m->allocs;
+    struct rusage usage;
+
+    getrusage( RUSAGE_SELF, &usage );
+
+    printf( "%s\t%" G_GUINT64_FORMAT "\t%.1f\t", name, n_actions, elapsed * 1000.0 / n_ops );
+    if( ALLOCS_SUPPORTED ) {
+        printf( "%.4f", (double) allocs / n_ops );
+    } else {
+        printf( "-1" );
+    }
+    printf( "\t%ld\n", usage.ru_maxrss );
+    fflush( stdout );
+}
+
+static void add_actions( GundoSequence *seq, guint64 n_actions ) {
+    guint64 i;
+
+    for( i = 0; i < n_actions; i++ ) {
+        gundo_sequence_add_action( seq, &bench_action, NULL );
+    }
+}
+
+/* the life cycle of a flat history: recording, undoing and redoing all of
+ * it, dropping it as a redo tail and freeing it with the sequence */
+static void bench_lifecycle( guint64 n_actions ) {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory *history = GUNDO_HISTORY(seq);
+    Measurement m;
+    guint64 i;
+
+    measure_start( &m );
+    add_actions( seq, n_actions );
+    measure_report( &m, "add", n_actions, n_actions );
+
+    measure_start( &m );
+    for( i = 0; i < n_actions; i++ ) {
+        gundo_history_undo( history );
+    }
+    measure_report( &m, "undo", n_actions, n_actions );
+
+    measure_start( &m );
+    for( i = 0; i < n_actions; i++ ) {
+        gundo_history_redo( history );
+    }
+    measure_report( &m, "redo", n_actions, n_actions );
+
+    gundo_history_undo_n( history, n_actions );
+    measure_start( &m );
+    gundo_sequence_add_action( seq, &bench_action, NULL );
+    measure_report( &m, "truncate", n_actions, n_actions );
+
+    add_actions( seq, n_actions - 1 );
+    measure_start( &m );
+    g_object_unref(G_OBJECT(seq));
+    measure_report( &m, "finalize", n_actions, n_actions );
+}
+
+/* recording, undoing and redoing groups that nest three levels deep with
+ * ten actions in each of the innermost ones */
+static void bench_groups( guint64 n_actions ) {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory *history = GUNDO_HISTORY(seq);
+    Measurement m;
+    guint64 i;
+    guint n_steps;
+
+    measure_start( &m );
+    for( i = 0; i < n_actions; i += 10 ) {
+        if( i % 1000 == 0 ) {
+            gundo_sequence_start_group( seq );
+        }
+        if( i % 100 == 0 ) {
+            gundo_sequence_start_group( seq );
+        }
+        gundo_sequence_start_group( seq );
+        add_actions( seq, 10 );
+        gundo_sequence_end_group( seq );
+        if( (i + 10) % 100 == 0 || i + 10 >= n_actions ) {
+            gundo_sequence_end_group( seq );
+        }
+        if( (i + 10) % 1000 == 0 || i + 10 >= n_actions ) {
+            gundo_sequence_end_group( seq );
+        }
+    }
+    measure_report( &m, "groups-add", n_actions, n_actions );
+
+    n_steps = gundo_history_get_position( history );
+    measure_start( &m );
+    gundo_history_undo_n( history, n_steps );
+    measure_report( &m, "groups-undo", n_actions, n_actions );
+
+    measure_start( &m );
+    gundo_history_redo_n( history, n_steps );
+    measure_report( &m, "groups-redo", n_actions, n_actions );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+/* adding inside groups that nest 1, 30 and @max_depth levels deep */
+static void bench_nested( guint64 max_depth ) {
+    guint64 depths[] = { 1, 30, max_depth };
+    guint n_adds = 1000000;
+    guint i;
+
+    for( i = 0; i < G_N_ELEMENTS(depths); i++ ) {
+        GundoSequence *seq = gundo_sequence_new();
+        gchar *name = g_strdup_printf( "add-depth-%" G_GUINT64_FORMAT, depths[i] );
+        Measurement m;
+        guint64 j;
+
+        for( j = 0; j < depths[i]; j++ ) {
+            gundo_sequence_start_group( seq );
+        }
+
+        measure_start( &m );
+        add_actions( seq, n_adds );
+        measure_report( &m, name, n_adds, n_adds );
+
+        for( j = 0; j < depths[i]; j++ ) {
+            gundo_sequence_end_group( seq );
+        }
+        g_free( name );
+        g_object_unref(G_OBJECT(seq));
+    }
+}
+
+/* adding @n_actions steps with gundo_sequence_add_actions() */
+static void bench_batch( guint64 n_actions ) {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoActionEntry *entries = g_new( GundoActionEntry, n_actions );
+    Measurement m;
+    guint64 i;
+
+    for( i = 0; i < n_actions; i++ ) {
+        entries[i].type = &bench_action;
+        entries[i].data = NULL;
+    }
+
+    measure_start( &m );
+    gundo_sequence_add_actions( seq, entries, n_actions, FALSE );
+    measure_report( &m, "add-batch", n_actions, n_actions );
+
+    g_free( entries );
+    g_object_unref(G_OBJECT(seq));
+}
+
+/* the cost of adding to a full history of the given depth */
+static void bench_add_full( guint64 depth ) {
+    GundoSequence *seq = g_object_new(GUNDO_TYPE_SEQUENCE, "max-depth", (guint) depth, NULL);
+    Measurement m;
+    guint n_adds = 2000000;
+
+    add_actions( seq, depth );
+
+    measure_start( &m );
+    add_actions( seq, n_adds );
+    measure_report( &m, "add-full", depth, n_adds );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void on_history_event( gpointer history, gpointer data ) {
+    (*(guint*)data)++;
+}
+
+static void on_history_notify( gpointer history, gpointer pspec, gpointer data ) {
+    (*(guint*)data)++;
+}
+
+/* jumping the whole history back and forth, with a view listening; ns/op
+ * is per step */
+static void bench_jump( guint64 n_steps ) {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory *history = GUNDO_HISTORY(seq);
+    guint n_jumps = MAX( 1, 1000000 / n_steps );
+    guint n_events = 0;
+    Measurement m;
+    guint64 i, j;
+
+    add_actions( seq, n_steps );
+    g_signal_connect( seq, "changed", G_CALLBACK(on_history_event), &n_events );
+    g_signal_connect( seq, "undo", G_CALLBACK(on_history_event), &n_events );
+    g_signal_connect( seq, "redo", G_CALLBACK(on_history_event), &n_events );
+    g_signal_connect( seq, "notify", G_CALLBACK(on_history_notify), &n_events );
+
+    measure_start( &m );
+    for( i = 0; i < n_jumps; i++ ) {
+        for( j = 0; j < n_steps; j++ ) {
+            gundo_history_undo( history );
+        }
+        for( j = 0; j < n_steps; j++ ) {
+            gundo_history_redo( history );
+        }
+    }
+    measure_report( &m, "jump-signals", n_steps, 2 * n_steps * n_jumps );
+
+    measure_start( &m );
+    for( i = 0; i < n_jumps; i++ ) {
+        gundo_history_undo_n( history, n_steps );
+        gundo_history_redo_n( history, n_steps );
+    }
+    measure_report( &m, "jump-n", n_steps, 2 * n_steps * n_jumps );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+/* switching back and forth between two branches that fork 10 steps below
+ * their tips; ns/op is per switch and shouldn't depend on the length of the
+ * shared history */
+static void bench_branches( guint64 n_actions ) {
+    GundoSequence *seq = g_object_new( GUNDO_TYPE_SEQUENCE, "branching", TRUE, NULL );
+    GundoHistory *history = GUNDO_HISTORY(seq);
+    guint n_switches = 100000;
+    guint first, second;
+    Measurement m;
+    guint i;
+
+    add_actions( seq, MAX( n_actions, 10 ) );
+    first = gundo_sequence_get_branch( seq );
+    gundo_history_undo_n( history, 10 );
+    add_actions( seq, 10 );
+    second = gundo_sequence_get_branch( seq );
+
+    measure_start( &m );
+    for( i = 0; i < n_switches; i += 2 ) {
+        gundo_sequence_switch_branch( seq, first );
+        gundo_sequence_switch_branch( seq, second );
+    }
+    measure_report( &m, "switch-branch", n_actions, n_switches );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static guint8 file_payload[256];
+
+static void serialize_payload( gpointer p, GByteArray *buffer ) {
+    g_byte_array_append( buffer, file_payload, sizeof(file_payload) );
+}
+
+/* the actions don't need their payload back, but NULL would report it as
+ * damaged */
+static gpointer deserialize_payload( gconstpointer bytes, gsize len ) {
+    return (gpointer) file_payload;
+}
+
+static GundoActionType bench_file_action = { .undo = nop, .redo = nop,
+                                             .serialize = serialize_payload,
+                                             .deserialize = deserialize_payload };
+
+/* saving a history with 256 byte payloads, loading it back and undoing
+ * part of it; loading should only cost the index, no matter how big the
+ * payloads are */
+static void bench_history_file( guint64 n_actions ) {
+    const GundoActionType *types[] = { &bench_file_action };
+    GundoSequence *seq = gundo_sequence_new();
+    guint n_undos = 1000;
+    gchar *filename;
+    Measurement m;
+    guint64 i;
+    int fd;
+
+    filename = g_build_filename( g_get_tmp_dir(), "gundo-bench-XXXXXX", NULL );
+    fd = g_mkstemp( filename );
+    if( fd < 0 ) {
+        perror( filename );
+        exit(1);
+    }
+    close( fd );
+
+    for( i = 0; i < n_actions; i++ ) {
+        gundo_sequence_add_action( seq, &bench_file_action, NULL );
+    }
+    measure_start( &m );
+    if( !gundo_sequence_save( seq, filename, types, 1, NULL ) ) {
+        exit(1);
+    }
+    measure_report( &m, "file-save", n_actions, n_actions );
+    g_object_unref(G_OBJECT(seq));
+
+    seq = gundo_sequence_new();
+    measure_start( &m );
+    if( !gundo_sequence_load( seq, filename, types, 1, NULL ) ) {
+        exit(1);
+    }
+    measure_report( &m, "file-load", n_actions, n_actions );
+
+    measure_start( &m );
+    gundo_history_undo_n( GUNDO_HISTORY(seq), n_undos );
+    measure_report( &m, "file-undo", n_actions, n_undos );
+
+    g_object_unref(G_OBJECT(seq));
+    g_unlink( filename );
+    g_free( filename );
+}
+
+static void serialize_small( gpointer p, GByteArray *buffer ) {
+    g_byte_array_append( buffer, file_payload, 16 );
+}
+
+static GundoActionType bench_journal_action = { .undo = nop, .redo = nop,
+                                                .serialize = serialize_small,
+                                                .deserialize = deserialize_payload };
+
+/* adding actions with 16 byte payloads to a journaled sequence; the add
+ * shouldn't wait for the disk, the writer thread syncs in the background */
+static void bench_journal( guint64 n_actions ) {
+    const GundoActionType *types[] = { &bench_journal_action };
+    GundoSequence *seq = gundo_sequence_new();
+    gchar *filename;
+    Measurement m;
+    guint64 i;
+    int fd;
+
+    filename = g_build_filename( g_get_tmp_dir(), "gundo-bench-XXXXXX", NULL );
+    fd = g_mkstemp( filename );
+    if( fd < 0 ) {
+        perror( filename );
+        exit(1);
+    }
+    close( fd );
+
+    if( !gundo_sequence_open_journal( seq, filename, types, 1, NULL, NULL ) ) {
+        exit(1);
+    }
+    measure_start( &m );
+    for( i = 0; i < n_actions; i++ ) {
+        gundo_sequence_add_action( seq, &bench_journal_action, NULL );
+    }
+    measure_report( &m, "journal-add", n_actions, n_actions );
+
+    measure_start( &m );
+    if( !gundo_sequence_close_journal( seq, NULL ) ) {
+        exit(1);
+    }
+    measure_report( &m, "journal-drain", n_actions, n_actions );
+    g_object_unref(G_OBJECT(seq));
+
+    seq = gundo_sequence_new();
+    measure_start( &m );
+    if( !gundo_sequence_open_journal( seq, filename, types, 1, NULL, NULL ) ) {
+        exit(1);
+    }
+    measure_report( &m, "journal-recover", n_actions, n_actions );
+    g_object_unref(G_OBJECT(seq));
+
+    g_unlink( filename );
+    g_free( filename );
+}
+
+static void serialize_heap( gpointer p, GByteArray *buffer ) {
+    g_byte_array_append( buffer, p, sizeof(file_payload) );
+}
+
+static gpointer copy_payload( gconstpointer bytes, gsize len ) {
+    gpointer copy = g_malloc( len );
+    memcpy( copy, bytes, len );
+    return copy;
+}
+
+static gpointer deserialize_heap( gconstpointer bytes, gsize len ) {
+    return copy_payload( bytes, len );
+}
+
+static GundoActionType bench_heap_action = { .undo = nop, .redo = nop, .free = g_free,
+                                             .serialize = serialize_heap,
+                                             .deserialize = deserialize_heap };
+
+/* recording actions with 256 byte heap payloads while all but the latest
+ * 100 steps get spilled, then undoing all of them, which loads them back */
+static void bench_spill( guint64 n_actions ) {
+    GundoSequence *seq = gundo_sequence_new();
+    Measurement m;
+    guint64 i;
+
+    if( !gundo_sequence_open_spill( seq, NULL, NULL ) ) {
+        exit(1);
+    }
+    measure_start( &m );
+    for( i = 0; i < n_actions; i++ ) {
+        gundo_sequence_add_action( seq, &bench_heap_action,
+                                   copy_payload( file_payload, sizeof(file_payload) ) );
+    }
+    measure_report( &m, "spill-add", n_actions, n_actions );
+
+    measure_start( &m );
+    gundo_history_undo_n( GUNDO_HISTORY(seq), n_actions );
+    measure_report( &m, "spill-undo", n_actions, n_actions );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+/* fills @payload with text that differs per action, like an edit would */
+static void fill_text( guint8 *payload, gsize len, guint64 i ) {
+    static const char text[] = "The quick brown fox jumps over the lazy dog. ";
+    gsize j;
+
+    for( j = 0; j < len; j++ ) {
+        payload[j] = text[(i + j) % (sizeof(text) - 1)];
+    }
+    snprintf( (char*) payload, len, "%" G_GUINT64_FORMAT, i );
+}
+
+/* recording actions with 256 byte text payloads while only the latest 100
+ * steps stay uncompressed, then undoing all of them, which decompresses
+ * them batch by batch; the time of inflating a batch, from the compression
+ * stats, goes to stderr with the compression ratio */
+static void bench_compress( guint64 n_actions ) {
+    GundoSequence *seq = g_object_new( GUNDO_TYPE_SEQUENCE, "compress-distance", 100, NULL );
+    GundoCompressionStats stats;
+    guint8 payload[256];
+    Measurement m;
+    guint64 i;
+
+    measure_start( &m );
+    for( i = 0; i < n_actions; i++ ) {
+        fill_text( payload, sizeof(payload), i );
+        gundo_sequence_add_action( seq, &bench_heap_action, copy_payload( payload, sizeof(payload) ) );
+    }
+    measure_report( &m, "compress-add", n_actions, n_actions );
+
+    gundo_sequence_flush_compression( seq );
+    gundo_sequence_get_compression_stats( seq, &stats );
+    fprintf( stderr, "compress: %" G_GUINT64_FORMAT " bytes in %" G_GUINT64_FORMAT " (%.1fx)\n",
+             stats.raw_bytes, stats.compressed_bytes,
+             (double) stats.raw_bytes / MAX( stats.compressed_bytes, 1 ) );
+
+    measure_start( &m );
+    gundo_history_undo_n( GUNDO_HISTORY(seq), n_actions );
+    measure_report( &m, "compress-undo", n_actions, n_actions );
+
+    gundo_sequence_get_compression_stats( seq, &stats );
+    fprintf( stderr, "compress: inflated %" G_GUINT64_FORMAT " batches in %.1f ns each\n",
+             stats.decompress.n_calls,
+             (double) stats.decompress.total_ns / MAX( stats.decompress.n_calls, 1 ) );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+/* stands in for an expensive action, like an image filter */
+static volatile guint64 spin_sink;
+
+static void spin( gpointer p ) {
+    gint64 end = g_get_monotonic_time() + 10;
+
+    while( g_get_monotonic_time() < end ) {
+        spin_sink++;
+    }
+}
+
+static GundoActionType bench_spin_action = { .undo = spin, .redo = spin };
+
+/* the state the actions work on, like a 512x512 RGBA layer */
+#define DOCUMENT_SIZE (512 * 512 * 4)
+
+typedef struct {
+    guint8  *document;
+    guint64  n_snapshots;
+    guint64  snapshot_ns;
+} BenchDocument;
+
+static gpointer snapshot_document( gpointer user_data ) {
+    BenchDocument *doc = user_data;
+    gint64 start = g_get_monotonic_time();
+    gpointer snapshot = g_memdup( doc->document, DOCUMENT_SIZE );
+
+    doc->n_snapshots++;
+    doc->snapshot_ns += (g_get_monotonic_time() - start) * 1000;
+    return snapshot;
+}
+
+static void restore_document( gpointer snapshot, gpointer user_data ) {
+    BenchDocument *doc = user_data;
+
+    memcpy( doc->document, snapshot, DOCUMENT_SIZE );
+}
+
+/* random far jumps through a history of actions taking 10 us each, plain
+ * and with checkpoints every millisecond of replay; ns/op is per jump. The
+ * checkpoints copy a whole document, what that costs goes to stderr */
+static void bench_checkpoints( guint64 n_steps ) {
+    GRand *rand = g_rand_new_with_seed( 42 );
+    BenchDocument doc = { NULL, 0, 0 };
+    guint n_jumps = 100;
+    int checkpoints;
+
+    doc.document = g_malloc0( DOCUMENT_SIZE );
+
+    for( checkpoints = 0; checkpoints <= 1; checkpoints++ ) {
+        GundoSequence *seq = g_object_new( GUNDO_TYPE_SEQUENCE, "checkpoint-cost", (guint64) 1000000,
+                                           "max-checkpoints", 64, NULL );
+        GundoHistory *history = GUNDO_HISTORY(seq);
+        Measurement m;
+        guint64 i;
+
+        if( checkpoints ) {
+            gundo_sequence_set_checkpoint_funcs( seq, snapshot_document, restore_document, g_free,
+                                                 &doc, NULL );
+        }
+
+        measure_start( &m );
+        for( i = 0; i < n_steps; i++ ) {
+            gundo_sequence_add_action( seq, &bench_spin_action, NULL );
+        }
+        measure_report( &m, checkpoints ? "checkpoint-add" : "plain-add", n_steps, n_steps );
+
+        /* the first trip measures the actions and places the checkpoints */
+        gundo_history_goto( history, 0 );
+        gundo_history_goto( history, n_steps );
+
+        g_rand_set_seed( rand, 42 );
+        measure_start( &m );
+        for( i = 0; i < n_jumps; i++ ) {
+            gundo_history_goto( history, g_rand_int_range( rand, 0, n_steps + 1 ) );
+        }
+        measure_report( &m, checkpoints ? "checkpoint-jump" : "plain-jump", n_steps, n_jumps );
+
+        g_object_unref(G_OBJECT(seq));
+    }
+
+    fprintf( stderr, "checkpoints: %" G_GUINT64_FORMAT " snapshots of %u KiB in %.1f ns each\n",
+             doc.n_snapshots, DOCUMENT_SIZE / 1024,
+             (double) doc.snapshot_ns / MAX( doc.n_snapshots, 1 ) );
+
+    g_free( doc.document );
+    g_rand_free( rand );
+}
+
+typedef struct {
+    const char *name;
+    void      (*run)( guint64 n_actions );
+    gboolean    scaled; /* run at every size, otherwise at @size only */
+    guint64     size;
+} Workload;
+
+static const Workload workloads[] = {
+    { "lifecycle", bench_lifecycle, TRUE,  0 },
+    { "groups",    bench_groups,    TRUE,  0 },
+    { "batch",     bench_batch,     TRUE,  0 },
+    { "add-full",  bench_add_full,  FALSE, 1000000 },
+    { "nested",    bench_nested,    FALSE, 1000 },
+    { "jump",      bench_jump,      FALSE, 500 },
+    { "branches",  bench_branches,  TRUE,  0 },
+    { "file",      bench_history_file, FALSE, 1000000 },
+    { "journal",   bench_journal,   FALSE, 1000000 },
+    { "spill",     bench_spill,     FALSE, 1000000 },
+    { "compress",  bench_compress,  FALSE, 1000000 },
+    { "checkpoints", bench_checkpoints, FALSE, 10000 },
+};
+
+/* runs @workload in a child process so its peak RSS is its own */
+static void run_isolated( const Workload *workload, guint64 n_actions ) {
+    pid_t pid;
+    int status;
+
+    fflush( stdout );
+    pid = fork();
+    if( pid < 0 ) {
+        perror( "fork" );
+        exit(1);
+    }
+    if( pid == 0 ) {
+        g_type_init();
+        workload->run( n_actions );
+        fflush( stdout );
+        _exit(0);
+    }
+    if( waitpid( pid, &status, 0 ) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) ) {
+        fprintf( stderr, "%s at %" G_GUINT64_FORMAT " actions: FAILED\n", workload->name, n_actions );
+        exit(1);
+    }
+}
+
+static gboolean is_selected( const Workload *workload, int argc, char **argv ) {
+    gboolean any = FALSE;
+    int i;
+
+    for( i = 1; i < argc; i++ ) {
+        if( argv[i][0] == '-' ) {
+            continue;
+        }
+        any = TRUE;
+        if( !strcmp( argv[i], workload->name ) ) {
+            return TRUE;
+        }
+    }
+    return !any;
+}
+
+int main( int argc, char **argv ) {
+    guint64 max_actions = 10000000;
+    guint64 n;
+    guint i;
+    int j;
+
+    for( j = 1; j < argc; j++ ) {
+        if( !strncmp( argv[j], "--max-actions=", 14 ) ) {
+            max_actions = strtoull( argv[j] + 14, NULL, 10 );
+        } else if( argv[j][0] == '-' ) {
+            fprintf( stderr, "usage: %s [--max-actions=N] [WORKLOAD...]\n", argv[0] );
+            return 1;
+        }
+    }
+
+    printf( "benchmark\tactions\tns_per_op\tallocs_per_op\tpeak_rss_kib\n" );
+    for( i = 0; i < G_N_ELEMENTS(workloads); i++ ) {
+        if( !is_selected( &workloads[i], argc, argv ) ) {
+            continue;
+        }
+        if( !workloads[i].scaled ) {
+            run_isolated( &workloads[i], workloads[i].size );
+            continue;
+        }
+        for( n = 1000; n <= max_actions; n *= 10 ) {
+            run_isolated( &workloads[i], n );
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+/* This file is part of gundo, a multilevel undo/redo facility for GTK+
+ *
+ * AUTHORS
+ *	Sven Herzberg		<herzi@gnome-de.org>
+ *
+ * Copyright (C) 2009  Sven Herzberg
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+/* Tests of the private parts of the library, which tundo can't reach
+ * through the public API. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gundo.h>
+#include <gundo-action-store.h>
+#include <gundo-sequence-private.h>
+
+static void undo_nothing( gpointer p ) {
+}
+
+static void redo_nothing( gpointer p ) {
+}
+
+static GundoActionType test_empty_action = { .undo = undo_nothing, .redo = redo_nothing };
+
+static void test_storage_blocks() {
+    GundoActionStore *store = gundo_action_store_new();
+    UndoAction action = { NULL, NULL };
+    guint n_blocks;
+    int i;
+
+    /* truncating keeps the reserved blocks, like an empty group that gets
+     * dropped right after the reservation */
+    gundo_action_store_reserve( store, 3 * GUNDO_ACTION_STORE_BLOCK_SIZE );
+    n_blocks = store->n_blocks;
+    for( i = 0; i < 10; i++ )
+        gundo_action_store_append( store, &action );
+    gundo_action_store_truncate( store, 0 );
+    gundo_action_store_remove_range( store, 0, 0 );
+    if( store->n_blocks != n_blocks ) {
+        fprintf( stderr, "storage blocks: FAILED: truncating dropped reserved blocks\n" );
+        exit(1);
+    }
+
+    /* growing past the reservation uses it up */
+    for( i = 0; i < 4 * GUNDO_ACTION_STORE_BLOCK_SIZE; i++ )
+        gundo_action_store_append( store, &action );
+    gundo_action_store_truncate( store, 0 );
+    if( store->n_blocks != 0 ) {
+        fprintf( stderr, "storage blocks: FAILED: %u blocks kept after the reservation\n",
+                 store->n_blocks );
+        exit(1);
+    }
+    gundo_action_store_free( store );
+}
+
+static void test_batch_blocks() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    GundoActionEntry entries[10];
+    int i;
+
+    /* the redo tail is gone before the batch reserves its records, so the
+     * store doesn't keep the blocks of the tail around */
+    for( i = 0; i < 8 * GUNDO_ACTION_STORE_BLOCK_SIZE; i++ ) {
+        gundo_sequence_add_action( seq, &test_empty_action, NULL );
+    }
+    gundo_history_undo_n( history, 4 * GUNDO_ACTION_STORE_BLOCK_SIZE );
+    for( i = 0; i < 10; i++ ) {
+        entries[i].type = &test_empty_action;
+        entries[i].data = NULL;
+    }
+    gundo_sequence_add_actions( seq, entries, 10, TRUE );
+    if( seq->priv->actions->n_blocks != 5 ) {
+        fprintf( stderr, "batch blocks: FAILED: %u blocks after truncating\n",
+                 seq->priv->actions->n_blocks );
+        exit(1);
+    }
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+int main( int argc, char **argv ) {
+    g_type_init();
+    test_storage_blocks();
+    test_batch_blocks();
+
+    return 0;
+}
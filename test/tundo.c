@@ -25,7 +25,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+#include <gio/gio.h>
+#include <glib/gstdio.h>
 #include <gundo.h>
 
 #ifndef VERBOSE
@@ -46,14 +50,53 @@ static void redo_inc( gpointer p ) {
     (*((TestData*)p)->count)++;
 }
 
+/* the worker thread frees thread-safe actions */
+static gint n_freed = 0;
+
 static void free_data( gpointer p ) {
+    g_atomic_int_inc( &n_freed );
     g_free(p);
 }
 
-static GundoActionType test_undo_action = { undo_inc, redo_inc, free_data };
+static gsize size_data( gpointer p ) {
+    return sizeof(TestData);
+}
+
+static GundoActionType test_undo_action = { .undo = undo_inc, .redo = redo_inc, .free = free_data,
+                                           .size = size_data };
+
+static GundoActionType test_threadsafe_action = { .undo = undo_inc, .redo = redo_inc, .free = free_data,
+                                                  .size = size_data,
+                                                  .flags = GUNDO_ACTION_FREE_THREADSAFE };
 
 static int count = 0;
 
+typedef struct MergeData MergeData;
+struct MergeData {
+    int delta;
+};
+
+static void undo_add( gpointer p ) {
+    count -= ((MergeData*)p)->delta;
+}
+
+static void redo_add( gpointer p ) {
+    count += ((MergeData*)p)->delta;
+}
+
+static gboolean merge_add( gpointer p, gpointer new_p ) {
+    ((MergeData*)p)->delta += ((MergeData*)new_p)->delta;
+    return TRUE;
+}
+
+static GundoActionType test_merge_action = { .undo = undo_add, .redo = redo_add, .free = free_data,
+                                             .merge = merge_add };
+
+static GundoActionType test_inline_action = { .undo = undo_add, .redo = redo_add,
+                                              .merge = merge_add };
+
+static GundoActionType test_group_action = { .undo = undo_add, .redo = redo_add };
+
 
 static void check_value( int n, const char *test_id ) {
     if( count != n ) {
@@ -128,10 +171,2948 @@ static void test_groups() {
     check_value( 5, "freed undo sequence" );
 }
 
+static void test_nested_groups() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+
+    count = 0;
+    n_freed = 0;
+
+    gundo_sequence_start_group( seq );
+    do_inc( seq );
+    gundo_sequence_start_group( seq );
+    do_inc( seq );
+    do_inc( seq );
+    gundo_sequence_end_group( seq );
+    gundo_sequence_start_group( seq );
+    gundo_sequence_end_group( seq );
+    gundo_sequence_start_group( seq );
+    do_inc( seq );
+    gundo_sequence_abort_group( seq );
+    do_inc( seq );
+    if( seq->group != seq ) {
+        fprintf( stderr, "nested groups: FAILED: the open group is not set\n" );
+        exit(1);
+    }
+    gundo_sequence_end_group( seq );
+
+    check_value( 5, "performed nested groups" );
+    if( seq->group ) {
+        fprintf( stderr, "nested groups: FAILED: the group is still set after ending it\n" );
+        exit(1);
+    }
+    if( gundo_history_get_position(history) != 1 || n_freed != 1 ) {
+        fprintf( stderr, "nested groups: FAILED: expected a single step\n" );
+        exit(1);
+    }
+    count--; /* the aborted action is not part of the history */
+
+    gundo_history_undo(history);
+    check_value( 0, "undid the nested groups" );
+    gundo_history_redo(history);
+    check_value( 4, "redid the nested groups" );
+    gundo_history_undo(history);
+    check_value( 0, "undid the nested groups again" );
+
+    /* adding an action discards the undone group */
+    do_inc( seq );
+    if( n_freed != 5 || gundo_history_can_redo(history) ) {
+        fprintf( stderr, "nested groups: FAILED: group was not discarded\n" );
+        exit(1);
+    }
+    gundo_history_undo(history);
+    check_value( 0, "undid the action after the group" );
+
+    g_object_unref(G_OBJECT(seq));
+    check_value( 0, "freed undo sequence" );
+}
+
+static void test_budget() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    gsize action_size;
+    int i;
+
+    count = 0;
+    n_freed = 0;
+
+    do_inc(seq);
+    action_size = gundo_sequence_get_size(seq);
+    g_object_set(seq, "max-size", (guint64)(3 * action_size), NULL);
+
+    for( i = 0; i < 5; i++ ) {
+        do_inc(seq);
+    }
+    check_value( 6, "performed six actions within a budget of three" );
+    if( gundo_sequence_get_n_evicted(seq) != 3 || n_freed != 3 ||
+        gundo_sequence_get_size(seq) != 3 * action_size ) {
+        fprintf( stderr, "budget: FAILED: evicted %u actions, expected 3\n",
+                 gundo_sequence_get_n_evicted(seq) );
+        exit(1);
+    }
+
+    while( gundo_history_can_undo(history) ) {
+        gundo_history_undo(history);
+    }
+    check_value( 3, "undid all actions that were kept" );
+
+    g_object_unref(G_OBJECT(seq));
+    check_value( 3, "freed undo sequence" );
+}
+
+static void test_max_depth() {
+    GundoSequence *seq = g_object_new(GUNDO_TYPE_SEQUENCE, "max-depth", 5, NULL);
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    int steps[5];
+    int i, n;
+
+    count = 0;
+
+    /* mix single actions, groups and truncations to wrap the ring */
+    for( i = 0; i < 100; i++ ) {
+        if( i % 3 == 0 ) {
+            gundo_sequence_start_group( seq );
+            do_inc( seq );
+            do_inc( seq );
+            gundo_sequence_end_group( seq );
+        } else {
+            do_inc( seq );
+        }
+        if( i % 7 == 6 ) {
+            gundo_history_undo( history );
+            gundo_history_undo( history );
+        }
+    }
+
+    if( gundo_history_get_position(history) != 5 || gundo_history_can_redo(history) ) {
+        fprintf( stderr, "max depth: FAILED: expected five undoable steps\n" );
+        exit(1);
+    }
+
+    for( n = 0; gundo_history_can_undo(history); n++ ) {
+        steps[n] = count;
+        gundo_history_undo( history );
+    }
+    while( n > 0 ) {
+        gundo_history_redo( history );
+        check_value( steps[--n], "redid a step of a wrapped sequence" );
+    }
+
+    g_object_unref(G_OBJECT(seq));
+
+    /* an evicted group counts as a single step */
+    seq = g_object_new(GUNDO_TYPE_SEQUENCE, "max-depth", 1, NULL);
+    gundo_sequence_start_group( seq );
+    do_inc( seq );
+    do_inc( seq );
+    do_inc( seq );
+    gundo_sequence_end_group( seq );
+    do_inc( seq );
+    if( gundo_sequence_get_n_evicted(seq) != 1 ) {
+        fprintf( stderr, "max depth: FAILED: %u steps evicted instead of 1\n",
+                 gundo_sequence_get_n_evicted(seq) );
+        exit(1);
+    }
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void test_reserve() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    int i;
+
+    count = 0;
+
+    /* enough actions to span several storage blocks */
+    gundo_sequence_reserve( seq, 1000 );
+    for( i = 0; i < 1000; i++ )
+        do_inc( seq );
+    check_value( 1000, "added reserved actions" );
+
+    for( i = 0; i < 900; i++ )
+        gundo_history_undo( history );
+    check_value( 100, "undid across storage blocks" );
+
+    /* truncate the redo tail */
+    n_freed = 0;
+    do_inc( seq );
+    if( n_freed != 900 || gundo_history_can_redo(history) ) {
+        fprintf( stderr, "reserve: FAILED: expected the redo tail to be freed\n" );
+        exit(1);
+    }
+
+    for( i = 0; i < 600; i++ )
+        do_inc( seq );
+    for( i = 0; i < 701; i++ )
+        gundo_history_undo( history );
+    check_value( 0, "undid regrown sequence" );
+    for( i = 0; i < 701; i++ )
+        gundo_history_redo( history );
+    check_value( 701, "redid regrown sequence" );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void test_storage_blocks() {
+    GundoSequence *seq;
+    GundoHistory * history;
+    int i;
+
+    /* mix single actions, groups and truncations to cycle through the
+     * storage blocks */
+    seq = g_object_new(GUNDO_TYPE_SEQUENCE, "max-depth", 5, NULL);
+    history = GUNDO_HISTORY(seq);
+    count = 0;
+    for( i = 0; i < 1000; i++ ) {
+        if( i % 3 == 0 ) {
+            gundo_sequence_start_group( seq );
+            do_inc( seq );
+            do_inc( seq );
+            gundo_sequence_end_group( seq );
+        } else {
+            do_inc( seq );
+        }
+        if( i % 7 == 6 ) {
+            gundo_history_undo( history );
+            gundo_history_undo( history );
+        }
+    }
+    i = count;
+    while( gundo_history_can_undo(history) )
+        gundo_history_undo( history );
+    while( gundo_history_can_redo(history) )
+        gundo_history_redo( history );
+    check_value( i, "cycled through the storage blocks" );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void test_deferred_free() {
+    GundoSequence *seq = g_object_new(GUNDO_TYPE_SEQUENCE, "deferred-free", TRUE, NULL);
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    int n_iterations = 0;
+    int i;
+
+    count = 0;
+    n_freed = 0;
+
+    for( i = 0; i < 1000; i++ )
+        do_inc( seq );
+    for( i = 0; i < 999; i++ )
+        gundo_history_undo( history );
+
+    /* dropping the redo tail must not free it right away */
+    do_inc( seq );
+    check_value( 2, "added action after undoing" );
+    if( n_freed != 0 || gundo_history_can_redo(history) ) {
+        fprintf( stderr, "deferred free: FAILED: the redo tail was freed synchronously\n" );
+        exit(1);
+    }
+
+    while( g_main_context_iteration( NULL, FALSE ) )
+        n_iterations++;
+    if( n_freed != 999 || n_iterations < 2 ) {
+        fprintf( stderr, "deferred free: FAILED: freed %d actions in %d idle calls\n",
+                 n_freed, n_iterations );
+        exit(1);
+    }
+
+    /* thread-safe actions get freed by the worker, finalizing hands over
+     * all remaining actions */
+    for( i = 0; i < 100; i++ ) {
+        count++;
+        gundo_sequence_add_action( seq, &test_threadsafe_action, test_undo_data() );
+    }
+    g_atomic_int_set( &n_freed, 0 );
+    g_object_unref(G_OBJECT(seq));
+    gundo_sequence_flush_discarded( NULL );
+    if( g_atomic_int_get( &n_freed ) != 102 ) {
+        fprintf( stderr, "deferred free: FAILED: flushed %d actions, expected 102\n",
+                 g_atomic_int_get( &n_freed ) );
+        exit(1);
+    }
+
+    /* without a main loop, a huge batch doesn't wait for the idle handler */
+    seq = g_object_new(GUNDO_TYPE_SEQUENCE, "deferred-free", TRUE, NULL);
+    for( i = 0; i < 100000; i++ )
+        do_inc( seq );
+    g_atomic_int_set( &n_freed, 0 );
+    g_object_unref(G_OBJECT(seq));
+    if( g_atomic_int_get( &n_freed ) != 100000 ) {
+        fprintf( stderr, "deferred free: FAILED: %d of a huge batch freed right away\n",
+                 g_atomic_int_get( &n_freed ) );
+        exit(1);
+    }
+}
+
+static void do_add( GundoSequence *seq, int delta ) {
+    MergeData *d = g_new(MergeData,1);
+    d->delta = delta;
+    count += delta;
+    gundo_sequence_add_action( seq, &test_merge_action, d );
+}
+
+static void count_changed( GundoHistory *history, int *n_changed ) {
+    (*n_changed)++;
+}
+
+static void test_merge() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    int n_changed = 0;
+
+    count = 0;
+    n_freed = 0;
+    g_signal_connect( seq, "changed", G_CALLBACK(count_changed), &n_changed );
+
+    do_add( seq, 1 );
+    do_add( seq, 2 );
+    do_add( seq, 3 );
+    if( gundo_history_get_position(history) != 1 || n_changed != 1 || n_freed != 2 ) {
+        fprintf( stderr, "merge: FAILED: expected a single step\n" );
+        exit(1);
+    }
+    gundo_history_undo( history );
+    check_value( 0, "undid merged actions" );
+    gundo_history_redo( history );
+    check_value( 6, "redid merged actions" );
+
+    /* other types and group boundaries stop merging */
+    do_inc( seq );
+    do_add( seq, 1 );
+    gundo_sequence_start_group( seq );
+    do_add( seq, 1 );
+    do_add( seq, 1 );
+    gundo_sequence_end_group( seq );
+    do_add( seq, 1 );
+    if( gundo_history_get_position(history) != 5 ) {
+        fprintf( stderr, "merge: FAILED: merged across a boundary\n" );
+        exit(1);
+    }
+
+    /* a redo tail stops merging, too */
+    gundo_history_undo( history );
+    do_add( seq, 1 );
+    if( gundo_history_get_position(history) != 5 || gundo_history_can_redo(history) ) {
+        fprintf( stderr, "merge: FAILED: merged into a redo entry\n" );
+        exit(1);
+    }
+
+    while( gundo_history_can_undo(history) ) {
+        gundo_history_undo( history );
+    }
+    check_value( 0, "undid all merged steps" );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void test_inline() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    MergeData big[100];
+    MergeData d, owned;
+    guint n;
+    int i;
+
+    count = 0;
+
+    /* enough payloads to fill several arena chunks */
+    for( i = 0; i < 2000; i++ ) {
+        d.delta = i;
+        count += i;
+        gundo_sequence_add_action_inline( seq, &test_inline_action, &d, sizeof(d) );
+        do_inc( seq );
+    }
+    for( i = 0; i < 1000; i++ ) {
+        gundo_history_undo( history );
+        gundo_history_undo( history );
+    }
+    check_value( 999 * 1000 / 2 + 1000, "undid inline actions" );
+
+    /* truncate the redo tail, then merge into an inline payload */
+    d.delta = 1;
+    count++;
+    gundo_sequence_add_action_inline( seq, &test_inline_action, &d, sizeof(d) );
+    count++;
+    gundo_sequence_add_action_inline( seq, &test_inline_action, &d, sizeof(d) );
+    if( gundo_history_get_position(history) != 2001 ) {
+        fprintf( stderr, "inline: FAILED: expected the inline actions to merge\n" );
+        exit(1);
+    }
+
+    /* payloads too big for the arena */
+    memset( big, 0, sizeof(big) );
+    big[0].delta = 5;
+    count += 5;
+    gundo_sequence_add_action_inline( seq, &test_inline_action, big, sizeof(big) );
+    big[0].delta = 0;
+
+    /* inline copies and caller-owned pointers of one type don't merge */
+    n = gundo_history_get_position( history );
+    owned.delta = 2;
+    count += 2;
+    gundo_sequence_add_action( seq, &test_inline_action, &owned );
+    d.delta = 3;
+    count += 3;
+    gundo_sequence_add_action_inline( seq, &test_inline_action, &d, sizeof(d) );
+    if( gundo_history_get_position(history) != n + 2 || owned.delta != 2 ) {
+        fprintf( stderr, "inline: FAILED: merged an inline copy with a pointer\n" );
+        exit(1);
+    }
+
+    while( gundo_history_can_undo(history) ) {
+        gundo_history_undo( history );
+    }
+    check_value( 0, "undid all inline actions" );
+    while( gundo_history_can_redo(history) ) {
+        gundo_history_redo( history );
+    }
+    check_value( 999 * 1000 / 2 + 1000 + 12, "redid all inline actions" );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void do_group_add( GundoSequence *seq, int delta ) {
+    MergeData *d = gundo_sequence_group_alloc( seq, sizeof(MergeData) );
+    d->delta = delta;
+    count += delta;
+    gundo_sequence_add_action( seq, &test_group_action, d );
+}
+
+static void test_group_alloc() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    int i;
+
+    count = 0;
+
+    /* enough payloads to fill several arena chunks */
+    gundo_sequence_start_group( seq );
+    for( i = 0; i < 10000; i++ ) {
+        do_group_add( seq, 1 );
+    }
+    gundo_sequence_start_group( seq );
+    do_group_add( seq, 1 );
+    gundo_sequence_abort_group( seq );
+    count--;
+    gundo_sequence_start_group( seq );
+    do_group_add( seq, 2 );
+    gundo_sequence_end_group( seq );
+    gundo_sequence_end_group( seq );
+    check_value( 10002, "performed a group with arena payloads" );
+
+    gundo_history_undo( history );
+    check_value( 0, "undid a group with arena payloads" );
+    gundo_history_redo( history );
+    check_value( 10002, "redid a group with arena payloads" );
+
+    /* aborted groups and truncated groups release their arena */
+    gundo_sequence_start_group( seq );
+    do_group_add( seq, 1 );
+    gundo_sequence_abort_group( seq );
+    count--;
+    gundo_history_undo( history );
+    gundo_sequence_start_group( seq );
+    gundo_sequence_group_alloc( seq, 100000 );
+    do_group_add( seq, 3 );
+    gundo_sequence_end_group( seq );
+    check_value( 3, "replaced a group with arena payloads" );
+    if( gundo_history_can_redo(history) || gundo_history_get_position(history) != 1 ) {
+        fprintf( stderr, "group alloc: FAILED: expected a single step\n" );
+        exit(1);
+    }
+
+    /* empty groups drop their arena, open groups are freed with the
+     * sequence */
+    gundo_sequence_start_group( seq );
+    gundo_sequence_group_alloc( seq, 16 );
+    gundo_sequence_end_group( seq );
+    gundo_sequence_start_group( seq );
+    do_group_add( seq, 1 );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void count_notify( GundoHistory *history, GParamSpec *pspec, int *n_notify ) {
+    (*n_notify)++;
+}
+
+static void test_set_max_depth() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    int n_changed = 0;
+    int n_notify = 0;
+    int i;
+
+    count = 0;
+    for( i = 0; i < 10; i++ )
+        do_inc( seq );
+
+    g_signal_connect( seq, "changed", G_CALLBACK(count_changed), &n_changed );
+    g_signal_connect( seq, "notify::n-evicted", G_CALLBACK(count_notify), &n_notify );
+
+    /* lowering the depth evicts right away */
+    g_object_set( seq, "max-depth", 4, NULL );
+    if( gundo_history_get_position(history) != 4 || gundo_sequence_get_n_evicted(seq) != 6 ||
+        n_changed != 1 || n_notify != 1 ) {
+        fprintf( stderr, "set max depth: FAILED: %u steps, %u evicted, %d changed, %d notify\n",
+                 gundo_history_get_position(history), gundo_sequence_get_n_evicted(seq),
+                 n_changed, n_notify );
+        exit(1);
+    }
+
+    /* raising it evicts nothing */
+    gundo_sequence_set_max_depth( seq, 8 );
+    if( gundo_sequence_get_max_depth(seq) != 8 || n_changed != 1 || n_notify != 1 ) {
+        fprintf( stderr, "set max depth: FAILED: raising the depth evicted\n" );
+        exit(1);
+    }
+
+    /* a group bigger than the undoable part replaces the redo tail by
+     * moving the undoable records instead */
+    gundo_history_undo( history );
+    gundo_sequence_start_group( seq );
+    for( i = 0; i < 600; i++ )
+        do_inc( seq );
+    gundo_sequence_end_group( seq );
+    check_value( 609, "added a group behind the redo tail" );
+    if( gundo_history_can_redo(history) || gundo_history_get_position(history) != 4 ) {
+        fprintf( stderr, "set max depth: FAILED: the redo tail is still there\n" );
+        exit(1);
+    }
+    gundo_history_undo( history );
+    check_value( 9, "undid the group" );
+    gundo_history_undo( history );
+    gundo_history_undo( history );
+    gundo_history_undo( history );
+    check_value( 6, "undid the moved steps" );
+    for( i = 0; i < 4; i++ )
+        gundo_history_redo( history );
+    check_value( 609, "redid the moved steps" );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void count_jump( GundoHistory *history, guint position, int *n_jumps ) {
+    (*n_jumps)++;
+}
+
+static void check_changed_before( GundoHistory *history, gpointer user_data ) {
+    if( gundo_history_get_position(history) != 6 || gundo_history_get_n_redos(history) ||
+        gundo_history_can_redo(history) ) {
+        fprintf( stderr, "goto: FAILED: changed was not emitted before adding\n" );
+        exit(1);
+    }
+}
+
+static void test_goto() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    int n_changed = 0;
+    int n_notify = 0;
+    int n_jumps = 0;
+    int n_steps = 0;
+    int i;
+
+    count = 0;
+
+    for( i = 0; i < 500; i++ ) {
+        do_inc( seq );
+    }
+    gundo_sequence_start_group( seq );
+    do_inc( seq );
+    do_inc( seq );
+    gundo_sequence_end_group( seq );
+
+    g_signal_connect( seq, "changed", G_CALLBACK(count_changed), &n_changed );
+    g_signal_connect( seq, "go-to", G_CALLBACK(count_jump), &n_jumps );
+    g_signal_connect( seq, "notify::can-redo", G_CALLBACK(count_notify), &n_notify );
+
+    gundo_history_undo_n( history, 301 );
+    check_value( 200, "undid 301 steps at once" );
+    if( gundo_history_get_position(history) != 200 || gundo_history_get_n_redos(history) != 301 ||
+        n_jumps != 1 || n_notify != 1 ) {
+        fprintf( stderr, "goto: FAILED: %d jumps and %d notify emissions\n", n_jumps, n_notify );
+        exit(1);
+    }
+
+    /* get_n_undos() keeps counting all steps while any can be undone */
+    if( gundo_history_get_n_undos(history) != 501 ) {
+        fprintf( stderr, "goto: FAILED: %u undoable steps\n", gundo_history_get_n_undos(history) );
+        exit(1);
+    }
+
+    gundo_history_redo_n( history, 100 );
+    check_value( 300, "redid 100 steps at once" );
+    gundo_history_goto( history, 501 );
+    check_value( 502, "jumped to the end" );
+    gundo_history_goto( history, 0 );
+    check_value( 0, "jumped to the start" );
+    gundo_history_goto( history, 0 );
+    if( n_jumps != 4 || n_notify != 3 || n_changed ||
+        gundo_history_get_n_undos(history) != 0 ) {
+        fprintf( stderr, "goto: FAILED: %d jumps, %d changed and %d notify emissions\n",
+                 n_jumps, n_changed, n_notify );
+        exit(1);
+    }
+
+    /* with undo and redo handlers, they see every step */
+    g_signal_connect( seq, "undo", G_CALLBACK(count_changed), &n_steps );
+    g_signal_connect( seq, "redo", G_CALLBACK(count_changed), &n_steps );
+    gundo_history_goto( history, 10 );
+    gundo_history_undo_n( history, 4 );
+    check_value( 6, "jumped step by step" );
+    if( n_steps != 14 || n_jumps != 4 ) {
+        fprintf( stderr, "goto: FAILED: %d undo/redo emissions and %d jumps\n", n_steps, n_jumps );
+        exit(1);
+    }
+
+    /* adding drops the redo tail from the class handler of ::changed,
+     * which runs before the new step is there */
+    g_signal_connect( seq, "changed", G_CALLBACK(check_changed_before), NULL );
+    do_inc( seq );
+    if( n_changed != 1 || gundo_history_get_position(history) != 7 ||
+        gundo_history_can_redo(history) ) {
+        fprintf( stderr, "goto: FAILED: %d changed emissions when adding\n", n_changed );
+        exit(1);
+    }
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void count_emission( GundoHistory *history, int *n_emissions ) {
+    (*n_emissions)++;
+}
+
+static gboolean count_hook( GSignalInvocationHint *ihint, guint n_params, const GValue *params, gpointer data ) {
+    (*(int*)data)++;
+    return TRUE;
+}
+
+/* a sequence subclass that counts undos in its own class handler */
+typedef GundoSequence      TestSequence;
+typedef GundoSequenceClass TestSequenceClass;
+
+GType test_sequence_get_type( void );
+
+G_DEFINE_TYPE( TestSequence, test_sequence, GUNDO_TYPE_SEQUENCE );
+
+static int n_class_undos = 0;
+
+static void test_sequence_undo( GundoHistory *history ) {
+    n_class_undos++;
+    g_signal_chain_from_overridden_handler( history );
+}
+
+static void test_sequence_init( TestSequence *seq ) {
+}
+
+static void test_sequence_class_init( TestSequenceClass *klass ) {
+    g_signal_override_class_handler( "undo", test_sequence_get_type(),
+                                     G_CALLBACK(test_sequence_undo) );
+}
+
+static void test_signal_emission() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    int n_emissions = 0;
+    int n_notify = 0;
+    gulong undo_hook, changed_hook;
+    int n_undo_hooked = 0;
+    int n_changed_hooked = 0;
+
+    count = 0;
+
+    /* without handlers undo and redo don't go through the signals, so only
+     * the hooks of ::changed run */
+    undo_hook = g_signal_add_emission_hook( g_signal_lookup( "undo", GUNDO_TYPE_HISTORY ), 0,
+                                            count_hook, &n_undo_hooked, NULL );
+    changed_hook = g_signal_add_emission_hook( g_signal_lookup( "changed", GUNDO_TYPE_HISTORY ), 0,
+                                               count_hook, &n_changed_hooked, NULL );
+    do_inc( seq );
+    do_inc( seq );
+    gundo_history_undo( history );
+    check_value( 1, "fast undo" );
+    gundo_history_redo( history );
+    check_value( 2, "fast redo" );
+    g_signal_remove_emission_hook( g_signal_lookup( "undo", GUNDO_TYPE_HISTORY ), undo_hook );
+    g_signal_remove_emission_hook( g_signal_lookup( "changed", GUNDO_TYPE_HISTORY ), changed_hook );
+    if( n_undo_hooked != 0 || n_changed_hooked != 2 ) {
+        fprintf( stderr, "signal emission: FAILED: %d hooked undos and %d hooked changes\n",
+                 n_undo_hooked, n_changed_hooked );
+        exit(1);
+    }
+
+    /* but connected handlers still run */
+    g_signal_connect( seq, "undo", G_CALLBACK(count_emission), &n_emissions );
+    g_signal_connect( seq, "redo", G_CALLBACK(count_emission), &n_emissions );
+    g_signal_connect( seq, "notify::can-undo", G_CALLBACK(count_notify), &n_notify );
+    gundo_history_undo( history );
+    gundo_history_undo( history );
+    check_value( 0, "undo with handlers" );
+    gundo_history_redo( history );
+    check_value( 1, "redo with handlers" );
+    if( n_emissions != 3 || n_notify != 2 ||
+        gundo_history_can_undo(history) != TRUE || gundo_history_can_redo(history) != TRUE ) {
+        fprintf( stderr, "signal emission: FAILED: %d emissions and %d notify emissions\n", n_emissions, n_notify );
+        exit(1);
+    }
+
+    do_inc( seq );
+    if( gundo_history_can_redo(history) != FALSE ) {
+        fprintf( stderr, "signal emission: FAILED: can still redo after an add\n" );
+        exit(1);
+    }
+
+    g_object_unref(G_OBJECT(seq));
+
+    /* a subclass may have overridden the class closure, so it always gets
+     * the emission */
+    seq = g_object_new( test_sequence_get_type(), NULL );
+    history = GUNDO_HISTORY(seq);
+    count = 0;
+    do_inc( seq );
+    gundo_history_undo( history );
+    check_value( 0, "overridden undo" );
+    if( n_class_undos != 1 ) {
+        fprintf( stderr, "signal emission: FAILED: %d overridden undos instead of 1\n", n_class_undos );
+        exit(1);
+    }
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static guint64 stats_calls( GundoSequence *seq, const GundoActionType *type, GundoActionOp op ) {
+    GundoActionStats stats;
+
+    if( !gundo_sequence_get_action_stats( seq, type, op, &stats ) ) {
+        return 0;
+    }
+    return stats.n_calls;
+}
+
+static void sum_stats( const GundoActionType *type, GundoActionOp op,
+                       const GundoActionStats *stats, gpointer user_data ) {
+    guint64 in_histogram = 0;
+    int i;
+
+    for( i = 0; i < GUNDO_ACTION_STATS_N_BUCKETS; i++ ) {
+        in_histogram += stats->histogram[i];
+    }
+    if( in_histogram != stats->n_calls || stats->max_ns > stats->total_ns ) {
+        fprintf( stderr, "instrumentation: FAILED: inconsistent stats\n" );
+        exit(1);
+    }
+    *(guint64*)user_data += stats->n_calls;
+}
+
+static void test_instrumentation() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    MergeData d;
+    guint64 n_calls = 0;
+
+    count = 0;
+
+    /* nothing is measured before the instrumentation is turned on */
+    do_inc( seq );
+    g_object_set( seq, "instrumented", TRUE, NULL );
+
+    do_inc( seq );
+    gundo_sequence_start_group( seq );
+    do_inc( seq );
+    d.delta = 3;
+    count += 3;
+    gundo_sequence_add_action_inline( seq, &test_inline_action, &d, sizeof(d) );
+    gundo_sequence_end_group( seq );
+
+    gundo_history_undo_n( history, 3 );
+    check_value( 0, "undid instrumented actions" );
+    gundo_history_redo( history );
+
+    /* the actions of the group are accounted to their own types */
+    if( stats_calls( seq, &test_undo_action, GUNDO_ACTION_OP_ADD ) != 2 ||
+        stats_calls( seq, &test_undo_action, GUNDO_ACTION_OP_UNDO ) != 3 ||
+        stats_calls( seq, &test_undo_action, GUNDO_ACTION_OP_REDO ) != 1 ||
+        stats_calls( seq, &test_inline_action, GUNDO_ACTION_OP_ADD ) != 1 ||
+        stats_calls( seq, &test_inline_action, GUNDO_ACTION_OP_UNDO ) != 1 ||
+        stats_calls( seq, &test_inline_action, GUNDO_ACTION_OP_REDO ) != 0 ) {
+        fprintf( stderr, "instrumentation: FAILED: wrong call counts\n" );
+        exit(1);
+    }
+
+    /* truncating the redo tail frees the grouped actions */
+    do_inc( seq );
+    if( stats_calls( seq, &test_undo_action, GUNDO_ACTION_OP_FREE ) != 2 ||
+        stats_calls( seq, &test_inline_action, GUNDO_ACTION_OP_FREE ) != 1 ) {
+        fprintf( stderr, "instrumentation: FAILED: wrong free counts\n" );
+        exit(1);
+    }
+
+    gundo_sequence_foreach_action_stats( seq, sum_stats, &n_calls );
+    if( n_calls != 3 + 3 + 1 + 1 + 1 + 2 + 1 ) {
+        fprintf( stderr, "instrumentation: FAILED: %" G_GUINT64_FORMAT " calls in total\n", n_calls );
+        exit(1);
+    }
+
+    /* turning it off keeps the stats */
+    gundo_sequence_set_instrumented( seq, FALSE );
+    gundo_history_undo( history );
+    if( stats_calls( seq, &test_undo_action, GUNDO_ACTION_OP_UNDO ) != 3 ) {
+        fprintf( stderr, "instrumentation: FAILED: measured while turned off\n" );
+        exit(1);
+    }
+    gundo_sequence_reset_action_stats( seq );
+    if( stats_calls( seq, &test_undo_action, GUNDO_ACTION_OP_ADD ) != 0 ) {
+        fprintf( stderr, "instrumentation: FAILED: stats not reset\n" );
+        exit(1);
+    }
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static gchar *read_trace( const gchar *filename ) {
+    gchar *contents = NULL;
+
+    if( !g_file_get_contents( filename, &contents, NULL, NULL ) ||
+        contents[0] != '[' || !strstr( contents, "\n]\n" ) ) {
+        fprintf( stderr, "trace: FAILED: %s is not a complete trace\n", filename );
+        exit(1);
+    }
+    return contents;
+}
+
+static gpointer trace_in_thread( gpointer data ) {
+    static MergeData zero = { .delta = 0 };
+    GundoSequence *seq = gundo_sequence_new();
+
+    gundo_sequence_add_action( seq, &test_group_action, &zero );
+    g_object_unref(G_OBJECT(seq));
+    return NULL;
+}
+
+/* counts the different thread ids in a trace */
+static guint trace_n_threads( const gchar *contents ) {
+    GHashTable *tids = g_hash_table_new( g_direct_hash, g_direct_equal );
+    const gchar *tid;
+    guint n_tids;
+
+    for( tid = strstr( contents, "\"tid\":" ); tid; tid = strstr( tid + 1, "\"tid\":" ) ) {
+        g_hash_table_insert( tids, GUINT_TO_POINTER( (guint) atoi( tid + 6 ) + 1 ), NULL );
+    }
+    n_tids = g_hash_table_size( tids );
+    g_hash_table_destroy( tids );
+    return n_tids;
+}
+
+static void test_trace() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    gchar *dump = g_build_filename( g_get_tmp_dir(), "tundo-trace.json", NULL );
+    gchar *stream = g_build_filename( g_get_tmp_dir(), "tundo-trace-stream.json", NULL );
+    gchar *contents;
+    int n_changed = 0;
+    GError *error = NULL;
+
+    count = 0;
+
+    g_signal_connect( seq, "changed", G_CALLBACK(count_changed), &n_changed );
+
+    gundo_trace_start( 16 );
+    gundo_sequence_start_group( seq );
+    do_inc( seq );
+    gundo_sequence_start_group( seq );
+    do_inc( seq );
+    gundo_sequence_end_group( seq );
+    gundo_sequence_end_group( seq );
+    gundo_history_undo( history );
+    check_value( 0, "undid a traced group" );
+
+    if( !gundo_trace_dump( dump, &error ) ) {
+        fprintf( stderr, "trace: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    contents = read_trace( dump );
+    if( !strstr( contents, "\"name\":\"undo\"" ) ||
+        !strstr( contents, "\"name\":\"undo-actions\"" ) ||
+        !strstr( contents, "\"name\":\"changed\"" ) ||
+        !strstr( contents, "\"name\":\"notify::can-redo\"" ) ||
+        !strstr( contents, "\"name\":\"add_action\",\"cat\":\"gundo\",\"ph\":\"X\"" ) ||
+        !strstr( contents, "\"depth\":2}" ) ) {
+        fprintf( stderr, "trace: FAILED: missing events in\n%s\n", contents );
+        exit(1);
+    }
+    if( trace_n_threads( contents ) != 1 ) {
+        fprintf( stderr, "trace: FAILED: %u threads in a single threaded trace\n", trace_n_threads( contents ) );
+        exit(1);
+    }
+    g_free( contents );
+
+    /* events of other threads are recorded with their own thread id */
+    g_thread_join( g_thread_new( "trace", trace_in_thread, NULL ) );
+    if( !gundo_trace_dump( dump, &error ) ) {
+        fprintf( stderr, "trace: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    contents = read_trace( dump );
+    if( trace_n_threads( contents ) != 2 ) {
+        fprintf( stderr, "trace: FAILED: %u threads instead of 2\n", trace_n_threads( contents ) );
+        exit(1);
+    }
+    g_free( contents );
+
+
+    /* stream the trace while the ring fills up */
+    if( !gundo_trace_set_watermark( 8, stream, &error ) ) {
+        fprintf( stderr, "trace: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    while( count < 20 ) {
+        do_inc( seq );
+    }
+    gundo_trace_stop();
+    if( gundo_trace_is_running() ) {
+        fprintf( stderr, "trace: FAILED: still running\n" );
+        exit(1);
+    }
+    do_inc( seq );
+
+    contents = read_trace( stream );
+    if( !strstr( contents, "\"name\":\"truncate\"" ) ) {
+        fprintf( stderr, "trace: FAILED: lost events in the stream\n" );
+        exit(1);
+    }
+    g_free( contents );
+
+    /* restarting the trace completes a watermark file that is still open */
+    gundo_trace_start( 16 );
+    if( !gundo_trace_set_watermark( 8, stream, &error ) ) {
+        fprintf( stderr, "trace: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    do_inc( seq );
+    gundo_trace_start( 16 );
+    gundo_trace_stop();
+    contents = read_trace( stream );
+    if( !strstr( contents, "\"name\":\"add_action\"" ) ) {
+        fprintf( stderr, "trace: FAILED: restarting lost the streamed events\n" );
+        exit(1);
+    }
+    g_free( contents );
+
+    remove( dump );
+    remove( stream );
+    g_free( dump );
+    g_free( stream );
+    g_object_unref(G_OBJECT(seq));
+}
+
+static gsize usage_total( const GundoMemoryUsage *usage ) {
+    return usage->records + usage->groups + usage->payloads;
+}
+
+static void check_usage( GundoSequence *seq, const char *test_id ) {
+    GundoMemoryUsage undo, redo;
+    guint64 undo_prop, redo_prop;
+
+    gundo_history_get_memory_usage( GUNDO_HISTORY(seq), &undo, &redo );
+    g_object_get( seq, "undo-memory-usage", &undo_prop, "redo-memory-usage", &redo_prop, NULL );
+    if( usage_total( &undo ) + usage_total( &redo ) != gundo_sequence_get_size( seq ) ||
+        undo_prop != usage_total( &undo ) || redo_prop != usage_total( &redo ) ) {
+        fprintf( stderr, "%s: FAILED: inconsistent memory usage\n", test_id );
+        exit(1);
+    }
+}
+
+static void test_memory_usage() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    GundoMemoryUsage undo, redo, all;
+    gsize record;
+    int n_changed = 0;
+    int i;
+
+    count = 0;
+
+    for( i = 0; i < 4; i++ ) {
+        do_inc( seq );
+    }
+    gundo_history_get_memory_usage( history, &all, &redo );
+    record = all.records / 4;
+    if( !record || all.payloads != 4 * sizeof(TestData) || all.groups ||
+        usage_total( &redo ) ) {
+        fprintf( stderr, "memory usage: FAILED: wrong usage of plain actions\n" );
+        exit(1);
+    }
+    check_usage( seq, "memory usage of plain actions" );
+
+    /* a group with arena memory */
+    gundo_sequence_start_group( seq );
+    do_group_add( seq, 1 );
+    do_group_add( seq, 2 );
+    gundo_sequence_end_group( seq );
+    gundo_sequence_add_action_inline( seq, &test_inline_action, &i, sizeof(i) );
+    count += i;
+    gundo_history_get_memory_usage( history, &all, NULL );
+    if( all.records != 7 * record || all.groups <= 3 * record ||
+        all.payloads <= 4 * sizeof(TestData) ) {
+        fprintf( stderr, "memory usage: FAILED: wrong usage of groups\n" );
+        exit(1);
+    }
+
+    /* undoing moves the usage over to the redo side */
+    gundo_history_undo_n( history, 3 );
+    gundo_history_get_memory_usage( history, &undo, &redo );
+    if( undo.records != 3 * record || redo.records != 4 * record ||
+        undo.groups || redo.groups != all.groups ||
+        undo.payloads != 3 * sizeof(TestData) ) {
+        fprintf( stderr, "memory usage: FAILED: wrong undo/redo split\n" );
+        exit(1);
+    }
+    check_usage( seq, "memory usage after undo" );
+    gundo_history_redo( history );
+    check_usage( seq, "memory usage after redo" );
+
+    /* evicting keeps the redo side, and tells about it */
+    gundo_history_get_memory_usage( history, NULL, &redo );
+    g_signal_connect( seq, "changed", G_CALLBACK(count_changed), &n_changed );
+    gundo_sequence_set_max_size( seq, 1 );
+    gundo_history_get_memory_usage( history, &undo, &all );
+    if( undo.records != record || all.records != redo.records ) {
+        fprintf( stderr, "memory usage: FAILED: wrong usage after eviction\n" );
+        exit(1);
+    }
+    if( n_changed != 1 ) {
+        fprintf( stderr, "memory usage: FAILED: %d changed emissions on eviction\n", n_changed );
+        exit(1);
+    }
+    check_usage( seq, "memory usage after eviction" );
+
+    /* and truncating drops it */
+    gundo_sequence_set_max_size( seq, 0 );
+    do_inc( seq );
+    gundo_history_get_memory_usage( history, &undo, &redo );
+    if( usage_total( &redo ) || undo.records != 2 * record ) {
+        fprintf( stderr, "memory usage: FAILED: wrong usage after truncation\n" );
+        exit(1);
+    }
+    check_usage( seq, "memory usage after truncation" );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void test_deep_groups() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    int depth = 100000;
+    int i;
+
+    count = 0;
+
+    /* far deeper than any recursion would survive */
+    for( i = 0; i < depth; i++ ) {
+        gundo_sequence_start_group( seq );
+        do_inc( seq );
+    }
+    gundo_sequence_start_group( seq );
+    do_inc( seq );
+    gundo_sequence_abort_group( seq );
+    count--;
+    for( i = 0; i < depth; i++ ) {
+        gundo_sequence_end_group( seq );
+    }
+    if( gundo_history_get_position(history) != 1 ) {
+        fprintf( stderr, "deep groups: FAILED: expected a single step\n" );
+        exit(1);
+    }
+
+    gundo_history_undo( history );
+    check_value( 0, "undid deeply nested groups" );
+    gundo_history_redo( history );
+    check_value( depth, "redid deeply nested groups" );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void test_quiet_groups() {
+    GundoSequence *seq = gundo_sequence_new();
+    int n_changed = 0;
+    int n_notify = 0;
+    int i;
+
+    count = 0;
+
+    g_signal_connect( seq, "changed", G_CALLBACK(count_changed), &n_changed );
+    g_signal_connect( seq, "notify", G_CALLBACK(count_notify), &n_notify );
+
+    /* building a group doesn't emit anything */
+    gundo_sequence_start_group( seq );
+    for( i = 0; i < 100000; i++ ) {
+        if( i % 1000 == 0 ) {
+            gundo_sequence_start_group( seq );
+        }
+        do_inc( seq );
+        if( i % 1000 == 999 ) {
+            gundo_sequence_end_group( seq );
+        }
+    }
+    if( n_changed || n_notify ) {
+        fprintf( stderr, "quiet groups: FAILED: %d changed and %d notify emissions while building\n",
+                 n_changed, n_notify );
+        exit(1);
+    }
+
+    /* committing it does, once */
+    gundo_sequence_end_group( seq );
+    if( n_changed != 1 || n_notify != 1 ) {
+        fprintf( stderr, "quiet groups: FAILED: %d changed and %d notify emissions on commit\n",
+                 n_changed, n_notify );
+        exit(1);
+    }
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void test_add_actions() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    GundoActionEntry entries[100];
+    GundoMemoryUsage undo, redo;
+    int n_changed = 0;
+    int n_notify = 0;
+    int i;
+
+    count = 0;
+    do_inc( seq );
+    do_inc( seq );
+    gundo_history_undo( history );
+
+    g_signal_connect( seq, "changed", G_CALLBACK(count_changed), &n_changed );
+    g_signal_connect( seq, "notify", G_CALLBACK(count_notify), &n_notify );
+
+    /* one step per action, but a single truncation and emission */
+    n_freed = 0;
+    for( i = 0; i < 100; i++ ) {
+        entries[i].type = &test_undo_action;
+        entries[i].data = test_undo_data();
+        count++;
+    }
+    gundo_sequence_add_actions( seq, entries, 100, FALSE );
+    if( gundo_history_get_position(history) != 101 || gundo_history_get_n_redos(history) != 0 ||
+        n_freed != 1 || n_changed != 1 || n_notify != 1 ) {
+        fprintf( stderr, "add actions: FAILED: %u steps, %d changed and %d notify emissions\n",
+                 gundo_history_get_position(history), n_changed, n_notify );
+        exit(1);
+    }
+    gundo_history_undo_n( history, 100 );
+    check_value( 1, "undid a batch" );
+
+    /* as a group */
+    for( i = 0; i < 100; i++ ) {
+        entries[i].type = &test_undo_action;
+        entries[i].data = test_undo_data();
+        count++;
+    }
+    gundo_sequence_add_actions( seq, entries, 100, TRUE );
+    if( gundo_history_get_position(history) != 2 || gundo_history_get_n_redos(history) != 0 ) {
+        fprintf( stderr, "add actions: FAILED: expected the batch as a single step\n" );
+        exit(1);
+    }
+    gundo_history_undo( history );
+    check_value( 1, "undid a grouped batch" );
+
+    /* actions of a batch merge like single ones */
+    gundo_history_redo( history );
+    for( i = 0; i < 10; i++ ) {
+        MergeData *d = g_new( MergeData, 1 );
+        d->delta = 1;
+        count++;
+        entries[i].type = &test_merge_action;
+        entries[i].data = d;
+    }
+    gundo_sequence_add_actions( seq, entries, 10, FALSE );
+    if( gundo_history_get_position(history) != 3 ) {
+        fprintf( stderr, "add actions: FAILED: batch didn't merge\n" );
+        exit(1);
+    }
+    gundo_history_undo( history );
+    check_value( 101, "undid a merged batch" );
+
+    g_object_unref(G_OBJECT(seq));
+
+    /* the redo tail is dropped before the batch goes in */
+    seq = gundo_sequence_new();
+    history = GUNDO_HISTORY(seq);
+    count = 0;
+    for( i = 0; i < 2000; i++ ) {
+        do_inc( seq );
+    }
+    gundo_history_undo_n( history, 1000 );
+    n_changed = 0;
+    g_signal_connect( seq, "changed", G_CALLBACK(count_changed), &n_changed );
+    for( i = 0; i < 10; i++ ) {
+        entries[i].type = &test_undo_action;
+        entries[i].data = test_undo_data();
+        count++;
+    }
+    gundo_sequence_add_actions( seq, entries, 10, TRUE );
+    gundo_history_get_memory_usage( history, &undo, &redo );
+    if( n_changed != 1 || usage_total( &redo ) ||
+        undo.payloads != 1010 * sizeof(TestData) ||
+        gundo_history_get_position(history) != 1001 ||
+        gundo_history_get_n_redos(history) != 0 ) {
+        fprintf( stderr, "add actions: FAILED: %d changed emissions and %u payload bytes after truncating\n",
+                 n_changed, (guint) undo.payloads );
+        exit(1);
+    }
+    check_usage( seq, "add actions: usage after truncating" );
+    gundo_history_undo( history );
+    check_value( 1000, "undid a batch behind a truncation" );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void test_freeze_notify() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    int n_changed = 0;
+    int n_emissions = 0;
+    int n_undo_notify = 0;
+    int n_redo_notify = 0;
+
+    count = 0;
+    do_inc( seq );
+    do_inc( seq );
+
+    g_signal_connect( seq, "changed", G_CALLBACK(count_changed), &n_changed );
+    g_signal_connect( seq, "undo", G_CALLBACK(count_emission), &n_emissions );
+    g_signal_connect( seq, "redo", G_CALLBACK(count_emission), &n_emissions );
+    g_signal_connect( seq, "notify::can-undo", G_CALLBACK(count_notify), &n_undo_notify );
+    g_signal_connect( seq, "notify::can-redo", G_CALLBACK(count_notify), &n_redo_notify );
+
+    /* nothing gets out while frozen, not even with nested freezes */
+    gundo_history_freeze_notify( history );
+    gundo_history_freeze_notify( history );
+    gundo_history_undo( history );
+    gundo_history_undo( history );
+    gundo_history_redo( history );
+    do_inc( seq );
+    gundo_history_undo( history );
+    check_value( 1, "undid while frozen" );
+    gundo_history_thaw_notify( history );
+    if( !gundo_history_is_notify_frozen(history) || n_changed || n_emissions ||
+        n_undo_notify || n_redo_notify ) {
+        fprintf( stderr, "freeze notify: FAILED: %d changed, %d undo/redo, %d can-undo and %d can-redo emissions while frozen\n",
+                 n_changed, n_emissions, n_undo_notify, n_redo_notify );
+        exit(1);
+    }
+
+    /* thawing emits a single ::changed and only notifies about can-redo,
+     * as can-undo ended up where it started */
+    gundo_history_thaw_notify( history );
+    if( gundo_history_is_notify_frozen(history) || n_changed != 1 || n_emissions ||
+        n_undo_notify || n_redo_notify != 1 ) {
+        fprintf( stderr, "freeze notify: FAILED: %d changed, %d undo/redo, %d can-undo and %d can-redo emissions on thaw\n",
+                 n_changed, n_emissions, n_undo_notify, n_redo_notify );
+        exit(1);
+    }
+
+    /* a round trip still changes the history, but none of the states */
+    gundo_history_freeze_notify( history );
+    gundo_history_undo( history );
+    gundo_history_redo( history );
+    gundo_history_thaw_notify( history );
+    if( n_changed != 2 || n_undo_notify || n_redo_notify != 1 ) {
+        fprintf( stderr, "freeze notify: FAILED: %d changed, %d can-undo and %d can-redo emissions after a round trip\n",
+                 n_changed, n_undo_notify, n_redo_notify );
+        exit(1);
+    }
+
+    /* an idle freeze is silent */
+    gundo_history_freeze_notify( history );
+    gundo_history_thaw_notify( history );
+    if( n_changed != 2 ) {
+        fprintf( stderr, "freeze notify: FAILED: idle freeze emitted ::changed\n" );
+        exit(1);
+    }
+
+    /* and everything is back to normal */
+    gundo_history_undo( history );
+    if( n_emissions != 1 || n_undo_notify != 1 ) {
+        fprintf( stderr, "freeze notify: FAILED: still frozen after thaw\n" );
+        exit(1);
+    }
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+typedef struct {
+    guint n_undo_rows;
+    guint n_redo_rows;
+    int n_emissions;
+    GundoHistoryChange last;
+} StackRows;
+
+static void apply_stack_change( GundoStackChange const *change, guint *n_rows ) {
+    if( change->position + change->n_removed > *n_rows ) {
+        fprintf( stderr, "stacks changed: FAILED: removing %u rows at %u of %u\n",
+                 change->n_removed, change->position, *n_rows );
+        exit(1);
+    }
+    *n_rows = *n_rows - change->n_removed + change->n_added;
+}
+
+static void count_stacks_changed( GundoHistory *history, GundoHistoryChange const *change, StackRows *rows ) {
+    apply_stack_change( &change->undo, &rows->n_undo_rows );
+    apply_stack_change( &change->redo, &rows->n_redo_rows );
+    rows->last = *change;
+    rows->n_emissions++;
+}
+
+static void check_stack_rows( GundoHistory *history, StackRows const *rows, const char *what ) {
+    if( rows->n_undo_rows != gundo_history_get_position(history) ||
+        rows->n_redo_rows != gundo_history_get_n_redos(history) ) {
+        fprintf( stderr, "stacks changed: FAILED: %s: %u/%u rows for %u/%u changes\n", what,
+                 rows->n_undo_rows, rows->n_redo_rows,
+                 gundo_history_get_position(history), gundo_history_get_n_redos(history) );
+        exit(1);
+    }
+}
+
+static void test_stacks_changed() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    GundoActionEntry entries[10];
+    StackRows rows = { .n_emissions = 0 };
+    GundoHistoryChange *copy;
+    int i;
+
+    count = 0;
+    g_signal_connect( seq, "stacks-changed", G_CALLBACK(count_stacks_changed), &rows );
+
+    for( i = 0; i < 5; i++ ) {
+        do_inc( seq );
+    }
+    check_stack_rows( history, &rows, "added" );
+    if( rows.n_emissions != 5 || rows.last.undo.position != 0 || rows.last.undo.n_added != 1 ) {
+        fprintf( stderr, "stacks changed: FAILED: expected one row per add at the top\n" );
+        exit(1);
+    }
+
+    gundo_history_undo( history );
+    gundo_history_undo( history );
+    check_stack_rows( history, &rows, "undone" );
+    gundo_history_redo( history );
+    check_stack_rows( history, &rows, "redone" );
+
+    /* a jump is a single range per side */
+    rows.n_emissions = 0;
+    gundo_history_goto( history, 1 );
+    check_stack_rows( history, &rows, "jumped back" );
+    if( rows.n_emissions != 1 || rows.last.undo.n_removed != 3 || rows.last.redo.n_added != 3 ) {
+        fprintf( stderr, "stacks changed: FAILED: jump wasn't reported as a single range\n" );
+        exit(1);
+    }
+    gundo_history_goto( history, 3 );
+    check_stack_rows( history, &rows, "jumped forward" );
+
+    /* adding truncates the redoable changes in the same emission */
+    rows.n_emissions = 0;
+    do_inc( seq );
+    check_stack_rows( history, &rows, "truncated" );
+    if( rows.n_emissions != 1 || rows.last.redo.n_removed != 2 ) {
+        fprintf( stderr, "stacks changed: FAILED: truncation wasn't reported with the add\n" );
+        exit(1);
+    }
+
+    /* a batch is a single range, and so is a group */
+    gundo_history_undo( history );
+    rows.n_emissions = 0;
+    for( i = 0; i < 10; i++ ) {
+        entries[i].type = &test_undo_action;
+        entries[i].data = test_undo_data();
+        count++;
+    }
+    gundo_sequence_add_actions( seq, entries, 10, FALSE );
+    check_stack_rows( history, &rows, "added a batch" );
+    if( rows.n_emissions != 1 || rows.last.undo.n_added != 10 || rows.last.redo.n_removed != 1 ) {
+        fprintf( stderr, "stacks changed: FAILED: batch wasn't reported as a single range\n" );
+        exit(1);
+    }
+    rows.n_emissions = 0;
+    gundo_sequence_start_group( seq );
+    for( i = 0; i < 3; i++ ) {
+        do_inc( seq );
+    }
+    gundo_sequence_end_group( seq );
+    check_stack_rows( history, &rows, "added a group" );
+    if( rows.n_emissions != 1 ) {
+        fprintf( stderr, "stacks changed: FAILED: group wasn't reported as a single change\n" );
+        exit(1);
+    }
+
+    /* evicted changes go away at the bottom */
+    rows.n_emissions = 0;
+    gundo_sequence_set_max_size( seq, 1 );
+    check_stack_rows( history, &rows, "evicted" );
+    if( rows.n_emissions != 1 || rows.last.undo.position != 1 || rows.last.undo.n_added != 0 ) {
+        fprintf( stderr, "stacks changed: FAILED: eviction wasn't reported at the bottom\n" );
+        exit(1);
+    }
+
+    /* the change is boxed, so handlers can keep a copy */
+    copy = g_boxed_copy( GUNDO_TYPE_HISTORY_CHANGE, &rows.last );
+    if( !G_TYPE_IS_BOXED( GUNDO_TYPE_HISTORY_CHANGE ) || memcmp( copy, &rows.last, sizeof(*copy) ) ) {
+        fprintf( stderr, "stacks changed: FAILED: the change can't be copied as a boxed type\n" );
+        exit(1);
+    }
+    g_boxed_free( GUNDO_TYPE_HISTORY_CHANGE, copy );
+    gundo_sequence_set_max_size( seq, 0 );
+    for( i = 0; i < 3; i++ ) {
+        do_inc( seq );
+    }
+    g_object_unref(G_OBJECT(seq));
+
+    /* the new change is reported before the eviction it causes */
+    seq = g_object_new(GUNDO_TYPE_SEQUENCE, "max-depth", 2, NULL);
+    history = GUNDO_HISTORY(seq);
+    rows.n_undo_rows = rows.n_redo_rows = 0;
+    g_signal_connect( seq, "stacks-changed", G_CALLBACK(count_stacks_changed), &rows );
+    for( i = 0; i < 5; i++ ) {
+        do_inc( seq );
+    }
+    check_stack_rows( history, &rows, "added beyond the maximal depth" );
+    gundo_history_undo( history );
+    do_inc( seq );
+    do_inc( seq );
+    check_stack_rows( history, &rows, "truncated at the maximal depth" );
+
+    /* frozen changes come out as a single range replacing both sides */
+    rows.n_emissions = 0;
+    gundo_history_freeze_notify( history );
+    gundo_history_undo( history );
+    do_inc( seq );
+    gundo_history_undo( history );
+    gundo_history_undo( history );
+    gundo_history_thaw_notify( history );
+    check_stack_rows( history, &rows, "thawed" );
+    if( rows.n_emissions != 1 ) {
+        fprintf( stderr, "stacks changed: FAILED: %d emissions on thaw\n", rows.n_emissions );
+        exit(1);
+    }
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void test_add_actions_limits() {
+    GundoSequence *seq = g_object_new( GUNDO_TYPE_SEQUENCE, "max-depth", 100, NULL );
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    GundoActionEntry *entries = g_new( GundoActionEntry, 100000 );
+    GundoMemoryUsage undo, redo;
+    StackRows rows = { .n_emissions = 0 };
+    int n_notify = 0;
+    int i;
+
+    count = 0;
+    for( i = 0; i < 10; i++ ) {
+        do_inc( seq );
+    }
+    rows.n_undo_rows = 10;
+    rows.n_redo_rows = 0;
+    g_signal_connect( seq, "notify::n-evicted", G_CALLBACK(count_notify), &n_notify );
+    g_signal_connect( seq, "stacks-changed", G_CALLBACK(count_stacks_changed), &rows );
+
+    /* max-depth holds while a big batch goes in, but is only reported at
+     * the end */
+    for( i = 0; i < 100000; i++ ) {
+        entries[i].type = &test_undo_action;
+        entries[i].data = test_undo_data();
+        count++;
+    }
+    n_freed = 0;
+    gundo_sequence_add_actions( seq, entries, 100000, FALSE );
+    if( n_freed != 100000 + 10 - 100 ||
+        gundo_history_get_position( history ) != 100 ||
+        gundo_sequence_get_n_evicted( seq ) != 100000 + 10 - 100 || n_notify != 1 ) {
+        fprintf( stderr, "add actions limits: FAILED: %d freed, %u evicted, %d notify emissions\n",
+                 n_freed, gundo_sequence_get_n_evicted( seq ), n_notify );
+        exit(1);
+    }
+    check_stack_rows( history, &rows, "add actions limits: max-depth" );
+    check_usage( seq, "add actions limits: usage after max-depth" );
+    gundo_history_undo_n( history, 100 );
+    check_value( 100000 + 10 - 100, "add actions limits: undid what was kept" );
+    gundo_history_redo_n( history, 100 );
+
+    /* max-size holds once the batch is in */
+    gundo_sequence_set_max_depth( seq, 0 );
+    gundo_history_get_memory_usage( history, &undo, &redo );
+    gundo_sequence_set_max_size( seq, usage_total( &undo ) );
+    n_notify = 0;
+    for( i = 0; i < 1000; i++ ) {
+        entries[i].type = &test_undo_action;
+        entries[i].data = test_undo_data();
+        count++;
+    }
+    gundo_sequence_add_actions( seq, entries, 1000, FALSE );
+    if( gundo_sequence_get_size( seq ) > usage_total( &undo ) || n_notify != 1 ) {
+        fprintf( stderr, "add actions limits: FAILED: %u bytes over a budget of %u, %d notify emissions\n",
+                 (guint) gundo_sequence_get_size( seq ), (guint) usage_total( &undo ), n_notify );
+        exit(1);
+    }
+    check_stack_rows( history, &rows, "add actions limits: max-size" );
+    check_usage( seq, "add actions limits: usage after max-size" );
+
+    g_free( entries );
+    g_object_unref(G_OBJECT(seq));
+}
+
+static void test_quiet_group_budget() {
+    GundoSequence *seq = gundo_sequence_new();
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    GundoMemoryUsage undo, redo;
+    StackRows rows = { .n_emissions = 0 };
+    int n_notify = 0;
+
+    count = 0;
+    do_inc( seq );
+    do_inc( seq );
+    do_inc( seq );
+    gundo_history_get_memory_usage( history, &undo, &redo );
+    gundo_sequence_set_max_size( seq, usage_total( &undo ) );
+    rows.n_undo_rows = 3;
+    rows.n_redo_rows = 0;
+    g_signal_connect( seq, "notify::n-evicted", G_CALLBACK(count_notify), &n_notify );
+    g_signal_connect( seq, "stacks-changed", G_CALLBACK(count_stacks_changed), &rows );
+
+    /* merging into the group's latest record doesn't evict while it's open */
+    gundo_sequence_start_group( seq );
+    do_add( seq, 1 );
+    do_add( seq, 1 );
+    do_add( seq, 1 );
+    if( n_notify || rows.n_emissions || gundo_sequence_get_n_evicted(seq) ) {
+        fprintf( stderr, "quiet group budget: FAILED: %d notify and %d stacks emissions, %u evicted while building\n",
+                 n_notify, rows.n_emissions, gundo_sequence_get_n_evicted(seq) );
+        exit(1);
+    }
+
+    /* committing it enforces the budget */
+    gundo_sequence_end_group( seq );
+    if( n_notify != 1 || !gundo_sequence_get_n_evicted(seq) ) {
+        fprintf( stderr, "quiet group budget: FAILED: %d notify emissions, %u evicted on commit\n",
+                 n_notify, gundo_sequence_get_n_evicted(seq) );
+        exit(1);
+    }
+    check_stack_rows( history, &rows, "quiet group budget" );
+    check_value( 6, "quiet group budget" );
+
+    g_object_unref(G_OBJECT(seq));
+}
+
+static int n_step_calls = 0;
+
+static void undo_step( gpointer p ) {
+    n_step_calls++;
+    undo_add( p );
+}
+
+static void redo_step( gpointer p ) {
+    n_step_calls++;
+    redo_add( p );
+}
+
+static GundoActionType test_weight_action = { .undo = undo_step, .redo = redo_step, .free = free_data };
+
+static void do_step( GundoSequence *seq, int delta ) {
+    MergeData *d = g_new( MergeData, 1 );
+    d->delta = delta;
+    count += delta;
+    gundo_sequence_add_action( seq, &test_weight_action, d );
+}
+
+typedef struct {
+    guint branch;
+    guint fork;
+    guint n_steps;
+} BranchTip;
+
+static void collect_branch( guint branch, guint fork, guint n_steps, gpointer user_data ) {
+    GArray *tips = user_data;
+    BranchTip tip = { branch, fork, n_steps };
+    g_array_append_val( tips, tip );
+}
+
+/* looks up the branch with its tip @n_steps steps deep and forking off the
+ * current line after @fork steps */
+static guint find_branch( GundoSequence *seq, guint fork, guint n_steps ) {
+    GArray *tips = g_array_new( FALSE, FALSE, sizeof(BranchTip) );
+    guint branch = G_MAXUINT;
+    guint i;
+
+    gundo_sequence_foreach_branch( seq, collect_branch, tips );
+    for( i = 0; i < tips->len; i++ ) {
+        BranchTip *tip = &g_array_index( tips, BranchTip, i );
+        if( tip->fork == fork && tip->n_steps == n_steps ) {
+            if( branch != G_MAXUINT ) {
+                fprintf( stderr, "branches: FAILED: more than one branch with fork %u and %u steps\n", fork, n_steps );
+                exit(1);
+            }
+            branch = tip->branch;
+        }
+    }
+    g_array_free( tips, TRUE );
+
+    if( branch == G_MAXUINT ) {
+        fprintf( stderr, "branches: FAILED: no branch with fork %u and %u steps\n", fork, n_steps );
+        exit(1);
+    }
+    return branch;
+}
+
+static void test_branches() {
+    GundoSequence *seq = g_object_new(GUNDO_TYPE_SEQUENCE, "branching", TRUE, NULL);
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    GundoMemoryUsage redo_usage;
+    StackRows rows = { .n_emissions = 0 };
+    guint line, bc, d, e, g;
+
+    count = 0;
+    n_freed = 0;
+    g_signal_connect( seq, "stacks-changed", G_CALLBACK(count_stacks_changed), &rows );
+
+    /* A B C, then A D: B C is kept */
+    do_step( seq, 1 );
+    do_step( seq, 10 );
+    do_step( seq, 100 );
+    line = gundo_sequence_get_branch( seq );
+    gundo_history_undo_n( history, 2 );
+    do_step( seq, 1000 );
+    check_value( 1001, "added on a new branch" );
+    bc = find_branch( seq, 1, 3 );
+    if( bc != line || gundo_sequence_get_branch(seq) == line || n_freed ||
+        gundo_history_can_redo(history) || gundo_history_get_position(history) != 2 ) {
+        fprintf( stderr, "branches: FAILED: the redoable changes weren't kept as a branch\n" );
+        exit(1);
+    }
+    gundo_history_get_memory_usage( history, NULL, &redo_usage );
+    if( !redo_usage.records ) {
+        fprintf( stderr, "branches: FAILED: the branch isn't accounted\n" );
+        exit(1);
+    }
+
+    /* A E: A D is kept */
+    gundo_history_undo( history );
+    do_step( seq, 10000 );
+    d = find_branch( seq, 1, 2 );
+    e = gundo_sequence_get_branch( seq );
+    check_stack_rows( history, &rows, "branched twice" );
+
+    /* back to A B C, and A B G from there */
+    if( !gundo_sequence_switch_branch( seq, bc ) ) {
+        fprintf( stderr, "branches: FAILED: couldn't switch branches\n" );
+        exit(1);
+    }
+    check_value( 111, "switched to a branch" );
+    check_stack_rows( history, &rows, "switched to a branch" );
+    if( gundo_sequence_get_branch(seq) != bc || gundo_sequence_get_n_branches(seq) != 2 ) {
+        fprintf( stderr, "branches: FAILED: expected A D and A E to be left\n" );
+        exit(1);
+    }
+    gundo_history_undo( history );
+    do_step( seq, 100000 );
+    do_step( seq, 1000000 );
+    check_value( 1100011, "added on a nested branch" );
+    g = gundo_sequence_get_branch( seq );
+
+    /* A D leaves A B G H behind, with C forking off B */
+    gundo_sequence_switch_branch( seq, d );
+    check_value( 1001, "switched to an older branch" );
+    check_stack_rows( history, &rows, "switched to an older branch" );
+    if( gundo_sequence_get_n_branches(seq) != 3 || find_branch( seq, 1, 2 ) != e ||
+        find_branch( seq, 1, 3 ) != bc || find_branch( seq, 1, 4 ) != g ) {
+        fprintf( stderr, "branches: FAILED: unexpected branches after switching\n" );
+        exit(1);
+    }
+
+    /* this splits A B G H at B */
+    gundo_sequence_switch_branch( seq, bc );
+    check_value( 111, "switched to a nested branch" );
+    check_stack_rows( history, &rows, "switched to a nested branch" );
+    if( find_branch( seq, 2, 4 ) != g ) {
+        fprintf( stderr, "branches: FAILED: G H doesn't fork off B\n" );
+        exit(1);
+    }
+    /* only the steps between the tips and B are run */
+    n_step_calls = 0;
+    gundo_sequence_switch_branch( seq, g );
+    check_value( 1100011, "switched to a sibling" );
+    if( n_step_calls != 3 ) {
+        fprintf( stderr, "branches: FAILED: %d callbacks to switch to a sibling, expected 3\n", n_step_calls );
+        exit(1);
+    }
+    gundo_sequence_switch_branch( seq, e );
+    check_value( 10001, "switched to a cousin" );
+    check_stack_rows( history, &rows, "switched to a cousin" );
+
+    /* switching to the current branch goes to its tip */
+    gundo_history_undo( history );
+    gundo_sequence_switch_branch( seq, e );
+    check_value( 10001, "switched to the current branch" );
+    if( gundo_sequence_switch_branch( seq, 12345 ) ) {
+        fprintf( stderr, "branches: FAILED: switched to an unknown branch\n" );
+        exit(1);
+    }
+    if( n_freed ) {
+        fprintf( stderr, "branches: FAILED: %d actions freed while switching\n", n_freed );
+        exit(1);
+    }
+
+    /* the least recently left branches without branches of their own go first */
+    gundo_sequence_set_max_branches( seq, 2 );
+    if( gundo_sequence_get_n_branches(seq) != 2 || !n_freed ) {
+        fprintf( stderr, "branches: FAILED: the branches weren't limited\n" );
+        exit(1);
+    }
+    gundo_sequence_set_max_branch_size( seq, 1 );
+    if( gundo_sequence_get_n_branches(seq) != 0 ) {
+        fprintf( stderr, "branches: FAILED: the branches weren't limited in size\n" );
+        exit(1);
+    }
+    gundo_history_get_memory_usage( history, NULL, &redo_usage );
+    if( redo_usage.records || redo_usage.payloads ) {
+        fprintf( stderr, "branches: FAILED: discarded branches are still accounted\n" );
+        exit(1);
+    }
+    gundo_sequence_set_max_branch_size( seq, 0 );
+    gundo_sequence_set_max_branches( seq, 0 );
+
+    /* without branching, the redoable changes are gone again */
+    gundo_history_undo( history );
+    do_step( seq, 1 );
+    gundo_sequence_set_branching( seq, FALSE );
+    if( gundo_sequence_get_n_branches(seq) != 0 ) {
+        fprintf( stderr, "branches: FAILED: branches kept without branching\n" );
+        exit(1);
+    }
+
+    g_object_unref(G_OBJECT(seq));
+
+    /* branches forking off evicted steps are discarded */
+    seq = g_object_new(GUNDO_TYPE_SEQUENCE, "branching", TRUE, "max-depth", 2, NULL);
+    history = GUNDO_HISTORY(seq);
+    count = 0;
+    do_step( seq, 1 );
+    do_step( seq, 10 );
+    gundo_history_undo( history );
+    do_step( seq, 100 );
+    do_step( seq, 1000 );
+    bc = find_branch( seq, 0, 1 );
+    do_step( seq, 10000 );
+    if( gundo_sequence_get_n_branches(seq) != 0 ) {
+        fprintf( stderr, "branches: FAILED: kept a branch forking off an evicted step\n" );
+        exit(1);
+    }
+    g_object_unref(G_OBJECT(seq));
+}
+
+static int n_deserialized = 0;
+/* the delta of the payload whose bytes count as damaged, 0 for none */
+static int damaged_delta = 0;
+
+static gsize size_add( gpointer p ) {
+    return sizeof(MergeData);
+}
+
+static void serialize_add( gpointer p, GByteArray *buffer ) {
+    g_byte_array_append( buffer, p, sizeof(MergeData) );
+}
+
+static gpointer deserialize_add( gconstpointer bytes, gsize len ) {
+    MergeData *d = g_new( MergeData, 1 );
+
+    if( len != sizeof(MergeData) ) {
+        fprintf( stderr, "history file: FAILED: read back %u bytes\n", (guint) len );
+        exit(1);
+    }
+    memcpy( d, bytes, len );
+    if( damaged_delta && d->delta == damaged_delta ) {
+        g_free( d );
+        return NULL;
+    }
+    n_deserialized++;
+    return d;
+}
+
+static GundoActionType test_file_action = { .undo = undo_add, .redo = redo_add, .free = free_data,
+                                            .size = size_add,
+                                            .serialize = serialize_add,
+                                            .deserialize = deserialize_add };
+
+static void do_file_add( GundoSequence *seq, int delta ) {
+    MergeData *d = g_new( MergeData, 1 );
+    d->delta = delta;
+    count += delta;
+    gundo_sequence_add_action( seq, &test_file_action, d );
+}
+
+static void check_steps( GundoSequence *seq, guint n_undos, guint n_redos, const char *test_id ) {
+    if( gundo_history_get_position( GUNDO_HISTORY(seq) ) != n_undos ||
+        gundo_history_get_n_redos( GUNDO_HISTORY(seq) ) != n_redos ) {
+        fprintf( stderr, "%s: FAILED: expected %u/%u steps, got %u/%u\n", test_id, n_undos, n_redos,
+                 gundo_history_get_position( GUNDO_HISTORY(seq) ),
+                 gundo_history_get_n_redos( GUNDO_HISTORY(seq) ) );
+        exit(1);
+    }
+}
+
+static void check_error( GError *error, GQuark domain, gint code, const char *test_id ) {
+    if( !error || error->domain != domain || error->code != code ) {
+        fprintf( stderr, "%s: FAILED: expected error %i, got %s\n", test_id, code,
+                 error ? error->message : "none" );
+        exit(1);
+    }
+}
+
+static void test_history_file() {
+    const GundoActionType *types[] = { &test_weight_action, &test_file_action, &test_inline_action };
+    GundoSequence *seq = gundo_sequence_new();
+    GundoSequence *loaded;
+    GundoSequence *again;
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    GundoMemoryUsage undo, redo, loaded_undo, loaded_redo;
+    GStatBuf stat_buf;
+    GError *error = NULL;
+    MergeData d;
+    gchar *filename;
+    gchar *contents;
+    gsize length;
+    int fd;
+    int i;
+
+    filename = g_build_filename( g_get_tmp_dir(), "tundo-XXXXXX", NULL );
+    fd = g_mkstemp( filename );
+    if( fd < 0 ) {
+        fprintf( stderr, "history file: FAILED: can't create %s\n", filename );
+        exit(1);
+    }
+    close( fd );
+
+    count = 0;
+    for( i = 1; i <= 100; i++ ) {
+        do_file_add( seq, i );
+    }
+    d.delta = 1000;
+    count += d.delta;
+    gundo_sequence_add_action_inline( seq, &test_inline_action, &d, sizeof(d) );
+    /* the arena of the group isn't saved, the actions in it are */
+    gundo_sequence_start_group( seq );
+    do_file_add( seq, 10000 );
+    gundo_sequence_start_group( seq );
+    do_file_add( seq, 20000 );
+    gundo_sequence_end_group( seq );
+    gundo_sequence_group_alloc( seq, 16 );
+    gundo_sequence_end_group( seq );
+    do_file_add( seq, 40000 );
+    gundo_history_undo( history );
+    check_value( 5050 + 1000 + 30000, "history file: recorded" );
+
+    /* the saved file replaces the old one, with its permissions */
+    g_chmod( filename, 0640 );
+    if( !gundo_sequence_save( seq, filename, types, G_N_ELEMENTS(types), &error ) ) {
+        fprintf( stderr, "history file: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    if( g_stat( filename, &stat_buf ) || (stat_buf.st_mode & 0777) != 0640 ) {
+        fprintf( stderr, "history file: FAILED: the saved file has mode %o\n", stat_buf.st_mode & 0777 );
+        exit(1);
+    }
+
+    /* loading only reads the index */
+    n_deserialized = 0;
+    loaded = gundo_sequence_new();
+    if( !gundo_sequence_load( loaded, filename, types, G_N_ELEMENTS(types), &error ) ) {
+        fprintf( stderr, "history file: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    check_steps( loaded, 102, 1, "history file: loaded" );
+    gundo_history_get_memory_usage( GUNDO_HISTORY(loaded), &loaded_undo, &loaded_redo );
+    if( n_deserialized != 0 || loaded_undo.payloads != 0 || loaded_redo.payloads != 0 ||
+        !gundo_history_can_undo( GUNDO_HISTORY(loaded) ) || !gundo_history_can_redo( GUNDO_HISTORY(loaded) ) ) {
+        fprintf( stderr, "history file: FAILED: loading materialized actions\n" );
+        exit(1);
+    }
+
+    /* actions get materialized as they are reached */
+    gundo_history_redo( GUNDO_HISTORY(loaded) );
+    gundo_history_undo( GUNDO_HISTORY(loaded) );
+    gundo_history_undo( GUNDO_HISTORY(loaded) );
+    check_value( 5050 + 1000, "history file: undid a loaded group" );
+    if( n_deserialized != 3 ) {
+        fprintf( stderr, "history file: FAILED: deserialized %i actions, expected 3\n", n_deserialized );
+        exit(1);
+    }
+    check_usage( loaded, "history file: usage after materializing" );
+
+    /* save the partly materialized sequence over the file it was loaded from */
+    if( !gundo_sequence_save( loaded, filename, types, G_N_ELEMENTS(types), &error ) ) {
+        fprintf( stderr, "history file: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    while( gundo_history_can_undo( GUNDO_HISTORY(loaded) ) ) {
+        gundo_history_undo( GUNDO_HISTORY(loaded) );
+    }
+    check_value( 0, "history file: undid the loaded sequence" );
+    if( n_deserialized != 103 ) {
+        fprintf( stderr, "history file: FAILED: deserialized %i actions, expected 103\n", n_deserialized );
+        exit(1);
+    }
+    while( gundo_history_can_undo( history ) ) {
+        gundo_history_undo( history );
+    }
+    check_value( -5050 - 1000 - 30000, "history file: undid the original sequence" );
+    count = 0;
+
+    /* the same payloads end up on the redo side */
+    gundo_history_get_memory_usage( history, &undo, &redo );
+    gundo_history_get_memory_usage( GUNDO_HISTORY(loaded), &loaded_undo, &loaded_redo );
+    if( loaded_redo.payloads != redo.payloads || loaded_redo.records != redo.records ||
+        loaded_undo.payloads != 0 ) {
+        fprintf( stderr, "history file: FAILED: loaded payloads are accounted wrongly\n" );
+        exit(1);
+    }
+    check_usage( loaded, "history file: usage after undoing" );
+    g_object_unref( loaded );
+
+    again = gundo_sequence_new();
+    if( !gundo_sequence_load( again, filename, types, G_N_ELEMENTS(types), &error ) ) {
+        fprintf( stderr, "history file: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    check_steps( again, 101, 2, "history file: loaded again" );
+    while( gundo_history_can_redo( GUNDO_HISTORY(again) ) ) {
+        gundo_history_redo( GUNDO_HISTORY(again) );
+    }
+    check_value( 40000 + 30000, "history file: redid the saved copy" );
+    while( gundo_history_can_undo( GUNDO_HISTORY(again) ) ) {
+        gundo_history_undo( GUNDO_HISTORY(again) );
+    }
+    check_value( -5050 - 1000, "history file: undid the saved copy" );
+    g_object_unref( again );
+
+    /* a payload that can't be deserialized stops undo and jumps in front
+     * of its step */
+    damaged_delta = 50;
+    again = gundo_sequence_new();
+    if( !gundo_sequence_load( again, filename, types, G_N_ELEMENTS(types), &error ) ||
+        !gundo_sequence_get_restore_error( again, NULL ) ) {
+        fprintf( stderr, "history file: FAILED: damaged payload failed early\n" );
+        exit(1);
+    }
+    gundo_history_goto( GUNDO_HISTORY(again), 0 );
+    gundo_history_undo( GUNDO_HISTORY(again) );
+    if( gundo_history_get_position( GUNDO_HISTORY(again) ) != 50 ||
+        gundo_sequence_get_restore_error( again, &error ) ) {
+        fprintf( stderr, "history file: FAILED: got to %u past a damaged payload\n",
+                 gundo_history_get_position( GUNDO_HISTORY(again) ) );
+        exit(1);
+    }
+    check_error( error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_INVALID_FILE, "history file: damaged payload" );
+    g_clear_error( &error );
+    check_usage( again, "history file: usage with a damaged payload" );
+    damaged_delta = 0;
+    g_object_unref( again );
+    count = 0;
+
+    /* types missing from the table or without callbacks */
+    if( gundo_sequence_save( seq, filename, types, 1, &error ) ) {
+        fprintf( stderr, "history file: FAILED: saved an unknown type\n" );
+        exit(1);
+    }
+    check_error( error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED, "history file: unknown type" );
+    g_clear_error( &error );
+    gundo_sequence_add_action( seq, &test_weight_action, g_new0( MergeData, 1 ) );
+    if( gundo_sequence_save( seq, filename, types, G_N_ELEMENTS(types), &error ) ) {
+        fprintf( stderr, "history file: FAILED: saved a type without serialize callback\n" );
+        exit(1);
+    }
+    check_error( error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED, "history file: no serializer" );
+    g_clear_error( &error );
+    loaded = gundo_sequence_new();
+    if( gundo_sequence_load( loaded, filename, types, 2, &error ) ) {
+        fprintf( stderr, "history file: FAILED: loaded with a short type table\n" );
+        exit(1);
+    }
+    check_error( error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED, "history file: short table" );
+    g_clear_error( &error );
+
+    /* the failed saves left the file alone, cut it short now */
+    if( !g_file_get_contents( filename, &contents, &length, NULL ) ||
+        !g_file_set_contents( filename, contents, length - 20, NULL ) ) {
+        fprintf( stderr, "history file: FAILED: can't truncate %s\n", filename );
+        exit(1);
+    }
+    g_free( contents );
+    if( gundo_sequence_load( loaded, filename, types, G_N_ELEMENTS(types), &error ) ) {
+        fprintf( stderr, "history file: FAILED: loaded a truncated file\n" );
+        exit(1);
+    }
+    check_error( error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_INVALID_FILE, "history file: truncated" );
+    g_clear_error( &error );
+    check_steps( loaded, 0, 0, "history file: failed load" );
+    g_object_unref( loaded );
+
+    g_unlink( filename );
+    g_free( filename );
+    g_object_unref( seq );
+}
+
+static GundoActionType test_file_merge_action = { .undo = undo_add, .redo = redo_add, .free = free_data,
+                                                  .size = size_add, .merge = merge_add,
+                                                  .serialize = serialize_add,
+                                                  .deserialize = deserialize_add };
+
+static gchar *temp_filename( void ) {
+    gchar *filename = g_build_filename( g_get_tmp_dir(), "tundo-XXXXXX", NULL );
+    int fd = g_mkstemp( filename );
+
+    if( fd < 0 ) {
+        fprintf( stderr, "FAILED: can't create %s\n", filename );
+        exit(1);
+    }
+    close( fd );
+    return filename;
+}
+
+static void open_journal( GundoSequence *seq, const gchar *filename,
+                          const GundoActionType * const *types, guint n_types ) {
+    GError *error = NULL;
+
+    if( !gundo_sequence_open_journal( seq, filename, types, n_types, NULL, &error ) ) {
+        fprintf( stderr, "journal: FAILED: %s\n", error->message );
+        exit(1);
+    }
+}
+
+static void test_journal() {
+    const GundoActionType *types[] = { &test_file_action, &test_inline_action, &test_file_merge_action };
+    GundoSequence *seq = gundo_sequence_new();
+    GundoSequence *recovered;
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    GError *error = NULL;
+    MergeData d;
+    gchar *filename = temp_filename();
+    gchar *crashed = temp_filename();
+    gchar *contents;
+    gchar *torn;
+    gsize length;
+    guint n_replayed;
+    int expected;
+    int i;
+
+    /* an empty file is an empty journal */
+    open_journal( seq, filename, types, G_N_ELEMENTS(types) );
+    count = 0;
+    for( i = 1; i <= 5; i++ ) {
+        do_file_add( seq, i );
+    }
+    d.delta = 100;
+    count += d.delta;
+    gundo_sequence_add_action_inline( seq, &test_inline_action, &d, sizeof(d) );
+    for( i = 0; i < 3; i++ ) {
+        MergeData *m = g_new( MergeData, 1 );
+        m->delta = 1000;
+        count += m->delta;
+        gundo_sequence_add_action( seq, &test_file_merge_action, m );
+    }
+    gundo_sequence_start_group( seq );
+    do_file_add( seq, 10000 );
+    gundo_sequence_start_group( seq );
+    do_file_add( seq, 20000 );
+    gundo_sequence_end_group( seq );
+    gundo_sequence_end_group( seq );
+    gundo_history_undo( history );
+    gundo_history_undo( history );
+    gundo_history_redo( history );
+    /* aborting a group keeps the changes, it only drops their record */
+    gundo_sequence_start_group( seq );
+    do_file_add( seq, 100000 );
+    gundo_sequence_abort_group( seq );
+    /* a group in the works when the application crashes */
+    gundo_sequence_start_group( seq );
+    do_file_add( seq, 200000 );
+    check_steps( seq, 7, 1, "journal: recorded" );
+    expected = count;
+
+    if( !gundo_sequence_sync_journal( seq, &error ) ||
+        !g_file_get_contents( filename, &contents, &length, NULL ) ) {
+        fprintf( stderr, "journal: FAILED: can't read the synced journal\n" );
+        exit(1);
+    }
+    /* the crash also tore the record that was being written */
+    torn = g_malloc( length + 10 );
+    memcpy( torn, contents, length );
+    memset( torn + length, 0x5a, 10 );
+    if( !g_file_set_contents( crashed, torn, length + 10, NULL ) ) {
+        fprintf( stderr, "journal: FAILED: can't write %s\n", crashed );
+        exit(1);
+    }
+    g_free( torn );
+    g_free( contents );
+
+    /* recovering applies the actions again, starting from scratch */
+    count = 0;
+    recovered = gundo_sequence_new();
+    open_journal( recovered, crashed, types, G_N_ELEMENTS(types) );
+    check_value( expected, "journal: recovered" );
+    check_steps( recovered, 7, 1, "journal: recovered" );
+
+    /* the recovered sequence keeps journaling after the torn record */
+    do_file_add( recovered, 7 );
+    expected = count;
+    g_object_unref( recovered );
+
+    count = 0;
+    recovered = gundo_sequence_new();
+    open_journal( recovered, crashed, types, G_N_ELEMENTS(types) );
+    check_value( expected, "journal: recovered twice" );
+    check_steps( recovered, 8, 0, "journal: recovered twice" );
+    while( gundo_history_can_undo( GUNDO_HISTORY(recovered) ) ) {
+        gundo_history_undo( GUNDO_HISTORY(recovered) );
+    }
+    check_value( 100000 + 200000, "journal: undid the recovered history" );
+    if( !gundo_sequence_close_journal( recovered, &error ) ) {
+        fprintf( stderr, "journal: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    g_object_unref( recovered );
+
+    /* a replay that fails keeps what it applied, and says how much it was */
+    count = 0;
+    recovered = gundo_sequence_new();
+    if( gundo_sequence_open_journal( recovered, crashed, types, 1, &n_replayed, &error ) ) {
+        fprintf( stderr, "journal: FAILED: replayed an unknown action type\n" );
+        exit(1);
+    }
+    check_error( error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED, "journal: unknown type" );
+    g_clear_error( &error );
+    if( n_replayed != 5 ) {
+        fprintf( stderr, "journal: FAILED: replayed %u operations, expected 5\n", n_replayed );
+        exit(1);
+    }
+    check_value( 1 + 2 + 3 + 4 + 5, "journal: partly replayed" );
+    check_steps( recovered, 5, 0, "journal: partly replayed" );
+    do_file_add( recovered, 6 );
+    check_steps( recovered, 6, 0, "journal: added after a failed replay" );
+    g_object_unref( recovered );
+
+    /* actions that can't be journaled stop the journal */
+    gundo_sequence_end_group( seq );
+    gundo_sequence_add_action( seq, &test_weight_action, g_new0( MergeData, 1 ) );
+    if( gundo_sequence_sync_journal( seq, &error ) ) {
+        fprintf( stderr, "journal: FAILED: journaled an action without serializer\n" );
+        exit(1);
+    }
+    check_error( error, GUNDO_SEQUENCE_ERROR, GUNDO_SEQUENCE_ERROR_UNSUPPORTED, "journal: no serializer" );
+    g_clear_error( &error );
+    if( gundo_sequence_close_journal( seq, &error ) ) {
+        fprintf( stderr, "journal: FAILED: closed a failed journal\n" );
+        exit(1);
+    }
+    g_clear_error( &error );
+    g_object_unref( seq );
+
+    g_unlink( crashed );
+    g_unlink( filename );
+    g_free( crashed );
+    g_free( filename );
+}
+
+static void open_spill( GundoSequence *seq, const gchar *filename ) {
+    GError *error = NULL;
+
+    if( !gundo_sequence_open_spill( seq, filename, &error ) ) {
+        fprintf( stderr, "spill: FAILED: %s\n", error->message );
+        exit(1);
+    }
+}
+
+static void test_spill() {
+    const GundoActionType *types[] = { &test_weight_action, &test_file_action, &test_inline_action };
+    GundoSequence *seq = g_object_new( GUNDO_TYPE_SEQUENCE, "spill-depth", 10, NULL );
+    GundoSequence *loaded;
+    GundoSequence *deep;
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    GundoMemoryUsage undo, redo, resident;
+    GError *error = NULL;
+    MergeData d;
+    gchar *filename = temp_filename();
+    int freed;
+    int i;
+
+    count = 0;
+    for( i = 1; i <= 1000; i++ ) {
+        do_file_add( seq, i );
+    }
+    d.delta = 1000000;
+    count += d.delta;
+    gundo_sequence_add_action_inline( seq, &test_inline_action, &d, sizeof(d) );
+    gundo_sequence_start_group( seq );
+    do_file_add( seq, 10000000 );
+    d.delta = 20000000;
+    count += d.delta;
+    gundo_sequence_add_action_inline( seq, &test_inline_action, &d, sizeof(d) );
+    gundo_sequence_end_group( seq );
+    gundo_history_get_memory_usage( history, &resident, NULL );
+
+    /* opening the spill moves all but the latest steps out */
+    n_freed = 0;
+    n_deserialized = 0;
+    open_spill( seq, NULL );
+    for( i = 1; i <= 20; i++ ) {
+        do_file_add( seq, -i );
+    }
+    check_value( 500500 + 1000000 + 30000000 - 210, "spill: recorded" );
+    check_steps( seq, 1022, 0, "spill: recorded" );
+    gundo_history_get_memory_usage( history, &undo, &redo );
+    if( n_freed != 1000 + 1 + 10 || n_deserialized != 0 ||
+        undo.payloads >= resident.payloads / 10 ) {
+        fprintf( stderr, "spill: FAILED: spilled %i actions, %u payload bytes left\n",
+                 n_freed, (guint) undo.payloads );
+        exit(1);
+    }
+    check_usage( seq, "spill: usage after spilling" );
+
+    /* undoing loads them back */
+    for( i = 0; i < 15; i++ ) {
+        gundo_history_undo( history );
+    }
+    check_value( 500500 + 1000000 + 30000000 - 15, "spill: undid some" );
+    if( n_deserialized != 5 ) {
+        fprintf( stderr, "spill: FAILED: loaded %i actions, expected 5\n", n_deserialized );
+        exit(1);
+    }
+    check_usage( seq, "spill: usage after undoing" );
+
+    /* spilled actions get saved without being loaded */
+    if( !gundo_sequence_save( seq, filename, types, G_N_ELEMENTS(types), &error ) ) {
+        fprintf( stderr, "spill: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    while( gundo_history_can_undo( history ) ) {
+        gundo_history_undo( history );
+    }
+    check_value( 0, "spill: undid everything" );
+    check_usage( seq, "spill: usage after undoing everything" );
+    gundo_history_goto( history, 1007 );
+    check_value( 500500 + 1000000 + 30000000 - 15, "spill: redid" );
+    check_usage( seq, "spill: usage after redoing" );
+
+    count = 0;
+    loaded = gundo_sequence_new();
+    if( !gundo_sequence_load( loaded, filename, types, G_N_ELEMENTS(types), &error ) ) {
+        fprintf( stderr, "spill: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    check_steps( loaded, 1007, 15, "spill: loaded" );
+    while( gundo_history_can_undo( GUNDO_HISTORY(loaded) ) ) {
+        gundo_history_undo( GUNDO_HISTORY(loaded) );
+    }
+    check_value( -500500 - 1000000 - 30000000 + 15, "spill: undid the saved copy" );
+    g_object_unref( loaded );
+
+    /* closing the spill brings everything back */
+    freed = n_freed;
+    if( !gundo_sequence_close_spill( seq, &error ) ) {
+        fprintf( stderr, "spill: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    gundo_history_get_memory_usage( history, &undo, &redo );
+    if( n_freed != freed || undo.payloads < resident.payloads ) {
+        fprintf( stderr, "spill: FAILED: closing didn't load the actions back\n" );
+        exit(1);
+    }
+    check_usage( seq, "spill: usage after closing" );
+
+    /* actions that can't be serialized stay */
+    gundo_sequence_set_spill_depth( seq, 1 );
+    open_spill( seq, filename );
+    count = 0;
+    do_step( seq, 1 );
+    /* this would spill the step before */
+    n_freed = 0;
+    do_step( seq, 2 );
+    do_step( seq, 3 );
+    gundo_history_undo( history );
+    gundo_history_undo( history );
+    check_value( 1, "spill: undid unserializable actions" );
+    if( n_freed != 0 ) {
+        fprintf( stderr, "spill: FAILED: spilled an unserializable action\n" );
+        exit(1);
+    }
+    check_usage( seq, "spill: usage with unserializable actions" );
+    g_object_unref( seq );
+
+    /* evicted steps leave a hole in the spill file that gets closed */
+    count = 0;
+    deep = g_object_new( GUNDO_TYPE_SEQUENCE, "max-depth", 1000, "spill-depth", 5, NULL );
+    open_spill( deep, filename );
+    for( i = 0; i < 400000; i++ ) {
+        do_file_add( deep, 1 );
+    }
+    for( i = 0; i < 1000; i++ ) {
+        gundo_history_undo( GUNDO_HISTORY(deep) );
+    }
+    check_value( 399000, "spill: undid an evicting sequence" );
+    check_usage( deep, "spill: usage of an evicting sequence" );
+    g_object_unref( deep );
+
+    /* spilled payloads are discarded like any other, so they honour
+     * deferred-free too */
+    seq = g_object_new( GUNDO_TYPE_SEQUENCE, "spill-depth", 10, "deferred-free", TRUE, NULL );
+    open_spill( seq, NULL );
+    n_freed = 0;
+    for( i = 0; i < 100; i++ ) {
+        do_file_add( seq, 1 );
+    }
+    if( n_freed != 0 ) {
+        fprintf( stderr, "spill: FAILED: freed %i spilled actions synchronously\n", n_freed );
+        exit(1);
+    }
+    while( g_main_context_iteration( NULL, FALSE ) );
+    if( n_freed != 90 ) {
+        fprintf( stderr, "spill: FAILED: freed %i spilled actions, expected 90\n", n_freed );
+        exit(1);
+    }
+    g_object_unref( seq );
+    gundo_sequence_flush_discarded( NULL );
+
+    /* a spilled action that can't be loaded back stops undo in front of
+     * its step, and keeps the spill open */
+    count = 0;
+    seq = g_object_new( GUNDO_TYPE_SEQUENCE, "spill-depth", 10, NULL );
+    history = GUNDO_HISTORY(seq);
+    open_spill( seq, NULL );
+    for( i = 1; i <= 100; i++ ) {
+        do_file_add( seq, i );
+    }
+    damaged_delta = 50;
+    gundo_history_goto( history, 0 );
+    gundo_history_undo( history );
+    if( gundo_history_get_position( history ) != 50 ||
+        gundo_sequence_get_restore_error( seq, &error ) ) {
+        fprintf( stderr, "spill: FAILED: got to %u past a damaged action\n",
+                 gundo_history_get_position( history ) );
+        exit(1);
+    }
+    check_error( error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "spill: damaged action" );
+    g_clear_error( &error );
+    check_value( 50 * 51 / 2, "spill: stopped at a damaged action" );
+    check_usage( seq, "spill: usage with a damaged action" );
+    if( gundo_sequence_close_spill( seq, &error ) ) {
+        fprintf( stderr, "spill: FAILED: closed the spill of a damaged action\n" );
+        exit(1);
+    }
+    check_error( error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "spill: closing with a damaged action" );
+    g_clear_error( &error );
+
+    /* its bytes are still there */
+    damaged_delta = 0;
+    gundo_history_goto( history, 0 );
+    check_value( 0, "spill: undid past a repaired action" );
+    if( !gundo_sequence_close_spill( seq, &error ) ) {
+        fprintf( stderr, "spill: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    check_usage( seq, "spill: usage after closing" );
+    g_object_unref( seq );
+
+    g_free( filename );
+}
+
+typedef struct ColdData ColdData;
+struct ColdData {
+    int delta;
+    char text[124];
+};
+
+static gsize size_cold( gpointer p ) {
+    return sizeof(ColdData);
+}
+
+static void serialize_cold( gpointer p, GByteArray *buffer ) {
+    g_byte_array_append( buffer, p, sizeof(ColdData) );
+}
+
+static gpointer deserialize_cold( gconstpointer bytes, gsize len ) {
+    ColdData *d = g_new( ColdData, 1 );
+
+    if( len != sizeof(ColdData) ) {
+        fprintf( stderr, "compression: FAILED: read back %u bytes\n", (guint) len );
+        exit(1);
+    }
+    memcpy( d, bytes, len );
+    if( damaged_delta && d->delta == damaged_delta ) {
+        g_free( d );
+        return NULL;
+    }
+    n_deserialized++;
+    return d;
+}
+
+static GundoActionType test_cold_action = { .undo = undo_add, .redo = redo_add, .free = free_data,
+                                            .size = size_cold,
+                                            .serialize = serialize_cold,
+                                            .deserialize = deserialize_cold };
+
+static void do_cold_add( GundoSequence *seq, int delta ) {
+    ColdData *d = g_new( ColdData, 1 );
+    d->delta = delta;
+    memset( d->text, 'a' + delta % 26, sizeof(d->text) );
+    count += delta;
+    gundo_sequence_add_action( seq, &test_cold_action, d );
+}
+
+static void test_compression() {
+    const GundoActionType *types[] = { &test_cold_action };
+    GundoSequence *seq = g_object_new( GUNDO_TYPE_SEQUENCE, "compress-distance", 10,
+                                       "branching", TRUE, NULL );
+    GundoSequence *loaded;
+    GundoSequence *deep;
+    GundoHistory * history = GUNDO_HISTORY(seq);
+    GundoCompressionStats stats;
+    GundoMemoryUsage undo, redo;
+    GError *error = NULL;
+    gchar *filename = temp_filename();
+    guint branch;
+    int i;
+
+    /* the steps beyond the distance get compressed right away */
+    count = 0;
+    n_freed = 0;
+    n_deserialized = 0;
+    for( i = 1; i <= 1000; i++ ) {
+        do_cold_add( seq, i );
+    }
+    gundo_sequence_flush_compression( seq );
+    gundo_sequence_get_compression_stats( seq, &stats );
+    gundo_history_get_memory_usage( history, &undo, &redo );
+    if( n_freed != 990 || n_deserialized != 0 || stats.n_actions != 990 ||
+        stats.raw_bytes != 990 * sizeof(ColdData) || stats.compressed_bytes * 4 > stats.raw_bytes ||
+        stats.decompress.n_calls != 0 || undo.payloads != 10 * sizeof(ColdData) ) {
+        fprintf( stderr, "compression: FAILED: compressed %u actions from %u to %u bytes\n",
+                 (guint) stats.n_actions, (guint) stats.raw_bytes, (guint) stats.compressed_bytes );
+        exit(1);
+    }
+    check_usage( seq, "compression: usage after compressing" );
+
+    /* undoing decompresses the undoable steps it reaches and compresses the
+     * redoable ones beyond the distance */
+    for( i = 0; i < 20; i++ ) {
+        gundo_history_undo( history );
+    }
+    check_value( 500500 - 19810, "compression: undid some" );
+    gundo_sequence_get_compression_stats( seq, &stats );
+    if( n_deserialized != 10 || n_freed != 1000 || stats.n_actions != 990 ||
+        stats.decompress.n_calls == 0 ) {
+        fprintf( stderr, "compression: FAILED: loaded %i actions, compressed %i\n",
+                 n_deserialized, n_freed );
+        exit(1);
+    }
+    check_usage( seq, "compression: usage after undoing" );
+
+    gundo_history_goto( history, 1000 );
+    check_value( 500500, "compression: redid" );
+    if( n_deserialized != 20 ) {
+        fprintf( stderr, "compression: FAILED: loaded %i actions, expected 20\n", n_deserialized );
+        exit(1);
+    }
+    check_usage( seq, "compression: usage after redoing" );
+
+    /* compressed actions get saved without being loaded */
+    if( !gundo_sequence_save( seq, filename, types, G_N_ELEMENTS(types), &error ) ) {
+        fprintf( stderr, "compression: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    if( n_deserialized != 20 ) {
+        fprintf( stderr, "compression: FAILED: saving loaded compressed actions\n" );
+        exit(1);
+    }
+    count = 0;
+    loaded = gundo_sequence_new();
+    if( !gundo_sequence_load( loaded, filename, types, G_N_ELEMENTS(types), &error ) ) {
+        fprintf( stderr, "compression: FAILED: %s\n", error->message );
+        exit(1);
+    }
+    while( gundo_history_can_undo( GUNDO_HISTORY(loaded) ) ) {
+        gundo_history_undo( GUNDO_HISTORY(loaded) );
+    }
+    check_value( -500500, "compression: undid the saved copy" );
+    g_object_unref( loaded );
+
+    /* compressed redoable steps survive in a branch */
+    count = 500500;
+    gundo_history_goto( history, 900 );
+    branch = gundo_sequence_get_branch( seq );
+    do_cold_add( seq, 1 );
+    if( !gundo_sequence_switch_branch( seq, branch ) ) {
+        fprintf( stderr, "compression: FAILED: lost the branch\n" );
+        exit(1);
+    }
+    check_value( 500500, "compression: switched back" );
+    gundo_sequence_set_branching( seq, FALSE );
+    check_usage( seq, "compression: usage after switching" );
+
+    /* turning it off decompresses the line */
+    gundo_sequence_set_compress_distance( seq, 0 );
+    gundo_sequence_get_compression_stats( seq, &stats );
+    gundo_history_get_memory_usage( history, &undo, &redo );
+    if( stats.n_actions != 0 || undo.payloads != 1000 * sizeof(ColdData) ) {
+        fprintf( stderr, "compression: FAILED: %u actions stayed compressed\n", (guint) stats.n_actions );
+        exit(1);
+    }
+    check_usage( seq, "compression: usage after turning it off" );
+    g_object_unref( seq );
+
+    /* small actions aren't worth it */
+    deep = g_object_new( GUNDO_TYPE_SEQUENCE, "compress-distance", 1, NULL );
+    for( i = 0; i < 100; i++ ) {
+        do_file_add( deep, 1 );
+    }
+    gundo_sequence_get_compression_stats( deep, &stats );
+    if( stats.n_actions != 0 ) {
+        fprintf( stderr, "compression: FAILED: compressed small actions\n" );
+        exit(1);
+    }
+    g_object_unref( deep );
+
+    /* evicted steps release their batches */
+    count = 0;
+    deep = g_object_new( GUNDO_TYPE_SEQUENCE, "max-depth", 1000, "compress-distance", 5, NULL );
+    for( i = 0; i < 100000; i++ ) {
+        do_cold_add( deep, 1 );
+    }
+    gundo_sequence_flush_compression( deep );
+    gundo_sequence_get_compression_stats( deep, &stats );
+    if( stats.n_actions != 995 || stats.raw_bytes > 2 * 995 * sizeof(ColdData) + 128 * 1024 ) {
+        fprintf( stderr, "compression: FAILED: %u bytes held after evicting\n", (guint) stats.raw_bytes );
+        exit(1);
+    }
+    for( i = 0; i < 1000; i++ ) {
+        gundo_history_undo( GUNDO_HISTORY(deep) );
+    }
+    check_value( 99000, "compression: undid an evicting sequence" );
+    check_usage( deep, "compression: usage of an evicting sequence" );
+    g_object_unref( deep );
+
+    /* compressed payloads count for the budget */
+    count = 0;
+    deep = g_object_new( GUNDO_TYPE_SEQUENCE, "compress-distance", 5, NULL );
+    gundo_sequence_set_max_size( deep, 64 * 1024 );
+    for( i = 0; i < 100000; i++ ) {
+        do_cold_add( deep, 1 );
+    }
+    if( gundo_history_get_position( GUNDO_HISTORY(deep) ) >= 100000 ) {
+        fprintf( stderr, "compression: FAILED: nothing got evicted\n" );
+        exit(1);
+    }
+    g_object_unref( deep );
+
+    /* compressed payloads are discarded like any other, so they honour
+     * deferred-free too */
+    deep = g_object_new( GUNDO_TYPE_SEQUENCE, "compress-distance", 10, "deferred-free", TRUE, NULL );
+    n_freed = 0;
+    for( i = 0; i < 100; i++ ) {
+        do_cold_add( deep, 1 );
+    }
+    if( n_freed != 0 ) {
+        fprintf( stderr, "compression: FAILED: freed %i compressed actions synchronously\n", n_freed );
+        exit(1);
+    }
+    while( g_main_context_iteration( NULL, FALSE ) );
+    if( n_freed != 90 ) {
+        fprintf( stderr, "compression: FAILED: freed %i compressed actions, expected 90\n", n_freed );
+        exit(1);
+    }
+    g_object_unref( deep );
+    gundo_sequence_flush_discarded( NULL );
+
+    /* a compressed action that can't be restored stops undo in front of
+     * its step */
+    count = 0;
+    deep = g_object_new( GUNDO_TYPE_SEQUENCE, "compress-distance", 10, NULL );
+    for( i = 1; i <= 100; i++ ) {
+        do_cold_add( deep, i );
+    }
+    gundo_sequence_flush_compression( deep );
+    damaged_delta = 50;
+    gundo_history_goto( GUNDO_HISTORY(deep), 0 );
+    gundo_history_undo( GUNDO_HISTORY(deep) );
+    if( gundo_history_get_position( GUNDO_HISTORY(deep) ) != 50 ||
+        gundo_sequence_get_restore_error( deep, &error ) ) {
+        fprintf( stderr, "compression: FAILED: got to %u past a damaged action\n",
+                 gundo_history_get_position( GUNDO_HISTORY(deep) ) );
+        exit(1);
+    }
+    check_error( error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "compression: damaged action" );
+    g_clear_error( &error );
+    check_value( 50 * 51 / 2, "compression: stopped at a damaged action" );
+    check_usage( deep, "compression: usage with a damaged action" );
+    damaged_delta = 0;
+    g_object_unref( deep );
+
+    g_free( filename );
+}
+
+static int n_replayed = 0;
+static int n_snapshots = 0;
+static int n_restores = 0;
+
+static void undo_replayed( gpointer p ) {
+    n_replayed++;
+    undo_add( p );
+}
+
+static void redo_replayed( gpointer p ) {
+    n_replayed++;
+    redo_add( p );
+}
+
+static void undo_slow( gpointer p ) {
+    g_usleep( 1000 );
+    undo_replayed( p );
+}
+
+static void redo_slow( gpointer p ) {
+    g_usleep( 1000 );
+    redo_replayed( p );
+}
+
+static GundoActionType test_replayed_action = { .undo = undo_replayed, .redo = redo_replayed, .free = free_data };
+
+static GundoActionType test_slow_action = { .undo = undo_slow, .redo = redo_slow, .free = free_data };
+
+static void do_replayed_add( GundoSequence *seq, const GundoActionType *type, int delta ) {
+    MergeData *data = g_new( MergeData, 1 );
+    data->delta = delta;
+    count += delta;
+    gundo_sequence_add_action( seq, type, data );
+}
+
+static gpointer snapshot_count( gpointer user_data ) {
+    n_snapshots++;
+    return g_memdup( &count, sizeof(count) );
+}
+
+static void restore_count( gpointer snapshot, gpointer user_data ) {
+    n_restores++;
+    count = *(int*)snapshot;
+}
+
+static void destroy_checkpoint_data( gpointer user_data ) {
+    *(gboolean*)user_data = TRUE;
+}
+
+static void check_checkpoints( GundoSequence *seq, guint n, const char *test_id ) {
+    if( gundo_sequence_get_n_checkpoints( seq ) != n ) {
+        fprintf( stderr, "%s: FAILED: %u checkpoints, expected %u\n",
+                 test_id, gundo_sequence_get_n_checkpoints( seq ), n );
+        exit(1);
+    }
+}
+
+static void check_replayed( int n, int n_restored, const char *test_id ) {
+    if( n_replayed != n || n_restores != n_restored ) {
+        fprintf( stderr, "%s: FAILED: replayed %i steps and restored %i times, expected %i and %i\n",
+                 test_id, n_replayed, n_restores, n, n_restored );
+        exit(1);
+    }
+}
+
+static GundoActionType test_slow_file_action = { .undo = undo_slow, .redo = redo_slow, .free = free_data,
+                                                .size = size_add,
+                                                .serialize = serialize_add,
+                                                .deserialize = deserialize_add };
+
+static GundoActionType test_slow_cold_action = { .undo = undo_slow, .redo = redo_slow, .free = free_data,
+                                                .size = size_cold,
+                                                .serialize = serialize_cold,
+                                                .deserialize = deserialize_cold };
+
+/* jumps to a checkpoint only load the steps replayed from there */
+static void test_checkpoint_tiers() {
+    GundoSequence *seq;
+    GundoHistory *history;
+    GError *error = NULL;
+    guint branch;
+    int i;
+
+    /* spilled steps stay in the file when a jump passes them */
+    count = 0;
+    seq = g_object_new( GUNDO_TYPE_SEQUENCE, "spill-depth", 10, "checkpoint-interval", 10,
+                        "checkpoint-cost", (guint64) 0, "max-checkpoints", 0, NULL );
+    history = GUNDO_HISTORY(seq);
+    gundo_sequence_set_checkpoint_funcs( seq, snapshot_count, restore_count, g_free, NULL, NULL );
+    open_spill( seq, NULL );
+    for( i = 1; i <= 100; i++ ) {
+        do_replayed_add( seq, &test_slow_file_action, i );
+    }
+    n_deserialized = 0;
+    n_replayed = 0;
+    n_restores = 0;
+    gundo_history_goto( history, 5 );
+    check_value( 15, "checkpoint tiers: jumped over spilled steps" );
+    check_replayed( 5, 1, "checkpoint tiers: jumped over spilled steps" );
+    if( n_deserialized != 5 ) {
+        fprintf( stderr, "checkpoint tiers: FAILED: loaded %i spilled actions, expected 5\n",
+                 n_deserialized );
+        exit(1);
+    }
+    check_usage( seq, "checkpoint tiers: usage after jumping back" );
+    gundo_history_goto( history, 100 );
+    check_value( 5050, "checkpoint tiers: jumped forward over spilled steps" );
+    if( n_deserialized != 5 ) {
+        fprintf( stderr, "checkpoint tiers: FAILED: loaded %i spilled actions, expected 5\n",
+                 n_deserialized );
+        exit(1);
+    }
+    check_usage( seq, "checkpoint tiers: usage after jumping forward" );
+    while( gundo_history_can_undo( history ) ) {
+        gundo_history_undo( history );
+    }
+    check_value( 0, "checkpoint tiers: undid the spilled steps" );
+
+    /* adding drops the spilled steps a jump left on the redo side */
+    gundo_history_goto( history, 40 );
+    gundo_history_goto( history, 25 );
+    do_replayed_add( seq, &test_slow_file_action, 1000 );
+    check_value( 325 + 1000, "checkpoint tiers: added after jumping" );
+    check_usage( seq, "checkpoint tiers: usage after adding" );
+    while( gundo_history_can_undo( history ) ) {
+        gundo_history_undo( history );
+    }
+    check_value( 0, "checkpoint tiers: undid after adding" );
+    if( !gundo_sequence_close_spill( seq, NULL ) ) {
+        fprintf( stderr, "checkpoint tiers: FAILED: the spill failed\n" );
+        exit(1);
+    }
+    g_object_unref( seq );
+
+    /* a branch cut off spilled steps ends in front of one that can't be
+     * loaded back, and the branches forking off later are gone */
+    count = 0;
+    seq = g_object_new( GUNDO_TYPE_SEQUENCE, "spill-depth", 10, "checkpoint-interval", 10,
+                        "checkpoint-cost", (guint64) 0, "max-checkpoints", 0, "branching", TRUE, NULL );
+    history = GUNDO_HISTORY(seq);
+    gundo_sequence_set_checkpoint_funcs( seq, snapshot_count, restore_count, g_free, NULL, NULL );
+    open_spill( seq, NULL );
+    for( i = 1; i <= 100; i++ ) {
+        do_replayed_add( seq, &test_slow_file_action, i );
+    }
+    gundo_history_goto( history, 70 );
+    do_replayed_add( seq, &test_slow_file_action, 2000 );
+    gundo_history_goto( history, 5 );
+    branch = gundo_sequence_get_branch( seq );
+    damaged_delta = 50;
+    do_replayed_add( seq, &test_slow_file_action, 1000 );
+    damaged_delta = 0;
+    check_value( 15 + 1000, "checkpoint tiers: added after a damaged action" );
+    if( gundo_sequence_get_n_branches( seq ) != 1 ||
+        gundo_sequence_get_restore_error( seq, &error ) ) {
+        fprintf( stderr, "checkpoint tiers: FAILED: kept %u branches past a damaged action\n",
+                 gundo_sequence_get_n_branches( seq ) );
+        exit(1);
+    }
+    check_error( error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "checkpoint tiers: damaged action" );
+    g_clear_error( &error );
+    gundo_sequence_switch_branch( seq, branch );
+    check_value( 49 * 50 / 2, "checkpoint tiers: switched to a branch ending at a damaged action" );
+    check_steps( seq, 49, 0, "checkpoint tiers: switched to a branch ending at a damaged action" );
+    g_object_unref( seq );
+
+    /* so do compressed ones */
+    count = 0;
+    seq = g_object_new( GUNDO_TYPE_SEQUENCE, "compress-distance", 10, "checkpoint-interval", 10,
+                        "checkpoint-cost", (guint64) 0, "max-checkpoints", 0, NULL );
+    history = GUNDO_HISTORY(seq);
+    gundo_sequence_set_checkpoint_funcs( seq, snapshot_count, restore_count, g_free, NULL, NULL );
+    for( i = 1; i <= 100; i++ ) {
+        ColdData *d = g_new( ColdData, 1 );
+        d->delta = i;
+        memset( d->text, 'a' + i % 26, sizeof(d->text) );
+        count += i;
+        gundo_sequence_add_action( seq, &test_slow_cold_action, d );
+    }
+    gundo_sequence_flush_compression( seq );
+    n_deserialized = 0;
+    gundo_history_goto( history, 5 );
+    check_value( 15, "checkpoint tiers: jumped over compressed steps" );
+    gundo_history_goto( history, 100 );
+    check_value( 5050, "checkpoint tiers: jumped forward over compressed steps" );
+    if( n_deserialized != 5 ) {
+        fprintf( stderr, "checkpoint tiers: FAILED: loaded %i compressed actions, expected 5\n",
+                 n_deserialized );
+        exit(1);
+    }
+    check_usage( seq, "checkpoint tiers: usage after jumping over compressed steps" );
+    while( gundo_history_can_undo( history ) ) {
+        gundo_history_undo( history );
+    }
+    check_value( 0, "checkpoint tiers: undid the compressed steps" );
+    g_object_unref( seq );
+}
+
+static void test_checkpoints() {
+    GundoSequence *seq = g_object_new( GUNDO_TYPE_SEQUENCE, "checkpoint-interval", 10,
+                                       "checkpoint-cost", (guint64) 0, "max-checkpoints", 0, NULL );
+    GundoHistory *history = GUNDO_HISTORY(seq);
+    gboolean destroyed = FALSE;
+    guint n;
+    int i;
+
+    count = 0;
+    n_replayed = 0;
+    n_snapshots = 0;
+    n_restores = 0;
+
+    /* the current state gets checkpointed right away, then every 10 steps */
+    gundo_sequence_set_checkpoint_funcs( seq, snapshot_count, restore_count, g_free,
+                                         &destroyed, destroy_checkpoint_data );
+    for( i = 1; i <= 100; i++ ) {
+        do_replayed_add( seq, &test_slow_action, i );
+    }
+    check_checkpoints( seq, 11, "checkpoints: added" );
+
+    /* far jumps restore the closest checkpoint and replay from there */
+    gundo_history_goto( history, 5 );
+    check_value( 15, "checkpoints: jumped back" );
+    check_replayed( 5, 1, "checkpoints: jumped back" );
+    gundo_history_goto( history, 97 );
+    check_value( 4753, "checkpoints: jumped forward" );
+    check_replayed( 8, 2, "checkpoints: jumped forward" );
+    gundo_history_goto( history, 55 );
+    check_value( 1540, "checkpoints: jumped back again" );
+    check_replayed( 13, 3, "checkpoints: jumped back again" );
+
+    /* short ones just replay */
+    gundo_history_undo( history );
+    gundo_history_goto( history, 55 );
+    check_value( 1540, "checkpoints: stepped" );
+    check_replayed( 15, 3, "checkpoints: stepped" );
+
+    /* adding drops the checkpoints that can't be redone anymore */
+    do_replayed_add( seq, &test_replayed_action, 1000 );
+    check_checkpoints( seq, 6, "checkpoints: truncated" );
+
+    /* merging changes the state of the latest checkpoint */
+    gundo_sequence_set_checkpoint_interval( seq, 1 );
+    do_add( seq, 1 );
+    check_checkpoints( seq, 7, "checkpoints: added with interval 1" );
+    do_add( seq, 1 );
+    check_checkpoints( seq, 6, "checkpoints: merged" );
+    gundo_sequence_set_checkpoint_interval( seq, 10 );
+
+    gundo_sequence_set_max_checkpoints( seq, 1 );
+    check_checkpoints( seq, 1, "checkpoints: thinned" );
+
+    gundo_sequence_set_checkpoint_funcs( seq, NULL, NULL, NULL, NULL, NULL );
+    check_checkpoints( seq, 0, "checkpoints: unset" );
+    if( !destroyed ) {
+        fprintf( stderr, "checkpoints: FAILED: user data not destroyed\n" );
+        exit(1);
+    }
+    g_object_unref( seq );
+
+    /* evicting drops the checkpoints of the evicted states */
+    count = 0;
+    n_replayed = 0;
+    n_restores = 0;
+    seq = g_object_new( GUNDO_TYPE_SEQUENCE, "max-depth", 20, "checkpoint-interval", 10,
+                        "checkpoint-cost", (guint64) 0, NULL );
+    history = GUNDO_HISTORY(seq);
+    gundo_sequence_set_checkpoint_funcs( seq, snapshot_count, restore_count, g_free, NULL, NULL );
+    for( i = 1; i <= 50; i++ ) {
+        do_replayed_add( seq, &test_replayed_action, i );
+    }
+    check_checkpoints( seq, 3, "checkpoints: evicted" );
+    gundo_history_goto( history, 3 );
+    check_value( 561, "checkpoints: jumped after evicting" );
+    check_replayed( 3, 1, "checkpoints: jumped after evicting" );
+    g_object_unref( seq );
+
+    /* without an interval, the measured cost of the actions decides */
+    count = 0;
+    seq = g_object_new( GUNDO_TYPE_SEQUENCE, "checkpoint-cost", (guint64) 5000000, NULL );
+    history = GUNDO_HISTORY(seq);
+    gundo_sequence_set_checkpoint_funcs( seq, snapshot_count, restore_count, g_free, NULL, NULL );
+    for( i = 1; i <= 20; i++ ) {
+        do_replayed_add( seq, &test_slow_action, i );
+    }
+    check_checkpoints( seq, 1, "checkpoints: added unmeasured actions" );
+
+    /* replaying measures them and places checkpoints on the way */
+    gundo_history_goto( history, 10 );
+    check_value( 55, "checkpoints: replayed unmeasured actions" );
+    n = gundo_sequence_get_n_checkpoints( seq );
+    if( n < 3 ) {
+        fprintf( stderr, "checkpoints: FAILED: %u checkpoints after replaying\n", n );
+        exit(1);
+    }
+    gundo_history_goto( history, 20 );
+    check_value( 210, "checkpoints: went back to the tip" );
+
+    /* further expensive actions get checkpointed as they are added; how
+     * many checkpoints the measurements give is up to the timing, so only
+     * the minimum is checked */
+    n = gundo_sequence_get_n_checkpoints( seq );
+    for( i = 21; i <= 40; i++ ) {
+        do_replayed_add( seq, &test_slow_action, i );
+    }
+    if( gundo_sequence_get_n_checkpoints( seq ) < n + 3 ) {
+        fprintf( stderr, "checkpoints: FAILED: %u checkpoints after adding measured actions\n",
+                 gundo_sequence_get_n_checkpoints( seq ) );
+        exit(1);
+    }
+
+    gundo_history_goto( history, 0 );
+    check_value( 0, "checkpoints: jumped to the start" );
+    g_object_unref( seq );
+
+    test_checkpoint_tiers();
+}
+
 int main( int argc, char **argv ) {
     g_type_init();
     test_undo();
     test_groups();
+    test_nested_groups();
+    test_budget();
+    test_max_depth();
+    test_reserve();
+    test_storage_blocks();
+    test_deferred_free();
+    test_merge();
+    test_inline();
+    test_group_alloc();
+    test_set_max_depth();
+    test_goto();
+    test_signal_emission();
+    test_instrumentation();
+    test_trace();
+    test_memory_usage();
+    test_deep_groups();
+    test_quiet_groups();
+    test_add_actions();
+    test_freeze_notify();
+    test_stacks_changed();
+    test_quiet_group_budget();
+    test_add_actions_limits();
+    test_branches();
+    test_history_file();
+    test_journal();
+    test_spill();
+    test_compression();
+    test_checkpoints();
     printf( "%s: OK\n", argv[0] );
     return 0;
 }